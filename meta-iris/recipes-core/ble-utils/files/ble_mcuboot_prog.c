@@ -63,14 +63,20 @@
 
 
 #define RX_TIMEOUT                          10
+#define PARAMS_TIMEOUT                      2
 #define MAX_BLE_RESET_ATTEMPTS              5
+#define MAX_TX_RETRIES                      3
 
 #define CRC_POLY                            0x1021
 #define CRC_INIT                            0x0000
 
 #define NMP_HDR_SIZE                        8
 #define READ_CHUNK_SIZE                     196
-#define MAX_BUF_SIZE                        512
+#define LINE_SIZE                           124
+#define MAX_BUF_SIZE                        2048
+
+/* Room for the newtmgr header and the CBOR around the image data */
+#define UPLOAD_OVERHEAD                     64
 
 #define NMP_OP_READ                         0
 #define NMP_OP_READ_RSP                     1
@@ -82,6 +88,9 @@
 
 #define NMP_ID_IMAGE_UPLOAD                 1
 #define NMP_ID_CONS_ECHO_CTRL               1
+#define NMP_ID_PARAMS                       6
+
+#define NMP_RC_BAD_OFFSET                   33
 
 #define SHELL_NLIP_PKT_START1               6
 #define SHELL_NLIP_PKT_START2               9
@@ -89,11 +98,24 @@
 #define SHELL_NLIP_DATA_START1              4
 #define SHELL_NLIP_DATA_START2              20
 
+#define BOOT_SERIAL_RAW_START1              6
+#define BOOT_SERIAL_RAW_START2              11
+
 /* ----------------------------------------------------------------------------
  *                                           Typedefs
  * ----------------------------------------------------------------------------
  */
 
+/* How data is sent to the bootloader.  Older bootloaders only take short
+ * base64 lines and answer every chunk; newer ones report what they can
+ * handle in response to a params request. */
+typedef struct {
+    int     lineSize;       // base64 characters per line
+    int     chunkSize;      // image bytes per upload request
+    int     window;         // upload requests sent before waiting
+    bool    raw;            // binary frames accepted
+} BleLink;
+
 
 /* ---------------------------------------------------------------------------
  *                                     Local Variables
@@ -108,6 +130,9 @@ static unsigned char ble_res[MAX_BUF_SIZE];
 
 static unsigned char curSeq = 0;
 
+static const BleLink legacyLink = { LINE_SIZE, READ_CHUNK_SIZE, 1, false };
+static BleLink bleLink;
+
 /* Reset support in in main code */
 void BLE_assertReset(void);
 void BLE_deassertReset(void);
@@ -140,7 +165,21 @@ static unsigned short crc16(unsigned char *buf, int len, bool pad)
     return crc;
 }
 
-static int BLE_getByte(int fd, unsigned char* ch) {
+static unsigned long crc32(unsigned char *buf, int len)
+{
+    unsigned long crc = 0xFFFFFFFF;
+    int b;
+
+    while (len--) {
+        crc ^= *buf++;
+        for (b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+        }
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+static int BLE_getByte(int fd, unsigned char* ch, int timeoutSecs) {
     unsigned char newchar;
     fd_set set;
     struct timeval timeout;
@@ -150,7 +189,7 @@ static int BLE_getByte(int fd, unsigned char* ch) {
     FD_SET(fd, &set);
 
     /* Timeout after a few seconds */
-    timeout.tv_sec = RX_TIMEOUT/2;
+    timeout.tv_sec = timeoutSecs;
     timeout.tv_usec = 0;
 
     if (select(fd + 1, &set, NULL, NULL, &timeout) > 0) {
@@ -163,13 +202,14 @@ static int BLE_getByte(int fd, unsigned char* ch) {
 }
 
 // Get a line from BLE module
-static int BLE_getLine(int fd, unsigned char *buf, size_t maxLen)
+static int BLE_getLine(int fd, unsigned char *buf, size_t maxLen,
+                       int timeoutSecs)
 {
     unsigned char ch;
     int index = 0;
 
     // Messages end with a newline
-    while (BLE_getByte(fd, &ch) == 0) {
+    while (BLE_getByte(fd, &ch, timeoutSecs) == 0) {
         if (ch == '\n') {
             return index;
         }
@@ -194,7 +234,7 @@ static int BLE_tx(int fd, unsigned char *buf, int len)
 {
     unsigned short crc;
     int i, written;
-    unsigned char encoded[MAX_BUF_SIZE];
+    unsigned char encoded[MAX_BUF_SIZE * 2];
     size_t encoded_len;
 
     // Add length - account for CRC bytes as well
@@ -229,8 +269,10 @@ static int BLE_tx(int fd, unsigned char *buf, int len)
         } else {
             /* slower platforms take some time to process each segment
              * and have very small receive buffers.  Give them a bit of
-             * time here */
-            usleep(20000);
+             * time here, unless they told us about their buffers */
+            if (bleLink.window == 1) {
+                usleep(20000);
+            }
             BLE_txRaw(fd, cont, sizeof(cont));
         }
 
@@ -240,9 +282,10 @@ static int BLE_tx(int fd, unsigned char *buf, int len)
          * we need to save room for the header (2 byte) and
          * carriage return (and possibly LF 2 bytes), */
 
-        /* all totaled, 124 bytes should work */
-        writeLen = (124 < (encoded_len - written)) ? 124 :
-          (encoded_len - written);
+        /* all totaled, 124 bytes should work - newer bootloaders
+         * take longer lines */
+        writeLen = (bleLink.lineSize < (encoded_len - written)) ?
+          bleLink.lineSize : (encoded_len - written);
 
         // Write packet data
         if (BLE_txRaw(fd, &encoded[written], writeLen)) {
@@ -257,10 +300,32 @@ static int BLE_tx(int fd, unsigned char *buf, int len)
     return 0;
 }
 
+// Send a packet as a binary frame, protected by a CRC32 instead of base64
+static int BLE_txFrame(int fd, unsigned char *buf, int len)
+{
+    unsigned long crc;
+
+    ble_buf[0] = BOOT_SERIAL_RAW_START1;
+    ble_buf[1] = BOOT_SERIAL_RAW_START2;
+
+    // Length covers the data and the CRC
+    ble_buf[2] = ((len + 4) & 0xFF00) >> 8;
+    ble_buf[3] = (len + 4) & 0x00FF;
+    memcpy(&ble_buf[4], buf, len);
+
+    crc = crc32(buf, len);
+    ble_buf[4 + len] = (crc >> 24) & 0xFF;
+    ble_buf[5 + len] = (crc >> 16) & 0xFF;
+    ble_buf[6 + len] = (crc >> 8) & 0xFF;
+    ble_buf[7 + len] = crc & 0xFF;
+
+    return BLE_txRaw(fd, ble_buf, len + 8);
+}
+
 // Blocking receive.
-static unsigned char *BLE_getMsg(int fd, int *retLen)
+static unsigned char *BLE_getMsg(int fd, int *retLen, int timeoutSecs)
 {
-    time_t endTime = time(NULL) + RX_TIMEOUT;
+    time_t endTime = time(NULL) + timeoutSecs;
 
     // Get data
     while (time(NULL) < endTime) {
@@ -270,7 +335,8 @@ static unsigned char *BLE_getMsg(int fd, int *retLen)
         unsigned char decoded[MAX_BUF_SIZE];
 
         // Get line
-        dataLen = BLE_getLine(fd, ble_res, sizeof(ble_res));
+        dataLen = BLE_getLine(fd, ble_res, sizeof(ble_res),
+                              (timeoutSecs + 1) / 2);
 
         //fprintf(stdout, "Got BLE response(%d): %s\n", dataLen, ble_res);
 
@@ -340,8 +406,8 @@ static unsigned char *BLE_getMsg(int fd, int *retLen)
 }
 
 
-static unsigned char *BLE_txNmp(int fd, unsigned char *hdr,
-                                unsigned char *buf, int len, int *resLen)
+static int BLE_sendNmp(int fd, unsigned char *hdr, unsigned char *buf,
+                       int len)
 {
     unsigned char data[MAX_BUF_SIZE];
 
@@ -354,13 +420,23 @@ static unsigned char *BLE_txNmp(int fd, unsigned char *hdr,
     }
 
     // Send message
-    if (BLE_tx(fd, data, len + NMP_HDR_SIZE)) {
+    if (bleLink.raw) {
+        return BLE_txFrame(fd, data, len + NMP_HDR_SIZE);
+    }
+    return BLE_tx(fd, data, len + NMP_HDR_SIZE);
+}
+
+static unsigned char *BLE_txNmp(int fd, unsigned char *hdr,
+                                unsigned char *buf, int len, int *resLen)
+{
+    // Send message
+    if (BLE_sendNmp(fd, hdr, buf, len)) {
         *resLen = 0;
         return NULL;
     }
 
     // Return response
-    return BLE_getMsg(fd, resLen);
+    return BLE_getMsg(fd, resLen, RX_TIMEOUT);
 }
 
 
@@ -388,14 +464,107 @@ void BLE_populateNmpHdr(unsigned char *hdr, unsigned char nmp_op,
 }
 
 
+// Send one upload request, without waiting for the response
+static int BLE_txChunk(int fd, unsigned char *image, size_t fileSize,
+                       int offset, int count, int slot, bool ack)
+{
+    unsigned char hdr[NMP_HDR_SIZE];
+    unsigned char body[MAX_BUF_SIZE];
+    int bodyLen;
+    CborEncoder encoder, mapEncoder;
+
+    // Create CBOR data
+    cbor_encoder_init(&encoder, body, sizeof(body), 0);
+    cbor_encoder_create_map(&encoder, &mapEncoder, CborIndefiniteLength);
+    cbor_encode_text_stringz(&mapEncoder, "off");
+    cbor_encode_uint(&mapEncoder, offset);
+    if (offset == 0) {
+        // Set upper byte with slot value (really just 0 or 1)
+        cbor_encode_text_stringz(&mapEncoder, "len");
+        cbor_encode_uint(&mapEncoder, fileSize | ((slot & 0x0F) << 24));
+    }
+    cbor_encode_text_stringz(&mapEncoder, "data");
+    cbor_encode_byte_string(&mapEncoder, &image[offset], count);
+    if (!ack) {
+        // Only the last request of a window is answered
+        cbor_encode_text_stringz(&mapEncoder, "ack");
+        cbor_encode_boolean(&mapEncoder, false);
+    }
+    cbor_encoder_close_container(&encoder, &mapEncoder);
+    bodyLen = cbor_encoder_get_buffer_size (&encoder, body);
+
+    // Create header
+    BLE_populateNmpHdr(hdr, NMP_OP_WRITE, NMP_GROUP_IMAGE,
+                       NMP_ID_IMAGE_UPLOAD, bodyLen);
+
+    return BLE_sendNmp(fd, hdr, body, bodyLen);
+}
+
+// Wait for the answer to a window of upload requests, the first of which
+// used sequence number firstSeq.  Returns the offset to carry on from.
+static int BLE_rxChunkRsp(int fd, unsigned char firstSeq, int count,
+                          int sent)
+{
+    unsigned char *response;
+    int resLen;
+
+    while ((response = BLE_getMsg(fd, &resLen, RX_TIMEOUT)) != NULL) {
+        CborParser parser;
+        CborValue map, value;
+        int result = -1;
+        int offset = sent;
+
+        // Check header data
+        if ((resLen < NMP_HDR_SIZE) ||
+            (response[0] != NMP_OP_WRITE_RSP) ||
+            (response[4] != ((NMP_GROUP_IMAGE & 0xFF00) >> 8)) ||
+            (response[5] != (NMP_GROUP_IMAGE & 0x00FF)) ||
+            (response[7] != NMP_ID_IMAGE_UPLOAD)) {
+            fprintf(stderr, "Unexpected header response data!\n");
+            return -1;
+        }
+
+        // A late answer to an earlier window
+        if ((unsigned char)(response[6] - firstSeq) >= count) {
+            continue;
+        }
+
+        // Check CBOR data
+        if (cbor_parser_init(&response[8], resLen-8, 0, &parser, &map)) {
+            fprintf(stderr, "Error decoding CBOR data!\n");
+            return -1;
+        }
+        if ((cbor_value_map_find_value(&map, "rc", &value) == 0) &&
+            cbor_value_is_integer(&value)) {
+            cbor_value_get_int(&value, &result);
+        }
+        if ((cbor_value_map_find_value(&map, "off", &value) == 0) &&
+            cbor_value_is_unsigned_integer(&value)) {
+            cbor_value_get_int(&value, &offset);
+        } else if (result != 0) {
+            offset = -1;
+        }
+        if (((result != 0) && (result != NMP_RC_BAD_OFFSET)) ||
+            (offset < 0)) {
+            fprintf(stderr, "Upload failed, rc=%d!\n", result);
+            return -1;
+        }
+        return offset;
+    }
+
+    // Timeout - the caller resends from where it was
+    return -2;
+}
+
 static int BLE_txImage(int fd, char *filename, int slot)
 {
-    size_t          remaining;
-    size_t          readCount;
     int             offset, res;
+    int             retries = MAX_TX_RETRIES;
     FILE            *f = NULL;
     struct stat     sb;
     size_t          fileSize;
+    unsigned char   *image = NULL;
+    struct timespec startTime, endTime;
 
     // Make sure we can open file
     f = fopen(filename, "r");
@@ -418,133 +587,165 @@ static int BLE_txImage(int fd, char *filename, int slot)
         slot = 0;
     }
 
-    // Write out data from file
-    remaining = fileSize = sb.st_size;
-    offset = 0;
-    while (remaining) {
-        unsigned char hdr[NMP_HDR_SIZE];
-        unsigned char body[MAX_BUF_SIZE];
-        unsigned char data[READ_CHUNK_SIZE];
-        int bodyLen, resLen;
-        unsigned char *response;
-        CborEncoder encoder, mapEncoder;
-
-        // How much should we read?
-        if (remaining < READ_CHUNK_SIZE) {
-            readCount = remaining;
-        } else {
-            readCount = READ_CHUNK_SIZE;
-        }
+    // Keep the whole file around, the bootloader may ask to go back
+    fileSize = sb.st_size;
+    image = malloc(fileSize);
+    if ((image == NULL) || (fread(image, 1, fileSize, f) != fileSize)) {
+        fprintf(stderr, "Error reading BLE data!\n");
+        res = -1;
+        goto exit;
+    }
 
-        // Flash is erased on first block
-        if (offset == 0) {
-            fprintf(stdout, "Erasing BLE chip...");
-            fflush(stdout);
-        } else if (offset == READ_CHUNK_SIZE) {
-            fprintf(stdout, "Done\nWriting data to BLE chip\n");
-            fflush(stdout);
-        }
+    // Flash is erased on first block
+    fprintf(stdout, "Erasing BLE chip...");
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
 
-        // Read chunk from file
-        if (fread(data, 1, readCount, f) != readCount) {
-            fprintf(stderr, "Error reading BLE data!\n");
-            res = -1;
-            goto exit;
-        }
+    // Write out data from file, a window of chunks at a time
+    offset = 0;
+    while (offset < fileSize) {
+        unsigned char firstSeq = curSeq;
+        int sent = offset;
+        int count, i, next;
 
-        // Create CBOR data
-        cbor_encoder_init(&encoder, body, sizeof(body), 0);
-        cbor_encoder_create_map(&encoder, &mapEncoder, CborIndefiniteLength);
-        cbor_encode_text_stringz(&mapEncoder, "off");
-        cbor_encode_uint(&mapEncoder, offset);
-        if (offset == 0) {
-            // Set upper byte with slot value (really just 0 or 1)
-            if (slot) {
-                remaining |= (slot & 0x0F) << 24;
+        for (i = 0; i < bleLink.window; i++) {
+            bool last;
+
+            count = bleLink.chunkSize;
+            if (fileSize - sent < count) {
+                count = fileSize - sent;
             }
-            cbor_encode_text_stringz(&mapEncoder, "len");
-            cbor_encode_uint(&mapEncoder, remaining);
-            remaining &= 0x00FFFFFF;
-        }
-        cbor_encode_text_stringz(&mapEncoder, "data");
-        cbor_encode_byte_string(&mapEncoder, data, readCount);
-        cbor_encoder_close_container(&encoder, &mapEncoder);
-        bodyLen = cbor_encoder_get_buffer_size (&encoder, body);
-
-        // Create header
-        BLE_populateNmpHdr(hdr, NMP_OP_WRITE, NMP_GROUP_IMAGE,
-                           NMP_ID_IMAGE_UPLOAD, bodyLen);
-
-        // Send data
-        if ((response = BLE_txNmp(fd, hdr, body, bodyLen, &resLen)) != NULL) {
-            CborParser parser;
-            CborValue map;
-            CborError err;
-
-            // Check header data
-            if ((response[0] != NMP_OP_WRITE_RSP) ||
-                (response[4] != ((NMP_GROUP_IMAGE & 0xFF00) >> 8)) ||
-                (response[5] != (NMP_GROUP_IMAGE & 0x00FF)) ||
-                (response[7] != NMP_ID_IMAGE_UPLOAD)) {
-                fprintf(stderr, "Unexpected header response data!\n");
+
+            // Wait on the first block, while the slot is erased
+            last = (sent == 0) || (i == bleLink.window - 1) ||
+                   (sent + count == fileSize);
+
+            if (BLE_txChunk(fd, image, fileSize, sent, count, slot, last)) {
+                fprintf(stderr, "Failed to send firmware data packet!\n");
                 res = -1;
                 goto exit;
             }
-
-	    // Check CBOR data
-            err = cbor_parser_init(&response[8], resLen-8, 0, &parser, &map);
-            if (!err) {
-              CborValue value;
-              if (cbor_value_map_find_value(&map, "rc", &value) == 0) {
-                  int result;
-                  if (cbor_value_get_int(&value, &result) == 0) {
-                      //fprintf(stdout, "RC: %d ", result);
-                  }
-              }
-
-              if (cbor_value_map_find_value(&map, "off", &value) == 0) {
-                  CborType type = cbor_value_get_type(&value);
-
-                  if (type == 0) {
-                      int result;
-                      if (cbor_value_get_int(&value, &result) == 0) {
-			//fprintf(stdout, "Off: %d\n", result);
-                      }
-                  }
-              }
-            } else {
-                fprintf(stderr, "Error decoding CBOR data!\n");
+            sent += count;
+            if (last) {
+                break;
             }
+        }
 
-        } else {
-            fprintf(stderr, "Failed to send firmware data packet!\n");
+        next = BLE_rxChunkRsp(fd, firstSeq, i + 1, sent);
+        if (next == -1) {
             res = -1;
             goto exit;
+        } else if (next == -2) {
+            if (--retries == 0) {
+                fprintf(stderr, "Failed to send firmware data packet!\n");
+                res = -1;
+                goto exit;
+            }
+            continue;
         }
+        retries = MAX_TX_RETRIES;
 
-        // Update address - go on to next block
-        remaining -= readCount;
-        offset += readCount;
-
-        // Show status, after first chunk where we erase
-        if (offset > READ_CHUNK_SIZE) {
-            fprintf(stdout,
-                    "\r  %3d / %3d [ %3d%% ] chunks sent, file is %d bytes",
-                    (offset / READ_CHUNK_SIZE), (fileSize / READ_CHUNK_SIZE),
-                    ((offset * 100) / fileSize), fileSize);
+        if (offset == 0) {
+            fprintf(stdout, "Done\nWriting data to BLE chip\n");
             fflush(stdout);
         }
+        offset = next;
+
+        // Show status
+        fprintf(stdout,
+                "\r  %3d / %3d [ %3d%% ] chunks sent, file is %d bytes",
+                (offset / bleLink.chunkSize),
+                (int)(fileSize / bleLink.chunkSize),
+                (int)((offset * 100) / fileSize), (int)fileSize);
+        fflush(stdout);
     }
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
     fprintf(stdout, "\n");
 
+    {
+        long ms = (endTime.tv_sec - startTime.tv_sec) * 1000 +
+                  (endTime.tv_nsec - startTime.tv_nsec) / 1000000;
+
+        if (ms > 0) {
+            fprintf(stdout, "Sent %d bytes in %ld ms (%ld bytes/sec)\n",
+                    (int)fileSize, ms, (long)fileSize * 1000 / ms);
+        }
+    }
+
     // Success
     res = 0;
 
  exit:
+    free(image);
     if (f != NULL) fclose(f);
     return res;
 }
 
+// Ask the bootloader how much it can take at once.  Older bootloaders
+// do not answer, and are sent short lines, one chunk at a time.
+static void BLE_getParams(int fd)
+{
+    unsigned char hdr[NMP_HDR_SIZE];
+    unsigned char body[1];
+    unsigned char *response;
+    int resLen, bufSize = 0, bufCount = 0;
+    bool raw = false;
+    CborParser parser;
+    CborValue map, value;
+
+    bleLink = legacyLink;
+
+    BLE_populateNmpHdr(hdr, NMP_OP_READ, NMP_GROUP_DEFAULT, NMP_ID_PARAMS, 0);
+    if (BLE_sendNmp(fd, hdr, body, 0)) {
+        return;
+    }
+
+    response = BLE_getMsg(fd, &resLen, PARAMS_TIMEOUT);
+    if ((response == NULL) || (resLen <= NMP_HDR_SIZE) ||
+        (response[0] != NMP_OP_READ_RSP) ||
+        (response[7] != NMP_ID_PARAMS) ||
+        cbor_parser_init(&response[8], resLen-8, 0, &parser, &map)) {
+        fprintf(stdout, "Legacy bootloader, using %d byte chunks\n",
+                bleLink.chunkSize);
+        return;
+    }
+
+    if ((cbor_value_map_find_value(&map, "buf_size", &value) == 0) &&
+        cbor_value_is_unsigned_integer(&value)) {
+        cbor_value_get_int(&value, &bufSize);
+    }
+    if ((cbor_value_map_find_value(&map, "buf_count", &value) == 0) &&
+        cbor_value_is_unsigned_integer(&value)) {
+        cbor_value_get_int(&value, &bufCount);
+    }
+    if ((cbor_value_map_find_value(&map, "raw", &value) == 0) &&
+        cbor_value_is_boolean(&value)) {
+        cbor_value_get_boolean(&value, &raw);
+    }
+
+    if (bufSize > MAX_BUF_SIZE) {
+        bufSize = MAX_BUF_SIZE;
+    }
+    if (bufSize <= LINE_SIZE + UPLOAD_OVERHEAD + 8) {
+        return;
+    }
+
+    // Each request goes in a single line or frame, so the bootloader can
+    // take one more while it writes to flash
+    bleLink.raw = raw;
+    bleLink.lineSize = ((bufSize - 3) / 4) * 4;
+    if (raw) {
+        bleLink.chunkSize = bufSize - 8 - UPLOAD_OVERHEAD;
+    } else {
+        bleLink.chunkSize = (bleLink.lineSize / 4) * 3 - 4 - UPLOAD_OVERHEAD;
+    }
+    bleLink.chunkSize &= ~3;
+    bleLink.window = (bufCount > 2) ? bufCount - 1 : 1;
+
+    fprintf(stdout, "Using %d byte chunks, %d per window%s\n",
+            bleLink.chunkSize, bleLink.window, bleLink.raw ? ", binary frames" : "");
+}
+
 static int BLE_ping(int fd)
 {
     unsigned char hdr[NMP_HDR_SIZE];
@@ -595,7 +796,7 @@ int BLE_vendorProgram(int fd, char *filename, int slot)
         BLE_deassertReset();
 
         // Wait for bootloader to be ready (will send "ready\r\n")
-        BLE_getLine(fd, ble_res, sizeof(ble_res));
+        BLE_getLine(fd, ble_res, sizeof(ble_res), RX_TIMEOUT/2);
         if (strncmp((char *)ble_res, "ready", 5) == 0) {
             fprintf(stdout, "Done\n");
             break;
@@ -615,6 +816,9 @@ int BLE_vendorProgram(int fd, char *filename, int slot)
         goto exit;
     }
 
+    // Find out how fast we can go
+    BLE_getParams(fd);
+
     // Send image
     if (BLE_txImage(fd, filename, slot) < 0) {
         fprintf(stderr, "Error programming image to BLE chip!\n");
@@ -25,12 +25,12 @@
 #include <ctype.h>
 #include <sys/signalfd.h>
 #include <sys/types.h>
-#include <sys/stat.h>
 
 #include <glib.h>
 #include <dbus/dbus.h>
 #include <bluez-dbus.h>
 #include <irislib.h>
+#include <wifiscan.h>
 #include <aes.h>
 
 // Syslog name
@@ -65,7 +65,6 @@
 #define CURRENT_MODE                    "N"
 #define CURRENT_FREQ                    "2.4"
 #define DEFAULT_STATUS                  "DISCONNECTED"
-#define SSID_KEY                        "{\"ssid\":"
 
 #define SCAN_RESULTS_DESC               "WiFi Scan"
 #define SUPPORTED_MODES_DESC            "WiFi Modes"
@@ -102,10 +101,11 @@ static uint8_t wifi_key[]  = { 0x2E, 0x2C, 0x18, 0x3D, 0xBB, 0x77, 0x49, 0x3D, 0
 #define MAX_SSID_LEN                32
 #define MAX_PASSWD_LEN              64
 
-// Scan states
-#define SCAN_INIT                   0
-#define SCAN_START                  1
-#define SCAN_MORE                   2
+// Scan results - served from a cache, refreshed once older than this
+#define SCAN_REFRESH_AGE            20      // seconds
+#define SCAN_POLL_PERIOD            250     // ms between checks for results
+#define SCAN_TIMEOUT                10000   // ms
+#define SCAN_PAGE_SIZE              2       // results per read
 
 // Inactivity timeout
 #define PROV_IDLE_CHECK             15
@@ -126,11 +126,17 @@ static char wifiAuthType[16] = { 0 };
 static uint8_t wifiPasswd[MAX_PASSWD_LEN] = { 0 };
 static int  wifiPasswdLen = 0;
 static char wifiStatus[24] = { 0 };
-static char *wifiScanResults = NULL;
-static int wifiScanState = SCAN_INIT;
-static char *wifiScanPtr = NULL;
-static int wifiScanCount = 0;
-static char wifiScanData[512];
+static WifiScanResult wifiScanCache[WIFI_SCAN_MAX_RESULTS];
+static int wifiScanCacheCount = 0;
+static gint64 wifiScanTime = 0;
+static guint wifiScanPoll = 0;
+static int wifiScanPolls = 0;
+// Results being read by a client - a copy, so pages stay consistent even
+//  if a scan completes part way through
+static WifiScanResult wifiScanPage[WIFI_SCAN_MAX_RESULTS];
+static int wifiScanPageCount = 0;
+static int wifiScanPageNext = 0;
+static char wifiScanData[(SCAN_PAGE_SIZE * WIFI_SCAN_JSON_LEN) + 64];
 static time_t wifiActivity;
 static pthread_mutex_t activityLock;
 
@@ -307,135 +313,136 @@ static void updateActivity()
     pthread_mutex_unlock(&activityLock);
 }
 
-// Callbacks to update items
-static gboolean UpdateWifiScanResults(uint8_t **value, int *vlen,
-                                      gboolean internal)
+// One read worth of results, starting at *next - "more" tells the client
+//  to read again
+static int formatScanPage(const WifiScanResult *results, int count,
+                          int *next, char *buf, int len)
 {
-    struct stat st;
-    char *ptr;
+    int i, n;
 
-    // If the request is internal, return entire blob
-    if (internal) {
-        wifiScanState = SCAN_INIT;
+    n = snprintf(buf, len, "{\"scanresults\":[");
+    for (i = 0; (i < SCAN_PAGE_SIZE) && (*next < count); i++) {
+        if (i) {
+            n += snprintf(&buf[n], len - n, ", ");
+        }
+        n += wifiScanFormat(&results[(*next)++], 1, &buf[n], len - n);
+    }
+    if (*next < count) {
+        n += snprintf(&buf[n], len - n, "], \"more\":\"true\"}");
     } else {
-        updateActivity();
+        n += snprintf(&buf[n], len - n, "]}");
+        *next = 0;
     }
+    return n;
+}
 
-    // Response depends on state
-    switch (wifiScanState) {
-    case SCAN_INIT:
-        // Get size of scan file
-        if (stat(WIFI_SCAN_FILE, &st) != -1) {
-            if (st.st_size > 0) {
-                FILE *f;
-
-                f = fopen(WIFI_SCAN_FILE, "r");
-                if (f != NULL) {
-                    // Free existing buffer
-                    if (wifiScanResults) {
-                        free(wifiScanResults);
-                    }
-
-                    // Get buffer
-                    wifiScanResults = malloc(st.st_size+1);
-                    if (wifiScanResults != NULL) {
-                        wifiScanResults[0] = '\0';
-                        if (fread(wifiScanResults, 1, st.st_size, f) ==
-                            st.st_size) {
-                          wifiScanResults[st.st_size] = '\0';
-                          wifiScanPtr = wifiScanResults;
-                        }
-                    }
-                }
+// Did the networks seen change?  Signal levels alone don't count
+static gboolean scanResultsChanged(const WifiScanResult *results, int count)
+{
+    int i, j;
+
+    if (count != wifiScanCacheCount) {
+        return TRUE;
+    }
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < wifiScanCacheCount; j++) {
+            if ((memcmp(results[i].bssid, wifiScanCache[j].bssid,
+                        sizeof(results[i].bssid)) == 0) &&
+                (strcmp(results[i].ssid, wifiScanCache[j].ssid) == 0) &&
+                (results[i].security == wifiScanCache[j].security)) {
+                break;
             }
         }
-
-        // No data?
-        if (wifiScanPtr == NULL) {
-            *vlen = 0;
-            *value = NULL;
-            return FALSE;
+        if (j == wifiScanCacheCount) {
+            return TRUE;
         }
+    }
+    return FALSE;
+}
 
-        // Internal? return entire block
-        if (internal) {
-            *vlen = strlen(wifiScanResults);
-            *value = (uint8_t *)wifiScanResults;
-            return FALSE;
-        }
+// New scan results - let clients that asked know if anything changed
+static void scanResultsUpdate(const WifiScanResult *results, int count)
+{
+    gboolean changed = scanResultsChanged(results, count);
+    char data[sizeof(wifiScanData)];
+    int next = 0, len;
 
-        // We fall through to START state
-        wifiScanState = SCAN_START;
+    memcpy(wifiScanCache, results, count * sizeof(results[0]));
+    wifiScanCacheCount = count;
 
-    case SCAN_START:
-        // How many SSIDs?
-        wifiScanCount = 0;
-        ptr = wifiScanPtr;
-        while ((ptr = strstr(ptr, SSID_KEY)) != NULL) {
-            ptr += strlen(SSID_KEY);
-            wifiScanCount++;
-        }
+    if (changed && count) {
+        len = formatScanPage(wifiScanCache, wifiScanCacheCount, &next,
+                             data, sizeof(data));
+        notify_characteristic(WIFI_SCAN_RESULTS_UUID, (uint8_t *)data, len);
+    }
+}
 
-        // 2 or fewer SSIDs?  Return whole block
-        if (wifiScanCount <= 2) {
-            *vlen = strlen(wifiScanResults);
-            *value = (uint8_t *)wifiScanResults;
-            // Reset state
-            wifiScanState = SCAN_INIT;
-            wifiScanPtr = NULL;
-            return TRUE;
-        }
-        // We fall through to MORE state
-        wifiScanState = SCAN_MORE;
+static gboolean scanPollHandler(gpointer data)
+{
+    WifiScanResult results[WIFI_SCAN_MAX_RESULTS];
+    int count;
+
+    count = wifiScanResults(WIFI_IF, results, WIFI_SCAN_MAX_RESULTS);
+    if ((count < 0) && (errno == EAGAIN) &&
+        (++wifiScanPolls < (SCAN_TIMEOUT / SCAN_POLL_PERIOD))) {
+        return TRUE;
+    }
+    wifiScanPoll = 0;
+    if (count >= 0) {
+        scanResultsUpdate(results, count);
+    }
+    return FALSE;
+}
 
-    case SCAN_MORE:
+// Start a scan if the results are getting old - the cache is served until
+//  the new results are in
+static void scanRefresh(void)
+{
+    gint64 now = g_get_monotonic_time();
 
-        if (wifiScanCount <= 2) {
-            snprintf(wifiScanData, sizeof(wifiScanData),
-                     "{\"scanresults\":[%s", strstr(wifiScanPtr, SSID_KEY));
-            wifiScanCount = 0;
-        } else {
-            char ssid1[128];
-            char ssid2[128];
-            char *ptr1, *ptr2;
-            int len;
-
-            ptr1 = strstr(wifiScanPtr, SSID_KEY);
-            ptr2 = ptr1 + strlen(SSID_KEY);
-            ptr2 = strstr(ptr2, SSID_KEY);
-            while (*ptr2 != '}') ptr2--;
-            len = (ptr2 - ptr1) + 1;
-            strncpy(ssid1, ptr1, len);
-            ssid1[len] = '\0';
-
-            ptr1 = strstr(ptr2, SSID_KEY);
-            ptr2 = ptr1 + strlen(SSID_KEY);
-            ptr2 = strstr(ptr2, SSID_KEY);
-            while (*ptr2 != '}') ptr2--;
-            len = (ptr2 - ptr1) + 1;
-            strncpy(ssid2, ptr1, len);
-            ssid2[len] = '\0';
-            wifiScanPtr = ptr2;
-            snprintf(wifiScanData, sizeof(wifiScanData),
-                     "{\"scanresults\":[%s, %s], \"more\":\"true\"}",
-                     ssid1, ssid2);
-            wifiScanCount -= 2;
-        }
-        *vlen = strlen(wifiScanData);
-        *value = (uint8_t *)wifiScanData;
+    if (wifiScanPoll ||
+        (wifiScanTime && ((now - wifiScanTime) <
+                          (SCAN_REFRESH_AGE * G_USEC_PER_SEC)))) {
+        return;
+    }
+    wifiScanTime = now;
 
-        // If no more ssids, back to init state
-        if (wifiScanCount == 0) {
-            wifiScanState = SCAN_INIT;
-            wifiScanPtr = NULL;
-        }
-        return TRUE;
+    // May fail if a scan is already running - results come all the same
+    wifiScanStart(WIFI_IF);
+    wifiScanPolls = 0;
+    wifiScanPoll = g_timeout_add(SCAN_POLL_PERIOD, scanPollHandler, NULL);
+}
 
-    default:
-        *vlen = 0;
-        *value = NULL;
+// Callbacks to update items
+static gboolean UpdateWifiScanResults(uint8_t **value, int *vlen,
+                                      gboolean internal)
+{
+    // Property reads get the current value (last notification, if any)
+    if (internal) {
         return FALSE;
     }
+    updateActivity();
+
+    // Start of a listing - take the latest results to page through
+    if (wifiScanPageNext == 0) {
+        scanRefresh();
+        memcpy(wifiScanPage, wifiScanCache,
+               wifiScanCacheCount * sizeof(wifiScanCache[0]));
+        wifiScanPageCount = wifiScanCacheCount;
+
+        // No data?
+        if (wifiScanPageCount == 0) {
+            *vlen = 0;
+            *value = NULL;
+            return FALSE;
+        }
+    }
+
+    *vlen = formatScanPage(wifiScanPage, wifiScanPageCount,
+                           &wifiScanPageNext, wifiScanData,
+                           sizeof(wifiScanData));
+    *value = (uint8_t *)wifiScanData;
+    return TRUE;
 }
 
 static gboolean UpdateWifiStatus(uint8_t **value, int *vlen, gboolean internal)
@@ -617,7 +624,7 @@ static char *create_wifi_cfg_service(DBusConnection *conn)
     // Scan results
     if (!register_characteristic(conn, WIFI_SCAN_RESULTS_UUID,
                                  (uint8_t *)"", 0, // Filled in by scan...
-                                 read_only_props,
+                                 read_notify_props,
                                  WIFI_SCAN_RESULTS_UUID,
                                  (uint8_t *)SCAN_RESULTS_DESC,
                                  strlen(SCAN_RESULTS_DESC),
@@ -892,6 +899,15 @@ int main(int argc, char *argv[])
     // Create GATT services we handle
     create_services(conn, services);
 
+    // Have scan results ready for the first read - the driver still has
+    //  the last scan's, then a new scan is started
+    wifiScanCacheCount = wifiScanResults(WIFI_IF, wifiScanCache,
+                                         WIFI_SCAN_MAX_RESULTS);
+    if (wifiScanCacheCount < 0) {
+        wifiScanCacheCount = 0;
+    }
+    scanRefresh();
+
     // Set display name - we use main MAC address
     IRIS_getMACAddr1(macAddr);
     // Skip colons
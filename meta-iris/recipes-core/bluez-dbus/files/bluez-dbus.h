@@ -74,6 +74,9 @@ gboolean register_characteristic(DBusConnection *conn,
 				 const ValidateFunction validate_cb,
 				 const UpdateFunction update_cb);
 
+gboolean notify_characteristic(const char *chr_uuid,
+			       const uint8_t *value, int vlen);
+
 char *register_service(DBusConnection *conn, const char *uuid);
 
 void register_app(GDBusProxy *proxy);
@@ -75,6 +75,8 @@ struct characteristic {
 	DBusConnection *connection;
 	ValidateFunction validate_cb;
 	UpdateFunction update_cb;
+	// IRIS Change - track whether clients have asked for notifications
+	gboolean notifying;
 };
 
 struct descriptor {
@@ -93,6 +95,9 @@ struct descriptor {
  */
 const char *desc_props[] = { "read", "write", NULL };
 
+// IRIS Change - keep registered characteristics to look up for notifications
+static GSList *characteristics = NULL;
+
 static gboolean desc_get_uuid(const GDBusPropertyTable *property,
 					DBusMessageIter *iter, void *user_data)
 {
@@ -407,6 +412,7 @@ static void chr_iface_destroy(gpointer user_data)
 {
 	struct characteristic *chr = user_data;
 
+	characteristics = g_slist_remove(characteristics, chr);
 	g_free(chr->uuid);
 	g_free(chr->service);
 	g_free(chr->value);
@@ -540,9 +546,19 @@ static DBusMessage *chr_write_value(DBusConnection *conn, DBusMessage *msg,
 	return dbus_message_new_method_return(msg);
 }
 
+// IRIS Change - support notifications on characteristics that allow them
 static DBusMessage *chr_start_notify(DBusConnection *conn, DBusMessage *msg,
 							void *user_data)
 {
+	struct characteristic *chr = user_data;
+	int i;
+
+	for (i = 0; chr->props[i]; i++) {
+		if (strcmp(chr->props[i], "notify") == 0) {
+			chr->notifying = TRUE;
+			return dbus_message_new_method_return(msg);
+		}
+	}
 	return g_dbus_create_error(msg, DBUS_ERROR_NOT_SUPPORTED,
 							"Not Supported");
 }
@@ -550,8 +566,10 @@ static DBusMessage *chr_start_notify(DBusConnection *conn, DBusMessage *msg,
 static DBusMessage *chr_stop_notify(DBusConnection *conn, DBusMessage *msg,
 							void *user_data)
 {
-	return g_dbus_create_error(msg, DBUS_ERROR_NOT_SUPPORTED,
-							"Not Supported");
+	struct characteristic *chr = user_data;
+
+	chr->notifying = FALSE;
+	return dbus_message_new_method_return(msg);
 }
 
 static const GDBusMethodTable chr_methods[] = {
@@ -666,6 +684,8 @@ gboolean register_characteristic(DBusConnection *conn,
 		return FALSE;
 	}
 
+	characteristics = g_slist_prepend(characteristics, chr);
+
 	if (!desc_uuid)
 		return TRUE;
 
@@ -692,6 +712,26 @@ gboolean register_characteristic(DBusConnection *conn,
 	return TRUE;
 }
 
+// IRIS Change - send a new value to clients that asked for notifications.
+//  The value stands until the next read updates it.
+gboolean notify_characteristic(const char *chr_uuid,
+			       const uint8_t *value, int vlen)
+{
+	GSList *l;
+
+	for (l = characteristics; l; l = l->next) {
+		struct characteristic *chr = l->data;
+
+		if (strcmp(chr->uuid, chr_uuid) == 0) {
+			if (!chr->notifying)
+				return FALSE;
+			chr_write(chr, value, vlen);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 char *register_service(DBusConnection *conn, const char *uuid)
 {
 	static int id = 1;
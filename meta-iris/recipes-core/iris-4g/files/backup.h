@@ -42,6 +42,8 @@
 #define LTE_ZTEWELINK_AT_RESET  "AT+ZRST\n"
 #define LTE_ZTEWELINK_AT_ZSWITCH_CHECK "AT+ZSWITCH?\n"
 #define LTE_ZTEWELINK_AT_ZSWITCH_SET "AT+ZSWITCH=L\n"
+#define LTE_ZTEWELINK_AT_CREG_URC "AT+CREG=1\n"
+#define LTE_ZTEWELINK_AT_CGEV_URC "AT+CGEREP=1\n"
 
 // DNS config
 #define PRI_DNS_FILE     "/tmp/pri_resolv.conf"
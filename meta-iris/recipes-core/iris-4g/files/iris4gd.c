@@ -19,11 +19,19 @@
 #include <signal.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <syslog.h>
+#include <net/if.h>
 #include <sys/inotify.h>
-#include <pthread.h>
-#include <at_parser.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include <at_engine.h>
 #include <irislib.h>
+#include <netmon.h>
 #include "backup.h"
 
 
@@ -33,9 +41,23 @@
 #define AT_STATUS_CHECK_DELAY 15
 #define AT_STATUS_INIT_DELAY  30
 #define AT_STATUS_RESET_DELAY 10
+#define AT_OPEN_RETRY_DELAY   5
+
+// Route out the primary gateway kept while on backup
+#define PRI_GW_BACKUP_METRIC  2
 
 static volatile int done = 0;
 
+// Backup interface, empty until the modem shows up
+static char  backup_if[32];
+static int   primary_up = 1;
+
+// Commands run in the background - exits are seen through SIGCHLD
+static pid_t controlPid = 0;
+static char  controlPending[16];
+static pid_t checkPid = 0;
+static int   checkAgain = 0;
+
 static void lteModuleReset(void)
 {
     char cmd[128];
@@ -70,221 +92,364 @@ static void iris4g_sig_handler(int sig)
     }
 }
 
+/* Run a shell command without waiting for it to finish */
+static pid_t runCommand(const char *cmd)
+{
+    sigset_t mask;
+    pid_t    pid;
+
+    pid = fork();
+    if (pid == 0) {
+        sigemptyset(&mask);
+        sigprocmask(SIG_SETMASK, &mask, NULL);
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        _exit(127);
+    }
+    if (pid < 0) {
+        syslog(LOG_ERR, "Unable to run %s: %s", cmd, strerror(errno));
+        return 0;
+    }
+    return pid;
+}
+
+/* Arm a timer - delay and period in seconds, period 0 for one shot */
+static void timerSet(int fd, int delay, int period)
+{
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = delay;
+    its.it_interval.tv_sec = period;
+    timerfd_settime(fd, 0, &its, NULL);
+}
+
+static void timerAck(int fd)
+{
+    unsigned long long expired;
+
+    read(fd, &expired, sizeof(expired));
+}
+
+/* Start, stop or init the LTE connection */
+static void lteControl(const char *request)
+{
+    const char *cmd;
+
+    if (strncmp(request, "connect", 7) == 0) {
+        cmd = LTE_START_COMMAND;
+    } else if (strncmp(request, "disconnect", 10) == 0) {
+        cmd = LTE_STOP_COMMAND;
+    } else if (strncmp(request, "init", 4) == 0) {
+        cmd = LTE_INIT_COMMAND;
+    } else {
+        return;
+    }
+
+    /* One at a time - the latest request is run when this one is done */
+    if (controlPid) {
+        snprintf(controlPending, sizeof(controlPending), "%s", request);
+        return;
+    }
+
+    /* Lend the AT port to backup_start/backup_stop for the call setup */
+    atEngineClose();
+    controlPid = runCommand(cmd);
+}
+
 /* Simple LTE control handler */
-static void *lteControlThreadHandler(void *ptr)
+static void lteControlChanged(int fd, void *arg)
 {
     FILE *f;
-    int  fd;
     char buf[512];
     int  len;
+    int  i;
 
-    /* We want to be notified when the LED mode file is changed */
-    fd = inotify_init();
-    if (fd >= 0) {
+    /* Read inotify fd to get events */
+    len = read(fd, buf, sizeof(buf));
 
-        /* Add LTE control file to watch list */
-        inotify_add_watch(fd, LTE_CONTROL_FILE, IN_MODIFY);
+    /* Parse events, looking for modify events ... */
+    i = 0;
+    while (i < len) {
+        struct inotify_event *event = (struct inotify_event *)&buf[i];
+
+        /* Got a file modification event */
+        if (event->mask & IN_MODIFY) {
+
+            /* Open lteControl file */
+            f = fopen(LTE_CONTROL_FILE, "r");
+            if (f != NULL) {
+                char data[128];
 
-        /* Keep looking for file modifications... */
-        while (1) {
-
-            /* Read inotify fd to get events */
-            len = read(fd, buf, sizeof(buf));
-            if (len >= 0) {
-                int i;
-
-                /* Parse events, looking for modify events ... */
-                i = 0;
-                while (i < len) {
-                    struct inotify_event *event =
-		      (struct inotify_event *)&buf[i];
-
-                    /* Got a file modification event */
-                    if (event->mask & IN_MODIFY) {
-
-                        /* Open lteControl file */
-                        f = fopen(LTE_CONTROL_FILE, "r");
-                        if (f != NULL) {
-                            char data[128];
-
-                            /* Read data from lteControl file */
-                            memset(data, 0, sizeof(data));
-                            if (fread(data, 1, sizeof(data)-1, f) <= 0) {
-                                /* Try again */
-                                i += (sizeof(struct inotify_event)) +
-                                  event->len;
-				fclose(f);
-                                continue;
-                            }
-
-                            /* Removing trailing \n */
-                            if (data[strlen(data) - 1] == '\n') {
-                                data[strlen(data) - 1] = '\0';
-                            }
-
-                            /* Connect or disconnect */
-			    if (strncmp(data, "connect", 7) == 0) {
-			        system(LTE_START_COMMAND);
-			    } else if (strncmp(data, "disconnect", 10) == 0) {
-				system(LTE_STOP_COMMAND);
-			    } else if (strncmp(data, "init", 4) == 0) {
-			        system(LTE_INIT_COMMAND);
-			    }
-
-                            /* Close lteControl file */
-                            fclose(f);
-                        }
+                /* Read data from lteControl file */
+                memset(data, 0, sizeof(data));
+                if (fread(data, 1, sizeof(data)-1, f) > 0) {
+
+                    /* Removing trailing \n */
+                    if (data[strlen(data) - 1] == '\n') {
+                        data[strlen(data) - 1] = '\0';
                     }
-                    i += (sizeof(struct inotify_event)) + event->len;
+
+                    /* Connect or disconnect */
+                    lteControl(data);
                 }
+
+                /* Close lteControl file */
+                fclose(f);
             }
         }
+        i += (sizeof(struct inotify_event)) + event->len;
     }
 }
 
 #ifdef ZTE_LTE_SUPPORTED
-/* AT Status handler handler */
-static void *atStatusThreadHandler(void *ptr)
+#define AT_TIMEOUT_MS      (DEFAULT_AT_TIMEOUT * 1000)
+
+enum {AT_STATE_WAIT = 0, AT_STATE_RESET, AT_STATE_INFO, AT_STATE_STATUS,
+      AT_STATE_STOPPED};
+
+static int atState = AT_STATE_WAIT;
+static int atTimer = -1;
+static int atStatusPending = 0;
+
+// Fixed status - SIM info, etc.  Only want the digits
+typedef struct {
+    const char *name;
+    char       *cmd;
+    int        offset;
+    int        len;
+    char       value[32];
+} ATInfo;
+
+static ATInfo atInfo[] = {
+    { "imei",   LTE_ZTEWELINK_AT_IMEI,   0,  15, "N/A" },
+    { "imsi",   LTE_ZTEWELINK_AT_IMSI,   0,  15, "N/A" },
+    { "iccid",  LTE_ZTEWELINK_AT_ICCID,  12, 20, "N/A" },
+    // Data format: +CNUM: ,"13052154423",129,7,4
+    { "msisdn", LTE_ZTEWELINK_AT_MSISDN, 9,  11, "N/A" },
+};
+#define AT_NUM_INFO (sizeof(atInfo) / sizeof(atInfo[0]))
+
+// Periodic status, like signal strength, etc.
+static int  signalStrength = 0;
+static int  network = 0;
+static int  simStatus = 0;
+static char connStatus[8] = {"N/A"};
+
+static void atStatusRefresh(void);
+
+static void atSignalRead(int status, const char *data, void *arg)
 {
-    ATPort *port;
-    char   imei[32] = {"N/A"};
-    char   imsi[32] = {"N/A"};
-    char   iccid[32] = {"N/A"};
-    char   msisdn[32] = {"N/A"};
-    FILE   *infoFile = NULL;
+    int a, b;
 
-    /* Delay for the modem to settle */
-    sleep(AT_STATUS_INIT_DELAY);
+    // Data format: +CSQ: 16,99
+    signalStrength = 0;
+    if ((status == OK) && (sscanf(data, "+CSQ: %d,%d", &a, &b) == 2)) {
+        signalStrength = a;
+    }
+}
 
-    /* Open port */
-    while ((port = atOpen(LTE_ZTEWELINK_AT_PORT, LTE_ZTEWELINK_AT_SPEED,
-                          LTE_ZTEWELINK_AT_FLOW)) == NULL) {
-        syslog(LOG_ERR, "LTE AT status - cannot open AT control port.\n");
-        sleep(5);
-    }
-
-    /* Make sure dongle is in correct state for ether_cdc support */
-    atSend(port, LTE_ZTEWELINK_AT_ZSWITCH_CHECK, DEFAULT_AT_TIMEOUT);
-    if (port->status == OK) {
-        if (strstr(port->data, ": L") == NULL) {
-	    syslog(LOG_ERR, "LTE: Need to set module mode to Linux\n");
-	    atSend(port, LTE_ZTEWELINK_AT_ZSWITCH_SET, DEFAULT_AT_TIMEOUT);
-	    if (port->status != OK) {
-	        syslog(LOG_ERR, "LTE: Cannot set LTE module mode!\n");
-		atClose(port);
-		return NULL;
-	    }
-
-	    // Reset LTE module and wait for it to restart
-	    atClose(port);
-	    lteModuleReset();
-	    sleep(MODULE_REBOOT_DELAY);
-	    port = atOpen(LTE_ZTEWELINK_AT_PORT, LTE_ZTEWELINK_AT_SPEED,
-			  LTE_ZTEWELINK_AT_FLOW);
-        }
+static void atSysinfoRead(int status, const char *data, void *arg)
+{
+    FILE *statusFile;
+    int  a, b, c, d, e;
+
+    atStatusPending = 0;
+
+    // Port was lent out, nothing to report
+    if (status == AT_CLOSED) {
+        return;
     }
 
-    /* Get fixed status - SIM info, etc */
-    atSend(port, LTE_ZTEWELINK_AT_IMEI, DEFAULT_AT_TIMEOUT);
-    if (port->status == OK) {
-        // Only want the digits
-        if (port->data[0] != '\0') {
-            strncpy(imei, port->data, 15);
-        }
+    // Data format: ^SYSINFO: 2,3,0,9,1
+    snprintf(connStatus, sizeof(connStatus), "N/A");
+    network = 0;
+    simStatus = 0;
+    if ((status == OK) && (sscanf(data, "^SYSINFO: %d,%d,%d,%d,%d",
+                                  &a, &b, &c, &d, &e) == 5)) {
+        snprintf(connStatus, sizeof(connStatus), "%d:%d", a, b);
+        network = d;
+        simStatus = e;
     }
-    atSend(port, LTE_ZTEWELINK_AT_IMSI, DEFAULT_AT_TIMEOUT);
-    if (port->status == OK) {
-        // Only want the digits
-        if (port->data[0] != '\0') {
-            strncpy(imsi, port->data, 15);
-        }
+
+    statusFile = fopen(LTE_NET_STATUS_FILE, "w");
+    if (statusFile) {
+        fprintf(statusFile, "sim: %d\n", simStatus);
+        fprintf(statusFile, "signal: %d\n", signalStrength);
+        fprintf(statusFile, "status: %s\n", connStatus);
+        fprintf(statusFile, "type: %d\n", network);
+        fclose(statusFile);
     }
-    atSend(port, LTE_ZTEWELINK_AT_ICCID, DEFAULT_AT_TIMEOUT);
-    if (port->status == OK) {
-        // Only want the digits
-        if (port->data[0] != '\0') {
-            strncpy(iccid, &port->data[12], 20);
-        }
+}
+
+static void atStatusRefresh(void)
+{
+    if (atStatusPending || !atEngineIsOpen()) {
+        return;
     }
-    atSend(port, LTE_ZTEWELINK_AT_MSISDN, DEFAULT_AT_TIMEOUT);
-    if (port->status == OK) {
-        // Only want the digits
-        // Data format: +CNUM: ,"13052154423",129,7,4
-        if (port->data[0] != '\0') {
-            strncpy(msisdn, & port->data[9], 11);
-            msisdn[11] = '\0';
-        }
+    if ((atEngineQueue(LTE_ZTEWELINK_AT_SIGNAL, AT_TIMEOUT_MS,
+                       atSignalRead, NULL) == 0) &&
+        (atEngineQueue(LTE_ZTEWELINK_AT_INFO, AT_TIMEOUT_MS,
+                       atSysinfoRead, NULL) == 0)) {
+        atStatusPending = 1;
+    }
+}
+
+/* Registration or packet data state changed - don't wait for the next check */
+static void atNetworkChanged(const char *line, void *arg)
+{
+    syslog(LOG_INFO, "LTE: %s", line);
+    atStatusRefresh();
+}
+
+static void atInfoRead(int status, const char *data, void *arg)
+{
+    ATInfo *info = (ATInfo *)arg;
+    FILE   *infoFile;
+    int    i;
+
+    if ((status == OK) && (strlen(data) > info->offset)) {
+        snprintf(info->value, sizeof(info->value), "%.*s",
+                 info->len, &data[info->offset]);
+    }
+    if (info != &atInfo[AT_NUM_INFO - 1]) {
+        return;
     }
 
     /* Log SIM info to file */
     infoFile = fopen(LTE_INFO_FILE, "w");
     if (infoFile) {
-        fprintf(infoFile, "imei: %s\n", imei);
-        fprintf(infoFile, "imsi: %s\n", imsi);
-        fprintf(infoFile, "iccid: %s\n", iccid);
-        fprintf(infoFile, "msisdn: %s\n", msisdn);
+        for (i = 0; i < AT_NUM_INFO; i++) {
+            fprintf(infoFile, "%s: %s\n", atInfo[i].name, atInfo[i].value);
+        }
         fclose(infoFile);
     }
 
-    /* Close port - we don't want to keep it open all the time */
-    atClose(port);
+    /* Have the modem tell us when registration or the data call changes */
+    atEngineQueue(LTE_ZTEWELINK_AT_CREG_URC, AT_TIMEOUT_MS, NULL, NULL);
+    atEngineQueue(LTE_ZTEWELINK_AT_CGEV_URC, AT_TIMEOUT_MS, NULL, NULL);
 
-    /* Check for periodic status like signal strength, etc */
-    while (1) {
-        int    signalStrength = 0;
-        int    network = 0;
-        int    simStatus = 0;
-        char   connStatus[8] = {"N/A"};
+    /* Status is still checked periodically, for the signal strength */
+    atState = AT_STATE_STATUS;
+    timerSet(atTimer, AT_STATUS_CHECK_DELAY, AT_STATUS_CHECK_DELAY);
+    atStatusRefresh();
+}
 
-        /* Only need to check periodically */
-        sleep(AT_STATUS_CHECK_DELAY);
+static void atReadInfo(void)
+{
+    int i;
 
-        port = atOpen(LTE_ZTEWELINK_AT_PORT, LTE_ZTEWELINK_AT_SPEED,
-                      LTE_ZTEWELINK_AT_FLOW);
-        if (port == NULL) {
-            continue;
-        }
+    atState = AT_STATE_INFO;
+    for (i = 0; i < AT_NUM_INFO; i++) {
+        atEngineQueue(atInfo[i].cmd, AT_TIMEOUT_MS, atInfoRead, &atInfo[i]);
+    }
+}
 
-        atSend(port, LTE_ZTEWELINK_AT_SIGNAL, DEFAULT_AT_TIMEOUT);
-        if (port->status == OK) {
-            // Data format: +CSQ: 16,99
-            if (port->data[0] != '\0') {
-                int a, b;
-                if (sscanf(&port->data[6], "%d,%d", &a, &b) == 2) {
-                    signalStrength = a;
-                }
-            }
-        }
+static void atZswitchSet(int status, const char *data, void *arg)
+{
+    if (status != OK) {
+        syslog(LOG_ERR, "LTE: Cannot set LTE module mode!\n");
+        atState = AT_STATE_STOPPED;
+        atEngineClose();
+        return;
+    }
 
-        atSend(port, LTE_ZTEWELINK_AT_INFO, DEFAULT_AT_TIMEOUT);
-        if (port->status == OK) {
-            // Data format: ^SYSINFO: 2,3,0,9,1
-            if (port->data[0] != '\0') {
-                int a, b, c, d, e;
-                if (sscanf(&port->data[10], "%d,%d,%d,%d,%d",
-                           &a, &b, &c, &d, &e) == 5) {
-                    snprintf(connStatus, sizeof(connStatus), "%d:%d", a, b);
-                    network = d;
-                    simStatus = e;
-                }
-            }
-        }
+    // Reset LTE module and wait for it to restart
+    atState = AT_STATE_RESET;
+    atEngineClose();
+    lteModuleReset();
+    timerSet(atTimer, MODULE_REBOOT_DELAY, 0);
+}
+
+/* Make sure dongle is in correct state for ether_cdc support */
+static void atZswitchChecked(int status, const char *data, void *arg)
+{
+    if ((status == OK) && (strstr(data, ": L") == NULL)) {
+        syslog(LOG_ERR, "LTE: Need to set module mode to Linux\n");
+        atEngineQueue(LTE_ZTEWELINK_AT_ZSWITCH_SET, AT_TIMEOUT_MS,
+                      atZswitchSet, NULL);
+        return;
+    }
+    atReadInfo();
+}
+
+/* (Re)open the AT port, unless backup_start/backup_stop have it */
+static int atPortOpen(void)
+{
+    if (atEngineIsOpen() || controlPid) {
+        return atEngineIsOpen() ? 0 : -1;
+    }
+    if (atEngineOpen(LTE_ZTEWELINK_AT_PORT, LTE_ZTEWELINK_AT_SPEED,
+                     LTE_ZTEWELINK_AT_FLOW) < 0) {
+        syslog(LOG_ERR, "LTE AT status - cannot open AT control port.\n");
+        return -1;
+    }
+    return 0;
+}
 
-        FILE *statusFile = fopen(LTE_NET_STATUS_FILE, "w");
-        if (statusFile) {
-            fprintf(infoFile, "sim: %d\n", simStatus);
-            fprintf(infoFile, "signal: %d\n", signalStrength);
-            fprintf(infoFile, "status: %s\n", connStatus);
-            fprintf(infoFile, "type: %d\n", network);
-            fclose(statusFile);
+/* AT status timer - startup steps, then periodic status */
+static void atTimerExpired(int fd, void *arg)
+{
+    timerAck(fd);
+
+    switch (atState) {
+    case AT_STATE_WAIT:
+        if (atPortOpen() < 0) {
+            timerSet(atTimer, AT_OPEN_RETRY_DELAY, 0);
+        } else if (atEngineQueue(LTE_ZTEWELINK_AT_ZSWITCH_CHECK, AT_TIMEOUT_MS,
+                                 atZswitchChecked, NULL) < 0) {
+            atReadInfo();
         }
+        break;
+    case AT_STATE_RESET:
+        if (atPortOpen() < 0) {
+            timerSet(atTimer, AT_OPEN_RETRY_DELAY, 0);
+        } else {
+            atReadInfo();
+        }
+        break;
+    case AT_STATE_STATUS:
+        // Port is closed if the modem was reset or unplugged
+        if (atPortOpen() == 0) {
+            atStatusRefresh();
+        }
+        break;
+    }
+}
 
-        /* Close port, can't keep it open in case needed by others */
-        atClose(port);
+static void atStatusStart(void)
+{
+    atTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (atTimer < 0) {
+        return;
     }
+    atEngineOnUrc("+CREG:", atNetworkChanged, NULL);
+    atEngineOnUrc("+CGEV:", atNetworkChanged, NULL);
+    atEngineWatch(atTimer, atTimerExpired, NULL);
+
+    /* Delay for the modem to settle */
+    timerSet(atTimer, AT_STATUS_INIT_DELAY, 0);
 }
 #endif
 
+/* Number of default routes via gw out intf - NULL or -1 matches any */
+static int defaultRouteFind(const char *gw, const char *intf, int metric)
+{
+    NetmonRoute routes[NETMON_MAX_ROUTES];
+    in_addr_t   addr = gw ? inet_addr(gw) : 0;
+    int         i, n, count = 0;
+
+    n = netmonGetDefaultRoutes(routes, NETMON_MAX_ROUTES);
+    for (i = 0; i < n; i++) {
+        if ((gw && (routes[i].gateway != addr)) ||
+            (intf && strcmp(routes[i].intf, intf)) ||
+            ((metric >= 0) && (routes[i].metric != metric))) {
+            continue;
+        }
+        count++;
+    }
+    return count;
+}
+
 /* Configure for primary connection */
 static int configPrimary()
 {
@@ -307,29 +472,23 @@ static int configPrimary()
             intf = PRIMARY_ETH_IF;
         }
 
-        snprintf(cmd, sizeof(cmd),
-                 "/sbin/ip route | grep -v 'metric 2' | grep 'default via %s dev %s'", 
-                 gw, intf);
-	f = popen(cmd, "r");
-	if (f) {
-	    char line[256];
-	    if (fgets(line, sizeof(line), f) == NULL) {
-	        snprintf(cmd, sizeof(cmd),
-			 "/sbin/ip route del default > /dev/null 2>&1");
-		system(cmd);
-		snprintf(cmd, sizeof(cmd),
-		  "/sbin/ip route add default via %s metric 0 > /dev/null 2>&1",
-			 gw);
-		if (!system(cmd)) {
-		    snprintf(cmd, sizeof(cmd), "cp %s %s", PRI_DNS_FILE,
-			     ORIG_DNS_FILE);
-		    res = system(cmd);
-		} else {
-		    syslog(LOG_ERR, "Error configuring primary route!");
-		    res = 1;
-		}
-	    }
-	    pclose(f);
+        // Metric 2 route doesn't count, it is only there while on backup
+        if (defaultRouteFind(gw, intf, -1) ==
+            defaultRouteFind(gw, intf, PRI_GW_BACKUP_METRIC)) {
+            snprintf(cmd, sizeof(cmd),
+                     "/sbin/ip route del default > /dev/null 2>&1");
+            system(cmd);
+            snprintf(cmd, sizeof(cmd),
+                     "/sbin/ip route add default via %s metric 0 > /dev/null 2>&1",
+                     gw);
+            if (!system(cmd)) {
+                snprintf(cmd, sizeof(cmd), "cp %s %s", PRI_DNS_FILE,
+                         ORIG_DNS_FILE);
+                res = system(cmd);
+            } else {
+                syslog(LOG_ERR, "Error configuring primary route!");
+                res = 1;
+            }
         }
     }
     return res;
@@ -349,27 +508,20 @@ static int configBackup(char *intf)
         fscanf(f, "%s", gw);
         fclose(f);
 
-        snprintf(cmd, sizeof(cmd),
-                 "/sbin/ip route | grep 'default via %s dev %s'", gw, intf);
-	f = popen(cmd, "r");
-	if (f) {
-	    char line[256];
-	    if (fgets(line, sizeof(line), f) == NULL) {
-	        snprintf(cmd, sizeof(cmd),
-			 "/sbin/ip route del default > /dev/null 2>&1");
-		system(cmd);
-		snprintf(cmd, sizeof(cmd),
-		  "/sbin/ip route add default via %s metric 0 > /dev/null 2>&1",
-			 gw);
-		if (!system(cmd)) {
-		    snprintf(cmd, sizeof(cmd), "cp %s %s", BKUP_DNS_FILE,
-			     ORIG_DNS_FILE);
-		    res = system(cmd);
-		} else {
-		    syslog(LOG_ERR, "Error configuring backup route!\n");
-		}
-	    }
-	    pclose(f);
+        if (defaultRouteFind(gw, intf, -1) == 0) {
+            snprintf(cmd, sizeof(cmd),
+                     "/sbin/ip route del default > /dev/null 2>&1");
+            system(cmd);
+            snprintf(cmd, sizeof(cmd),
+                     "/sbin/ip route add default via %s metric 0 > /dev/null 2>&1",
+                     gw);
+            if (!system(cmd)) {
+                snprintf(cmd, sizeof(cmd), "cp %s %s", BKUP_DNS_FILE,
+                         ORIG_DNS_FILE);
+                res = system(cmd);
+            } else {
+                syslog(LOG_ERR, "Error configuring backup route!\n");
+            }
         }
     }
     return res;
@@ -388,60 +540,148 @@ static void configRouteViaPriGateway()
         fscanf(f, "%s", gw);
         fclose(f);
 
-        snprintf(cmd, sizeof(cmd), "/sbin/ip route | grep 'metric 2'");
-	f = popen(cmd, "r");
-	if (f) {
-	    char line[256];
-	    if (fgets(line, sizeof(line), f) == NULL) {
-	        // Need to add temporary route to make sure we can get out
-	        snprintf(cmd, sizeof(cmd),
-		      "/sbin/route add default gw %s metric 2 > /dev/null 2>&1",
-			 gw);
-		system(cmd);
-	    }
-	    pclose(f);
+        if (defaultRouteFind(NULL, NULL, PRI_GW_BACKUP_METRIC) == 0) {
+            // Need to add temporary route to make sure we can get out
+            snprintf(cmd, sizeof(cmd),
+                     "/sbin/route add default gw %s metric %d > /dev/null 2>&1",
+                     gw, PRI_GW_BACKUP_METRIC);
+            system(cmd);
         }
     }
 }
 
-/* Monitor LTE control file used by agent to start/stop LTE */
-int main(int argc, char** argv)
+
+/* Interface flags, 0 if it doesn't exist */
+static int linkFlags(const char *intf)
 {
-    pthread_t  lte_thread, at_thread;
-    int        primary_up = 1;
-    FILE       *f;
-    char       dongleID[128];
-    char       backup_if[32];
-    char       cmd[128];
+    struct ifreq ifr;
+    int sock;
 
-    /* Turn ourselves into a daemon */
-    daemon(1, 1);
+    sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return 0;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", intf);
+    if (ioctl(sock, SIOCGIFFLAGS, &ifr) < 0) {
+        ifr.ifr_flags = 0;
+    }
+    close(sock);
+    return ifr.ifr_flags;
+}
 
-    /* Catch signals so we can bring down connection */
-    signal(SIGHUP, iris4g_sig_handler);
-    signal(SIGTERM, iris4g_sig_handler);
+/* Result of CHECK_PRIMARY_CMD, run while the backup connection is in use */
+static void primaryChecked(int available)
+{
+    char cmd[128];
 
-    /* Setup syslog */
-    openlog(SYSLOG_IDENT, (LOG_CONS | LOG_PID | LOG_PERROR), LOG_DAEMON);
+    if (available) {
+        if (!primary_up) {
+            // It's back - notify agent
+            snprintf(cmd, sizeof(cmd), "echo available > %s",
+                     PRI_GW_AVAIL_FILE);
+            system(cmd);
+
+            // Restore primary route and DNS
+            if (!configPrimary()) {
+                primary_up = 1;
+            }
+        }
+    } else {
+        // Setup backup gw and DNS
+        if (!configBackup(backup_if)) {
+            primary_up = 0;
+            unlink(PRI_GW_AVAIL_FILE);
+        }
+    }
+}
 
-    /* Create LTE control handler */
-    pthread_create(&lte_thread, NULL, &lteControlThreadHandler, NULL);
+/* Check on primary gateway */
+static void gatewayCheck(void)
+{
+    FILE *f;
+    char state[16];
+    char cmd[128];
 
-    /* Make sure LTE modem is present - wait for this file to exist! */
-    while (!done) {
-        f = fopen(LTE_DONGLE_FILE, "r");
-        dongleID[0] = '\0';
-        if (f) {
-            fscanf(f, "%s", dongleID);
-            fclose(f);
+    /* If we are testing the wifi connection, don't get in the way */
+    if (access("/tmp/testWifi.cfg", F_OK) != -1) {
+        return;
+    }
+
+    /* Already checking - check again once that is done */
+    if (checkPid) {
+        checkAgain = 1;
+        return;
+    }
+
+    /* If backup connection is in use, check if primary gateway is back */
+    snprintf(state, sizeof(state), "%s",
+             (linkFlags(backup_if) & IFF_UP) ? "up" : "down");
+
+    // Update status looked at by the agent
+    f = fopen(LTE_STATUS_FILE, "r");
+    if (f) {
+        char oldstate[16];
+        fscanf(f, "%s", oldstate);
+        fclose(f);
+        if (strncmp(state, oldstate, sizeof(oldstate))) {
+            snprintf(cmd, sizeof(cmd), "echo %s > %s",
+                     state, LTE_STATUS_FILE);
+            system(cmd);
         }
-        if (dongleID[0] != '\0') {
-            done = 1;
-        } else {
-            sleep(GATEWAY_CHECK_DELAY);
+    }
+
+    // Is backup connection up?
+    if (strncmp(state, "up", 2) == 0) {
+
+        // Add metric 2 route out primary, if not there
+        configRouteViaPriGateway();
+
+        // Check if primary is back up - result is handled on exit
+        checkPid = runCommand(CHECK_PRIMARY_CMD);
+    } else {
+        // Use primary route and DNS
+        if (!primary_up && !configPrimary()) {
+            primary_up = 1;
         }
     }
-    done = 0;
+}
+
+/* Link or address changes on the interfaces we care about trigger a check
+   right away - route changes are our own doing, so are left out */
+static void networkChanged(const char *intf, int changes, void *arg)
+{
+    if (!(changes & (NETMON_LINK | NETMON_ADDR)) || (backup_if[0] == '\0')) {
+        return;
+    }
+    if ((strcmp(intf, PRIMARY_ETH_IF) == 0) ||
+        (strcmp(intf, PRIMARY_WLAN_IF) == 0) ||
+        (strcmp(intf, backup_if) == 0)) {
+        gatewayCheck();
+    }
+}
+
+static void networkHandler(int fd, void *arg)
+{
+    netmonProcess();
+}
+
+/* Make sure LTE modem is present - wait for this file to exist! */
+static int lteDongleCheck(void)
+{
+    FILE *f;
+    char dongleID[128];
+    char cmd[128];
+
+    f = fopen(LTE_DONGLE_FILE, "r");
+    dongleID[0] = '\0';
+    if (f) {
+        fscanf(f, "%s", dongleID);
+        fclose(f);
+    }
+    if (dongleID[0] == '\0') {
+        return -1;
+    }
 
     // What type of dongle is it?
     if (strncmp(dongleID, LTE_HUAWEI_MODEM_ID,
@@ -457,8 +697,8 @@ int main(int argc, char** argv)
 		       strlen(LTE_ZTEWELINK_MODEM_ID)) == 0) {
         snprintf(backup_if, sizeof(backup_if), "%s", BACKUP_USB_IF);
 
-        /* Create AT status thread */
-        pthread_create(&at_thread, NULL, &atStatusThreadHandler, NULL);
+        /* Start AT status checks */
+        atStatusStart();
 #endif
     } else {
         snprintf(backup_if, sizeof(backup_if), "Unknown");
@@ -467,78 +707,110 @@ int main(int argc, char** argv)
     /* Record interface for agent access */
     snprintf(cmd, sizeof(cmd), "echo %s > %s", backup_if, LTE_INTF_FILE);
     system(cmd);
+    return 0;
+}
 
-    /* Check on primary gateway */
-    while (!done) {
-        char state[16];
+static void gatewayTimerExpired(int fd, void *arg)
+{
+    timerAck(fd);
 
-        /* Do this every so often */
-        sleep(GATEWAY_CHECK_DELAY);
+    if (backup_if[0] == '\0') {
+        lteDongleCheck();
+    } else {
+        gatewayCheck();
+    }
+}
 
-        /* If we are testing the wifi connection, don't get in the way */
-        if (access("/tmp/testWifi.cfg", F_OK) != -1) {
-            continue;
-        }
+/* Background command exited */
+static void childExited(int fd, void *arg)
+{
+    struct signalfd_siginfo si;
+    char request[16];
+    int  status;
 
-        /* If backup connection is in use, check if primary gateway is back */
-        snprintf(state, sizeof(state), "down");
-        snprintf(cmd, sizeof(cmd), BACKUP_CHECK_IF_STATUS, backup_if);
-        f = popen(cmd, "r");
-        if (f) {
-            char line[256];
-            if (fgets(line, sizeof(line), f) != NULL) {
-                snprintf(state, sizeof(state), "up");
-            }
-            pclose(f);
+    while (read(fd, &si, sizeof(si)) == sizeof(si)) {
+    }
+
+    if (controlPid && (waitpid(controlPid, &status, WNOHANG) == controlPid)) {
+        controlPid = 0;
+
+#ifdef ZTE_LTE_SUPPORTED
+        /* Take the AT port back */
+        if ((atState == AT_STATE_INFO) || (atState == AT_STATE_STATUS)) {
+            atPortOpen();
+        }
+#endif
+        if (controlPending[0] != '\0') {
+            snprintf(request, sizeof(request), "%s", controlPending);
+            controlPending[0] = '\0';
+            lteControl(request);
         }
+    }
 
-        // Update status looked at by the agent
-        f = fopen(LTE_STATUS_FILE, "r");
-        if (f) {
-            char oldstate[16];
-            fscanf(f, "%s", oldstate);
-            fclose(f);
-            if (strncmp(state, oldstate, sizeof(oldstate))) {
-                snprintf(cmd, sizeof(cmd), "echo %s > %s",
-                         state, LTE_STATUS_FILE);
-                system(cmd);
-            }
+    if (checkPid && (waitpid(checkPid, &status, WNOHANG) == checkPid)) {
+        checkPid = 0;
+        primaryChecked(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+        if (checkAgain) {
+            checkAgain = 0;
+            gatewayCheck();
         }
+    }
+}
 
-        // Is backup connection up?
-        if (strncmp(state, "up", 2) == 0) {
+/* Monitor LTE control file used by agent to start/stop LTE */
+int main(int argc, char** argv)
+{
+    sigset_t mask;
+    int      fd;
 
-            // Add metric 2 route out primary, if not there
-            configRouteViaPriGateway();
+    /* Turn ourselves into a daemon */
+    daemon(1, 1);
 
-            // Check if primary is back up
-            if (!system(CHECK_PRIMARY_CMD)) {
-                if (!primary_up) {
-                    // It's back - notify agent
-                    snprintf(cmd, sizeof(cmd), "echo available > %s",
-                             PRI_GW_AVAIL_FILE);
-                    system(cmd);
+    /* Catch signals so we can bring down connection */
+    signal(SIGHUP, iris4g_sig_handler);
+    signal(SIGTERM, iris4g_sig_handler);
 
-                    // Restore primary route and DNS
-                    if (!configPrimary()) {
-                        primary_up = 1;
-                    }
-                }
-            } else {
-                // Setup backup gw and DNS
-                if (!configBackup(backup_if)) {
-                    primary_up = 0;
-                    unlink(PRI_GW_AVAIL_FILE);
-                }
-            }
-        } else {
-            // Use primary route and DNS
-            if (!primary_up && !configPrimary()) {
-                primary_up = 1;
-            }
-        }
+    /* Setup syslog */
+    openlog(SYSLOG_IDENT, (LOG_CONS | LOG_PID | LOG_PERROR), LOG_DAEMON);
+
+    /* Everything runs from the AT engine's event loop */
+    if (atEngineInit() < 0) {
+        exit(1);
     }
-    return 0;
-}
 
+    /* Background commands are reaped through a file descriptor */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd >= 0) {
+        atEngineWatch(fd, childExited, NULL);
+    }
 
+    /* We want to be notified when the LTE control file is changed */
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0) {
+        inotify_add_watch(fd, LTE_CONTROL_FILE, IN_MODIFY);
+        atEngineWatch(fd, lteControlChanged, NULL);
+    }
+
+    /* Interface, address and route changes are reported by the kernel */
+    if (netmonInit() < 0) {
+        exit(1);
+    }
+    netmonSubscribe(networkChanged, NULL);
+    atEngineWatch(netmonFd(), networkHandler, NULL);
+
+    /* Periodic check still catches failures upstream of the links */
+    lteDongleCheck();
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd >= 0) {
+        timerSet(fd, GATEWAY_CHECK_DELAY, GATEWAY_CHECK_DELAY);
+        atEngineWatch(fd, gatewayTimerExpired, NULL);
+    }
+
+    while (!done) {
+        atEnginePoll(-1);
+    }
+    return 0;
+}
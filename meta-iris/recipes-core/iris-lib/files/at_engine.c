@@ -0,0 +1,416 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <syslog.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include "irislib.h"
+#include "at_engine.h"
+
+#define AT_ENG_MAX_EVENTS   (AT_ENG_MAX_WATCHES + 2)
+
+typedef struct {
+    char       cmd[AT_ENG_CMD_LEN];
+    char       prefix[AT_ENG_CMD_LEN];  // response prefix, e.g. "+CSQ:"
+    int        timeout;
+    ATCallback cb;
+    void       *arg;
+} ATCommand;
+
+typedef struct {
+    char         prefix[AT_ENG_CMD_LEN];
+    ATUrcHandler handler;
+    void         *arg;
+} ATUrc;
+
+typedef struct {
+    int            fd;
+    ATWatchHandler handler;
+    void           *arg;
+} ATWatch;
+
+static int epollFd = -1;
+static int timerFd = -1;
+static int portFd = -1;
+
+// Command queue - the head is in flight once written
+static ATCommand queue[AT_ENG_MAX_QUEUE];
+static int queueHead = 0;
+static int queueCount = 0;
+static int inFlight = 0;
+
+// Response being collected, and the partial line read so far
+static char data[AT_DATA_BUF_SIZE];
+static int dataLen = 0;
+static char line[AT_DATA_BUF_SIZE];
+static int lineLen = 0;
+
+static ATUrc urcs[AT_ENG_MAX_URCS];
+static int numUrcs = 0;
+static ATWatch watches[AT_ENG_MAX_WATCHES];
+static int numWatches = 0;
+
+static void atEngineArm(int timeout)
+{
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = timeout / 1000;
+    its.it_value.tv_nsec = (timeout % 1000) * 1000000;
+    timerfd_settime(timerFd, 0, &its, NULL);
+}
+
+// Response lines start with the command name - "AT+CSQ" answers "+CSQ:"
+static void atEnginePrefix(ATCommand *c)
+{
+    int len = 0;
+    const char *p = c->cmd + 2;
+
+    if ((*p == '+') || (*p == '^') || (*p == '$')) {
+        while ((p[len] != '\0') && (strchr("=?;\r\n", p[len]) == NULL)) {
+            len++;
+        }
+        memcpy(c->prefix, p, len);
+        c->prefix[len++] = ':';
+        c->prefix[len] = '\0';
+    } else {
+        c->prefix[0] = '\0';
+    }
+}
+
+static void atEngineNext(void);
+
+// Final result for the command in flight - pass it on, then send the next
+static void atEngineDone(int status)
+{
+    ATCommand c = queue[queueHead];
+    char response[AT_DATA_BUF_SIZE];
+
+    atEngineArm(0);
+    queueHead = (queueHead + 1) % AT_ENG_MAX_QUEUE;
+    queueCount--;
+    inFlight = 0;
+
+    // Callback may queue more, so hand it a copy
+    memcpy(response, data, dataLen + 1);
+    dataLen = 0;
+    data[0] = '\0';
+    if (c.cb) {
+        c.cb(status, response, c.arg);
+    }
+    atEngineNext();
+}
+
+static void atEngineNext(void)
+{
+    ATCommand *c;
+    int len;
+
+    if (inFlight || (queueCount == 0) || (portFd < 0)) {
+        return;
+    }
+    c = &queue[queueHead];
+
+    // Terminate the command line, if the caller didn't
+    len = strlen(c->cmd);
+    if ((len == 0) ||
+        ((c->cmd[len - 1] != '\r') && (c->cmd[len - 1] != '\n'))) {
+        c->cmd[len++] = '\r';
+        c->cmd[len] = '\0';
+    }
+
+    dataLen = 0;
+    data[0] = '\0';
+    inFlight = 1;
+    if (write(portFd, c->cmd, len) != len) {
+        syslog(LOG_ERR, "Unable to write AT command");
+        atEngineDone(ERROR);
+        return;
+    }
+    atEngineArm(c->timeout);
+}
+
+static int atEngineIsFinal(const char *l, int *status)
+{
+    if (strcmp(l, "OK") == 0) {
+        *status = OK;
+        return 1;
+    }
+    if ((strcmp(l, "ERROR") == 0) ||
+        (strncmp(l, "+CME ERROR", 10) == 0) ||
+        (strncmp(l, "+CMS ERROR", 10) == 0)) {
+        *status = ERROR;
+        return 1;
+    }
+    return 0;
+}
+
+static void atEngineLine(char *l)
+{
+    ATCommand *c = inFlight ? &queue[queueHead] : NULL;
+    int i, status, len;
+
+    // Skip blank lines, and the echo if it is on
+    if (l[0] == '\0') {
+        return;
+    }
+    if (c && (strncmp(l, c->cmd, strlen(l)) == 0) &&
+        (strchr("\r\n", c->cmd[strlen(l)]) != NULL)) {
+        return;
+    }
+
+    if (c && atEngineIsFinal(l, &status)) {
+        atEngineDone(status);
+        return;
+    }
+
+    // Unsolicited?  Not if it is what the command in flight answers with
+    if ((c == NULL) || (c->prefix[0] == '\0') ||
+        (strncmp(l, c->prefix, strlen(c->prefix)) != 0)) {
+        for (i = 0; i < numUrcs; i++) {
+            if (strncmp(l, urcs[i].prefix, strlen(urcs[i].prefix)) == 0) {
+                urcs[i].handler(l, urcs[i].arg);
+                return;
+            }
+        }
+    }
+    if (c == NULL) {
+        return;
+    }
+
+    // For now, just truncate if we get back too much data
+    len = strlen(l);
+    if (dataLen + len + 1 < sizeof(data)) {
+        if (dataLen) {
+            data[dataLen++] = '\n';
+        }
+        memcpy(&data[dataLen], l, len + 1);
+        dataLen += len;
+    }
+}
+
+static void atEngineRead(void)
+{
+    char buf[256];
+    int i, len;
+
+    while ((len = read(portFd, buf, sizeof(buf))) > 0) {
+        for (i = 0; i < len; i++) {
+            if (buf[i] == '\n') {
+                line[lineLen] = '\0';
+                lineLen = 0;
+                atEngineLine(line);
+
+                // A callback may have closed the port
+                if (portFd < 0) {
+                    return;
+                }
+            } else if ((buf[i] != '\r') && (lineLen < sizeof(line) - 1)) {
+                line[lineLen++] = buf[i];
+            }
+        }
+    }
+
+    // Modem gone - USB ports return EIO once unplugged or reset
+    if ((len == 0) || ((errno != EAGAIN) && (errno != EINTR))) {
+        syslog(LOG_ERR, "AT port closed: %s",
+               (len == 0) ? "end of file" : strerror(errno));
+        atEngineClose();
+    }
+}
+
+int atEngineInit(void)
+{
+    struct epoll_event ev;
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if ((epollFd < 0) || (timerFd < 0)) {
+        syslog(LOG_ERR, "Unable to create AT engine: %s", strerror(errno));
+        return -1;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = timerFd;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev);
+}
+
+/* Open/close port */
+int atEngineOpen(char *port, int speed, int flow)
+{
+    struct epoll_event ev;
+
+    if (portFd >= 0) {
+        return 0;
+    }
+
+    portFd = open(port, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (portFd < 0) {
+        return -1;
+    }
+    IRIS_initSerialPort(portFd, speed, flow);
+    tcflush(portFd, TCIOFLUSH);
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = portFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, portFd, &ev) < 0) {
+        close(portFd);
+        portFd = -1;
+        return -1;
+    }
+    lineLen = 0;
+
+    // Send anything queued while closed
+    atEngineNext();
+    return 0;
+}
+
+void atEngineClose(void)
+{
+    if (portFd < 0) {
+        return;
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, portFd, NULL);
+    close(portFd);
+    portFd = -1;
+
+    // The command in flight may or may not have run - let the caller decide
+    if (inFlight) {
+        atEngineDone(AT_CLOSED);
+    }
+}
+
+int atEngineIsOpen(void)
+{
+    return portFd >= 0;
+}
+
+/* Queue a command */
+int atEngineQueue(const char *cmd, int timeout, ATCallback cb, void *arg)
+{
+    ATCommand *c;
+
+    if ((cmd == NULL) || (strncmp(cmd, "AT", 2) != 0) ||
+        (strlen(cmd) > sizeof(c->cmd) - 2) ||
+        (queueCount == AT_ENG_MAX_QUEUE)) {
+        return -1;
+    }
+
+    c = &queue[(queueHead + queueCount) % AT_ENG_MAX_QUEUE];
+    snprintf(c->cmd, sizeof(c->cmd), "%s", cmd);
+    atEnginePrefix(c);
+    c->timeout = timeout;
+    c->cb = cb;
+    c->arg = arg;
+    queueCount++;
+
+    atEngineNext();
+    return 0;
+}
+
+int atEngineOnUrc(const char *prefix, ATUrcHandler handler, void *arg)
+{
+    ATUrc *u;
+
+    if (numUrcs == AT_ENG_MAX_URCS) {
+        return -1;
+    }
+    u = &urcs[numUrcs++];
+    snprintf(u->prefix, sizeof(u->prefix), "%s", prefix);
+    u->handler = handler;
+    u->arg = arg;
+    return 0;
+}
+
+int atEngineWatch(int fd, ATWatchHandler handler, void *arg)
+{
+    struct epoll_event ev;
+
+    if (numWatches == AT_ENG_MAX_WATCHES) {
+        return -1;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        return -1;
+    }
+    watches[numWatches].fd = fd;
+    watches[numWatches].handler = handler;
+    watches[numWatches].arg = arg;
+    numWatches++;
+    return 0;
+}
+
+void atEngineUnwatch(int fd)
+{
+    int i;
+
+    for (i = 0; i < numWatches; i++) {
+        if (watches[i].fd == fd) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+            watches[i] = watches[--numWatches];
+            return;
+        }
+    }
+}
+
+int atEnginePoll(int timeout)
+{
+    struct epoll_event events[AT_ENG_MAX_EVENTS];
+    int i, j, n;
+
+    n = epoll_wait(epollFd, events, AT_ENG_MAX_EVENTS, timeout);
+    if (n < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    for (i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+
+        if (fd == portFd) {
+            atEngineRead();
+        } else if (fd == timerFd) {
+            unsigned long long expired;
+
+            if ((read(timerFd, &expired, sizeof(expired)) > 0) && inFlight) {
+                syslog(LOG_WARNING, "AT command timed out: %.*s",
+                       (int)strcspn(queue[queueHead].cmd, "\r\n"),
+                       queue[queueHead].cmd);
+                atEngineDone(AT_TIMEOUT);
+            }
+        } else {
+            // Handlers may remove watches, so look each one up
+            for (j = 0; j < numWatches; j++) {
+                if (watches[j].fd == fd) {
+                    watches[j].handler(fd, watches[j].arg);
+                    break;
+                }
+            }
+        }
+    }
+    return n;
+}
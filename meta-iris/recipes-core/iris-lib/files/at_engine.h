@@ -0,0 +1,76 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _AT_ENGINE_H
+#define _AT_ENGINE_H
+
+#include "at_parser.h"
+
+/*
+ * AT engine - event driven alternative to atSend().
+ *
+ * Commands are queued with a callback and a timeout in ms, and go out one
+ * at a time: the next is written as soon as the final result of the one
+ * before it is read, so a batch costs no extra wakeups or port opens.
+ * Responses are split into lines as they arrive.  Lines that match a
+ * registered URC prefix (and not the response prefix of the command in
+ * flight) are passed to the URC handler instead.
+ *
+ * Everything runs from atEnginePoll(), which waits on an epoll set.  Other
+ * file descriptors can be added to the set, so a daemon needs no other
+ * loop and no threads.
+ */
+
+#define AT_ENG_MAX_QUEUE    16
+#define AT_ENG_MAX_URCS     8
+#define AT_ENG_MAX_WATCHES  8
+#define AT_ENG_CMD_LEN      64
+
+// Command status passed to callbacks, besides OK and ERROR
+#define AT_TIMEOUT          2
+#define AT_CLOSED           3   // port closed before the command completed
+
+/* Called with the final status and the response lines, '\n' separated */
+typedef void (*ATCallback)(int status, const char *data, void *arg);
+
+/* Called with each unsolicited line matching the prefix */
+typedef void (*ATUrcHandler)(const char *line, void *arg);
+
+/* Called when a watched file descriptor is ready */
+typedef void (*ATWatchHandler)(int fd, void *arg);
+
+/* Setup - call once */
+int atEngineInit(void);
+
+/* Open/close port - commands queued while closed wait for the next open */
+int atEngineOpen(char *port, int speed, int flow);
+void atEngineClose(void);
+int atEngineIsOpen(void);
+
+/* Queue a command - timeout in ms */
+int atEngineQueue(const char *cmd, int timeout, ATCallback cb, void *arg);
+
+/* Pass unsolicited lines starting with prefix to handler */
+int atEngineOnUrc(const char *prefix, ATUrcHandler handler, void *arg);
+
+/* Add/remove other file descriptors to wait on */
+int atEngineWatch(int fd, ATWatchHandler handler, void *arg);
+void atEngineUnwatch(int fd);
+
+/* Wait up to timeout ms (-1 forever) for, and handle, port and fd events */
+int atEnginePoll(int timeout);
+
+#endif /* _AT_ENGINE_H */
@@ -26,6 +26,9 @@
 // Location of LED mode file - write to this to change LED setting
 #define LED_MODE_FILE     "/tmp/ledMode"
 
+// LED engine socket - send a mode here to change LED setting directly
+#define LED_SOCKET_FILE   "/tmp/ledSocket"
+
 // Last LED mode setting file
 #define LAST_LED_MODE_FILE "/tmp/lastLedMode"
 
@@ -83,6 +86,9 @@ typedef enum
     CONNECTED
 } WifiStatusType;
 
+// Supervised daemon status, see supervisor.h
+#define DAEMON_STATUS_FILE "/tmp/daemonStatus"
+
 // Iris Button (hubv3) pushed time
 #define IRIS_BTN_PUSHED_FILE "/tmp/irisButtonPushed"
 
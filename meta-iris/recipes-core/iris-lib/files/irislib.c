@@ -26,12 +26,16 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <termios.h>
-#if imxdimagic
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#if imxdimagic
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #endif
 #include "irislib.h"
+#include "ledengine.h"
+#include "netmon.h"
 
 #if imxdimagic
 // Support for v3 hub power controller for hub shutdown
@@ -247,6 +251,11 @@ void IRIS_setLedMode(char *mode)
 {
     FILE *f;
 
+    // Straight to the LED engine if it is running
+    if (ledSendMode(mode) == 0) {
+        return;
+    }
+
     f = fopen(LED_MODE_FILE, "w");
     if (f != NULL) {
         fwrite(mode, 1, strlen(mode), f);
@@ -411,20 +420,25 @@ void IRIS_playAudio(char *filename, int delay)
 /* Check interface state */
 int IRIS_isIntfIPUp(char *intf)
 {
-    char cmd[256];
-    FILE *f;
+    struct ifreq ifr;
+    int sock, res;
 
-    snprintf(cmd, sizeof(cmd), CHECK_IF_IP_UP, intf);
-    f = popen(cmd, "r");
-    if (f) {
-        char line[256];
-        if (fgets(line, sizeof(line), f) != NULL) {
-            pclose(f);
-            return 1;
-        }
-        pclose(f);
+    // Network monitor running in this process?
+    res = netmonHasAddress(intf);
+    if (res >= 0) {
+        return res;
     }
-    return 0;
+
+    // Otherwise ask the kernel for an IPv4 address directly
+    sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return 0;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", intf);
+    res = (ioctl(sock, SIOCGIFADDR, &ifr) == 0);
+    close(sock);
+    return res;
 }
 
 /* Power down hub, if possible */
@@ -477,20 +491,27 @@ void IRIS_powerDownHub(void)
 
 int IRIS_isIntfConnected(char *intf)
 {
-    char cmd[256];
-    FILE *f;
+    char path[128];
+    char carrier = '0';
+    int fd, res;
+
+    // Network monitor running in this process?
+    res = netmonIsConnected(intf);
+    if (res >= 0) {
+        return res;
+    }
 
-    snprintf(cmd, sizeof(cmd), CHECK_IF_STATUS, intf);
-    f = popen(cmd, "r");
-    if (f) {
-        char line[256];
-        if (fgets(line, sizeof(line), f) != NULL) {
-            pclose(f);
-            return 1;
-        }
-        pclose(f);
+    // Otherwise read the carrier state - an error if the link is down
+    snprintf(path, sizeof(path), "/sys/class/net/%s/carrier", intf);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
     }
-    return 0;
+    if (read(fd, &carrier, 1) != 1) {
+        carrier = '0';
+    }
+    close(fd);
+    return carrier == '1';
 }
 
 
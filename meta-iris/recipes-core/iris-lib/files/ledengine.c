@@ -0,0 +1,1040 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <stdint.h>
+#include <syslog.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/timerfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include "irislib.h"
+#include "ledengine.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+// How long error modes are shown - some errors end in a reboot
+#define ERR_TIME            3000
+#define ERR_REBOOT_TIME     10000
+
+// Tick modes without a duration tick this often
+#define TICK_HOLD           5000
+
+// Every LED of the ring, or the three sysfs LEDs
+#define LED_ALL             0xFFF
+#define LED_GREEN           0x1
+#define LED_YELLOW          0x2
+#define LED_RED             0x4
+
+#define ALL(l)  { l, l, l, l, l, l, l, l, l, l, l, l }
+
+/*
+ * Animations
+ */
+
+#ifndef imxdimagic
+// Single LED, as ledctrl drove them
+static const LedStep onSteps[] = {
+    { 0, { 100 } }
+};
+static const LedStep blink0_5HzSteps[] = {
+    { 1000, { 100 } }, { 1000, { 0 } }
+};
+static const LedStep blink1HzSteps[] = {
+    { 500, { 100 } }, { 500, { 0 } }
+};
+static const LedStep blink2HzSteps[] = {
+    { 250, { 100 } }, { 250, { 0 } }
+};
+
+static const LedAnim animOn = { onSteps, 1, -1 };
+static const LedAnim anim0_5Hz = { blink0_5HzSteps, 2, 0 };
+static const LedAnim anim1Hz = { blink1HzSteps, 2, 0 };
+static const LedAnim anim2Hz = { blink2HzSteps, 2, 0 };
+#else
+// Whole ring, as ledRing drove it
+static const LedStep solidSteps[] = {
+    { 0, ALL(100) }
+};
+static const LedStep blinkLongSteps[] = {
+    { 2000, ALL(100) }
+};
+static const LedStep tripleSteps[] = {
+    { 500, ALL(0) },
+    { 300, ALL(100) }, { 300, ALL(0) },
+    { 300, ALL(100) }, { 300, ALL(0) },
+    { 300, ALL(100) }, { 500, ALL(0) }
+};
+
+// Clockwise, with a dimmer LED either side of the lit one
+static const LedStep rotateSteps[] = {
+    { 100, {  50,   0,   0,   0,   0,   0,   0,   0,   0,   0,  50, 100 } },
+    { 100, {   0,   0,   0,   0,   0,   0,   0,   0,   0,  50, 100,  50 } },
+    { 100, {   0,   0,   0,   0,   0,   0,   0,   0,  50, 100,  50,   0 } },
+    { 100, {   0,   0,   0,   0,   0,   0,   0,  50, 100,  50,   0,   0 } },
+    { 100, {   0,   0,   0,   0,   0,   0,  50, 100,  50,   0,   0,   0 } },
+    { 100, {   0,   0,   0,   0,   0,  50, 100,  50,   0,   0,   0,   0 } },
+    { 100, {   0,   0,   0,   0,  50, 100,  50,   0,   0,   0,   0,   0 } },
+    { 100, {   0,   0,   0,  50, 100,  50,   0,   0,   0,   0,   0,   0 } },
+    { 100, {   0,   0,  50, 100,  50,   0,   0,   0,   0,   0,   0,   0 } },
+    { 100, {   0,  50, 100,  50,   0,   0,   0,   0,   0,   0,   0,   0 } },
+    { 100, {  50, 100,  50,   0,   0,   0,   0,   0,   0,   0,   0,   0 } },
+    { 100, { 100,  50,   0,   0,   0,   0,   0,   0,   0,   0,   0,  50 } }
+};
+
+static const LedStep pulseSteps[] = {
+    { 100, ALL(0) },  { 100, ALL(10) }, { 100, ALL(20) }, { 100, ALL(30) },
+    { 100, ALL(40) }, { 100, ALL(50) }, { 100, ALL(60) }, { 100, ALL(70) },
+    { 100, ALL(80) }, { 100, ALL(90) }, { 100, ALL(100) }
+};
+static const LedStep waveSteps[] = {
+    { 100, ALL(0) },  { 100, ALL(10) }, { 100, ALL(20) }, { 100, ALL(30) },
+    { 100, ALL(40) }, { 100, ALL(50) }, { 100, ALL(60) }, { 100, ALL(70) },
+    { 100, ALL(80) }, { 100, ALL(90) }, { 100, ALL(100) },
+    { 100, ALL(100) }, { 100, ALL(90) }, { 100, ALL(80) }, { 100, ALL(70) },
+    { 100, ALL(60) }, { 100, ALL(50) }, { 100, ALL(40) }, { 100, ALL(30) },
+    { 100, ALL(20) }, { 100, ALL(10) }, { 100, ALL(0) }
+};
+
+// Segments go out one at a time over the mode duration
+#define T LED_HOLD_SPREAD
+static const LedStep tickDownSteps[] = {
+    { T, { 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100 } },
+    { T, { 100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100,   0 } },
+    { T, { 100, 100, 100, 100, 100, 100, 100, 100, 100, 100,   0,   0 } },
+    { T, { 100, 100, 100, 100, 100, 100, 100, 100, 100,   0,   0,   0 } },
+    { T, { 100, 100, 100, 100, 100, 100, 100, 100,   0,   0,   0,   0 } },
+    { T, { 100, 100, 100, 100, 100, 100, 100,   0,   0,   0,   0,   0 } },
+    { T, { 100, 100, 100, 100, 100, 100,   0,   0,   0,   0,   0,   0 } },
+    { T, { 100, 100, 100, 100, 100,   0,   0,   0,   0,   0,   0,   0 } },
+    { T, { 100, 100, 100, 100,   0,   0,   0,   0,   0,   0,   0,   0 } },
+    { T, { 100, 100, 100,   0,   0,   0,   0,   0,   0,   0,   0,   0 } },
+    { T, { 100, 100,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 } },
+    { T, { 100,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 } }
+};
+#undef T
+
+#define ANIM(s, loop)   { s, ARRAY_SIZE(s), loop }
+
+static const LedAnim solid = ANIM(solidSteps, -1);
+static const LedAnim blinkLong = ANIM(blinkLongSteps, -1);
+static const LedAnim triple = ANIM(tripleSteps, -1);
+static const LedAnim rotateSlow = ANIM(rotateSteps, 0);
+static const LedAnim pulse = ANIM(pulseSteps, 0);
+static const LedAnim wave = ANIM(waveSteps, 0);
+static const LedAnim tickDown = ANIM(tickDownSteps, 0);
+#endif
+
+/*
+ * Modes - names as ledctrl and ringctrl took them
+ */
+
+#ifdef imxdimagic
+#define COLOR_WHITE         0x402010
+#define COLOR_RED           0x640000
+#define COLOR_GREEN         0x006400
+#define COLOR_BLUE          0x000064
+#define COLOR_BLUE_TICK     0x000030 // Lower power to avoid bleed
+#define COLOR_PURPLE        0x640064
+#define COLOR_PINK          0x64000A
+#define COLOR_TEAL          0x006432
+#define COLOR_YELLOW        0x401800
+
+#define RING(name, pri, color, anim, secs) \
+    { name, pri, (secs) * 1000, 1, { { LED_ALL, color, &anim } } }
+#define KEEP(name) \
+    { name, LED_PRI_NORMAL, 0, 0 }
+#define RING_ERR(name, time) \
+    { name, LED_PRI_ERROR, time, 1, { { LED_ALL, COLOR_RED, &solid } } }
+
+#define N   LED_PRI_NORMAL
+#define E   LED_PRI_EVENT
+
+static const LedMode modes[] = {
+    RING("boot-post",                   N, COLOR_PURPLE, solid, 0),
+    RING("boot-linux",                  N, COLOR_PURPLE, solid, 0),
+    RING("boot-agent",                  N, COLOR_PURPLE, rotateSlow, 0),
+    KEEP("unassoc-conn-pri"),
+    KEEP("unassoc-conn-pri-batt"),
+    KEEP("unassoc-conn-backup"),
+    KEEP("unassoc-conn-backup-batt"),
+    KEEP("unassoc-disconn"),
+    KEEP("unassoc-disconn-batt"),
+    KEEP("assoc-conn-pri"),
+    KEEP("assoc-conn-pri-batt"),
+    KEEP("assoc-conn-backup"),
+    KEEP("assoc-conn-backup-batt"),
+    KEEP("assoc-disconn"),
+    KEEP("assoc-disconn-batt"),
+    RING("pairing-conn-pri",            N, COLOR_GREEN, rotateSlow, 0),
+    RING("pairing-conn-pri-batt",       N, COLOR_GREEN, rotateSlow, 0),
+    RING("pairing-conn-backup",         N, COLOR_GREEN, rotateSlow, 0),
+    RING("pairing-conn-backup-batt",    N, COLOR_GREEN, rotateSlow, 0),
+    RING("pairing-disconn",             N, COLOR_BLUE, pulse, 0),
+    RING("pairing-disconn-batt",        N, COLOR_BLUE, pulse, 0),
+    RING("upgrade-decrypt",             N, COLOR_WHITE, rotateSlow, 10),
+    RING_ERR("upgrade-decrypt-err",     ERR_TIME),
+    RING("upgrade-unpack",              N, COLOR_WHITE, rotateSlow, 10),
+    RING_ERR("upgrade-unpack-err",      ERR_TIME),
+    RING("upgrade-bootloader",          N, COLOR_WHITE, rotateSlow, 10),
+    RING_ERR("upgrade-bootloader-err",  ERR_REBOOT_TIME),
+    RING("upgrade-kernel",              N, COLOR_WHITE, rotateSlow, 10),
+    RING_ERR("upgrade-kernel-err",      ERR_REBOOT_TIME),
+    RING("upgrade-rootfs",              N, COLOR_WHITE, rotateSlow, 10),
+    RING_ERR("upgrade-rootfs-err",      ERR_REBOOT_TIME),
+    RING("upgrade-zigbee",              N, COLOR_WHITE, rotateSlow, 10),
+    RING_ERR("upgrade-zigbee-err",      ERR_TIME),
+    RING("upgrade-zwave",               N, COLOR_WHITE, rotateSlow, 10),
+    RING_ERR("upgrade-zwave-err",       ERR_TIME),
+    RING("upgrade-bte",                 N, COLOR_WHITE, rotateSlow, 10),
+    RING_ERR("upgrade-bte-err",         ERR_TIME),
+    RING("shutdown",                    N, COLOR_GREEN, solid, 5),
+    RING("button-reboot",               N, COLOR_GREEN, solid, 5),
+    RING("button-soft-reset",           N, COLOR_GREEN, solid, 5),
+    RING("button-factory-default",      N, COLOR_PINK, solid, 15),
+    RING("all-on",                      N, COLOR_WHITE, solid, 0),
+    RING("all-off",                     N, 0, solid, 0),
+    RING("first-bootup",                N, COLOR_BLUE, rotateSlow, 0),
+    RING("ethernet-inserted",           N, COLOR_BLUE, rotateSlow, 0),
+    RING("wifi-in-progress",            N, COLOR_BLUE, rotateSlow, 120),
+    RING("wifi-success",                N, COLOR_BLUE, rotateSlow, 0),
+    RING("wifi-failure",                N, COLOR_PINK, rotateSlow, 0),
+    RING("internet-in-progress",        N, COLOR_BLUE, rotateSlow, 60),
+    RING("internet-success",            N, COLOR_BLUE, rotateSlow, 0),
+    RING("internet-failure",            N, COLOR_PINK, solid, 0),
+    RING("cloud-in-progress",           N, COLOR_BLUE, rotateSlow, 60),
+    RING("cloud-success",               N, COLOR_BLUE, solid, 0),
+    RING("cloud-failure",               N, COLOR_PINK, pulse, 0),
+    RING("register-in-progress",        N, COLOR_BLUE, solid, 60),
+    RING("register-success",            E, COLOR_GREEN, triple, 0),
+    RING("register-failure",            N, COLOR_PINK, pulse, 0),
+    RING("device-paired",               E, COLOR_GREEN, triple, 0),
+    RING("device-removed",              E, COLOR_GREEN, blinkLong, 0),
+    RING("button-press-normal",         E, COLOR_GREEN, solid, 5),
+    RING("button-press-status",         E, COLOR_GREEN, solid, 5),
+    RING("button-press-battery",        E, COLOR_YELLOW, solid, 5),
+    RING("button-press-offline",        E, COLOR_PINK, solid, 5),
+    RING("button-press-backup",         E, COLOR_RED, solid, 5),
+    RING("button-press-backup-batt",    E, COLOR_YELLOW, solid, 5),
+    RING("button-press-offline-batt",   E, COLOR_PINK, solid, 5),
+    RING("button-press-backup-offline", E, COLOR_PINK, solid, 5),
+    RING("button-press-wifi-reconnect", E, COLOR_GREEN, solid, 5),
+    RING("deregistering",               N, COLOR_GREEN, solid, 10),
+    RING("factory-reset-ack",           N, COLOR_GREEN, solid, 15),
+    RING("turning-off",                 N, COLOR_GREEN, solid, 5),
+    RING("alarm-grace-enter",           N, COLOR_BLUE_TICK, tickDown, 0),
+    RING("alarm-grace-exit",            N, COLOR_BLUE_TICK, tickDown, 0),
+    RING("alarm-off",                   E, COLOR_GREEN, blinkLong, 0),
+    RING("alarm-on",                    E, COLOR_BLUE, blinkLong, 0),
+    RING("alarm-partial",               E, COLOR_BLUE, blinkLong, 0),
+    RING("alarm-failure",               E, COLOR_PINK, solid, 5),
+    RING("alarming-security",           N, COLOR_BLUE, pulse, 0),
+    RING("alarming-security-batt",      N, COLOR_BLUE, pulse, 120),
+    RING("alarming-local",              N, COLOR_BLUE, pulse, 0),
+    RING("alarming-local-batt",         N, COLOR_BLUE, pulse, 120),
+    RING("alarming-panic",              N, COLOR_WHITE, pulse, 0),
+    RING("alarming-panic-batt",         N, COLOR_WHITE, pulse, 120),
+    RING("alarming-panic-mon",          N, COLOR_WHITE, pulse, 0),
+    RING("alarming-panic-mon-batt",     N, COLOR_WHITE, pulse, 120),
+    RING("alarming-panic-local",        N, COLOR_WHITE, pulse, 0),
+    RING("alarming-panic-local-batt",   N, COLOR_WHITE, pulse, 120),
+    RING("alarming-smoke",              N, COLOR_RED, pulse, 0),
+    RING("alarming-smoke-batt",         N, COLOR_RED, pulse, 120),
+    RING("alarming-co",                 N, COLOR_RED, pulse, 0),
+    RING("alarming-co-batt",            N, COLOR_RED, pulse, 120),
+    RING("alarming-leak",               N, COLOR_TEAL, pulse, 0),
+    RING("alarming-leak-batt",          N, COLOR_TEAL, pulse, 120),
+    RING("alarming-care",               N, COLOR_PURPLE, wave, 0),
+    RING("alarming-care-batt",          N, COLOR_PURPLE, wave, 120),
+    RING("door-chime",                  E, COLOR_PURPLE, blinkLong, 0),
+};
+
+#undef N
+#undef E
+
+// Once shown, these modes only give way to the ones listed
+static const struct {
+    const char *mode;
+    const char *next[2];
+} finalModes[] = {
+    { "turning-off",            { NULL } },
+    { "shutdown",               { "boot-linux" } },
+    { "button-reboot",          { "shutdown", "button-soft-reset" } },
+    { "button-soft-reset",      { "shutdown", "button-factory-default" } },
+    { "button-factory-default", { "shutdown" } },
+    { "factory-reset-ack",      { "shutdown" } },
+};
+#else
+#define OFF     NULL
+#define ON      &animOn
+#define HZ0_5   &anim0_5Hz
+#define HZ1     &anim1Hz
+#define HZ2     &anim2Hz
+
+#define LEDS(name, pri, time, green, yellow, red) \
+    { name, pri, time, 3, { { LED_GREEN, 0, green }, \
+                            { LED_YELLOW, 0, yellow }, \
+                            { LED_RED, 0, red } } }
+#define LEDS_ERR(name, time, green, yellow, red) \
+    LEDS(name, LED_PRI_ERROR, time, green, yellow, red)
+
+#define N   LED_PRI_NORMAL
+
+static const LedMode modes[] = {
+    LEDS("boot-post",                N, 0, HZ1, HZ1, HZ1),
+    LEDS("boot-linux",               N, 0, HZ1, HZ1, OFF),
+    LEDS("boot-agent",               N, 0, HZ1, OFF, OFF),
+    LEDS("unassoc-conn-pri",         N, 0, HZ0_5, OFF, OFF),
+    LEDS("unassoc-conn-pri-batt",    N, 0, HZ0_5, HZ0_5, OFF),
+    LEDS("unassoc-conn-backup",      N, 0, HZ0_5, ON, OFF),
+    LEDS("unassoc-conn-backup-batt", N, 0, HZ0_5, HZ0_5, OFF),
+    LEDS("unassoc-disconn",          N, 0, HZ0_5, OFF, HZ1),
+    LEDS("unassoc-disconn-batt",     N, 0, HZ0_5, HZ0_5, HZ1),
+    LEDS("assoc-conn-pri",           N, 0, ON, OFF, OFF),
+    LEDS("assoc-conn-pri-batt",      N, 0, ON, HZ0_5, OFF),
+    LEDS("assoc-conn-backup",        N, 0, ON, ON, OFF),
+    LEDS("assoc-conn-backup-batt",   N, 0, ON, HZ0_5, OFF),
+    LEDS("assoc-disconn",            N, 0, ON, OFF, HZ1),
+    LEDS("assoc-disconn-batt",       N, 0, ON, HZ0_5, HZ1),
+    LEDS("pairing-conn-pri",         N, 0, HZ1, OFF, OFF),
+    LEDS("pairing-conn-pri-batt",    N, 0, HZ1, HZ0_5, OFF),
+    LEDS("pairing-conn-backup",      N, 0, HZ1, ON, OFF),
+    LEDS("pairing-conn-backup-batt", N, 0, HZ1, HZ0_5, OFF),
+    LEDS("pairing-disconn",          N, 0, HZ1, OFF, HZ1),
+    LEDS("pairing-disconn-batt",     N, 0, HZ1, HZ0_5, HZ1),
+    LEDS("upgrade-decrypt",          N, 0, OFF, HZ2, OFF),
+    LEDS_ERR("upgrade-decrypt-err",     ERR_TIME, OFF, HZ2, ON),
+    LEDS("upgrade-unpack",           N, 0, OFF, HZ2, OFF),
+    LEDS_ERR("upgrade-unpack-err",      ERR_TIME, OFF, HZ2, ON),
+    LEDS("upgrade-bootloader",       N, 0, OFF, OFF, HZ2),
+    LEDS_ERR("upgrade-bootloader-err",  ERR_REBOOT_TIME, OFF, OFF, ON),
+    LEDS("upgrade-kernel",           N, 0, OFF, OFF, HZ2),
+    LEDS_ERR("upgrade-kernel-err",      ERR_REBOOT_TIME, OFF, HZ1, ON),
+    LEDS("upgrade-rootfs",           N, 0, OFF, OFF, HZ2),
+    LEDS_ERR("upgrade-rootfs-err",      ERR_REBOOT_TIME, HZ1, HZ1, ON),
+    LEDS("upgrade-zigbee",           N, 0, HZ2, OFF, OFF),
+    LEDS_ERR("upgrade-zigbee-err",      ERR_TIME, HZ2, OFF, ON),
+    LEDS("upgrade-zwave",            N, 0, HZ2, OFF, OFF),
+    LEDS_ERR("upgrade-zwave-err",       ERR_TIME, HZ2, OFF, ON),
+    LEDS("upgrade-bte",              N, 0, HZ2, OFF, OFF),
+    LEDS_ERR("upgrade-bte-err",         ERR_TIME, HZ2, OFF, ON),
+    LEDS("shutdown",                 N, 0, ON, ON, ON),
+    LEDS("button-reboot",            N, 0, OFF, OFF, ON),
+    LEDS("button-soft-reset",        N, 0, OFF, ON, ON),
+    LEDS("button-factory-default",   N, 0, ON, ON, ON),
+    LEDS("all-on",                   N, 0, ON, ON, ON),
+    LEDS("all-off",                  N, 0, OFF, OFF, OFF),
+};
+
+#undef N
+#endif
+
+/*
+ * Backends - sysfs LEDs, or the LED ring on the v3 hub
+ */
+
+typedef struct {
+    int level;
+    int color;
+    int on;         // kernel blink times, 0 when steady
+    int off;
+} LedOut;
+
+#ifdef imxdimagic
+/* ioctl cmd */
+#define MOTOR_MAGIC         'L'
+#define IOCTL_GPIO_SPI_SET  _IOW(MOTOR_MAGIC, 0,int)
+#define RING_DEV            "/dev/MBI6023"
+
+// First version of hardware had 4 groups of LEDs rather than individual control
+#define MIN_IND_LED_VER     2
+#define TOTAL_LEDS          12
+#define TOTAL_QUADS         4
+
+typedef struct {
+    int  mbi6023[3 + (TOTAL_LEDS * 3)];
+    int  index;
+} RingFrame;
+
+static int ringFd = -1;
+static int ringQuads = 0;
+static LedOut ringOut[TOTAL_LEDS];
+
+static int backendInit(const char *dir)
+{
+    int hwVer;
+
+    ringFd = open(RING_DEV, O_RDWR | O_CLOEXEC);
+    if (ringFd < 0) {
+        syslog(LOG_ERR, "Unable to open LED ring: %s", strerror(errno));
+        return -1;
+    }
+
+    // If version not set, assume latest as board is likely yet to be
+    //  manufactured
+    hwVer = IRIS_getHardwareVersion();
+    ringQuads = (hwVer != 0) && (hwVer < MIN_IND_LED_VER);
+    return TOTAL_LEDS;
+}
+
+static int backendSet(int output, const LedOut *out)
+{
+    ringOut[output] = *out;
+    return 0;
+}
+
+// Colour value is in percentages of max brightness, scaled by the level
+static void ringColor(int *brg, const LedOut *out)
+{
+    brg[0] = ((out->color & 0x0000FF) * 0xFFFF / 100) * out->level / 100;
+    brg[1] = (((out->color & 0xFF0000) >> 16) * 0xFFFF / 100) * out->level / 100;
+    brg[2] = (((out->color & 0x00FF00) >> 8) * 0xFFFF / 100) * out->level / 100;
+}
+
+// The whole ring is written in one go
+static int backendFlush(void)
+{
+    RingFrame frame;
+    int i, num;
+
+    memset(&frame, 0, sizeof(frame));
+    if (ringQuads) {
+        // Each quadrant shows the middle LED of its three
+        frame.mbi6023[0] = 0xFC00;
+        frame.mbi6023[1] = 0xFC00;
+        frame.mbi6023[2] = 0x0000;
+        num = TOTAL_QUADS;
+        for (i = 0; i < TOTAL_QUADS; i++) {
+            ringColor(&frame.mbi6023[(i * 3) + 3], &ringOut[(i * 3) + 1]);
+        }
+        frame.index = 3 + (TOTAL_QUADS * 3);
+    } else {
+        frame.mbi6023[0] = 0xFC00;
+        frame.mbi6023[1] = 0xFC02;
+        frame.mbi6023[2] = 0x9002;
+        num = TOTAL_LEDS;
+        for (i = 0; i < num; i++) {
+            ringColor(&frame.mbi6023[(i * 3) + 3], &ringOut[i]);
+        }
+        frame.index = ARRAY_SIZE(frame.mbi6023);
+    }
+    return ioctl(ringFd, IOCTL_GPIO_SPI_SET, &frame);
+}
+
+// The ring has no blink support of its own
+#define BACKEND_BLINKS  0
+#else
+#define LED_SYSFS_DIR       "/sys/class/leds"
+#define BRIGHTNESS_ON_FULL  255
+
+static const char *sysfsNames[] = { "green", "yellow", "red" };
+static char sysfsDir[128] = LED_SYSFS_DIR;
+static LedOut sysfsOut[ARRAY_SIZE(sysfsNames)];
+
+static int sysfsWrite(int output, const char *attr, const char *value)
+{
+    char file[192];
+    int fd, len, res;
+
+    snprintf(file, sizeof(file), "%s/%s/%s", sysfsDir, sysfsNames[output],
+             attr);
+    fd = open(file, O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    len = strlen(value);
+    res = write(fd, value, len);
+    close(fd);
+    return (res == len) ? 0 : -1;
+}
+
+static int sysfsWriteInt(int output, const char *attr, int value)
+{
+    char buf[16];
+
+    snprintf(buf, sizeof(buf), "%d\n", value);
+    return sysfsWrite(output, attr, buf);
+}
+
+static int backendInit(const char *dir)
+{
+    if (dir != NULL) {
+        snprintf(sysfsDir, sizeof(sysfsDir), "%s", dir);
+    }
+    return ARRAY_SIZE(sysfsNames);
+}
+
+static int backendSet(int output, const LedOut *out)
+{
+    LedOut *cur = &sysfsOut[output];
+    int res = 0;
+
+    if (out->on) {
+        // Kernel timer trigger does the blinking
+        res |= sysfsWriteInt(output, "brightness",
+                             out->level * BRIGHTNESS_ON_FULL / 100);
+        res |= sysfsWrite(output, "trigger", "timer\n");
+        res |= sysfsWriteInt(output, "delay_on", out->on);
+        res |= sysfsWriteInt(output, "delay_off", out->off);
+    } else {
+        if (cur->on) {
+            res |= sysfsWrite(output, "trigger", "none\n");
+        }
+        res |= sysfsWriteInt(output, "brightness",
+                             out->level * BRIGHTNESS_ON_FULL / 100);
+    }
+    *cur = *out;
+    return res;
+}
+
+static int backendFlush(void)
+{
+    return 0;
+}
+
+#define BACKEND_BLINKS  1
+#endif
+
+/*
+ * Engine
+ */
+
+typedef struct {
+    const LedMode *mode;
+    char      text[LED_MODE_LEN];   // as requested
+    int       duration;
+    long long end;                  // ms, 0 = until replaced
+    int       step[LED_MAX_TRACKS];
+    long long due[LED_MAX_TRACKS];  // ms, 0 = nothing to do
+    int       blink[LED_MAX_TRACKS];
+    int       running;              // tracks with steps to go
+} LedLayer;
+
+static LedLayer layers[LED_NUM_PRI];
+static LedLayer *shown = NULL;
+static int restart = 0;
+static LedOut outs[LED_MAX_OUTPUTS];
+static int numOutputs = 0;
+static int timerFd = -1;
+static int sockFd = -1;
+static int watchFd = -1;
+static char modeFile[128];
+static char modeWritten[LED_MODE_LEN];
+static void (*endedCallback)(const char *mode) = NULL;
+
+static long long ledNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static const LedMode *ledFindMode(const char *name)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(modes); i++) {
+        if (strcmp(modes[i].name, name) == 0) {
+            return &modes[i];
+        }
+    }
+    return NULL;
+}
+
+#ifdef imxdimagic
+static int ledLocked(const LedMode *mode)
+{
+    int i, j;
+
+    if (shown == NULL) {
+        return 0;
+    }
+    for (i = 0; i < ARRAY_SIZE(finalModes); i++) {
+        if (strcmp(shown->mode->name, finalModes[i].mode) != 0) {
+            continue;
+        }
+        for (j = 0; j < ARRAY_SIZE(finalModes[i].next); j++) {
+            if ((finalModes[i].next[j] != NULL) &&
+                (strcmp(mode->name, finalModes[i].next[j]) == 0)) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
+#else
+static int ledLocked(const LedMode *mode)
+{
+    return 0;
+}
+#endif
+
+static int ledHold(const LedLayer *l, const LedAnim *anim, int step)
+{
+    int hold = anim->steps[step].hold;
+
+    if (hold == LED_HOLD_SPREAD) {
+        hold = l->duration ? l->duration / anim->numSteps : TICK_HOLD;
+    }
+    return hold;
+}
+
+// A two step blink of a single LED can be left to the hardware
+static int ledCanBlink(const LedTrack *t)
+{
+    const LedAnim *a = t->anim;
+
+    return BACKEND_BLINKS && ((t->outputs & (t->outputs - 1)) == 0) &&
+           (a->numSteps == 2) && (a->loop == 0) &&
+           (a->steps[0].hold > 0) && (a->steps[1].hold > 0) &&
+           (a->steps[1].level[0] == 0);
+}
+
+static void ledStartLayer(LedLayer *l, long long now)
+{
+    int k, hold;
+
+    l->running = 0;
+    for (k = 0; k < l->mode->numTracks; k++) {
+        const LedTrack *t = &l->mode->tracks[k];
+
+        l->step[k] = 0;
+        l->due[k] = 0;
+        l->blink[k] = 0;
+        if (t->anim == NULL) {
+            continue;
+        }
+        l->running++;
+        if (ledCanBlink(t)) {
+            l->blink[k] = 1;
+            continue;
+        }
+        hold = ledHold(l, t->anim, 0);
+        if (hold) {
+            l->due[k] = now + hold;
+        }
+    }
+}
+
+// Move a track on, returns 1 when its animation has finished
+static int ledAdvance(LedLayer *l, int k)
+{
+    const LedAnim *anim = l->mode->tracks[k].anim;
+    long long due = l->due[k];
+    int hold;
+
+    if (++l->step[k] >= anim->numSteps) {
+        if (anim->loop < 0) {
+            l->step[k] = anim->numSteps - 1;
+            l->due[k] = 0;
+            return 1;
+        }
+        l->step[k] = anim->loop;
+    }
+
+    // Keep the cadence from the previous deadline, not from now
+    hold = ledHold(l, anim, l->step[k]);
+    l->due[k] = hold ? due + hold : 0;
+    return 0;
+}
+
+static void ledEndLayer(LedLayer *l)
+{
+    char name[LED_MODE_LEN];
+
+    snprintf(name, sizeof(name), "%s", l->mode->name);
+    memset(l, 0, sizeof(*l));
+    if (endedCallback) {
+        endedCallback(name);
+    }
+}
+
+static LedLayer *ledTop(void)
+{
+    int p;
+
+    for (p = LED_NUM_PRI - 1; p >= 0; p--) {
+        if (layers[p].mode) {
+            return &layers[p];
+        }
+    }
+    return NULL;
+}
+
+// Work out every LED from the layer shown, write only what changed
+static void ledRender(void)
+{
+    LedOut want[LED_MAX_OUTPUTS];
+    int changed = 0;
+    int o, k, j;
+
+    memset(want, 0, sizeof(want));
+    for (k = 0; shown && (k < shown->mode->numTracks); k++) {
+        const LedTrack *t = &shown->mode->tracks[k];
+        const LedStep *s;
+
+        if (t->anim == NULL) {
+            continue;
+        }
+        s = &t->anim->steps[shown->step[k]];
+        for (o = 0, j = 0; o < numOutputs; o++) {
+            if (!(t->outputs & (1 << o))) {
+                continue;
+            }
+            want[o].level = s->level[j++];
+            want[o].color = t->color;
+            if (shown->blink[k]) {
+                want[o].on = t->anim->steps[0].hold;
+                want[o].off = t->anim->steps[1].hold;
+            }
+        }
+    }
+
+    for (o = 0; o < numOutputs; o++) {
+        if (memcmp(&want[o], &outs[o], sizeof(LedOut)) != 0) {
+            backendSet(o, &want[o]);
+            outs[o] = want[o];
+            changed = 1;
+        }
+    }
+    if (changed) {
+        backendFlush();
+    }
+}
+
+static void ledArm(void)
+{
+    struct itimerspec its;
+    long long next = 0;
+    int p, k;
+
+    for (p = 0; p < LED_NUM_PRI; p++) {
+        if (layers[p].mode && layers[p].end &&
+            (!next || (layers[p].end < next))) {
+            next = layers[p].end;
+        }
+    }
+    for (k = 0; shown && (k < shown->mode->numTracks); k++) {
+        if (shown->due[k] && (!next || (shown->due[k] < next))) {
+            next = shown->due[k];
+        }
+    }
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = next / 1000;
+    its.it_value.tv_nsec = (next % 1000) * 1000000;
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+// Record the mode in the mode file for anyone reading it
+static void ledNote(const char *text)
+{
+    FILE *f;
+
+    if (!modeFile[0] || (strcmp(text, modeWritten) == 0)) {
+        return;
+    }
+    snprintf(modeWritten, sizeof(modeWritten), "%s", text);
+
+    // Don't add a new line to the data in this file!
+    f = fopen(modeFile, "w");
+    if (f != NULL) {
+        fputs(text, f);
+        fclose(f);
+    }
+}
+
+// Handle everything that is due, then sleep until the next thing is
+static void ledRun(void)
+{
+    long long now = ledNow();
+    int ended = 0;
+    LedLayer *top;
+    int p, k;
+
+    for (;;) {
+        // Timed modes that are over
+        for (p = 0; p < LED_NUM_PRI; p++) {
+            if (layers[p].mode && layers[p].end && (layers[p].end <= now)) {
+                ledEndLayer(&layers[p]);
+                ended = 1;
+            }
+        }
+
+        top = ledTop();
+        if ((top != shown) || restart) {
+            shown = top;
+            restart = 0;
+            if (shown) {
+                ledStartLayer(shown, now);
+            }
+        }
+        if (shown == NULL) {
+            break;
+        }
+
+        // Steps that are due, catching up if we were held up
+        for (k = 0; k < shown->mode->numTracks; k++) {
+            while (shown->due[k] && (shown->due[k] <= now)) {
+                if (ledAdvance(shown, k)) {
+                    shown->running--;
+                }
+            }
+        }
+
+        // One shot animations end the mode when they are done
+        if (shown->running == 0) {
+            for (k = 0; k < shown->mode->numTracks; k++) {
+                if (shown->mode->tracks[k].anim) {
+                    break;
+                }
+            }
+            if (k < shown->mode->numTracks) {
+                ledEndLayer(shown);
+                ended = 1;
+                continue;
+            }
+        }
+        break;
+    }
+
+    ledRender();
+    ledArm();
+    if (ended) {
+        ledNote(ledGetMode());
+    }
+}
+
+int ledInit(const char *sysfsDir)
+{
+    int o;
+
+    numOutputs = backendInit(sysfsDir);
+    if (numOutputs < 0) {
+        return -1;
+    }
+
+    // Force the first write of every LED
+    for (o = 0; o < LED_MAX_OUTPUTS; o++) {
+        outs[o].level = -1;
+    }
+
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd < 0) {
+        syslog(LOG_ERR, "Unable to create timerfd: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int ledServe(const char *socketFile, const char *file)
+{
+    struct sockaddr_un addr;
+
+    if (socketFile != NULL) {
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socketFile);
+        unlink(socketFile);
+
+        sockFd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if ((sockFd < 0) ||
+            (bind(sockFd, (struct sockaddr *)&addr, sizeof(addr)) < 0)) {
+            syslog(LOG_ERR, "Unable to create LED socket: %s",
+                   strerror(errno));
+            return -1;
+        }
+
+        // The agent doesn't run as root
+        chmod(socketFile, 0666);
+    }
+
+    if (file != NULL) {
+        snprintf(modeFile, sizeof(modeFile), "%s", file);
+        watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if ((watchFd < 0) ||
+            (inotify_add_watch(watchFd, file, IN_CLOSE_WRITE) < 0)) {
+            syslog(LOG_WARNING, "Unable to watch %s: %s", file,
+                   strerror(errno));
+        }
+    }
+    return 0;
+}
+
+void ledSetCallback(void (*ended)(const char *mode))
+{
+    endedCallback = ended;
+}
+
+int ledSetMode(const char *text)
+{
+    char name[LED_MODE_LEN];
+    const LedMode *mode;
+    LedLayer *l;
+    int secs = 0;
+
+    if (sscanf(text, "%63s %d", name, &secs) < 1) {
+        return -1;
+    }
+    mode = ledFindMode(name);
+    if (mode == NULL) {
+        syslog(LOG_WARNING, "Unknown LED mode: %s", name);
+        return -1;
+    }
+
+    // Some modes leave the LEDs as they are, some are never left
+    if ((mode->numTracks == 0) || ledLocked(mode)) {
+        return 0;
+    }
+
+    l = &layers[mode->priority];
+    memset(l, 0, sizeof(*l));
+    l->mode = mode;
+    snprintf(l->text, sizeof(l->text), "%s", text);
+    l->duration = (secs > 0) ? secs * 1000 : mode->duration;
+    if (l->duration) {
+        l->end = ledNow() + l->duration;
+    }
+
+    // Start over if it shows now, else it waits under what is shown
+    if ((shown == NULL) || (l >= shown)) {
+        restart = 1;
+    }
+    ledRun();
+    return 0;
+}
+
+const char *ledGetMode(void)
+{
+    return shown ? shown->text : "all-off";
+}
+
+// Pick up a mode written to the mode file the old way
+static void ledReadModeFile(void)
+{
+    char buf[sizeof(struct inotify_event) + 256];
+    char data[LED_MODE_LEN];
+    size_t len;
+    FILE *f;
+
+    while (read(watchFd, buf, sizeof(buf)) > 0) {
+    }
+
+    f = fopen(modeFile, "r");
+    if (f == NULL) {
+        return;
+    }
+    memset(data, 0, sizeof(data));
+    len = fread(data, 1, sizeof(data) - 1, f);
+    fclose(f);
+
+    // Removing trailing \n
+    while ((len > 0) && ((data[len - 1] == '\n') || (data[len - 1] == ' '))) {
+        data[--len] = '\0';
+    }
+
+    // Ignore our own writes
+    if ((len == 0) || (strcmp(data, modeWritten) == 0)) {
+        return;
+    }
+    snprintf(modeWritten, sizeof(modeWritten), "%s", data);
+    ledSetMode(data);
+}
+
+int ledPoll(int timeout)
+{
+    struct pollfd fds[3];
+    char buf[LED_MODE_LEN];
+    uint64_t ticks;
+    int nfds = 0, sockIdx = -1, watchIdx = -1;
+    int res, len;
+
+    fds[nfds].fd = timerFd;
+    fds[nfds++].events = POLLIN;
+    if (sockFd >= 0) {
+        sockIdx = nfds;
+        fds[nfds].fd = sockFd;
+        fds[nfds++].events = POLLIN;
+    }
+    if (watchFd >= 0) {
+        watchIdx = nfds;
+        fds[nfds].fd = watchFd;
+        fds[nfds++].events = POLLIN;
+    }
+
+    res = poll(fds, nfds, timeout);
+    if (res < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    if (fds[0].revents) {
+        read(timerFd, &ticks, sizeof(ticks));
+    }
+
+    // Requests are applied in order, an overlay may be followed by the
+    //  mode to go back to
+    if ((sockIdx >= 0) && fds[sockIdx].revents) {
+        while ((len = recv(sockFd, buf, sizeof(buf) - 1, 0)) > 0) {
+            buf[len] = '\0';
+            if (buf[len - 1] == '\n') {
+                buf[len - 1] = '\0';
+            }
+            if (ledSetMode(buf) == 0) {
+                ledNote(buf);
+            }
+        }
+    }
+
+    // Animation ticks are the common wakeup - only read the mode file
+    //  when inotify says it changed
+    if ((watchIdx >= 0) && fds[watchIdx].revents) {
+        ledReadModeFile();
+    }
+
+    ledRun();
+    return 0;
+}
+
+int ledSendMode(const char *mode)
+{
+    struct sockaddr_un addr;
+    int fd, res;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", LED_SOCKET_FILE);
+
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    res = sendto(fd, mode, strlen(mode), MSG_DONTWAIT,
+                 (struct sockaddr *)&addr, sizeof(addr));
+    close(fd);
+    return (res < 0) ? -1 : 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LEDENGINE_H
+#define _LEDENGINE_H
+
+/*
+ * LED engine - runs the LED modes in-process, from tables.
+ *
+ * A mode is a set of tracks, each stepping an animation over some of the
+ * LEDs.  All tracks share one timerfd, armed for whichever step is due
+ * first, so nothing sleeps and nothing is forked.  Simple blinks on sysfs
+ * LEDs are handed to the kernel timer trigger and cost no wakeups at all.
+ *
+ * Modes sit in layers by priority.  The highest layer in use is shown;
+ * when a timed mode ends the layer below it shows again, so error and
+ * button modes no longer lose the mode they interrupted.
+ *
+ * Other processes change the mode through a datagram socket, see
+ * ledSendMode().  Writes to LED_MODE_FILE are still picked up.
+ */
+
+#define LED_MAX_OUTPUTS     12
+#define LED_MAX_TRACKS      3
+#define LED_MODE_LEN        64
+
+// Mode priorities, lowest first
+enum LedPriority {LED_PRI_NORMAL = 0, LED_PRI_EVENT, LED_PRI_ERROR,
+                  LED_NUM_PRI};
+
+// One animation step - brightness percentage for each LED of the track
+typedef struct {
+    int           hold;         // ms before the next step, 0 = forever
+    unsigned char level[LED_MAX_OUTPUTS];
+} LedStep;
+
+// Hold value that spreads the mode duration evenly over the steps
+#define LED_HOLD_SPREAD     -1
+
+typedef struct {
+    const LedStep *steps;
+    int            numSteps;
+    int            loop;        // step to continue from after the last, or -1
+} LedAnim;
+
+typedef struct {
+    unsigned       outputs;     // bit mask of LEDs, in step level order
+    int            color;       // 0xRRGGBB, each channel a percentage
+    const LedAnim *anim;
+} LedTrack;
+
+typedef struct {
+    const char *name;
+    int         priority;
+    int         duration;       // ms before the mode ends, 0 = until replaced
+    int         numTracks;      // 0 = leave the LEDs as they are
+    LedTrack    tracks[LED_MAX_TRACKS];
+} LedMode;
+
+/* Setup - sysfsDir overrides where the sysfs LEDs live, NULL for default */
+int ledInit(const char *sysfsDir);
+
+/* Listen for modes on a datagram socket, and for writes to a mode file */
+int ledServe(const char *socketFile, const char *modeFile);
+
+/* Called with the mode name whenever a timed mode ends */
+void ledSetCallback(void (*ended)(const char *mode));
+
+/* Set a mode - "name" or "name seconds" to override its duration */
+int ledSetMode(const char *mode);
+
+/* The mode being shown, "all-off" if none */
+const char *ledGetMode(void);
+
+/* Wait up to timeout ms (-1 forever) for, and handle, steps and requests */
+int ledPoll(int timeout);
+
+/* Client side - ask the engine to set a mode, -1 if it is not running */
+int ledSendMode(const char *mode);
+
+#endif /* _LEDENGINE_H */
@@ -0,0 +1,664 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include "netmon.h"
+
+// Not in the C library's net/if.h
+#ifndef IFF_LOWER_UP
+#define IFF_LOWER_UP        0x10000
+#endif
+#ifndef RTNH_F_LINKDOWN
+#define RTNH_F_LINKDOWN     16
+#endif
+
+#define NETMON_FLAGS        (IFF_UP | IFF_RUNNING | IFF_LOWER_UP)
+#define NETMON_ROUTABLE     (IFF_UP | IFF_RUNNING)
+#define NETMON_MAX_SUBS     4
+#define NETMON_BUF_SIZE     16384
+#define NETMON_RCVBUF       (128 * 1024)
+#define NETMON_DUMP_TIMEOUT 1000
+
+typedef struct {
+    int       index;            // 0 once deleted
+    char      name[IF_NAMESIZE];
+    unsigned  flags;
+    in_addr_t addrs[NETMON_MAX_ADDRS];
+    int       addrStale[NETMON_MAX_ADDRS];
+    int       numAddrs;
+    int       changes;
+    int       stale;
+} NetmonLink;
+
+typedef struct {
+    NetmonHandler handler;
+    void          *arg;
+} NetmonSub;
+
+static pthread_mutex_t netmonMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t netmonCond;
+static unsigned netmonGeneration = 0;
+static int nlFd = -1;
+static unsigned nlSeq = 0;
+
+static NetmonLink links[NETMON_MAX_LINKS];
+static int numLinks = 0;
+static NetmonRoute routes[NETMON_MAX_ROUTES];
+static int routeStale[NETMON_MAX_ROUTES];
+static int numRoutes = 0;
+static int orphanChanges = 0;   // routes on links we don't know
+static int routeResync = 0;     // routes may have changed without events
+
+static NetmonSub subs[NETMON_MAX_SUBS];
+static int numSubs = 0;
+
+static NetmonLink *netmonFindIndex(int index)
+{
+    int i;
+
+    if (index == 0) {
+        return NULL;
+    }
+    for (i = 0; i < numLinks; i++) {
+        if (links[i].index == index) {
+            return &links[i];
+        }
+    }
+    return NULL;
+}
+
+static NetmonLink *netmonFindName(const char *name)
+{
+    int i;
+
+    for (i = 0; i < numLinks; i++) {
+        if (links[i].index && (strcmp(links[i].name, name) == 0)) {
+            return &links[i];
+        }
+    }
+    return NULL;
+}
+
+static void netmonRouteChanged(int index)
+{
+    NetmonLink *l = netmonFindIndex(index);
+
+    if (l) {
+        l->changes |= NETMON_ROUTE;
+    } else {
+        orphanChanges |= NETMON_ROUTE;
+    }
+}
+
+static void netmonRouteRemove(int i)
+{
+    netmonRouteChanged(routes[i].index);
+    numRoutes--;
+    routes[i] = routes[numRoutes];
+    routeStale[i] = routeStale[numRoutes];
+}
+
+/* The kernel flushes routes on link down without RTM_DELROUTE */
+static void netmonRouteFlush(int index)
+{
+    int i;
+
+    for (i = 0; i < numRoutes; i++) {
+        if (routes[i].index == index) {
+            netmonRouteRemove(i);
+            i--;
+        }
+    }
+}
+
+static void netmonLink(struct nlmsghdr *nh)
+{
+    struct ifinfomsg *ifi = NLMSG_DATA(nh);
+    struct rtattr    *rta = IFLA_RTA(ifi);
+    int              len = IFLA_PAYLOAD(nh);
+    const char       *name = NULL;
+    NetmonLink       *l = netmonFindIndex(ifi->ifi_index);
+    unsigned         flags;
+
+    for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_IFNAME) {
+            name = RTA_DATA(rta);
+        }
+    }
+
+    if (nh->nlmsg_type == RTM_DELLINK) {
+        if (l) {
+            l->changes |= NETMON_LINK | (l->numAddrs ? NETMON_ADDR : 0);
+            netmonRouteFlush(l->index);
+            l->index = 0;
+        }
+        return;
+    }
+
+    if (l == NULL) {
+        if ((name == NULL) || (numLinks == NETMON_MAX_LINKS)) {
+            return;
+        }
+        l = &links[numLinks++];
+        memset(l, 0, sizeof(*l));
+        l->index = ifi->ifi_index;
+    }
+    if (name) {
+        snprintf(l->name, sizeof(l->name), "%s", name);
+    }
+    l->stale = 0;
+
+    // Only up/down and carrier matter - wireless events are noise
+    flags = ifi->ifi_flags & NETMON_FLAGS;
+    if (flags != l->flags) {
+        // Routes through a link that can't carry traffic are dead, and
+        // those the kernel kept come back with it
+        if ((flags & NETMON_ROUTABLE) != NETMON_ROUTABLE) {
+            netmonRouteFlush(l->index);
+        } else if ((l->flags & NETMON_ROUTABLE) != NETMON_ROUTABLE) {
+            routeResync = 1;
+        }
+        l->flags = flags;
+        l->changes |= NETMON_LINK;
+    }
+}
+
+static void netmonAddr(struct nlmsghdr *nh)
+{
+    struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+    struct rtattr    *rta = IFA_RTA(ifa);
+    int              len = IFA_PAYLOAD(nh);
+    in_addr_t        addr = 0, local = 0;
+    NetmonLink       *l;
+    int              i;
+
+    if (ifa->ifa_family != AF_INET) {
+        return;
+    }
+    l = netmonFindIndex(ifa->ifa_index);
+    if (l == NULL) {
+        return;
+    }
+
+    for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFA_LOCAL) {
+            memcpy(&local, RTA_DATA(rta), sizeof(local));
+        } else if (rta->rta_type == IFA_ADDRESS) {
+            memcpy(&addr, RTA_DATA(rta), sizeof(addr));
+        }
+    }
+    if (local) {
+        addr = local;
+    }
+
+    for (i = 0; i < l->numAddrs; i++) {
+        if (l->addrs[i] == addr) {
+            break;
+        }
+    }
+
+    if (nh->nlmsg_type == RTM_DELADDR) {
+        if (i < l->numAddrs) {
+            l->numAddrs--;
+            l->addrs[i] = l->addrs[l->numAddrs];
+            l->addrStale[i] = l->addrStale[l->numAddrs];
+            l->changes |= NETMON_ADDR;
+
+            // Routes using the address are flushed without events
+            routeResync = 1;
+        }
+    } else if (i < l->numAddrs) {
+        l->addrStale[i] = 0;
+    } else if (l->numAddrs < NETMON_MAX_ADDRS) {
+        l->addrs[l->numAddrs] = addr;
+        l->addrStale[l->numAddrs] = 0;
+        l->numAddrs++;
+        l->changes |= NETMON_ADDR;
+    }
+}
+
+static void netmonRoute(struct nlmsghdr *nh)
+{
+    struct rtmsg  *rtm = NLMSG_DATA(nh);
+    struct rtattr *rta = RTM_RTA(rtm);
+    int           len = RTM_PAYLOAD(nh);
+    int           table = rtm->rtm_table;
+    NetmonRoute   r;
+    NetmonLink    *l;
+    int           del = (nh->nlmsg_type == RTM_DELROUTE);
+    int           i;
+
+    // Default routes in the main table only
+    if ((rtm->rtm_family != AF_INET) || (rtm->rtm_dst_len != 0) ||
+        (rtm->rtm_type != RTN_UNICAST)) {
+        return;
+    }
+
+    memset(&r, 0, sizeof(r));
+    for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        switch (rta->rta_type) {
+        case RTA_TABLE:
+            table = *(unsigned *)RTA_DATA(rta);
+            break;
+        case RTA_GATEWAY:
+            memcpy(&r.gateway, RTA_DATA(rta), sizeof(r.gateway));
+            break;
+        case RTA_OIF:
+            r.index = *(int *)RTA_DATA(rta);
+            break;
+        case RTA_PRIORITY:
+            r.metric = *(int *)RTA_DATA(rta);
+            break;
+        }
+    }
+    if (table != RT_TABLE_MAIN) {
+        return;
+    }
+
+    // Kept by the kernel, but not usable until the link is back
+    l = netmonFindIndex(r.index);
+    if ((rtm->rtm_flags & RTNH_F_LINKDOWN) ||
+        (l && ((l->flags & NETMON_ROUTABLE) != NETMON_ROUTABLE))) {
+        del = 1;
+    }
+
+    for (i = 0; i < numRoutes; i++) {
+        if ((routes[i].gateway == r.gateway) && (routes[i].index == r.index) &&
+            (routes[i].metric == r.metric)) {
+            break;
+        }
+    }
+
+    if (del) {
+        if (i < numRoutes) {
+            netmonRouteRemove(i);
+        }
+    } else if (i < numRoutes) {
+        routeStale[i] = 0;
+    } else if (numRoutes < NETMON_MAX_ROUTES) {
+        routes[numRoutes] = r;
+        routeStale[numRoutes] = 0;
+        numRoutes++;
+        netmonRouteChanged(r.index);
+    }
+}
+
+/* Read and apply what is queued - until the dump with seq is done, if set */
+static int netmonRead(unsigned seq)
+{
+    static char buf[NETMON_BUF_SIZE];
+    int dumping = (seq != 0);
+    int len, overflow = 0;
+
+    while (1) {
+        struct nlmsghdr *nh;
+
+        len = recv(nlFd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            if (errno == ENOBUFS) {
+                // Lost events - state has to be read again
+                overflow = 1;
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN) && seq) {
+                struct pollfd pfd = { nlFd, POLLIN, 0 };
+
+                if (poll(&pfd, 1, NETMON_DUMP_TIMEOUT) > 0) {
+                    continue;
+                }
+                return -1;
+            }
+            break;
+        }
+
+        for (nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, len);
+             nh = NLMSG_NEXT(nh, len)) {
+            switch (nh->nlmsg_type) {
+            case NLMSG_DONE:
+            case NLMSG_ERROR:
+                if (seq && (nh->nlmsg_seq == seq)) {
+                    seq = 0;
+                }
+                break;
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+                netmonLink(nh);
+                break;
+            case RTM_NEWADDR:
+            case RTM_DELADDR:
+                netmonAddr(nh);
+                break;
+            case RTM_NEWROUTE:
+            case RTM_DELROUTE:
+                netmonRoute(nh);
+                break;
+            }
+        }
+
+        // Dump is done - events queued after it are read by the caller
+        if (dumping && !seq) {
+            break;
+        }
+    }
+    return overflow;
+}
+
+static int netmonDump(int type)
+{
+    struct {
+        struct nlmsghdr nh;
+        struct rtgenmsg g;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.g));
+    req.nh.nlmsg_type = type;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq = ++nlSeq;
+    req.g.rtgen_family = (type == RTM_GETLINK) ? AF_UNSPEC : AF_INET;
+
+    if (send(nlFd, &req, req.nh.nlmsg_len, 0) < 0) {
+        return -1;
+    }
+    return netmonRead(nlSeq);
+}
+
+/* Read the default routes again, dropping whatever has gone */
+static int netmonSyncRoutes(void)
+{
+    int i;
+
+    routeResync = 0;
+    for (i = 0; i < numRoutes; i++) {
+        routeStale[i] = 1;
+    }
+
+    if (netmonDump(RTM_GETROUTE) < 0) {
+        syslog(LOG_ERR, "Unable to read routes");
+        return -1;
+    }
+
+    for (i = 0; i < numRoutes; i++) {
+        if (routeStale[i]) {
+            netmonRouteRemove(i);
+            i--;
+        }
+    }
+    return 0;
+}
+
+/* Read the whole state, dropping whatever has gone */
+static int netmonSync(void)
+{
+    int i, j;
+
+    for (i = 0; i < numLinks; i++) {
+        links[i].stale = 1;
+        for (j = 0; j < links[i].numAddrs; j++) {
+            links[i].addrStale[j] = 1;
+        }
+    }
+
+    if ((netmonDump(RTM_GETLINK) < 0) || (netmonDump(RTM_GETADDR) < 0)) {
+        syslog(LOG_ERR, "Unable to read network state");
+        return -1;
+    }
+
+    for (i = 0; i < numLinks; i++) {
+        NetmonLink *l = &links[i];
+
+        if (l->stale) {
+            l->changes |= NETMON_LINK | (l->numAddrs ? NETMON_ADDR : 0);
+            l->index = 0;
+            continue;
+        }
+        for (j = 0; j < l->numAddrs; j++) {
+            if (l->addrStale[j]) {
+                l->numAddrs--;
+                l->addrs[j] = l->addrs[l->numAddrs];
+                l->addrStale[j] = l->addrStale[l->numAddrs];
+                l->changes |= NETMON_ADDR;
+                j--;
+            }
+        }
+    }
+    return netmonSyncRoutes();
+}
+
+int netmonInit(void)
+{
+    struct sockaddr_nl sa;
+    pthread_condattr_t attr;
+    int size = NETMON_RCVBUF;
+    int i;
+
+    if (nlFd >= 0) {
+        return 0;
+    }
+
+    nlFd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  NETLINK_ROUTE);
+    if (nlFd < 0) {
+        syslog(LOG_ERR, "Unable to open netlink socket: %s", strerror(errno));
+        return -1;
+    }
+    setsockopt(nlFd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV4_ROUTE;
+    if (bind(nlFd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        syslog(LOG_ERR, "Unable to bind netlink socket: %s", strerror(errno));
+        close(nlFd);
+        nlFd = -1;
+        return -1;
+    }
+
+    // Waits are timed against the monotonic clock
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&netmonCond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    // Events that come in during the dumps are read in order with them
+    pthread_mutex_lock(&netmonMutex);
+    if (netmonSync() < 0) {
+        pthread_mutex_unlock(&netmonMutex);
+        close(nlFd);
+        nlFd = -1;
+        return -1;
+    }
+
+    // The state we start with is not a change
+    for (i = 0; i < numLinks; i++) {
+        links[i].changes = 0;
+    }
+    orphanChanges = 0;
+    pthread_mutex_unlock(&netmonMutex);
+    return 0;
+}
+
+int netmonFd(void)
+{
+    return nlFd;
+}
+
+int netmonProcess(void)
+{
+    struct {
+        char name[IF_NAMESIZE];
+        int  changes;
+    } changed[NETMON_MAX_LINKS + 1];
+    int numChanged = 0;
+    int i, j;
+
+    if (nlFd < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&netmonMutex);
+    if (netmonRead(0) > 0) {
+        netmonSync();
+    } else if (routeResync) {
+        netmonSyncRoutes();
+    }
+
+    // Note what changed, and drop deleted links
+    for (i = 0, j = 0; i < numLinks; i++) {
+        if (links[i].changes) {
+            snprintf(changed[numChanged].name, IF_NAMESIZE, "%s",
+                     links[i].name);
+            changed[numChanged++].changes = links[i].changes;
+            links[i].changes = 0;
+        }
+        if (links[i].index) {
+            links[j++] = links[i];
+        }
+    }
+    numLinks = j;
+    if (orphanChanges) {
+        changed[numChanged].name[0] = '\0';
+        changed[numChanged++].changes = orphanChanges;
+        orphanChanges = 0;
+    }
+    if (numChanged) {
+        netmonGeneration++;
+        pthread_cond_broadcast(&netmonCond);
+    }
+    pthread_mutex_unlock(&netmonMutex);
+
+    // Subscribers may look things up, so call them unlocked
+    for (i = 0; i < numChanged; i++) {
+        for (j = 0; j < numSubs; j++) {
+            subs[j].handler(changed[i].name, changed[i].changes, subs[j].arg);
+        }
+    }
+    return numChanged;
+}
+
+int netmonSubscribe(NetmonHandler handler, void *arg)
+{
+    if (numSubs == NETMON_MAX_SUBS) {
+        return -1;
+    }
+    subs[numSubs].handler = handler;
+    subs[numSubs].arg = arg;
+    numSubs++;
+    return 0;
+}
+
+int netmonWait(int timeout)
+{
+    struct timespec ts;
+    unsigned gen;
+    int res = 0;
+
+    // Not running - nothing will wake us
+    if (nlFd < 0) {
+        usleep(timeout * 1000);
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += timeout / 1000;
+    ts.tv_nsec += (timeout % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&netmonMutex);
+    gen = netmonGeneration;
+    while ((gen == netmonGeneration) &&
+           (pthread_cond_timedwait(&netmonCond, &netmonMutex, &ts) == 0)) {
+    }
+    res = (gen != netmonGeneration);
+    pthread_mutex_unlock(&netmonMutex);
+    return res;
+}
+
+static int netmonFlag(const char *intf, unsigned flag)
+{
+    NetmonLink *l;
+    int res;
+
+    if (nlFd < 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&netmonMutex);
+    l = netmonFindName(intf);
+    res = (l != NULL) && (l->flags & flag);
+    pthread_mutex_unlock(&netmonMutex);
+    return res;
+}
+
+int netmonIsUp(const char *intf)
+{
+    return netmonFlag(intf, IFF_UP);
+}
+
+int netmonIsConnected(const char *intf)
+{
+    return netmonFlag(intf, IFF_LOWER_UP);
+}
+
+int netmonHasAddress(const char *intf)
+{
+    NetmonLink *l;
+    int res;
+
+    if (nlFd < 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&netmonMutex);
+    l = netmonFindName(intf);
+    res = (l != NULL) && (l->numAddrs > 0);
+    pthread_mutex_unlock(&netmonMutex);
+    return res;
+}
+
+int netmonGetDefaultRoutes(NetmonRoute *r, int max)
+{
+    NetmonLink *l;
+    int i, res;
+
+    if (nlFd < 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&netmonMutex);
+    for (i = 0; (i < numRoutes) && (i < max); i++) {
+        r[i] = routes[i];
+        l = netmonFindIndex(routes[i].index);
+        snprintf(r[i].intf, sizeof(r[i].intf), "%s", l ? l->name : "");
+    }
+    res = numRoutes;
+    pthread_mutex_unlock(&netmonMutex);
+    return res;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _NETMON_H
+#define _NETMON_H
+
+#include <net/if.h>
+#include <netinet/in.h>
+
+/*
+ * Network monitor - keeps the state of links, IPv4 addresses and default
+ * routes as reported by RTNETLINK, so connectivity checks are lookups
+ * rather than shell commands run on a timer.
+ *
+ * Changes are read in batches: everything queued on the socket is applied
+ * before subscribers are called, once per link that changed.  Lookups and
+ * netmonWait() may be used from any thread; netmonProcess() should be
+ * called from one place, whenever netmonFd() is readable.
+ */
+
+#define NETMON_MAX_LINKS    16
+#define NETMON_MAX_ADDRS    4
+#define NETMON_MAX_ROUTES   8
+
+// Changes passed to subscribers
+#define NETMON_LINK         0x01    // up/down or carrier
+#define NETMON_ADDR         0x02    // IPv4 address added or removed
+#define NETMON_ROUTE        0x04    // default route added or removed
+
+typedef struct {
+    in_addr_t gateway;
+    int       index;
+    int       metric;
+    char      intf[IF_NAMESIZE];
+} NetmonRoute;
+
+/* Called with the link name and what changed */
+typedef void (*NetmonHandler)(const char *intf, int changes, void *arg);
+
+/* Setup - reads the current state before returning */
+int netmonInit(void);
+int netmonFd(void);
+
+/* Apply queued changes and call subscribers */
+int netmonProcess(void);
+int netmonSubscribe(NetmonHandler handler, void *arg);
+
+/* Wait up to timeout ms for the next change, 1 if there was one */
+int netmonWait(int timeout);
+
+/* Lookups - -1 if the monitor is not running */
+int netmonIsUp(const char *intf);
+int netmonIsConnected(const char *intf);
+int netmonHasAddress(const char *intf);
+int netmonGetDefaultRoutes(NetmonRoute *routes, int max);
+
+#endif /* _NETMON_H */
@@ -0,0 +1,454 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <dirent.h>
+#include <poll.h>
+#include <syslog.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include "supervisor.h"
+
+// Not in older C libraries - same number on all architectures
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+#ifndef PR_SET_CHILD_SUBREAPER
+#define PR_SET_CHILD_SUBREAPER 36
+#endif
+
+static SupDaemon daemons[SUP_MAX_DAEMONS];
+static int numDaemons = 0;
+static int sigFd = -1;
+
+static const char *stateNames[] = {
+    "stopped", "starting", "running", "waiting", "failed"
+};
+
+static time_t supNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+// Find a process by name, optionally only among our own children
+static pid_t supFindProcess(const char *name, pid_t ppid)
+{
+    DIR *dir;
+    struct dirent *ent;
+    pid_t pid = 0;
+
+    dir = opendir("/proc");
+    if (dir == NULL) {
+        return 0;
+    }
+
+    while ((ent = readdir(dir)) != NULL) {
+        char file[64];
+        char line[256];
+        char *comm, *end;
+        pid_t parent;
+        FILE *f;
+        int i;
+
+        pid = atoi(ent->d_name);
+        if (pid <= 0) {
+            continue;
+        }
+
+        // Format is "pid (comm) state ppid ..."
+        snprintf(file, sizeof(file), "/proc/%d/stat", pid);
+        f = fopen(file, "r");
+        if (f == NULL) {
+            continue;
+        }
+        if (fgets(line, sizeof(line), f) == NULL) {
+            fclose(f);
+            continue;
+        }
+        fclose(f);
+
+        comm = strchr(line, '(');
+        end = strrchr(line, ')');
+        if ((comm == NULL) || (end == NULL) || (end[1] == '\0')) {
+            continue;
+        }
+        *end = '\0';
+        parent = atoi(&end[4]);
+
+        // Skip zombies, they are about to be reaped
+        if (end[2] == 'Z') {
+            continue;
+        }
+        if ((ppid != 0) && (parent != ppid)) {
+            continue;
+        }
+        if (strncmp(comm + 1, name, 15) != 0) {
+            continue;
+        }
+
+        // Ignore the ones we already know about
+        for (i = 0; i < numDaemons; i++) {
+            if (daemons[i].pid == pid) {
+                pid = 0;
+                break;
+            }
+        }
+        if (pid) {
+            break;
+        }
+    }
+    closedir(dir);
+    if (ent == NULL) {
+        pid = 0;
+    }
+    return pid;
+}
+
+static SupDaemon *supFindDaemon(pid_t pid)
+{
+    int i;
+
+    for (i = 0; i < numDaemons; i++) {
+        if ((daemons[i].pid == pid) && !daemons[i].adopted) {
+            return &daemons[i];
+        }
+    }
+    return NULL;
+}
+
+static int supSpawn(SupDaemon *d, int restart)
+{
+    char *argv[3];
+    sigset_t mask;
+    pid_t pid;
+
+    argv[0] = d->name;
+    argv[1] = (restart && d->restartArg[0]) ? d->restartArg : NULL;
+    argv[2] = NULL;
+
+    pid = fork();
+    if (pid < 0) {
+        syslog(LOG_ERR, "Unable to start %s: %s", d->name, strerror(errno));
+        return -1;
+    }
+
+    if (pid == 0) {
+        // Child doesn't inherit our signal handling
+        sigemptyset(&mask);
+        sigprocmask(SIG_SETMASK, &mask, NULL);
+        setpgid(0, 0);
+        execv(d->path, argv);
+        _exit(127);
+    }
+
+    d->pid = pid;
+    d->adopted = 0;
+    d->state = (d->flags & SUP_DAEMONIZES) ? SUP_STARTING : SUP_RUNNING;
+    d->startTime = supNow();
+    d->starts++;
+    if (restart) {
+        d->restarts++;
+    }
+    return 0;
+}
+
+// Watch a copy of the daemon that someone else started
+static void supAdopt(SupDaemon *d, pid_t pid)
+{
+    d->pid = pid;
+    d->adopted = 1;
+    d->pidfd = syscall(__NR_pidfd_open, pid, 0);
+    d->state = SUP_RUNNING;
+    d->startTime = supNow();
+
+    syslog(LOG_INFO, "Watching running %s (pid %d)%s", d->name, pid,
+           (d->pidfd < 0) ? ", polling" : "");
+}
+
+// Daemon is gone - decide when to start it again
+static void supExited(SupDaemon *d, int status)
+{
+    time_t now = supNow();
+    time_t uptime = now - d->startTime;
+
+    if (d->pidfd >= 0) {
+        close(d->pidfd);
+        d->pidfd = -1;
+    }
+    d->pid = 0;
+    d->adopted = 0;
+
+    if (status == -1) {
+        syslog(LOG_WARNING, "%s exited after %lds", d->name, (long)uptime);
+    } else if (WIFSIGNALED(status)) {
+        syslog(LOG_WARNING, "%s killed by signal %d after %lds", d->name,
+               WTERMSIG(status), (long)uptime);
+    } else {
+        syslog(LOG_WARNING, "%s exited with status %d after %lds", d->name,
+               WEXITSTATUS(status), (long)uptime);
+    }
+
+    // Back off exponentially while it keeps failing quickly
+    if (uptime >= d->stableTime) {
+        d->backoff = d->minBackoff;
+    } else if (d->backoff == 0) {
+        d->backoff = d->minBackoff;
+    } else {
+        d->backoff *= 2;
+        if (d->backoff > d->maxBackoff) {
+            d->backoff = d->maxBackoff;
+        }
+    }
+
+    // Give up for a while if it is stuck in a crash loop
+    if ((d->windowExits == 0) || (now - d->windowStart > d->crashWindow)) {
+        d->windowStart = now;
+        d->windowExits = 0;
+    }
+    if (++d->windowExits > d->crashLimit) {
+        syslog(LOG_ERR, "%s exited %d times in %ds, waiting %ds",
+               d->name, d->windowExits, d->crashWindow, d->holdOff);
+        d->crashLoops++;
+        d->windowExits = 0;
+        d->backoff = d->minBackoff;
+        d->state = SUP_FAILED;
+        d->restartTime = now + d->holdOff;
+        return;
+    }
+
+    d->state = SUP_WAITING;
+    d->restartTime = now + d->backoff;
+}
+
+// Reap whatever exited: our daemons, the parents they left behind when
+// going into the background, and orphans handed to us as subreaper
+static void supReap(void)
+{
+    struct signalfd_siginfo info;
+    SupDaemon *d;
+    pid_t pid;
+    int status;
+
+    // Drain pending notifications, waitpid() finds out what happened
+    while (read(sigFd, &info, sizeof(info)) == sizeof(info)) {
+    }
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        d = supFindDaemon(pid);
+        if (d == NULL) {
+            continue;
+        }
+
+        if ((d->state == SUP_STARTING) && WIFEXITED(status) &&
+            (WEXITSTATUS(status) == 0)) {
+            // Daemon forked into the background - its new pid is ours now
+            pid = supFindProcess(d->name, getpid());
+            if (pid) {
+                d->pid = pid;
+                d->state = SUP_RUNNING;
+                continue;
+            }
+        }
+        supExited(d, status);
+    }
+}
+
+// Daemons we did not start
+static void supCheckAdopted(struct pollfd *fds, int nfds)
+{
+    int i, j;
+
+    for (i = 0; i < numDaemons; i++) {
+        SupDaemon *d = &daemons[i];
+
+        if ((d->state != SUP_RUNNING) || !d->adopted) {
+            continue;
+        }
+
+        if (d->pidfd >= 0) {
+            for (j = 1; j < nfds; j++) {
+                if ((fds[j].fd == d->pidfd) && fds[j].revents) {
+                    supExited(d, -1);
+                    break;
+                }
+            }
+        } else if (kill(d->pid, 0) < 0) {
+            supExited(d, -1);
+        }
+    }
+}
+
+int supInit(void)
+{
+    sigset_t mask;
+
+    // Daemons that fork into the background get re-parented to us
+    if (prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0) < 0) {
+        syslog(LOG_WARNING, "Unable to become subreaper: %s",
+               strerror(errno));
+    }
+
+    // Exits are delivered through a file descriptor
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    sigFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sigFd < 0) {
+        syslog(LOG_ERR, "Unable to create signalfd: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+SupDaemon *supAdd(const char *name, const char *path,
+                  const char *restartArg, int flags)
+{
+    SupDaemon *d;
+
+    if (numDaemons == SUP_MAX_DAEMONS) {
+        return NULL;
+    }
+    d = &daemons[numDaemons++];
+
+    memset(d, 0, sizeof(*d));
+    snprintf(d->name, sizeof(d->name), "%s", name);
+    snprintf(d->path, sizeof(d->path), "%s", path);
+    if (restartArg) {
+        snprintf(d->restartArg, sizeof(d->restartArg), "%s", restartArg);
+    }
+    d->flags = flags;
+    d->minBackoff = SUP_MIN_BACKOFF;
+    d->maxBackoff = SUP_MAX_BACKOFF;
+    d->stableTime = SUP_STABLE_TIME;
+    d->crashLimit = SUP_CRASH_LIMIT;
+    d->crashWindow = SUP_CRASH_WINDOW;
+    d->holdOff = SUP_HOLD_OFF;
+    d->pidfd = -1;
+    return d;
+}
+
+int supStart(SupDaemon *d)
+{
+    pid_t pid;
+
+    if (d->state != SUP_STOPPED) {
+        return 0;
+    }
+
+    // Already started by someone else?
+    pid = supFindProcess(d->name, 0);
+    if (pid) {
+        supAdopt(d, pid);
+        return 0;
+    }
+    return supSpawn(d, 0);
+}
+
+int supPoll(int timeout)
+{
+    struct pollfd fds[SUP_MAX_DAEMONS + 1];
+    time_t now = supNow();
+    int nfds = 1;
+    int i, res;
+
+    fds[0].fd = sigFd;
+    fds[0].events = POLLIN;
+
+    // Wake up for due restarts and adopted daemons we can't wait on
+    for (i = 0; i < numDaemons; i++) {
+        SupDaemon *d = &daemons[i];
+
+        if ((d->state == SUP_WAITING) || (d->state == SUP_FAILED)) {
+            if (d->restartTime - now < timeout) {
+                timeout = (d->restartTime > now) ? d->restartTime - now : 0;
+            }
+        } else if ((d->state == SUP_RUNNING) && (d->pidfd >= 0)) {
+            fds[nfds].fd = d->pidfd;
+            fds[nfds].events = POLLIN;
+            nfds++;
+        } else if ((d->state == SUP_RUNNING) && d->adopted &&
+                   (timeout > SUP_CHECK_PERIOD)) {
+            timeout = SUP_CHECK_PERIOD;
+        }
+    }
+
+    res = poll(fds, nfds, timeout * 1000);
+    if ((res < 0) && (errno != EINTR)) {
+        return -1;
+    }
+
+    supReap();
+    supCheckAdopted(fds, (res > 0) ? nfds : 0);
+
+    // Restart whatever is due
+    now = supNow();
+    for (i = 0; i < numDaemons; i++) {
+        SupDaemon *d = &daemons[i];
+
+        if (((d->state == SUP_WAITING) || (d->state == SUP_FAILED)) &&
+            (now >= d->restartTime)) {
+            syslog(LOG_INFO, "Restarting %s...", d->name);
+            if (supSpawn(d, 1) < 0) {
+                d->restartTime = now + d->maxBackoff;
+            }
+        }
+    }
+    return 0;
+}
+
+time_t supUptime(SupDaemon *d)
+{
+    if ((d->state != SUP_RUNNING) && (d->state != SUP_STARTING)) {
+        return 0;
+    }
+    return supNow() - d->startTime;
+}
+
+int supWriteStatus(const char *file)
+{
+    char tmp[128];
+    FILE *f;
+    int i;
+
+    // Write a new file and move it into place, readers never see half of it
+    snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+    f = fopen(tmp, "w");
+    if (f == NULL) {
+        return -1;
+    }
+    for (i = 0; i < numDaemons; i++) {
+        SupDaemon *d = &daemons[i];
+
+        fprintf(f, "%s pid=%d state=%s uptime=%ld starts=%u restarts=%u "
+                "crashloops=%u\n", d->name, d->pid, stateNames[d->state],
+                (long)supUptime(d), d->starts, d->restarts, d->crashLoops);
+    }
+    fclose(f);
+    return rename(tmp, file);
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _SUPERVISOR_H
+#define _SUPERVISOR_H
+
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * Daemon supervisor - starts daemons and restarts them as soon as they exit.
+ *
+ * Exits are seen through SIGCHLD, so there is no polling.  Daemons which
+ * fork themselves into the background are still caught: the supervisor is
+ * a child subreaper and adopts them.  A daemon that was already running
+ * before the supervisor started is watched through a pidfd, or checked
+ * every SUP_CHECK_PERIOD seconds where the kernel has none.
+ */
+
+#define SUP_MAX_DAEMONS         8
+#define SUP_CHECK_PERIOD        5
+
+// Daemon flags
+#define SUP_DAEMONIZES          0x01    // forks itself into the background
+
+// Default restart policy, in seconds
+#define SUP_MIN_BACKOFF         1
+#define SUP_MAX_BACKOFF         60
+#define SUP_STABLE_TIME         60      // uptime that resets the backoff
+#define SUP_CRASH_LIMIT         5       // exits allowed ...
+#define SUP_CRASH_WINDOW        300     // ... within this time
+#define SUP_HOLD_OFF            900     // wait after a crash loop
+
+enum SupState {SUP_STOPPED = 0, SUP_STARTING, SUP_RUNNING, SUP_WAITING,
+               SUP_FAILED};
+
+typedef struct {
+    char     name[32];
+    char     path[128];
+    char     restartArg[32];    // passed when restarted, if not empty
+    int      flags;
+
+    // Restart policy, defaults from above
+    int      minBackoff;
+    int      maxBackoff;
+    int      stableTime;
+    int      crashLimit;
+    int      crashWindow;
+    int      holdOff;
+
+    // Current state
+    int      state;
+    pid_t    pid;
+    int      adopted;           // started by someone else
+    int      pidfd;             // to wait on an adopted daemon, or -1
+    time_t   startTime;
+    time_t   restartTime;
+    int      backoff;
+    time_t   windowStart;
+    int      windowExits;
+
+    // Counters
+    unsigned starts;
+    unsigned restarts;
+    unsigned crashLoops;
+} SupDaemon;
+
+/* Setup - call once, before any daemon is added */
+int supInit(void);
+
+/* Add a daemon to supervise, and start it (or adopt a running copy) */
+SupDaemon *supAdd(const char *name, const char *path,
+                  const char *restartArg, int flags);
+int supStart(SupDaemon *d);
+
+/* Wait up to timeout seconds for, and handle, exits and due restarts */
+int supPoll(int timeout);
+
+/* Seconds the daemon has been up, 0 if it is not running */
+time_t supUptime(SupDaemon *d);
+
+/* Write one line per daemon: name, pid, state, uptime and counters */
+int supWriteStatus(const char *file);
+
+#endif /* _SUPERVISOR_H */
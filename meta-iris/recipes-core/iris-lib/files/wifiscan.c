@@ -0,0 +1,394 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/wireless.h>
+#include "wifiscan.h"
+
+#define WIFI_SCAN_BUF_SIZE  4096
+#define WIFI_SCAN_BUF_MAX   65535   // most a struct iw_point can ask for
+#define WIFI_SCAN_POLL      100     // ms between checks for a finished scan
+#define WIFI_SCAN_MAX_QUAL  70      // what cfg80211 uses, if not reported
+
+// Events in the stream have a 4 byte length/command header, then the
+//  payload - struct iw_point is packed without its pointer
+#define WIFI_EV_HDR_LEN     4
+#define WIFI_EV_POINT_LEN   4
+
+// Information elements we look at
+#define WIFI_IE_RSN         0x30
+#define WIFI_IE_VENDOR      0xDD
+
+static int wifiScanIoctl(const char *intf, int request, struct iwreq *wrq)
+{
+    int sock, res, err;
+
+    sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    snprintf(wrq->ifr_name, sizeof(wrq->ifr_name), "%s", intf);
+    res = ioctl(sock, request, wrq);
+    err = errno;
+    close(sock);
+    errno = err;
+    return res;
+}
+
+// Quality is reported against a driver specific maximum
+static int wifiScanMaxQual(const char *intf)
+{
+    struct iw_range range;
+    struct iwreq wrq;
+
+    memset(&range, 0, sizeof(range));
+    memset(&wrq, 0, sizeof(wrq));
+    wrq.u.data.pointer = &range;
+    wrq.u.data.length = sizeof(range);
+    if ((wifiScanIoctl(intf, SIOCGIWRANGE, &wrq) < 0) ||
+        (range.max_qual.qual == 0)) {
+        return WIFI_SCAN_MAX_QUAL;
+    }
+    return range.max_qual.qual;
+}
+
+// Drivers report either a channel or a frequency
+static int wifiScanChannel(const struct iw_freq *freq)
+{
+    long long mhz = freq->m;
+    int i;
+
+    if ((freq->e == 0) && (freq->m <= 1000)) {
+        return freq->m;
+    }
+
+    // Value is m * 10^e Hz
+    for (i = freq->e; i < 6; i++) {
+        mhz /= 10;
+    }
+    for (i = 6; i < freq->e; i++) {
+        mhz *= 10;
+    }
+    if (mhz == 2484) {
+        return 14;
+    } else if ((mhz > 2407) && (mhz < 2484)) {
+        return (mhz - 2407) / 5;
+    } else if ((mhz >= 5000) && (mhz < 5900)) {
+        return (mhz - 5000) / 5;
+    }
+    return 0;
+}
+
+// WPA2 has its own element, WPA is a Microsoft vendor element
+static void wifiScanIEs(const uint8_t *ie, int len, WifiScanResult *r)
+{
+    static const uint8_t wpaOui[] = { 0x00, 0x50, 0xF2, 0x01 };
+
+    while ((len >= 2) && (ie[1] + 2 <= len)) {
+        const uint8_t *data = ie + 2;
+        int dlen = ie[1];
+
+        if (ie[0] == WIFI_IE_RSN) {
+            r->security |= WIFI_SEC_WPA2;
+        } else if ((ie[0] == WIFI_IE_VENDOR) && (dlen >= 4) &&
+                   (memcmp(data, wpaOui, sizeof(wpaOui)) == 0)) {
+            r->security |= WIFI_SEC_WPA;
+
+            // Version, then the group cipher - 00:50:F2:02 is TKIP
+            if ((dlen >= 10) && (data[9] == 0x02)) {
+                r->tkip = 1;
+            }
+        }
+        len -= dlen + 2;
+        ie += dlen + 2;
+    }
+}
+
+// Keep a cell, if it is one a user could pick
+static void wifiScanCellDone(WifiScanResult *cell, int encrypted,
+                             WifiScanResult *results, int *count, int max)
+{
+    // Encryption without WPA information has to be WEP
+    if (!encrypted) {
+        cell->security = 0;
+    } else if (cell->security == 0) {
+        cell->security = WIFI_SEC_WEP;
+    }
+
+    // Hidden networks have no SSID, or one of all zeros
+    if ((cell->ssid[0] != '\0') && (*count < max)) {
+        results[(*count)++] = *cell;
+    }
+}
+
+/* Decode a SIOCGIWSCAN event stream */
+int wifiScanParse(const char *stream, int len, int maxQual,
+                  WifiScanResult *results, int max)
+{
+    WifiScanResult cell;
+    int pos = 0, count = 0, inCell = 0, encrypted = 0;
+
+    if (maxQual <= 0) {
+        maxQual = WIFI_SCAN_MAX_QUAL;
+    }
+
+    while (pos + WIFI_EV_HDR_LEN <= len) {
+        const char *p = stream + pos + WIFI_EV_HDR_LEN;
+        uint16_t evLen, cmd, ptLen = 0;
+        int plen;
+
+        memcpy(&evLen, stream + pos, sizeof(evLen));
+        memcpy(&cmd, stream + pos + 2, sizeof(cmd));
+        if ((evLen < WIFI_EV_HDR_LEN) || (pos + evLen > len)) {
+            break;
+        }
+        pos += evLen;
+        plen = evLen - WIFI_EV_HDR_LEN;
+
+        // Point payloads start with their length, then flags
+        if (plen >= WIFI_EV_POINT_LEN) {
+            memcpy(&ptLen, p, sizeof(ptLen));
+            if (ptLen > plen - WIFI_EV_POINT_LEN) {
+                ptLen = plen - WIFI_EV_POINT_LEN;
+            }
+        }
+
+        // Each cell starts with the access point address
+        if (cmd == SIOCGIWAP) {
+            if (inCell) {
+                wifiScanCellDone(&cell, encrypted, results, &count, max);
+            }
+            memset(&cell, 0, sizeof(cell));
+            inCell = 1;
+            encrypted = 0;
+            if (plen >= sizeof(struct sockaddr)) {
+                memcpy(cell.bssid, ((struct sockaddr *)p)->sa_data,
+                       sizeof(cell.bssid));
+            }
+            continue;
+        }
+        if (!inCell) {
+            continue;
+        }
+
+        switch (cmd) {
+        case SIOCGIWFREQ:
+            if ((plen >= sizeof(struct iw_freq)) && (cell.channel == 0)) {
+                struct iw_freq freq;
+
+                memcpy(&freq, p, sizeof(freq));
+                cell.channel = wifiScanChannel(&freq);
+            }
+            break;
+        case SIOCGIWMODE:
+            if (plen >= sizeof(uint32_t)) {
+                uint32_t mode;
+
+                memcpy(&mode, p, sizeof(mode));
+                cell.mode = (mode == IW_MODE_ADHOC) ? WIFI_MODE_ADHOC :
+                    WIFI_MODE_INFRA;
+            }
+            break;
+        case SIOCGIWESSID:
+            if ((plen >= WIFI_EV_POINT_LEN) &&
+                (ptLen <= WIFI_SCAN_SSID_LEN)) {
+                memcpy(cell.ssid, p + WIFI_EV_POINT_LEN, ptLen);
+                cell.ssid[ptLen] = '\0';
+
+                // Embedded zeros mean a hidden network
+                if (strlen(cell.ssid) != ptLen) {
+                    cell.ssid[0] = '\0';
+                }
+            }
+            break;
+        case SIOCGIWENCODE:
+            if (plen >= WIFI_EV_POINT_LEN) {
+                uint16_t flags;
+
+                memcpy(&flags, p + 2, sizeof(flags));
+                encrypted = !(flags & IW_ENCODE_DISABLED);
+            }
+            break;
+        case IWEVQUAL:
+            if (plen >= sizeof(struct iw_quality)) {
+                struct iw_quality qual;
+                int signal;
+
+                memcpy(&qual, p, sizeof(qual));
+                if (!(qual.updated & IW_QUAL_QUAL_INVALID)) {
+                    signal = (qual.qual * 100) / maxQual;
+                    cell.signal = (signal > 100) ? 100 : signal;
+                }
+            }
+            break;
+        case IWEVGENIE:
+            if (plen >= WIFI_EV_POINT_LEN) {
+                wifiScanIEs((const uint8_t *)p + WIFI_EV_POINT_LEN, ptLen,
+                            &cell);
+            }
+            break;
+        }
+    }
+    if (inCell) {
+        wifiScanCellDone(&cell, encrypted, results, &count, max);
+    }
+    return count;
+}
+
+/* Start a scan */
+int wifiScanStart(const char *intf)
+{
+    struct iwreq wrq;
+
+    memset(&wrq, 0, sizeof(wrq));
+    return wifiScanIoctl(intf, SIOCSIWSCAN, &wrq);
+}
+
+/* Results of the last scan */
+int wifiScanResults(const char *intf, WifiScanResult *results, int max)
+{
+    struct iwreq wrq;
+    char *buf = NULL, *newBuf;
+    int size = WIFI_SCAN_BUF_SIZE;
+    int res, err;
+
+    while (1) {
+        newBuf = realloc(buf, size);
+        if (newBuf == NULL) {
+            free(buf);
+            errno = ENOMEM;
+            return -1;
+        }
+        buf = newBuf;
+
+        memset(&wrq, 0, sizeof(wrq));
+        wrq.u.data.pointer = buf;
+        wrq.u.data.length = size;
+        if (wifiScanIoctl(intf, SIOCGIWSCAN, &wrq) == 0) {
+            break;
+        }
+
+        // Not enough room - some drivers say how much is needed
+        if ((errno == E2BIG) && (size < WIFI_SCAN_BUF_MAX)) {
+            size = (wrq.u.data.length > size) ? wrq.u.data.length : size * 2;
+            if (size > WIFI_SCAN_BUF_MAX) {
+                size = WIFI_SCAN_BUF_MAX;
+            }
+            continue;
+        }
+        err = errno;
+        free(buf);
+        errno = err;
+        return -1;
+    }
+
+    res = wifiScanParse(buf, wrq.u.data.length, wifiScanMaxQual(intf),
+                        results, max);
+    free(buf);
+    return res;
+}
+
+/* Start a scan and wait for the results */
+int wifiScan(const char *intf, WifiScanResult *results, int max, int timeout)
+{
+    int res, waited = 0;
+
+    // If a scan can't be started (one is already running, or no rights to
+    //  start one) the results of the last one are still worth having
+    wifiScanStart(intf);
+
+    while (((res = wifiScanResults(intf, results, max)) < 0) &&
+           (errno == EAGAIN) && (waited < timeout)) {
+        usleep(WIFI_SCAN_POLL * 1000);
+        waited += WIFI_SCAN_POLL;
+    }
+    return res;
+}
+
+// SSIDs are raw bytes - keep them valid in a JSON string
+static void wifiScanEscape(const char *ssid, char *buf, int len)
+{
+    int i, j = 0;
+
+    for (i = 0; (ssid[i] != '\0') && (j < len - 7); i++) {
+        unsigned char c = ssid[i];
+
+        if ((c == '\\') || (c == '\"')) {
+            buf[j++] = '\\';
+            buf[j++] = c;
+        } else if ((c < 0x20) || (c == 0x7F)) {
+            j += snprintf(&buf[j], len - j, "\\u%04x", c);
+        } else {
+            buf[j++] = c;
+        }
+    }
+    buf[j] = '\0';
+}
+
+/* JSON for one result */
+int wifiScanFormat(const WifiScanResult *r, int brief, char *buf, int len)
+{
+    char ssid[(WIFI_SCAN_SSID_LEN * 6) + 8];
+    char *security;
+
+    wifiScanEscape(r->ssid, ssid, sizeof(ssid));
+
+    // BLE clients get a single security item - WPA2 wins if both are there
+    if (brief) {
+        if (r->security & WIFI_SEC_WPA2) {
+            security = "WPA2-PSK";
+        } else if (r->security & WIFI_SEC_WPA) {
+            security = "WPA-PSK";
+        } else if (r->security & WIFI_SEC_WEP) {
+            security = "WEP";
+        } else {
+            security = "None";
+        }
+        return snprintf(buf, len, "{\"ssid\":\"%s\", \"security\":\"%s\", "
+                        "\"channel\":%d, \"signal\":%d}", ssid, security,
+                        r->channel, r->signal);
+    }
+
+    if ((r->security & WIFI_SEC_WPA2) && (r->security & WIFI_SEC_WPA)) {
+        security = "\"WPA2-PSK\",\"WPA-PSK\"";
+    } else if (r->security & WIFI_SEC_WPA2) {
+        security = "\"WPA2-PSK\"";
+    } else if (r->security & WIFI_SEC_WPA) {
+        security = "\"WPA-PSK\"";
+    } else if (r->security & WIFI_SEC_WEP) {
+        security = "\"WEP\"";
+    } else {
+        security = "\"None\"";
+    }
+
+    // Encryption names are as iwlist based scans always reported them
+    return snprintf(buf, len, "{\"ssid\":\"%s\", \"mode\":\"%s\", "
+                    "\"security\":[%s], \"wepauth\":\"%s\", "
+                    "\"encryption\":\"%s\", \"channel\":%d, "
+                    "\"signal\":%d, \"wps\":\"No\"}", ssid,
+                    (r->mode == WIFI_MODE_ADHOC) ? "Ad-hoc" : "Infrastructure",
+                    security, r->security ? "OpenSystem" : "Unknown",
+                    (r->security & WIFI_SEC_WPA2) ? "AES+TPIK" :
+                    (r->security & WIFI_SEC_WPA) ? (r->tkip ? "TPIK" : "AES") :
+                    (r->security & WIFI_SEC_WEP) ? "WEP" : "None",
+                    r->channel, r->signal);
+}
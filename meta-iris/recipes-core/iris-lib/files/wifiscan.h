@@ -0,0 +1,73 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _WIFISCAN_H
+#define _WIFISCAN_H
+
+#include <stdint.h>
+
+/*
+ * Wifi scan - asks the driver for scan results directly (the wireless
+ * extensions ioctls iwlist uses) instead of running iwlist and parsing
+ * its output.
+ *
+ * Results are kept as compact records, one per access point, and only
+ * turned into JSON when sent.  The driver keeps the results of the last
+ * scan, whoever started it, so wifiScanResults() can be called at any
+ * time for an answer right away.
+ */
+
+#define WIFI_SCAN_MAX_RESULTS   64
+#define WIFI_SCAN_SSID_LEN      32
+#define WIFI_SCAN_JSON_LEN      384     // longest JSON for one result
+
+// Security offered - none of these means an open network
+#define WIFI_SEC_WEP            0x01
+#define WIFI_SEC_WPA            0x02
+#define WIFI_SEC_WPA2           0x04
+
+// Network modes
+#define WIFI_MODE_INFRA         0
+#define WIFI_MODE_ADHOC         1
+
+typedef struct {
+    char    ssid[WIFI_SCAN_SSID_LEN + 1];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t signal;             // percent
+    uint8_t mode;
+    uint8_t security;
+    uint8_t tkip;               // WPA group cipher is TKIP
+} WifiScanResult;
+
+/* Start a scan - results are ready once wifiScanResults() stops failing
+   with EAGAIN */
+int wifiScanStart(const char *intf);
+
+/* Results of the last scan, -1 with errno EAGAIN while one is running */
+int wifiScanResults(const char *intf, WifiScanResult *results, int max);
+
+/* Start a scan and wait up to timeout ms for the results */
+int wifiScan(const char *intf, WifiScanResult *results, int max, int timeout);
+
+/* Decode a SIOCGIWSCAN event stream - maxQual scales the signal */
+int wifiScanParse(const char *stream, int len, int maxQual,
+                  WifiScanResult *results, int max);
+
+/* JSON for one result - brief is the form sent to BLE clients */
+int wifiScanFormat(const WifiScanResult *r, int brief, char *buf, int len);
+
+#endif /* _WIFISCAN_H */
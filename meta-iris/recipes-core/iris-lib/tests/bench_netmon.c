@@ -0,0 +1,112 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Network monitor timings - route checks by shell pipeline against
+ * lookups, and how long a carrier change takes to wake netmonWait().
+ * Run with unshare -rn.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <poll.h>
+#include "netmon.h"
+#include "irislib.h"
+
+#define POPEN_LOOPS     100
+#define LOOKUP_LOOPS    100000
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void *pump(void *arg)
+{
+    struct pollfd pfd = { netmonFd(), POLLIN, 0 };
+
+    while (1) {
+        if (poll(&pfd, 1, -1) > 0) {
+            netmonProcess();
+        }
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    NetmonRoute r[NETMON_MAX_ROUTES];
+    char line[256];
+    pthread_t tid;
+    double t;
+    int i;
+
+    if (system("ip link set lo up && "
+               "ip link add eth0 type veth peer name eth0p && "
+               "ip link set eth0 up && ip link set eth0p up && "
+               "ip addr add 10.0.0.2/24 dev eth0 && "
+               "ip route add default via 10.0.0.1") != 0) {
+        return 1;
+    }
+    if (netmonInit() < 0) {
+        return 1;
+    }
+
+    t = now();
+    for (i = 0; i < POPEN_LOOPS; i++) {
+        FILE *f = popen("/sbin/ip route | grep 'default via 10.0.0.1 dev eth0'",
+                        "r");
+
+        if (f) {
+            fgets(line, sizeof(line), f);
+            pclose(f);
+        }
+    }
+    printf("ip route pipeline: %.3f ms\n", (now() - t) / POPEN_LOOPS);
+
+    t = now();
+    for (i = 0; i < LOOKUP_LOOPS; i++) {
+        netmonGetDefaultRoutes(r, NETMON_MAX_ROUTES);
+    }
+    printf("netmonGetDefaultRoutes: %.1f ns\n", (now() - t) * 1e6 / LOOKUP_LOOPS);
+
+    t = now();
+    for (i = 0; i < LOOKUP_LOOPS; i++) {
+        IRIS_isIntfConnected("eth0");
+    }
+    printf("IRIS_isIntfConnected: %.1f ns\n", (now() - t) * 1e6 / LOOKUP_LOOPS);
+
+    t = now();
+    for (i = 0; i < LOOKUP_LOOPS; i++) {
+        IRIS_isIntfIPUp("eth0");
+    }
+    printf("IRIS_isIntfIPUp: %.1f ns\n", (now() - t) * 1e6 / LOOKUP_LOOPS);
+
+    pthread_create(&tid, NULL, pump, NULL);
+    usleep(100000);
+    t = now();
+    system("ip link set eth0p down");
+    while (netmonIsConnected("eth0") && netmonWait(5000)) {
+    }
+    printf("carrier down to wakeup: %.3f ms\n", now() - t);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#!/bin/sh
+#
+# iris4gd failover timings - eth0 is the primary link and eth1 stands in
+# for the backup modem.  Run with unshare -rn, with the iris4gd built by
+# "make check-failover".  iris4gd daemonizes, so this also wants a pid
+# namespace, where pkill only sees its own.
+#
+# Copyright 2019 Arcus Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+IRIS4GD=$1
+ROUNDS=6
+TIMEOUT=3000        # 5 ms polls, so 15 s
+
+ms() {
+    echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# Poll until the command succeeds, 1 if it never does
+until_ok() {
+    n=0
+    until eval "$1"; do
+        sleep 0.005
+        n=$((n + 1))
+        if [ $n -gt $TIMEOUT ]; then
+            ip route
+            return 1
+        fi
+    done
+    return 0
+}
+
+ip link set lo up
+ip link add eth0 type veth peer name eth0p
+ip link add eth1 type veth peer name eth1p
+for i in eth0 eth0p eth1 eth1p; do
+    ip link set $i up
+done
+ip addr add 10.0.0.2/24 dev eth0
+ip addr add 10.1.0.2/24 dev eth1
+ip route add default via 10.0.0.1
+
+# What the LTE scripts would have left behind
+echo 10.0.0.1 > /tmp/pri_gw.conf
+echo 10.1.0.1 > /tmp/bkup_gw.conf
+touch /tmp/pri_resolv.conf /tmp/bkup_resolv.conf
+echo 12d1:14dc > /tmp/lte_dongle
+echo down > /tmp/backupStatus
+rm -f /tmp/testWifi.cfg
+
+$IRIS4GD > /dev/null 2>&1
+sleep 6
+
+res=0
+for i in $(seq $ROUNDS); do
+    sleep 0.$(( (i * 37) % 10 ))
+    t0=$(ms)
+    ip link set eth0p down
+    if ! until_ok "ip route show default | grep -q 10.1.0.1"; then
+        echo "FAIL: no failover"
+        res=1
+        break
+    fi
+    t1=$(ms)
+    ip link set eth0p up
+    if ! until_ok "ip route show default | grep -v 'metric 2' | grep -q 10.0.0.1"; then
+        echo "FAIL: no failback"
+        res=1
+        break
+    fi
+    t2=$(ms)
+    echo "failover $((t1 - t0)) ms  failback $((t2 - t1)) ms"
+done
+
+pkill -x iris4gd
+exit $res
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+#
+# Canned wifi scans - each written as the SIOCGIWSCAN event stream a
+# driver returns (.bin) and as the iwlist output for it (.txt).  The
+# networks are random, but the same for the same seed.
+#
+# Copyright 2019 Arcus Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+import os
+import random
+import struct
+import sys
+
+SIOCGIWFREQ = 0x8B05
+SIOCGIWMODE = 0x8B07
+SIOCGIWAP = 0x8B15
+SIOCGIWESSID = 0x8B1B
+SIOCGIWRATE = 0x8B21
+SIOCGIWENCODE = 0x8B2B
+IWEVQUAL = 0x8C01
+IWEVCUSTOM = 0x8C02
+IWEVGENIE = 0x8C05
+
+IW_ENCODE_DISABLED = 0x8000
+IW_ENCODE_NOKEY = 0x0800
+
+# Name, seed and number of networks
+SCANS = [('s0', 9, 0), ('s1', 1, 9), ('s2', 2, 18), ('s3', 3, 27),
+         ('s4', 4, 36), ('s5', 5, 45), ('s6', 7, 64)]
+
+# Names that are hard to parse or escape - HIDDEN0 is sent as 7 NULs
+NAMES = ['HomeNet', 'Cafe "Wifi"', 'back\\slash', 'xfinitywifi', 'NETGEAR42',
+         'Lowe\'s', 'a' * 32, '', 'HIDDEN0', 'Ünïcode']
+
+
+def event(cmd, payload):
+    return struct.pack('<HH', 4 + len(payload), cmd) + payload
+
+
+def point(cmd, data, flags=0):
+    return event(cmd, struct.pack('<HH', len(data), flags) + data)
+
+
+def rsn(group=4):
+    return (bytes([0x30, 20]) + struct.pack('<H', 1) +
+            bytes([0, 0x0f, 0xac, group]) +
+            struct.pack('<H', 1) + bytes([0, 0x0f, 0xac, 4]) +
+            struct.pack('<H', 1) + bytes([0, 0x0f, 0xac, 2]) + b'\x00\x00')
+
+
+def wpa(group=2):
+    return (bytes([0xdd, 22]) + bytes([0, 0x50, 0xf2, 1]) +
+            struct.pack('<H', 1) + bytes([0, 0x50, 0xf2, group]) +
+            struct.pack('<H', 1) + bytes([0, 0x50, 0xf2, group]) +
+            struct.pack('<H', 1) + bytes([0, 0x50, 0xf2, 2]))
+
+
+def cells(seed, n):
+    r = random.Random(seed)
+    out = []
+    for i in range(n):
+        ssid = r.choice(NAMES)
+        sec = r.choice(['open', 'wep', 'wpa', 'wpa2', 'mixed'])
+        ch = r.choice([1, 6, 11, 36, 149, 14])
+        q = r.randint(10, 70)
+        out.append(dict(bssid=[r.randint(0, 255) for _ in range(6)],
+                        ssid=ssid, sec=sec, ch=ch, q=q,
+                        tkip=r.choice([0, 1])))
+    return out
+
+
+def freq(ch):
+    if ch == 14:
+        return 2484
+    if ch <= 13:
+        return 2407 + 5 * ch
+    return 5000 + 5 * ch
+
+
+def stream(cs):
+    s = b''
+    for c in cs:
+        s += event(SIOCGIWAP, struct.pack('<H', 1) + bytes(c['bssid']) +
+                   b'\0' * 8)
+        s += event(SIOCGIWMODE, struct.pack('<I', 3))
+        s += event(SIOCGIWFREQ, struct.pack('<ihBB', c['ch'], 0, 0, 0))
+        s += event(SIOCGIWFREQ, struct.pack('<ihBB', freq(c['ch']), 6, 0, 0))
+        s += event(IWEVQUAL, struct.pack('<BBBB', c['q'],
+                                         (c['q'] - 110) & 0xff, 0, 0x4b))
+        s += point(SIOCGIWENCODE, b'',
+                   IW_ENCODE_DISABLED if c['sec'] == 'open'
+                   else IW_ENCODE_NOKEY)
+        if c['ssid'] == 'HIDDEN0':
+            ssid = b'\0' * 7
+        else:
+            ssid = c['ssid'].encode()
+        s += point(SIOCGIWESSID, ssid, 1)
+        s += event(SIOCGIWRATE, struct.pack('<iBB2x', 54000000, 0, 0))
+        ies = bytes([0, len(ssid)]) + ssid
+        if c['sec'] in ('wpa2', 'mixed'):
+            ies += rsn()
+        if c['sec'] in ('wpa', 'mixed'):
+            ies += wpa(2 if c['tkip'] else 4)
+        s += point(IWEVGENIE, ies)
+        s += point(IWEVCUSTOM, b'tsf=0000000000000000')
+    return s
+
+
+def iwlist(cs):
+    pad = ' ' * 20
+    t = 'wlan0     Scan completed :\n'
+    for i, c in enumerate(cs):
+        t += '          Cell %02d - Address: %s\n' % (
+            i + 1, ':'.join('%02X' % b for b in c['bssid']))
+        t += pad + 'Channel:%d\n' % c['ch']
+        t += pad + 'Frequency:%.3f GHz (Channel %d)\n' % (
+            freq(c['ch']) / 1000, c['ch'])
+        t += pad + 'Quality=%d/70  Signal level=%d dBm  \n' % (
+            c['q'], c['q'] - 110)
+        t += pad + 'Encryption key:%s\n' % (
+            'off' if c['sec'] == 'open' else 'on')
+        if c['ssid'] == 'HIDDEN0':
+            t += pad + 'ESSID:"%s"\n' % ('\\x00' * 7)
+        else:
+            t += pad + 'ESSID:"%s"\n' % c['ssid']
+        t += (pad + 'Bit Rates:1 Mb/s; 2 Mb/s; 5.5 Mb/s; 11 Mb/s; 18 Mb/s\n' +
+              pad + '          24 Mb/s; 36 Mb/s; 54 Mb/s\n')
+        t += (pad + 'Mode:Master\n' + pad + 'Extra:tsf=0000000000000000\n' +
+              pad + 'Extra: Last beacon: 20ms ago\n')
+        t += pad + 'IE: Unknown: 00074C6F7765\n'
+        if c['sec'] in ('wpa2', 'mixed'):
+            t += (pad + 'IE: IEEE 802.11i/WPA2 Version 1\n' +
+                  pad + '    Group Cipher : CCMP\n' +
+                  pad + '    Pairwise Ciphers (1) : CCMP\n' +
+                  pad + '    Authentication Suites (1) : PSK\n')
+        if c['sec'] in ('wpa', 'mixed'):
+            t += (pad + 'IE: WPA Version 1\n' +
+                  pad + '    Group Cipher : %s\n' % (
+                      'TKIP' if c['tkip'] else 'CCMP') +
+                  pad + '    Pairwise Ciphers (1) : TKIP\n' +
+                  pad + '    Authentication Suites (1) : PSK\n')
+    return t + '\n'
+
+
+def main():
+    out = sys.argv[1] if len(sys.argv) > 1 else '.'
+    for name, seed, n in SCANS:
+        cs = cells(seed, n)
+        with open(os.path.join(out, name + '.bin'), 'wb') as f:
+            f.write(stream(cs))
+        with open(os.path.join(out, name + '.txt'), 'w') as f:
+            f.write(iwlist(cs))
+
+
+if __name__ == '__main__':
+    main()
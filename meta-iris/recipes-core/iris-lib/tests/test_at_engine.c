@@ -0,0 +1,260 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * AT engine test - runs the engine against a scripted modem on a pty,
+ * then times the engine and atSend() on the same modem.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <termios.h>
+#include "irislib.h"
+#include "at_engine.h"
+
+#define MAX_CMDS        16
+#define URC_LOOPS       200
+#define TIMING_LOOPS    500
+#define RUN_TIMEOUT     3000
+
+static int master, hold;
+static char slave[64];
+static volatile int echo = 0;
+static int failures = 0;
+
+static int gotStatus[MAX_CMDS];
+static char got[MAX_CMDS][128];
+static int doneCount = 0;
+
+static char urcLine[128];
+static int urcCount = 0;
+static double urcSent, urcLatency;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void say(const char *s)
+{
+    write(master, s, strlen(s));
+}
+
+/* Scripted modem - answers by command, some in pieces, with URCs mixed in */
+static void *modem(void *arg)
+{
+    char buf[256];
+    int  n = 0;
+    char c;
+
+    while (read(master, &c, 1) == 1) {
+        if ((c != '\r') && (c != '\n')) {
+            if (n < (int)sizeof(buf) - 1) {
+                buf[n++] = c;
+            }
+            continue;
+        }
+        if (n == 0) {
+            continue;
+        }
+        buf[n] = '\0';
+        n = 0;
+
+        if (echo) {
+            say(buf);
+            say("\r\n");
+        }
+        if (strcmp(buf, "AT+CGSN") == 0) {
+            say("\r\n8661234");
+            usleep(2000);
+            say("56789012\r");
+            usleep(2000);
+            say("\n\r\nOK\r\n");
+        } else if (strcmp(buf, "AT+CSQ") == 0) {
+            say("\r\n+CREG: 0\r\n");
+            say("\r\n+CSQ: 16,99\r\n\r\nOK\r\n");
+        } else if (strcmp(buf, "AT^SYSINFO") == 0) {
+            say("\r\n^SYSINFO: 2,3,0,9,1\r\n\r\nOK\r\n");
+        } else if (strcmp(buf, "AT+CREG?") == 0) {
+            say("\r\n+CREG: 1,1\r\n\r\nOK\r\n");
+        } else if (strcmp(buf, "AT+BAD") == 0) {
+            say("\r\n+CME ERROR: 3\r\n");
+        } else if (strcmp(buf, "AT+HANG") == 0) {
+            // Never answers
+        } else if (strcmp(buf, "AT+ZGETICCID") == 0) {
+            say("\r\n+ZGETICCID: 89860117851024812345\r\nOK\r\n");
+        } else if (strncmp(buf, "AT", 2) == 0) {
+            say("\r\nOK\r\n");
+        }
+    }
+    return NULL;
+}
+
+static void done(int status, const char *data, void *arg)
+{
+    long i = (long)arg;
+
+    gotStatus[i] = status;
+    snprintf(got[i], sizeof(got[i]), "%s", data);
+    doneCount++;
+}
+
+static void doneCounted(int status, const char *data, void *arg)
+{
+    doneCount++;
+}
+
+static void urc(const char *line, void *arg)
+{
+    snprintf(urcLine, sizeof(urcLine), "%s", line);
+    urcCount++;
+    urcLatency = now() - urcSent;
+}
+
+static void check(int ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+/* Poll until n commands are done */
+static void run(int n)
+{
+    double end = now() + RUN_TIMEOUT;
+
+    while ((doneCount < n) && (now() < end)) {
+        atEnginePoll(100);
+    }
+}
+
+int main(void)
+{
+    struct termios tio;
+    pthread_t tid;
+    ATPort *port;
+    double t, total = 0, max = 0;
+    int i, count;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    grantpt(master);
+    unlockpt(master);
+    ptsname_r(master, slave, sizeof(slave));
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+
+    // With no slave open, reads on the master fail - keep one open over
+    // the closes, so the modem stays up
+    hold = open(slave, O_RDWR | O_NOCTTY);
+    pthread_create(&tid, NULL, modem, NULL);
+
+    atEngineInit();
+    atEngineOnUrc("+CREG:", urc, NULL);
+    atEngineOnUrc("+CGEV:", urc, NULL);
+
+    // Queued while closed - goes out on open
+    atEngineQueue("AT+CGSN\n", 2000, done, (void *)0);
+    check(atEngineOpen(slave, B115200, FLOW_CONTROL_RTSCTS) == 0, "open");
+    atEngineQueue("AT+CSQ\n", 2000, done, (void *)1);
+    atEngineQueue("AT^SYSINFO", 2000, done, (void *)2);
+    atEngineQueue("AT+CREG?", 2000, done, (void *)3);
+    atEngineQueue("AT+BAD", 2000, done, (void *)4);
+    atEngineQueue("AT+HANG", 300, done, (void *)5);
+    atEngineQueue("AT+ZGETICCID\n", 2000, done, (void *)6);
+    run(7);
+
+    check((gotStatus[0] == OK) && (strcmp(got[0], "866123456789012") == 0),
+          "split response");
+    check((gotStatus[1] == OK) && (strcmp(got[1], "+CSQ: 16,99") == 0),
+          "response");
+    check((urcCount == 1) && (strcmp(urcLine, "+CREG: 0") == 0),
+          "URC inside a response");
+    check((gotStatus[2] == OK) &&
+          (strcmp(got[2], "^SYSINFO: 2,3,0,9,1") == 0), "response prefix");
+    check((gotStatus[3] == OK) && (strcmp(got[3], "+CREG: 1,1") == 0) &&
+          (urcCount == 1), "query response is not a URC");
+    check(gotStatus[4] == ERROR, "CME error");
+    check(gotStatus[5] == AT_TIMEOUT, "timeout");
+    check((gotStatus[6] == OK) &&
+          (strstr(got[6], "89860117851024812345") != NULL), "ICCID");
+
+    echo = 1;
+    doneCount = 0;
+    atEngineQueue("AT+CSQ", 2000, done, (void *)7);
+    run(1);
+    echo = 0;
+    check((gotStatus[7] == OK) && (strcmp(got[7], "+CSQ: 16,99") == 0),
+          "echo skipped");
+
+    // A close with a command in flight fails it, and keeps the rest
+    doneCount = 0;
+    atEngineQueue("AT+HANG", 5000, done, (void *)8);
+    atEngineQueue("AT+CSQ", 2000, done, (void *)9);
+    atEnginePoll(10);
+    atEngineClose();
+    check(gotStatus[8] == AT_CLOSED, "close with a command in flight");
+    atEngineOpen(slave, B115200, 0);
+    run(2);
+    check(gotStatus[9] == OK, "queue kept over a close");
+
+    // Timings
+    for (i = 0; i < URC_LOOPS; i++) {
+        count = urcCount;
+        urcSent = now();
+        say("\r\n+CGEV: NW DETACH\r\n");
+        while (urcCount == count) {
+            atEnginePoll(100);
+        }
+        total += urcLatency;
+        if (urcLatency > max) {
+            max = urcLatency;
+        }
+    }
+    printf("URC dispatch: mean %.3f ms, max %.3f ms\n", total / URC_LOOPS, max);
+
+    t = now();
+    doneCount = 0;
+    for (i = 0; i < TIMING_LOOPS; i++) {
+        atEngineQueue("AT+CSQ", 2000, doneCounted, NULL);
+        if ((i % 10) == 9) {
+            run(i + 1);
+        }
+    }
+    printf("atEngineQueue: %.3f ms/command\n", (now() - t) / TIMING_LOOPS);
+    atEngineClose();
+
+    port = atOpen(slave, B115200, 0);
+    t = now();
+    for (i = 0; i < TIMING_LOOPS; i++) {
+        atSend(port, "AT+CSQ\n", 2);
+    }
+    printf("atSend: %.3f ms/command\n", (now() - t) / TIMING_LOOPS);
+    atClose(port);
+    close(hold);
+
+    return failures ? 1 : 0;
+}
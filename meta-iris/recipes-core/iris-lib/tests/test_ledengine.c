@@ -0,0 +1,324 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * LED engine test - runs the engine against a stand-in sysfs LED
+ * directory, times mode changes through the socket and the mode file,
+ * and checks the engine sleeps while the kernel does the blinking.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "ledengine.h"
+
+#define CHANGE_LOOPS    200
+#define IDLE_TIME       1000
+#define WAIT_TIMEOUT    2000
+
+// Worst case allowed for a mode change to reach the LEDs, and average
+#define MAX_LATENCY     50.0
+#define AVG_LATENCY     5.0
+
+// The sysfs LEDs, in engine output order
+enum { GREEN, YELLOW, RED, NUM_LEDS };
+static const char *leds[] = { "green", "yellow", "red" };
+static const char *attrs[] = { "brightness", "trigger", "delay_on",
+                               "delay_off" };
+
+static char dir[64], sockFile[96], modeFile[96];
+static int watchFd = -1;
+static int ledWd[NUM_LEDS];
+static volatile int wakeups = 0;
+static volatile int ended = 0;
+static clockid_t engineClock;
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// CPU time used by the engine thread, in ms
+static double engineCpu(void)
+{
+    struct timespec ts;
+
+    clock_gettime(engineClock, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void endedCb(const char *mode)
+{
+    ended++;
+}
+
+static void *engine(void *arg)
+{
+    while (1) {
+        ledPoll(-1);
+        wakeups++;
+    }
+    return NULL;
+}
+
+static void writeFile(const char *file, const char *data)
+{
+    FILE *f = fopen(file, "w");
+
+    if (f == NULL) {
+        printf("FAIL: unable to write %s\n", file);
+        exit(1);
+    }
+    fputs(data, f);
+    fclose(f);
+}
+
+static void readFile(const char *file, char *buf, int len)
+{
+    FILE *f = fopen(file, "r");
+
+    buf[0] = '\0';
+    if (f != NULL) {
+        if (fgets(buf, len, f) == NULL) {
+            buf[0] = '\0';
+        }
+        fclose(f);
+    }
+}
+
+static void readAttr(int led, const char *attr, char *buf, int len)
+{
+    char file[160];
+
+    snprintf(file, sizeof(file), "%s/%s/%s", dir, leds[led], attr);
+    readFile(file, buf, len);
+}
+
+static void sendMode(const char *mode)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sockFile);
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if ((fd < 0) || (sendto(fd, mode, strlen(mode), 0,
+                            (struct sockaddr *)&addr, sizeof(addr)) < 0)) {
+        printf("FAIL: unable to send %s\n", mode);
+        exit(1);
+    }
+    close(fd);
+}
+
+// Drop anything already written to the LEDs
+static void drain(void)
+{
+    char buf[4096];
+
+    while (read(watchFd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+/* Wait for the engine to write attr of an LED, returns ms from start or -1 */
+static double waitWrite(int led, const char *attr, double start)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = { watchFd, POLLIN, 0 };
+    int len, off;
+
+    while (poll(&pfd, 1, WAIT_TIMEOUT) > 0) {
+        len = read(watchFd, buf, sizeof(buf));
+        for (off = 0; off < len; ) {
+            struct inotify_event *ev = (struct inotify_event *)&buf[off];
+
+            if ((ev->wd == ledWd[led]) && (ev->len > 0) &&
+                (strcmp(ev->name, attr) == 0)) {
+                return now() - start;
+            }
+            off += sizeof(*ev) + ev->len;
+        }
+    }
+    return -1;
+}
+
+// Wait for the engine to record mode in the mode file
+static int waitModeFile(const char *mode)
+{
+    double start = now();
+    char buf[LED_MODE_LEN];
+
+    do {
+        readFile(modeFile, buf, sizeof(buf));
+        if (strcmp(buf, mode) == 0) {
+            return 1;
+        }
+        usleep(1000);
+    } while (now() - start < WAIT_TIMEOUT);
+    return 0;
+}
+
+/*
+ * Flip between two modes, one with the LED steady and one with it
+ * blinking.  The last write is brightness for steady, delay_off for
+ * blinking.
+ */
+static void timeChanges(const char *how, int useFile, int led,
+                        const char *steady, const char *blink)
+{
+    double lat, total = 0, worst = 0, cpu;
+    char what[128];
+    int i, lost = 0;
+
+    cpu = engineCpu();
+    for (i = 0; i < CHANGE_LOOPS; i++) {
+        const char *mode = (i & 1) ? blink : steady;
+        double start;
+
+        drain();
+        start = now();
+        if (useFile) {
+            writeFile(modeFile, mode);
+        } else {
+            sendMode(mode);
+        }
+        lat = waitWrite(led, (i & 1) ? "delay_off" : "brightness", start);
+        if (lat < 0) {
+            lost++;
+            continue;
+        }
+        total += lat;
+        if (lat > worst) {
+            worst = lat;
+        }
+    }
+    cpu = engineCpu() - cpu;
+
+    printf("%s: %d changes, %.3f ms average, %.3f ms worst, "
+           "%.1f us engine CPU each\n", how, CHANGE_LOOPS,
+           total / CHANGE_LOOPS, worst, cpu * 1000.0 / CHANGE_LOOPS);
+    snprintf(what, sizeof(what), "every change by %s reached the LEDs", how);
+    check(lost == 0, what);
+    snprintf(what, sizeof(what), "change by %s within %.0f ms", how,
+             MAX_LATENCY);
+    check(worst < MAX_LATENCY, what);
+    snprintf(what, sizeof(what), "change by %s %.0f ms on average", how,
+             AVG_LATENCY);
+    check(total / CHANGE_LOOPS < AVG_LATENCY, what);
+}
+
+int main(void)
+{
+    char path[160], buf[64];
+    pthread_t tid;
+    double cpu;
+    int i, j, n;
+
+    // Stand-in for /sys/class/leds
+    snprintf(dir, sizeof(dir), "/tmp/ledtest.XXXXXX");
+    if (mkdtemp(dir) == NULL) {
+        printf("FAIL: unable to create %s\n", dir);
+        return 1;
+    }
+    watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    for (i = 0; i < NUM_LEDS; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, leds[i]);
+        mkdir(path, 0755);
+        for (j = 0; j < 4; j++) {
+            snprintf(path, sizeof(path), "%s/%s/%s", dir, leds[i], attrs[j]);
+            writeFile(path, "0\n");
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, leds[i]);
+        ledWd[i] = inotify_add_watch(watchFd, path, IN_CLOSE_WRITE);
+    }
+    snprintf(sockFile, sizeof(sockFile), "%s/ledSocket", dir);
+    snprintf(modeFile, sizeof(modeFile), "%s/ledMode", dir);
+    writeFile(modeFile, "");
+
+    if ((ledInit(dir) < 0) || (ledServe(sockFile, modeFile) < 0)) {
+        printf("FAIL: unable to start the LED engine\n");
+        return 1;
+    }
+    ledSetCallback(endedCb);
+    pthread_create(&tid, NULL, engine, NULL);
+    pthread_getcpuclockid(tid, &engineClock);
+
+    sendMode("boot-post");
+    check(waitWrite(RED, "delay_off", now()) >= 0, "boot-post shown");
+    readAttr(RED, "trigger", buf, sizeof(buf));
+    check(strcmp(buf, "timer\n") == 0, "blink left to the timer trigger");
+    readAttr(RED, "delay_on", buf, sizeof(buf));
+    check(strcmp(buf, "500\n") == 0, "1Hz blink is 500ms on");
+
+    // Red is off in boot-linux, green steady in assoc-disconn
+    timeChanges("socket", 0, RED, "boot-linux", "boot-post");
+
+    // The engine notes socket modes in the mode file after the LEDs are
+    //  written, let that land before writing the file ourselves
+    check(waitModeFile("boot-post"), "mode file records boot-post");
+    timeChanges("mode file", 1, GREEN, "assoc-disconn", "boot-post");
+
+    // The kernel blinks the LEDs, the engine should not wake at all
+    usleep(100000);
+    n = wakeups;
+    cpu = engineCpu();
+    usleep(IDLE_TIME * 1000);
+    n = wakeups - n;
+    cpu = engineCpu() - cpu;
+    printf("idle: %d wakeups, %.3f ms engine CPU in %d ms\n", n, cpu,
+           IDLE_TIME);
+    check(n == 0, "no wakeups while the kernel blinks");
+
+    // A timed error mode ends and the mode under it shows again
+    sendMode("boot-linux");
+    waitWrite(RED, "brightness", now());
+    n = ended;
+    sendMode("upgrade-zigbee-err 1");
+    check(waitWrite(RED, "brightness", now()) >= 0, "error mode shown");
+    readAttr(RED, "brightness", buf, sizeof(buf));
+    check(strcmp(buf, "255\n") == 0, "error mode red on");
+    check(waitWrite(RED, "brightness", now()) >= 0, "error mode ended");
+    readAttr(RED, "brightness", buf, sizeof(buf));
+    check(strcmp(buf, "0\n") == 0, "boot-linux red off again");
+    check(waitModeFile("boot-linux"), "mode file records boot-linux");
+    check(ended == n + 1, "ended callback called");
+
+    snprintf(path, sizeof(path), "rm -rf %s", dir);
+    system(path);
+    return failures ? 1 : 0;
+}
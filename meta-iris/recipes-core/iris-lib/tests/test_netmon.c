@@ -0,0 +1,108 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Network monitor test - drives a veth pair in a network namespace of
+ * its own and checks what netmon reports.  Run with unshare -rn.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <poll.h>
+#include "netmon.h"
+
+#define WAIT_TIMEOUT    2000
+
+static int failures = 0;
+
+static void *pump(void *arg)
+{
+    struct pollfd pfd = { netmonFd(), POLLIN, 0 };
+
+    while (1) {
+        if (poll(&pfd, 1, -1) > 0) {
+            netmonProcess();
+        }
+    }
+    return NULL;
+}
+
+static void run(const char *cmd)
+{
+    if (system(cmd) != 0) {
+        printf("FAIL: %s\n", cmd);
+        exit(1);
+    }
+}
+
+static int numRoutes(void)
+{
+    NetmonRoute r[NETMON_MAX_ROUTES];
+
+    return netmonGetDefaultRoutes(r, NETMON_MAX_ROUTES);
+}
+
+/* Run cmd, then wait for the default routes netmon knows to be expected */
+static void check(const char *what, const char *cmd, int expected)
+{
+    int n;
+
+    run(cmd);
+    while (((n = numRoutes()) != expected) && netmonWait(WAIT_TIMEOUT)) {
+    }
+    printf("%s: %s (%d routes)\n", (n == expected) ? "PASS" : "FAIL", what, n);
+    if (n != expected) {
+        failures++;
+    }
+}
+
+int main(void)
+{
+    pthread_t tid;
+
+    run("ip link set lo up && "
+        "ip link add eth0 type veth peer name eth0p && "
+        "ip link set eth0 up && ip link set eth0p up && "
+        "ip addr add 10.0.0.2/24 dev eth0");
+
+    if (netmonInit() < 0) {
+        printf("FAIL: netmonInit\n");
+        return 1;
+    }
+    pthread_create(&tid, NULL, pump, NULL);
+
+    check("route added", "ip route add default via 10.0.0.1", 1);
+    check("route deleted", "ip route del default", 0);
+
+    // The kernel keeps routes on carrier loss, marked linkdown
+    check("carrier lost", "ip route add default via 10.0.0.1 && "
+          "ip link set eth0p down", 0);
+    check("carrier back", "ip link set eth0p up", 1);
+
+    // The kernel flushes routes without RTM_DELROUTE from here on
+    check("link down", "ip link set eth0 down", 0);
+    check("link up", "ip link set eth0 up && "
+          "ip route add default via 10.0.0.1", 1);
+    check("address removed", "ip addr del 10.0.0.2/24 dev eth0", 0);
+    check("address added", "ip addr add 10.0.0.2/24 dev eth0 && "
+          "ip route add default via 10.0.0.1", 1);
+    check("link deleted", "ip link del eth0", 0);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Supervisor test - supervises shell scripts standing in for daemons.
+ * One exits straight away to walk the backoff up to the crash loop
+ * hold-off, one is started here and adopted, then killed, to time how
+ * soon the pidfd reports it gone.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "supervisor.h"
+
+// Short policy so the test runs in seconds
+#define TEST_MAX_BACKOFF    2
+#define TEST_CRASH_LIMIT    3
+#define TEST_HOLD_OFF       3
+#define WAIT_TIMEOUT        10
+
+// Slowest exit detection allowed for an adopted daemon, in ms
+#define MAX_DETECT          200.0
+
+static char dir[64];
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Seconds on the supervisor's own clock
+static time_t nowSecs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+// The script name is the process name the supervisor looks for
+static void script(const char *name, const char *body, char *path, int len)
+{
+    FILE *f;
+
+    snprintf(path, len, "%s/%s", dir, name);
+    f = fopen(path, "w");
+    if (f == NULL) {
+        printf("FAIL: unable to write %s\n", path);
+        exit(1);
+    }
+    fprintf(f, "#!/bin/sh\n%s\n", body);
+    fclose(f);
+    chmod(path, 0755);
+}
+
+/* Poll the supervisor until the daemon is in state, returns ms or -1 */
+static double waitState(SupDaemon *d, int state)
+{
+    double start = now();
+
+    while (d->state != state) {
+        if (now() - start > WAIT_TIMEOUT * 1000) {
+            return -1;
+        }
+        supPoll(1);
+    }
+    return now() - start;
+}
+
+static void policy(SupDaemon *d)
+{
+    d->maxBackoff = TEST_MAX_BACKOFF;
+    d->crashLimit = TEST_CRASH_LIMIT;
+    d->holdOff = TEST_HOLD_OFF;
+}
+
+static void testBackoff(const char *path)
+{
+    SupDaemon *d = supAdd("suptest-exit", path, NULL, 0);
+    int expect[] = { SUP_MIN_BACKOFF, SUP_MIN_BACKOFF * 2, TEST_MAX_BACKOFF };
+    char what[128];
+    time_t exited;
+    double ms;
+    int i;
+
+    policy(d);
+    supStart(d);
+    check(d->state == SUP_RUNNING, "exiting daemon started");
+
+    // Each quick exit doubles the backoff, up to the maximum
+    for (i = 0; i < TEST_CRASH_LIMIT; i++) {
+        check(waitState(d, SUP_WAITING) >= 0, "exit seen");
+        exited = nowSecs();
+        snprintf(what, sizeof(what), "backoff %ds after exit %d", expect[i],
+                 i + 1);
+        check(d->backoff == expect[i], what);
+
+        ms = waitState(d, SUP_RUNNING);
+        printf("restart %d after %.0f ms\n", i + 1, ms);
+        snprintf(what, sizeof(what), "restart %d not before the backoff",
+                 i + 1);
+        check((ms >= 0) && (nowSecs() - exited >= expect[i]), what);
+        snprintf(what, sizeof(what), "restart %d when the backoff is over",
+                 i + 1);
+        check((ms >= 0) && (ms < (expect[i] + 1) * 1000), what);
+        check(d->restarts == i + 1, "restart counted");
+    }
+
+    // One exit too many in the window holds it off
+    check(waitState(d, SUP_FAILED) >= 0, "crash loop seen");
+    exited = nowSecs();
+    check(d->crashLoops == 1, "crash loop counted");
+    check(d->restartTime - exited == TEST_HOLD_OFF, "held off");
+    ms = waitState(d, SUP_RUNNING);
+    printf("restart after crash loop after %.0f ms\n", ms);
+    check((ms >= 0) && (nowSecs() - exited >= TEST_HOLD_OFF),
+          "not restarted during the hold-off");
+    check(d->backoff == SUP_MIN_BACKOFF, "backoff reset by the hold-off");
+
+    // Leave it held off for the rest of the test
+    d->holdOff = 1000;
+    d->crashLimit = 0;
+    check(waitState(d, SUP_FAILED) >= 0, "exiting daemon stopped");
+}
+
+static void testAdopted(const char *path)
+{
+    SupDaemon *d;
+    double start, ms;
+    pid_t pid;
+
+    // Started by someone else before the supervisor looks
+    pid = fork();
+    if (pid == 0) {
+        setpgid(0, 0);
+        execl(path, "suptest-adopt", NULL);
+        _exit(127);
+    }
+    usleep(100000);
+
+    d = supAdd("suptest-adopt", path, NULL, 0);
+    policy(d);
+    supStart(d);
+    check(d->adopted && (d->pid == pid), "running copy adopted");
+    check(d->pidfd >= 0, "adopted daemon watched through a pidfd");
+
+    // Nothing to report while it runs
+    supPoll(1);
+    check(d->state == SUP_RUNNING, "adopted daemon still running");
+
+    kill(-pid, SIGTERM);
+    start = now();
+    while ((d->state == SUP_RUNNING) &&
+           (now() - start < WAIT_TIMEOUT * 1000)) {
+        supPoll(WAIT_TIMEOUT);
+    }
+    ms = now() - start;
+    printf("adopted exit seen after %.3f ms (check period %ds)\n", ms,
+           SUP_CHECK_PERIOD);
+    check(d->state == SUP_WAITING, "adopted daemon exit seen");
+    check(ms < MAX_DETECT, "adopted daemon exit seen at once");
+
+    // It comes back as a daemon of our own
+    check(waitState(d, SUP_RUNNING) >= 0, "adopted daemon restarted");
+    check(!d->adopted && (d->restarts == 1), "restarted as our own");
+
+    // Stop it for good, once it is in a process group of its own
+    d->crashLimit = 0;
+    d->holdOff = 1000;
+    usleep(100000);
+    kill(-d->pid, SIGTERM);
+    check(waitState(d, SUP_FAILED) >= 0, "adopted daemon stopped");
+}
+
+int main(void)
+{
+    char exitPath[128], adoptPath[128], cmd[96];
+
+    snprintf(dir, sizeof(dir), "/tmp/suptest.XXXXXX");
+    if (mkdtemp(dir) == NULL) {
+        printf("FAIL: unable to create %s\n", dir);
+        return 1;
+    }
+    script("suptest-exit", "exit 1", exitPath, sizeof(exitPath));
+    script("suptest-adopt", "sleep 30", adoptPath, sizeof(adoptPath));
+
+    if (supInit() < 0) {
+        printf("FAIL: unable to start the supervisor\n");
+        return 1;
+    }
+    testAdopted(adoptPath);
+    testBackoff(exitPath);
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2019 Arcus Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Wifi scan test - runs wifiScan() against a fake driver that returns a
+ * canned event stream, and prints the results as wifi_scan does.  The
+ * driver is busy for a few polls first, and the stream is larger than the
+ * first buffer wifiscan tries for all but the small scans.
+ *
+ * wifiscan.c is built with ioctl renamed to testIoctl.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <time.h>
+#include <linux/wireless.h>
+#include "wifiscan.h"
+
+#define SCAN_BUSY_POLLS     3
+#define SCAN_MAX_SIZE       65536
+#define PARSE_LOOPS         10000
+
+static char scan[SCAN_MAX_SIZE];
+static int scanLen;
+static int busy = SCAN_BUSY_POLLS;
+
+int testIoctl(int fd, unsigned long request, ...)
+{
+    struct iwreq *wrq;
+    va_list ap;
+
+    va_start(ap, request);
+    wrq = va_arg(ap, struct iwreq *);
+    va_end(ap);
+
+    switch (request) {
+    case SIOCSIWSCAN:
+        return 0;
+    case SIOCGIWRANGE:
+        ((struct iw_range *)wrq->u.data.pointer)->max_qual.qual = 70;
+        return 0;
+    case SIOCGIWSCAN:
+        if (busy > 0) {
+            busy--;
+            errno = EAGAIN;
+            return -1;
+        }
+        if (wrq->u.data.length < scanLen) {
+            errno = E2BIG;
+            return -1;
+        }
+        memcpy(wrq->u.data.pointer, scan, scanLen);
+        wrq->u.data.length = scanLen;
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Time parsing the stream, and formatting what it holds */
+static void bench(const char *name)
+{
+    WifiScanResult results[WIFI_SCAN_MAX_RESULTS];
+    char data[WIFI_SCAN_JSON_LEN];
+    double t;
+    int i, j, count = 0;
+
+    t = now();
+    for (i = 0; i < PARSE_LOOPS; i++) {
+        count = wifiScanParse(scan, scanLen, 70, results,
+                              WIFI_SCAN_MAX_RESULTS);
+    }
+    printf("%s: %d results, parse %.2f us", name, count,
+           (now() - t) * 1e3 / PARSE_LOOPS);
+
+    t = now();
+    for (i = 0; i < PARSE_LOOPS; i++) {
+        for (j = 0; j < count; j++) {
+            wifiScanFormat(&results[j], 1, data, sizeof(data));
+        }
+    }
+    printf(", format %.2f us\n", (now() - t) * 1e3 / PARSE_LOOPS);
+}
+
+int main(int argc, char **argv)
+{
+    WifiScanResult results[WIFI_SCAN_MAX_RESULTS];
+    char data[WIFI_SCAN_JSON_LEN];
+    int c, i, count, truncate = 0, timing = 0;
+    FILE *f;
+
+    while ((c = getopt(argc, argv, "bt")) != -1) {
+        switch (c) {
+        case 'b':
+            timing = 1;
+            break;
+        case 't':
+            truncate = 1;
+            break;
+        default:
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-b] [-t] scan.bin\n", argv[0]);
+        return 1;
+    }
+
+    f = fopen(argv[optind], "rb");
+    if (f == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    scanLen = fread(scan, 1, sizeof(scan), f);
+    fclose(f);
+
+    if (timing) {
+        bench(argv[optind]);
+        return 0;
+    }
+
+    count = wifiScan("wlan0", results, WIFI_SCAN_MAX_RESULTS, 1000);
+    if (count < 0) {
+        perror("wifiScan");
+        return 1;
+    }
+    fprintf(stdout, "{\"scanresults\":\n[");
+    for (i = 0; i < count; i++) {
+        wifiScanFormat(&results[i], truncate, data, sizeof(data));
+        fprintf(stdout, "%s%s", i ? "," : "", data);
+    }
+    fprintf(stdout, "]}\n");
+    return 0;
+}
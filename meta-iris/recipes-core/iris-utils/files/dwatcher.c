@@ -20,13 +20,14 @@
 #include <string.h>
 #include <syslog.h>
 #include <irislib.h>
+#include <supervisor.h>
 
 
 // Syslog name
 #define SYSLOG_IDENT               "dwatcher"
 
 // Check delays
-#define CHECK_PERIOD               5
+#define STATUS_PERIOD              30
 #define INIT_DELAY                 60
 
 // Daemons we care about
@@ -34,84 +35,68 @@
 #define BATTERYD_PROCESS_NAME      "batteryd"
 #define IRIS4GD_PROCESS_NAME       "iris4gd"
 #define IRISNFCD_PROCESS_NAME      "irisnfcd"
+#define IRISINITD_PATH             "/usr/bin/irisinitd"
+#define BATTERYD_PATH              "/usr/bin/batteryd"
 #define IRIS4GD_PATH               "/usr/bin/iris4gd"
 #define IRISNFCD_PATH              "/usr/bin/irisnfcd"
 
 
-static int checkProcess(char *process)
+static void watch(char *process, char *path, char *restartArg)
 {
-    FILE *f;
-    char cmd[256];
-    char line[128];
-    int  res = 0;
-
-    snprintf(cmd, sizeof(cmd), "pidof %s", process);
-    f = popen(cmd, "r");
-    if (f) {
-        // Is process running?
-        if (fgets(line, sizeof(line), f) != NULL) {
-            res = 1;
-        }
-        pclose(f);
+    SupDaemon *d;
+
+    d = supAdd(process, path, restartArg, SUP_DAEMONIZES);
+    if ((d == NULL) || (supStart(d) < 0)) {
+        syslog(LOG_ERR, "Unable to watch %s!", process);
     }
-    return res;
 }
 
 
-// Simple watcher to see if any of our daemons are no longer running
+// Simple watcher to restart any of our daemons that are no longer running
 int main(int argc, char** argv)
 {
-    char cmd[128];
-
     // Turn ourselves into a daemon
     daemon(1, 1);
 
     // Setup syslog
     openlog(SYSLOG_IDENT, (LOG_CONS | LOG_PID | LOG_PERROR), LOG_DAEMON);
 
+    // Catch exits of the daemons we start
+    if (supInit() < 0) {
+        return 1;
+    }
+
     // Wait for the system to settle before checking
     sleep(INIT_DELAY);
 
-    // Checked forever...
-    while (1) {
-
-        // Sleep between checks
-        sleep(CHECK_PERIOD);
+    // Make sure our init daemon is running!
+    watch(IRISINITD_PROCESS_NAME, IRISINITD_PATH, "restart");
 
-        // Make sure our init daemon is running!
-        if (!checkProcess(IRISINITD_PROCESS_NAME)) {
-            syslog(LOG_INFO, "Restarting Iris init daemon...");
-            snprintf(cmd, sizeof(cmd), "%s restart", IRISINITD_PROCESS_NAME);
-            system(cmd);
-        }
+    // For release image, check for other daemons...
+    if (IRIS_isReleaseImage()) {
 
-        // For release image, check for other daemons...
-        if (IRIS_isReleaseImage()) {
+        // Battery daemon
+        watch(BATTERYD_PROCESS_NAME, BATTERYD_PATH, NULL);
 
-            // Battery daemon
-            if (!checkProcess(BATTERYD_PROCESS_NAME)) {
-                syslog(LOG_INFO, "Restarting battery daemon...");
-                system(BATTERYD_PROCESS_NAME);
-            }
-
-            // 4G daemon
-            if ((access(IRIS4GD_PATH, F_OK) != -1) &&
-		!checkProcess(IRIS4GD_PROCESS_NAME)) {
-                syslog(LOG_INFO, "Restarting 4G daemon...");
-                system(IRIS4GD_PROCESS_NAME);
-            }
+        // 4G daemon
+        if (access(IRIS4GD_PATH, F_OK) != -1) {
+            watch(IRIS4GD_PROCESS_NAME, IRIS4GD_PATH, NULL);
+        }
 
 #ifdef imxdimagic
 #ifdef LATER
-            // NFC daemon - not supported yet...
-            if ((access(IRISNFCD_PATH, F_OK) != -1) &&
-		!checkProcess(IRISNFCD_PROCESS_NAME)) {
-                syslog(LOG_INFO, "Restarting NFC daemon...");
-                system(IRISNFCD_PROCESS_NAME);
-            }
+        // NFC daemon - not supported yet...
+        if (access(IRISNFCD_PATH, F_OK) != -1) {
+            watch(IRISNFCD_PROCESS_NAME, IRISNFCD_PATH, NULL);
+        }
 #endif
 #endif
-        }
+    }
+
+    // Restart them as soon as they exit, forever...
+    while (1) {
+        supPoll(STATUS_PERIOD);
+        supWriteStatus(DAEMON_STATUS_FILE);
     }
 
     // Should never get here...
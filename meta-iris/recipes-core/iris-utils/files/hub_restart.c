@@ -20,6 +20,7 @@
 #include <string.h>
 #include <errno.h>
 #include <irisdefs.h>
+#include <ledengine.h>
 
 static void usage(char *name)
 {
@@ -64,11 +65,13 @@ int main(int argc, char** argv)
         fprintf(stdout, "Restarting hub in %d seconds...\n", delay);
     }
 
-    // Change LEDs to indicate shutdown in process - call utility
-    //  directly as there is not enough time to write to ledMode file
-    //  if a delay is not given!
-    snprintf(cmd, sizeof(cmd), "%s shutdown", LED_CTRL_APP);
-    system(cmd);
+    // Change LEDs to indicate shutdown in process - tell the LED engine,
+    //  or call utility directly as there is not enough time to write to
+    //  ledMode file if a delay is not given!
+    if (ledSendMode("shutdown") < 0) {
+        snprintf(cmd, sizeof(cmd), "%s shutdown", LED_CTRL_APP);
+        system(cmd);
+    }
 
     // Delay first
     if (delay) {
@@ -82,8 +85,10 @@ int main(int argc, char** argv)
     }
 
     // Then turn on boot LEDs so ring isn't dark!
-    snprintf(cmd, sizeof(cmd), "%s boot-linux", LED_CTRL_APP);
-    system(cmd);
+    if (ledSendMode("boot-linux") < 0) {
+        snprintf(cmd, sizeof(cmd), "%s boot-linux", LED_CTRL_APP);
+        system(cmd);
+    }
 #endif
 
     // Reboot
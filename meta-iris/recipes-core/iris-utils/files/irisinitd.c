@@ -30,6 +30,8 @@
 #include <sys/inotify.h>
 #include <semaphore.h>
 #include <irislib.h>
+#include <ledengine.h>
+#include <netmon.h>
 #include <stropts.h>
 #include <linux/watchdog.h>
 
@@ -82,9 +84,6 @@
 // How long the Iris button needs to be held to reenter BLE provisioning (in ms)
 #define BLE_REENTER_PERIOD        5000
 
-// How often to do a wifi scan (in seconds)
-#define WIFI_SCAN_PERIOD          60
-
 // Audio files - part of agent install for now
 #define WIFI_SUCCESS_VOICE  "/data/agent/conf/voice/ConnectedWiFi.mp3"
 #define WIFI_FAILURE_VOICE  "/data/agent/conf/voice/WiFiConnectIssue.mp3"
@@ -111,7 +110,6 @@
 #define ZIGBEE_FIRMWARE          "zigbee-firmware-hwflow.bin"
 
 static GIOChannel* buttonChannel;
-static char last_led_mode[128] = { "boot-linux" };
 static sem_t led_sem;
 static int ssh_access = -1;
 static int button_push = 0;
@@ -142,14 +140,10 @@ static time_t pwrDownTime = 0;
 #define POWER_DOWN_PERIOD   10
 #endif
 
-/* Set LED mode file */
+/* Set LED mode - through the LED engine once it is running */
 static void setLedMode(char *mode)
 {
-    char cmd[128];
-
-    // Don't add a new line to the data in this file!
-    snprintf(cmd, sizeof(cmd), "echo -n %s > %s", mode, LED_MODE_FILE);
-    system(cmd);
+    IRIS_setLedMode(mode);
 }
 
 /* Simple alarm handler - if button is still pushed, reboot system */
@@ -697,6 +691,23 @@ static gboolean ifplugdWatchdog(gpointer data)
     return TRUE;
 }
 
+/* Network change reported by the network monitor */
+static void networkChanged(const char *intf, int changes, void *data)
+{
+    /* Cable plugged in - ifplugd has to be there to get an address */
+    if ((strcmp(intf, ETH_IF) == 0) && (changes & NETMON_LINK) &&
+        IRIS_isIntfConnected(ETH_IF)) {
+        ifplugdWatchdog(NULL);
+    }
+}
+
+static gboolean networkHandler(GIOChannel *channel, GIOCondition cond,
+                               gpointer data)
+{
+    netmonProcess();
+    return TRUE;
+}
+
 /* Poke watchdog */
 static gboolean hwWatchdog(gpointer data)
 {
@@ -705,104 +716,37 @@ static gboolean hwWatchdog(gpointer data)
     return TRUE;
 }
 
-/* Simple led handler thread - call "ledctrl" utility to handle
-   updates to ledMode file */
-static void *ledThreadHandler(void *ptr)
+/* Error modes during bootloader, kernel or rootfs upgrades are shown for
+   a while, then require a reboot! */
+static void ledModeEnded(const char *mode)
 {
-    FILE *f;
-    int  fd;
-    char buf[512];
-    int  len;
-
-    /* We want to be notified when the LED mode file is changed */
-    fd = inotify_init();
-    if (fd >= 0) {
-
-        /* Add ledMode file to watch list */
-        inotify_add_watch(fd, LED_MODE_FILE, IN_MODIFY);
-
-	/* We are ready for file changes */
-	sem_post(&led_sem);
-
-        /* Keep looking for file modifications... */
-        while (1) {
-
-            /* Read inotify fd to get events */
-            len = read(fd, buf, sizeof(buf));
-            if (len >= 0) {
-                int i;
-
-                /* Parse events, looking for modify events ... */
-                i = 0;
-                while (i < len) {
-                    struct inotify_event *event =
-		      (struct inotify_event *)&buf[i];
-
-                    /* Got a file modification event */
-                    if (event->mask & IN_MODIFY) {
-
-                        /* Open ledMode file */
-                        f = fopen(LED_MODE_FILE, "r");
-                        if (f != NULL) {
-                            char data[128];
-                            char cmd[128];
-
-                            /* Read data from ledMode file */
-                            memset(data, 0, sizeof(data));
-                            if (fread(data, 1, sizeof(data)-1, f) <= 0) {
-                                /* Try again */
-                                i += (sizeof(struct inotify_event)) +
-                                  event->len;
-
-                                /* Close ledMode file */
-                                fclose(f);
-                                continue;
-                            }
+    if ((strstr(mode, "-err") != NULL) &&
+        ((strstr(mode, "boot") != NULL) ||
+         (strstr(mode, "kernel") != NULL) ||
+         (strstr(mode, "root") != NULL))) {
+        /* In the background, so the engine can show the shutdown */
+        system("hub_restart now &");
+    }
+}
 
-                            /* Removing trailing \n */
-                            if (data[strlen(data) - 1] == '\n') {
-                                data[strlen(data) - 1] = '\0';
-                            }
+/* LED handler thread - runs the LED engine, which takes new modes from
+   the LED socket and from updates to the ledMode file */
+static void *ledThreadHandler(void *ptr)
+{
+    if ((ledInit(NULL) < 0) ||
+        (ledServe(LED_SOCKET_FILE, LED_MODE_FILE) < 0)) {
+        syslog(LOG_ERR, "Unable to start LED engine!");
+        sem_post(&led_sem);
+        return NULL;
+    }
+    ledSetCallback(ledModeEnded);
 
-                            /* Update LED mode */
-                            snprintf(cmd, sizeof(cmd) - 1, "%s %s",
-				     LED_CTRL_APP, data);
-                            system(cmd);
+    /* We are ready for mode changes */
+    sem_post(&led_sem);
 
-                            /* Close ledMode file */
-                            fclose(f);
-
-                            /* Handle error cases - need to flash LEDs for a
-			       short period and perhaps reboot afterwards */
-                            if (strstr(data, "-err") != NULL) {
-
-                                /* Errors during bootloader, kernel or rootfs
-                                   require a reboot! */
-                                if ((strstr(data, "boot") != NULL) ||
-                                    (strstr(data, "kernel") != NULL) ||
-                                    (strstr(data, "root") != NULL)) {
-                                    /* Wait for 10 seconds then reboot */
-                                    sleep(10);
-                                    system("hub_restart now");
-                                } else {
-                                    /* Wait for 3 seconds then go back to
-				       last led Mode */
-                                    sleep(3);
-                                    snprintf(cmd, sizeof(cmd) - 1, "%s %s",
-                                             LED_CTRL_APP, last_led_mode);
-                                    system(cmd);
-                                }
-                            } else {
-                                /* Update last mode */
-                                strncpy(last_led_mode, data,
-					sizeof(last_led_mode));
-                            }
-                        }
-                    }
-                    i += (sizeof(struct inotify_event)) + event->len;
-                }
-            }
-        }
+    /* Error modes time out and restore the previous mode by themselves */
+    while (1) {
+        ledPoll(-1);
     }
     return NULL;
 }
@@ -866,10 +810,16 @@ static int checkConnection(void)
 {
     char cmd[256];
     FILE *f;
-    int count = 0;
+    time_t endTime = time(NULL) + INTERNET_CHECK_PERIOD;
 
     // Check connection via DNS test - Wait at most 60 seconds!
-    while (count++ < INTERNET_CHECK_PERIOD) {
+    while (time(NULL) < endTime) {
+        // No point in a DNS lookup without a way out - wait for a route
+        if (netmonGetDefaultRoutes(NULL, 0) == 0) {
+            netmonWait(1000);
+            continue;
+        }
+
         snprintf(cmd, sizeof(cmd), "nslookup %s", TEST_RESOLVE_HOST);
         f = popen(cmd, "r");
         if (f) {
@@ -926,7 +876,7 @@ static int checkConnection(void)
             }
             pclose(f);
         }
-        sleep(1);
+        netmonWait(1000);
     }
     return 0;
 }
@@ -992,14 +942,19 @@ static void *provisioningThreadHandler(void *ptr)
     int atInit = (int)ptr;
     char cmd[128];
     char line[256];
-    time_t last_scan;
+    time_t last_check;
     FILE *f;
     time_t restartTime = 0;
+    int changed;
 
     // If we are running at hub init, do a few checks first
     if (atInit) {
-        // Sleep a bit to start to wait for networks to come up
-        sleep(PROV_INIT_DELAY);
+        // Wait a bit for networks to come up - done early if Ethernet
+        //  gets an address
+        last_check = time(NULL) + PROV_INIT_DELAY;
+        while ((time(NULL) < last_check) && !IRIS_isIntfIPUp(ETH_IF)) {
+            netmonWait((last_check - time(NULL)) * 1000);
+        }
 
         // If already provisioned, may need to bring up wifi if Ethernet not up
         if (access(PROVISIONED_FILE, F_OK) != -1) {
@@ -1074,12 +1029,7 @@ static void *provisioningThreadHandler(void *ptr)
         setLedMode("first-bootup 300");
     }
 
-    // Scan wifi network
-    snprintf(cmd, sizeof(cmd), "%s > %s", WIFI_SCAN_CMD, WIFI_SCAN_FILE);
-    system(cmd);
-    last_scan = time(NULL);
-
-    // Start BLE provisioning daemon
+    // Start BLE provisioning daemon - it scans for wifi networks itself
  start_prov:
     snprintf(cmd, sizeof(cmd), "%s&", WIFI_PROV_DAEMON);
     if (system(cmd)) {
@@ -1090,13 +1040,21 @@ static void *provisioningThreadHandler(void *ptr)
 
     // Set initial wifi status
     updateWifiStatus(DISCONNECTED);
+    last_check = time(NULL);
 
     // Check status
     while (!done && !(!atInit &&
                       (time(NULL) > (restartTime + BLE_RESTART_PERIOD)))) {
 
-        // Delay before another check
-        sleep(WIFI_STATUS_DELAY);
+        // Delay before another check - network changes end it early
+        changed = 0;
+        if (time(NULL) < (last_check + WIFI_STATUS_DELAY)) {
+            changed = netmonWait((last_check + WIFI_STATUS_DELAY -
+                                  time(NULL)) * 1000);
+        }
+        if (!changed) {
+            last_check = time(NULL);
+        }
 
         // If we are restarting BLE provisioning, need to poke watchdog
         //  in case it was started by agent
@@ -1111,14 +1069,6 @@ static void *provisioningThreadHandler(void *ptr)
             }
         }
 
-        // Rescan wifi network periodically
-        if ((last_scan + WIFI_SCAN_PERIOD) < time(NULL)) {
-            snprintf(cmd, sizeof(cmd), "%s > %s", WIFI_SCAN_CMD,
-                     WIFI_SCAN_FILE);
-            system(cmd);
-            last_scan = time(NULL);
-        }
-
         // Run state machine
         switch (lastWifiStatus) {
         case DISCONNECTED:
@@ -1162,7 +1112,7 @@ static void *provisioningThreadHandler(void *ptr)
                 } else {
                     updateWifiStatus(NO_INTERNET);
                 }
-            } else {
+            } else if (!changed) {
 
                 // If SSID is too small or too large, declare error
                 //  removed check against scan data as this data is a
@@ -1447,7 +1397,16 @@ int main(int argc, char** argv)
     /* Setup syslog */
     openlog(SYSLOG_IDENT, (LOG_CONS | LOG_PID | LOG_PERROR), LOG_DAEMON);
 
-    /* Create semaphore to wait for inotify code to be ready */
+    /* Keep track of network state - lookups and waits in the threads below
+       use it */
+    if (netmonInit() == 0) {
+        GIOChannel *channel = g_io_channel_unix_new(netmonFd());
+
+        netmonSubscribe(networkChanged, NULL);
+        g_io_add_watch(channel, G_IO_IN, networkHandler, (gpointer)0);
+    }
+
+    /* Create semaphore to wait for LED engine to be ready */
     sem_init(&led_sem, 0, 0);
 
     /* Create LED handler thread - may need to sleep for some actions */
@@ -1570,7 +1529,7 @@ int main(int argc, char** argv)
     }
 #endif
 
-    /* Wait or inotify support to be ready */
+    /* Wait for LED engine to be ready */
     sem_wait(&led_sem);
 
     /* For manufacturing, start with all LEDs off to avoid confusion
@@ -24,6 +24,13 @@
 extern "C" {
 #endif
 
+/*
+ * A raw frame starts with these two bytes, followed by the big endian
+ * length of the rest of the frame: the newtmgr packet and its CRC32.
+ */
+#define BOOT_SERIAL_RAW_START1  6
+#define BOOT_SERIAL_RAW_START2  11
+
 /*
  * Start processing newtmgr commands for uploading image0 over serial.
  *
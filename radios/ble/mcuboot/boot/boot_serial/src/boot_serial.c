@@ -18,6 +18,7 @@
  */
 #include <assert.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include <inttypes.h>
 #include <ctype.h>
 #include <stdio.h>
@@ -37,6 +38,7 @@
 #include <base64.h>
 #include <cbor.h>
 #else
+#include <syscfg/syscfg.h>
 #include <bsp/bsp.h>
 #include <hal/hal_system.h>
 #include <os/endian.h>
@@ -60,7 +62,23 @@
 #include "boot_serial/boot_serial.h"
 #include "boot_serial_priv.h"
 
-#define BOOT_SERIAL_OUT_MAX	48
+#define BOOT_SERIAL_OUT_MAX	128
+
+#ifdef __ZEPHYR__
+#define BOOT_SERIAL_CHUNK_MAX       CONFIG_BOOT_MAX_LINE_INPUT_LEN
+#define BOOT_SERIAL_IN_BUFS         CONFIG_BOOT_SERIAL_LINE_BUFS
+#define BOOT_SERIAL_WRITE_BUF_SIZE  CONFIG_BOOT_SERIAL_WRITE_BUF_SIZE
+#ifdef CONFIG_BOOT_SERIAL_RAW
+#define BOOT_SERIAL_RAW             1
+#endif
+#else
+#define BOOT_SERIAL_CHUNK_MAX       400
+#define BOOT_SERIAL_IN_BUFS         1
+#define BOOT_SERIAL_WRITE_BUF_SIZE  MYNEWT_VAL(BOOT_SERIAL_WRITE_BUF_SIZE)
+#if MYNEWT_VAL(BOOT_SERIAL_RAW)
+#define BOOT_SERIAL_RAW             1
+#endif
+#endif /* __ZEPHYR__ */
 
 #ifdef __ZEPHYR__
 /* base64 lib encodes data to null-terminated string */
@@ -78,7 +96,28 @@ static char dec_buf[CONFIG_BOOT_MAX_LINE_INPUT_LEN + 1];
 
 static uint32_t curr_off;
 static uint32_t img_size;
+static int bs_slot;
 static struct nmgr_hdr *bs_hdr;
+static int bs_max_input = BOOT_SERIAL_CHUNK_MAX;
+
+/*
+ * Set once an upload chunk arrived at the wrong offset and the host was
+ * told where to resume; the rest of its window is dropped silently.
+ */
+static bool bs_resync;
+
+static uint8_t bs_img_data[BOOT_SERIAL_CHUNK_MAX];
+
+#if BOOT_SERIAL_WRITE_BUF_SIZE > 0
+/*
+ * Upload data is gathered here and written to flash one buffer at a time.
+ * It belongs at bs_wbuf_off in the slot, and curr_off is always
+ * bs_wbuf_off + bs_wbuf_len.
+ */
+static uint8_t bs_wbuf[BOOT_SERIAL_WRITE_BUF_SIZE];
+static uint32_t bs_wbuf_off;
+static uint32_t bs_wbuf_len;
+#endif
 
 static char bs_obuf[BOOT_SERIAL_OUT_MAX];
 
@@ -95,6 +134,9 @@ static CborEncoder bs_rsp;
 int
 bs_cbor_writer(struct cbor_encoder_writer *cew, const char *data, int len)
 {
+    if (cew->bytes_written + len > sizeof(bs_obuf)) {
+        return CborErrorOutOfMemory;
+    }
     memcpy(&bs_obuf[cew->bytes_written], data, len);
     cew->bytes_written += len;
 
@@ -177,8 +219,95 @@ bs_list(char *buf, int len)
     boot_serial_output();
 }
 
+#if BOOT_SERIAL_WRITE_BUF_SIZE > 0
+/*
+ * Writes out the buffered upload data.  Only the end of the image can leave
+ * the buffer partly filled; it is padded to the flash alignment then.
+ */
+static int
+bs_flush(const struct flash_area *fap)
+{
+    uint32_t len;
+    uint8_t align;
+    int rc;
+
+    len = bs_wbuf_len;
+    if (len == 0) {
+        return 0;
+    }
+
+    align = flash_area_align(fap);
+    while (len % align) {
+        bs_wbuf[len++] = 0xff;
+    }
+
+    rc = flash_area_write(fap, bs_wbuf_off, bs_wbuf, len);
+    bs_wbuf_off += bs_wbuf_len;
+    bs_wbuf_len = 0;
+
+    return rc;
+}
+#endif
+
+/*
+ * Stores a chunk of the image at curr_off and advances it.  Returns the
+ * number of bytes consumed, which is less than len when flash writes go
+ * straight through and the chunk does not end on a write alignment.
+ */
+static int
+bs_write(const struct flash_area *fap, const uint8_t *data, uint32_t len)
+{
+#if BOOT_SERIAL_WRITE_BUF_SIZE > 0
+    uint32_t total;
+    uint32_t n;
+    int rc;
+
+    total = len;
+    while (len) {
+        n = min(len, sizeof(bs_wbuf) - bs_wbuf_len);
+        memcpy(&bs_wbuf[bs_wbuf_len], data, n);
+        bs_wbuf_len += n;
+        curr_off += n;
+        data += n;
+        len -= n;
+
+        if (bs_wbuf_len == sizeof(bs_wbuf) || curr_off >= img_size) {
+            rc = bs_flush(fap);
+            if (rc) {
+                return -1;
+            }
+        }
+    }
+
+    return total;
+#else
+    uint8_t rem_bytes;
+    int rc;
+
+    if (curr_off + len < img_size) {
+        rem_bytes = len % flash_area_align(fap);
+        if (rem_bytes) {
+            len -= rem_bytes;
+        }
+    }
+    rc = flash_area_write(fap, curr_off, data, len);
+    if (rc) {
+        return -1;
+    }
+    curr_off += len;
+
+    return len;
+#endif
+}
+
 /*
  * Image upload request.
+ *
+ * A chunk with "ack" set to false is not answered unless something went
+ * wrong, so a host can send a window of chunks and only wait for the reply
+ * to the last one.  A chunk that does not start at the current offset gets
+ * an answer with the offset to resume from, and the chunks following it
+ * in the same window are dropped without one.
  */
 /* IRIS CHANGE */
 #if 1
@@ -188,19 +317,18 @@ bs_upload(char *buf, int len)
     CborParser parser;
     CborValue map;
     CborValue value;
-    uint8_t img_data[400];
     long long unsigned int off = UINT_MAX;
     size_t img_blen = 0;
-    uint8_t rem_bytes;
-    int slot = 0;
+    int slot = bs_slot;
     long long unsigned int data_len = UINT_MAX;
     const struct flash_area *fap = NULL;
+    bool ack = true;
     int rc;
 
-    memset(img_data, 0, sizeof(img_data));
     rc = cbor_parser_init(buf, len, 0, &parser, &map);
     if (!rc) {
-        if (cbor_value_map_find_value(&map, "off", &value) == 0) {
+        if (cbor_value_map_find_value(&map, "off", &value) == 0 &&
+            cbor_value_is_unsigned_integer(&value)) {
             rc = cbor_value_get_uint64(&value, &off);
             if (rc) {
                 rc = 10;
@@ -211,7 +339,8 @@ bs_upload(char *buf, int len)
             goto out;
         }
         // Len is only provided when off=0
-        if (cbor_value_map_find_value(&map, "len", &value) == 0) {
+        if (cbor_value_map_find_value(&map, "len", &value) == 0 &&
+            cbor_value_is_unsigned_integer(&value)) {
             rc = cbor_value_get_uint64(&value, &data_len);
             if (rc) {
                 rc = 11;
@@ -226,9 +355,15 @@ bs_upload(char *buf, int len)
             }
             data_len &= 0x00FFFFFF;
         }
-        if (cbor_value_map_find_value(&map, "data", &value) == 0) {
-            img_blen = sizeof(img_data);
-            rc = cbor_value_copy_byte_string(&value, img_data, &img_blen, NULL);
+        if (cbor_value_map_find_value(&map, "ack", &value) == 0 &&
+            cbor_value_is_boolean(&value)) {
+            cbor_value_get_boolean(&value, &ack);
+        }
+        if (cbor_value_map_find_value(&map, "data", &value) == 0 &&
+            cbor_value_is_byte_string(&value)) {
+            img_blen = sizeof(bs_img_data);
+            rc = cbor_value_copy_byte_string(&value, bs_img_data, &img_blen,
+                                             NULL);
             if (rc) {
                 rc = 12;
                 goto out;
@@ -251,6 +386,12 @@ bs_upload(char *buf, int len)
 
     if (off == 0) {
         curr_off = 0;
+        bs_slot = slot;
+        bs_resync = false;
+#if BOOT_SERIAL_WRITE_BUF_SIZE > 0
+        bs_wbuf_off = 0;
+        bs_wbuf_len = 0;
+#endif
         if (data_len > fap->fa_size) {
             rc = MGMT_ERR_EINVAL;
             goto out;
@@ -263,28 +404,35 @@ bs_upload(char *buf, int len)
         img_size = data_len;
     }
     if (off != curr_off) {
+        if (bs_resync) {
+            /* The host was already told where to resume. */
+            flash_area_close(fap);
+            return;
+        }
+        bs_resync = true;
         rc = 33;
         goto out;
     }
-    if (curr_off + img_blen < img_size) {
-        rem_bytes = img_blen % flash_area_align(fap);
-        if (rem_bytes) {
-            img_blen -= rem_bytes;
-        }
-    }
-    rc = flash_area_write(fap, curr_off, img_data, img_blen);
-    if (rc) {
+    bs_resync = false;
+
+    rc = bs_write(fap, bs_img_data, img_blen);
+    if (rc < 0) {
         rc = MGMT_ERR_EINVAL;
         goto out;
     }
-    curr_off += img_blen;
+    rc = 0;
+
+    if (!ack) {
+        flash_area_close(fap);
+        return;
+    }
 
 out:
     BOOT_LOG_INF("RX: 0x%x", rc);
     cbor_encoder_create_map(&bs_root, &bs_rsp, CborIndefiniteLength);
     cbor_encode_text_stringz(&bs_rsp, "rc");
     cbor_encode_int(&bs_rsp, rc);
-    if (rc == 0) {
+    if (rc == 0 || rc == 33) {
         cbor_encode_text_stringz(&bs_rsp, "off");
         cbor_encode_uint(&bs_rsp, curr_off);
     }
@@ -403,6 +551,29 @@ bs_echo_ctl(char *buf, int len)
     boot_serial_output();
 }
 
+/*
+ * Report the input limits, so the host can size its upload chunks and
+ * windows: frames up to buf_size bytes long, buf_count of them in flight.
+ */
+static void
+bs_params(char *buf, int len)
+{
+    cbor_encoder_create_map(&bs_root, &bs_rsp, CborIndefiniteLength);
+    cbor_encode_text_stringz(&bs_rsp, "buf_size");
+    cbor_encode_uint(&bs_rsp, bs_max_input);
+    cbor_encode_text_stringz(&bs_rsp, "buf_count");
+    cbor_encode_uint(&bs_rsp, BOOT_SERIAL_IN_BUFS);
+    cbor_encode_text_stringz(&bs_rsp, "raw");
+#ifdef BOOT_SERIAL_RAW
+    cbor_encode_boolean(&bs_rsp, true);
+#else
+    cbor_encode_boolean(&bs_rsp, false);
+#endif
+    cbor_encoder_close_container(&bs_root, &bs_rsp);
+
+    boot_serial_output();
+}
+
 /*
  * Reset, and (presumably) boot to newly uploaded image. Flush console
  * before restarting.
@@ -474,6 +645,9 @@ boot_serial_input(char *buf, int len)
         case NMGR_ID_RESET:
             bs_reset(buf, len);
             break;
+        case NMGR_ID_PARAMS:
+            bs_params(buf, len);
+            break;
         default:
             break;
         }
@@ -488,8 +662,9 @@ boot_serial_output(void)
     uint16_t crc;
     uint16_t totlen;
     char pkt_start[2] = { SHELL_NLIP_PKT_START1, SHELL_NLIP_PKT_START2 };
-    char buf[BOOT_SERIAL_OUT_MAX];
-    char encoded_buf[BASE64_ENCODE_SIZE(BOOT_SERIAL_OUT_MAX)];
+    char buf[sizeof(uint16_t) + sizeof(struct nmgr_hdr) + BOOT_SERIAL_OUT_MAX +
+             sizeof(uint16_t)];
+    char encoded_buf[BASE64_ENCODE_SIZE(sizeof(buf))];
 
     data = bs_obuf;
     len = bs_writer.bytes_written;
@@ -544,11 +719,13 @@ boot_serial_in_dec(char *in, int inlen, char *out, int *out_off, int maxout)
     uint16_t crc;
     uint16_t len;
 #ifdef __ZEPHYR__
+    size_t dec_len;
     int err;
-    err = base64_decode( &out[*out_off], maxout, &rc, in, inlen - 2);
+    err = base64_decode( &out[*out_off], maxout - *out_off, &dec_len, in, inlen - 2);
     if (err) {
         return -1;
     }
+    rc = dec_len;
 #else
     if (*out_off + base64_decode_len(in) >= maxout) {
         return -1;
@@ -581,6 +758,97 @@ boot_serial_in_dec(char *in, int inlen, char *out, int *out_off, int maxout)
     return 0;
 }
 
+#ifdef BOOT_SERIAL_RAW
+/*
+ * CRC-32 (IEEE 802.3), as computed by zlib.
+ */
+static uint32_t
+bs_crc32(uint32_t crc, const uint8_t *data, int len)
+{
+    static const uint32_t tab[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+        0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+        0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+
+    crc = ~crc;
+    while (len--) {
+        crc = tab[(crc ^ *data) & 0x0f] ^ (crc >> 4);
+        crc = tab[(crc ^ (*data >> 4)) & 0x0f] ^ (crc >> 4);
+        data++;
+    }
+    return ~crc;
+}
+
+/*
+ * Checks a raw frame, without its start bytes: a big endian length, the
+ * newtmgr packet and a big endian CRC32 of the packet.  Returns the length
+ * of the packet, or -1 if the frame is truncated or corrupt.
+ */
+static int
+boot_serial_in_raw(uint8_t *in, int inlen)
+{
+    uint32_t crc;
+    int len;
+
+    if (inlen < 2) {
+        return -1;
+    }
+    len = (in[0] << 8) | in[1];
+    if (len < (int)sizeof(crc) || len > inlen - 2) {
+        return -1;
+    }
+    len -= sizeof(crc);
+    in += 2;
+
+    crc = ((uint32_t)in[len] << 24) | ((uint32_t)in[len + 1] << 16) |
+          ((uint32_t)in[len + 2] << 8) | in[len + 3];
+    if (bs_crc32(0, in, len) != crc) {
+        return -1;
+    }
+
+    return len;
+}
+#endif
+
+/*
+ * Handles one line read from the console: a base64 encoded packet or a
+ * part of it, or a raw frame.  Packets spread over several lines are
+ * gathered in dec.
+ */
+void
+boot_serial_input_line(char *buf, int len, char *dec, int *dec_off,
+                       int maxout)
+{
+    int rc = 0;
+
+    if (len < 2) {
+        return;
+    }
+
+    if (buf[0] == SHELL_NLIP_PKT_START1 &&
+      buf[1] == SHELL_NLIP_PKT_START2) {
+        *dec_off = 0;
+        rc = boot_serial_in_dec(&buf[2], len - 2, dec, dec_off, maxout);
+    } else if (buf[0] == SHELL_NLIP_DATA_START1 &&
+      buf[1] == SHELL_NLIP_DATA_START2) {
+        rc = boot_serial_in_dec(&buf[2], len - 2, dec, dec_off, maxout);
+#ifdef BOOT_SERIAL_RAW
+    } else if (buf[0] == BOOT_SERIAL_RAW_START1 &&
+      buf[1] == BOOT_SERIAL_RAW_START2) {
+        rc = boot_serial_in_raw((uint8_t *)&buf[2], len - 2);
+        if (rc > 0) {
+            boot_serial_input(&buf[4], rc);
+        }
+        return;
+#endif
+    }
+    if (rc == 1) {
+        boot_serial_input(&dec[2], *dec_off - 2);
+    }
+}
+
 /*
  * Task which waits reading console, expecting to get image over
  * serial port.
@@ -611,6 +879,7 @@ boot_serial_start(int max_input)
     dec = os_malloc(max_input);
 #endif
     assert(buf && dec);
+    bs_max_input = max_input - 1;
 
 #if 1
     // IRIS Change - let host know we are ready!
@@ -635,17 +904,7 @@ boot_serial_start(int max_input)
         if (!full_line) {
             continue;
         }
-        if (buf[0] == SHELL_NLIP_PKT_START1 &&
-          buf[1] == SHELL_NLIP_PKT_START2) {
-            dec_off = 0;
-            rc = boot_serial_in_dec(&buf[2], off - 2, dec, &dec_off, max_input);
-        } else if (buf[0] == SHELL_NLIP_DATA_START1 &&
-          buf[1] == SHELL_NLIP_DATA_START2) {
-            rc = boot_serial_in_dec(&buf[2], off - 2, dec, &dec_off, max_input);
-        }
-        if (rc == 1) {
-            boot_serial_input(&dec[2], dec_off - 2);
-        }
+        boot_serial_input_line(buf, off, dec, &dec_off, max_input);
         off = 0;
 #if 1
         idle_count = 0; // IRIS CHANGE
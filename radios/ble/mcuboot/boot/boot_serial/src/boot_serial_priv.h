@@ -48,6 +48,7 @@ extern "C" {
 
 #define NMGR_ID_CONS_ECHO_CTRL  1
 #define NMGR_ID_RESET           5
+#define NMGR_ID_PARAMS          6
 
 struct nmgr_hdr {
     uint8_t  nh_op;             /* NMGR_OP_XXX */
@@ -66,6 +67,8 @@ struct nmgr_hdr {
 
 
 void boot_serial_input(char *buf, int len);
+void boot_serial_input_line(char *buf, int len, char *dec, int *dec_off,
+                            int maxout);
 
 #ifdef __cplusplus
 }
@@ -37,6 +37,7 @@ uint32_t bootutil_get_caps(void);
 #define BOOTUTIL_CAP_ECDSA_P256         (1<<2)
 #define BOOTUTIL_CAP_SWAP_UPGRADE       (1<<3)
 #define BOOTUTIL_CAP_OVERWRITE_UPGRADE  (1<<4)
+#define BOOTUTIL_CAP_SWAP_MOVE          (1<<5)
 
 #ifdef __cplusplus
 }
@@ -120,6 +120,7 @@ boot_slots_trailer_sz(uint8_t min_write_sz)
 {
     return /* state for all sectors */
            BOOT_STATUS_MAX_ENTRIES * BOOT_STATUS_STATE_COUNT * min_write_sz +
+           BOOT_MARKER_SZ                                                   +
            BOOT_MAX_ALIGN * 3 /* copy_done + image_ok + swap_size */        +
            BOOT_MAGIC_SZ;
 }
@@ -200,6 +201,15 @@ boot_swap_size_off(const struct flash_area *fap)
     return fap->fa_size - BOOT_MAGIC_SZ - BOOT_MAX_ALIGN * 3;
 }
 
+#ifdef MCUBOOT_VALIDATE_SLOT0_ONCE
+static uint32_t
+boot_marker_off(const struct flash_area *fap)
+{
+    assert(fap->fa_id != FLASH_AREA_IMAGE_SCRATCH);
+    return boot_swap_size_off(fap) - BOOT_MARKER_SZ;
+}
+#endif
+
 int
 boot_read_swap_state(const struct flash_area *fap,
                      struct boot_swap_state *state)
@@ -406,6 +416,37 @@ boot_write_swap_size(const struct flash_area *fap, uint32_t swap_size)
     return 0;
 }
 
+#ifdef MCUBOOT_VALIDATE_SLOT0_ONCE
+int
+boot_read_marker(const struct flash_area *fap, uint8_t *marker)
+{
+    int rc;
+
+    rc = flash_area_read(fap, boot_marker_off(fap), marker, BOOT_MARKER_SZ);
+    if (rc != 0) {
+        return BOOT_EFLASH;
+    }
+
+    return 0;
+}
+
+int
+boot_write_marker(const struct flash_area *fap, const uint8_t *marker)
+{
+    int rc;
+
+    /* The marker size is a multiple of every supported write alignment. */
+    assert(BOOT_MARKER_SZ % BOOT_MAX_ALIGN == 0);
+
+    rc = flash_area_write(fap, boot_marker_off(fap), marker, BOOT_MARKER_SZ);
+    if (rc != 0) {
+        return BOOT_EFLASH;
+    }
+
+    return 0;
+}
+#endif
+
 int
 boot_swap_type(void)
 {
@@ -47,6 +47,14 @@ struct flash_area;
 
 #define BOOT_TMPBUF_SZ  256
 
+#if defined(MCUBOOT_SWAP_MOVE) && defined(MCUBOOT_OVERWRITE_ONLY)
+#error "MCUBOOT_SWAP_MOVE and MCUBOOT_OVERWRITE_ONLY are mutually exclusive"
+#endif
+
+#if defined(MCUBOOT_VALIDATE_SLOT0_ONCE) && !defined(MCUBOOT_VALIDATE_SLOT0)
+#error "MCUBOOT_VALIDATE_SLOT0_ONCE requires MCUBOOT_VALIDATE_SLOT0"
+#endif
+
 /*
  * Maintain state of copy progress.
  */
@@ -54,6 +62,9 @@ struct boot_status {
     uint32_t idx;         /* Which area we're operating on */
     uint8_t state;        /* Which part of the swapping process are we at */
     uint8_t use_scratch;  /* Are status bytes ever written to scratch? */
+#ifdef MCUBOOT_SWAP_MOVE
+    uint8_t op;           /* Which pass of a swap-move we are in */
+#endif
     uint32_t swap_size;   /* Total size of swapped image */
 };
 
@@ -71,6 +82,8 @@ struct boot_status {
  * ~                Swap status (variable, aligned)                ~
  * ~                                                               ~
  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * ~         Validation marker (32 octets, VALIDATE_SLOT0_ONCE)    ~
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  * |                          Swap size                            |
  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  * ~                  0xff padding (MAX ALIGN - 4)                 ~
@@ -111,6 +124,15 @@ struct boot_swap_state {
 #define BOOT_STATUS_STATE_COUNT    3
 #define BOOT_STATUS_MAX_ENTRIES    BOOT_MAX_IMG_SECTORS
 
+/*
+ * A swap-move first shifts the slot 0 sectors up by one (one status entry
+ * per sector), then swaps the slots in place (two entries per sector).  The
+ * entries for each pass are kept in separate regions of the status area,
+ * which has the same size as for the scratch based swap.
+ */
+#define BOOT_STATUS_OP_MOVE        0
+#define BOOT_STATUS_OP_SWAP        1
+
 #define BOOT_STATUS_SOURCE_NONE    0
 #define BOOT_STATUS_SOURCE_SCRATCH 1
 #define BOOT_STATUS_SOURCE_SLOT0   2
@@ -121,6 +143,17 @@ struct boot_swap_state {
 #define BOOT_FLAG_SET              0x01
 #define BOOT_FLAG_UNSET            0xff
 
+/*
+ * Once the image in slot 0 passed a full validation, a SHA-256 over its
+ * header and TLVs is recorded in the trailer so later boots can skip
+ * hashing the whole image again.
+ */
+#ifdef MCUBOOT_VALIDATE_SLOT0_ONCE
+#define BOOT_MARKER_SZ             32
+#else
+#define BOOT_MARKER_SZ             0
+#endif
+
 extern const uint32_t BOOT_MAGIC_SZ;
 
 /**
@@ -165,6 +198,10 @@ int boot_write_copy_done(const struct flash_area *fap);
 int boot_write_image_ok(const struct flash_area *fap);
 int boot_write_swap_size(const struct flash_area *fap, uint32_t swap_size);
 int boot_read_swap_size(uint32_t *swap_size);
+#ifdef MCUBOOT_VALIDATE_SLOT0_ONCE
+int boot_read_marker(const struct flash_area *fap, uint8_t *marker);
+int boot_write_marker(const struct flash_area *fap, const uint8_t *marker);
+#endif
 
 /*
  * Accessors for the contents of struct boot_loader_state.
@@ -35,6 +35,9 @@ uint32_t bootutil_get_caps(void)
 #else
         res |= BOOTUTIL_CAP_SWAP_UPGRADE;
 #endif
+#if defined(MCUBOOT_SWAP_MOVE)
+        res |= BOOTUTIL_CAP_SWAP_MOVE;
+#endif
 
         return res;
 }
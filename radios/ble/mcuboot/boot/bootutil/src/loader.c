@@ -39,6 +39,10 @@
 
 #include "mcuboot_config/mcuboot_config.h"
 
+#ifdef MCUBOOT_VALIDATE_SLOT0_ONCE
+#include "bootutil/sha256.h"
+#endif
+
 static struct boot_loader_state boot_data;
 
 #if defined(MCUBOOT_VALIDATE_SLOT0) && !defined(MCUBOOT_OVERWRITE_ONLY)
@@ -165,11 +169,18 @@ boot_status_source(void)
     rc = boot_read_swap_state_by_id(FLASH_AREA_IMAGE_0, &state_slot0);
     assert(rc == 0);
 
+#ifdef MCUBOOT_SWAP_MOVE
+    /* A swap-move keeps its status in slot 0 only. */
+    state_scratch.magic = BOOT_MAGIC_UNSET;
+#else
     rc = boot_read_swap_state_by_id(FLASH_AREA_IMAGE_SCRATCH, &state_scratch);
     assert(rc == 0);
+#endif
 
     BOOT_LOG_SWAP_STATE("Image 0", &state_slot0);
+#ifndef MCUBOOT_SWAP_MOVE
     BOOT_LOG_SWAP_STATE("Scratch", &state_scratch);
+#endif
 
     for (i = 0; i < BOOT_STATUS_TABLES_COUNT; i++) {
         table = &boot_status_tables[i];
@@ -255,6 +266,67 @@ done:
 }
 #endif /* !MCUBOOT_OVERWRITE_ONLY */
 
+#ifndef MCUBOOT_OVERWRITE_ONLY
+/*
+ * Size of the larger of the two images, which is the amount of data a new
+ * swap has to exchange.
+ */
+static uint32_t
+boot_largest_image_size(void)
+{
+    struct image_header *hdr;
+    uint32_t size_0;
+    uint32_t size_1;
+    int rc;
+
+    size_0 = size_1 = 0;
+
+    hdr = boot_img_hdr(&boot_data, 0);
+    if (hdr->ih_magic == IMAGE_MAGIC) {
+        rc = boot_read_image_size(0, hdr, &size_0);
+        assert(rc == 0);
+    }
+
+    hdr = boot_img_hdr(&boot_data, 1);
+    if (hdr->ih_magic == IMAGE_MAGIC) {
+        rc = boot_read_image_size(1, hdr, &size_1);
+        assert(rc == 0);
+    }
+
+    return size_1 > size_0 ? size_1 : size_0;
+}
+#endif /* !MCUBOOT_OVERWRITE_ONLY */
+
+#ifdef MCUBOOT_SWAP_MOVE
+/**
+ * Calculates the number of sectors a swap-move exchanges.  Slot 0 needs one
+ * spare sector above the image to shift it into, and neither the image nor
+ * the spare sector may share a sector with the slot 0 trailer.
+ *
+ * @param swap_size             The number of bytes to swap.
+ *
+ * @return                      The number of sectors to swap; 0 if the image
+ *                                  does not fit.
+ */
+static size_t
+boot_move_num_sectors(uint32_t swap_size)
+{
+    uint32_t sector_sz;
+    uint32_t trailer_off;
+    size_t num_sectors;
+
+    sector_sz = boot_img_sector_size(&boot_data, 0, 0);
+    num_sectors = (swap_size + sector_sz - 1) / sector_sz;
+    trailer_off = boot_status_off(BOOT_IMG_AREA(&boot_data, 0));
+
+    if ((num_sectors + 1) * sector_sz > trailer_off) {
+        return 0;
+    }
+
+    return num_sectors;
+}
+#endif /* MCUBOOT_SWAP_MOVE */
+
 static int
 boot_read_image_header(int slot, struct image_header *out_hdr)
 {
@@ -312,17 +384,21 @@ static uint8_t
 boot_write_sz(void)
 {
     uint8_t elem_sz;
+#ifndef MCUBOOT_SWAP_MOVE
     uint8_t align;
+#endif
 
     /* Figure out what size to write update status update as.  The size depends
      * on what the minimum write size is for scratch area, active image slot.
      * We need to use the bigger of those 2 values.
      */
     elem_sz = hal_flash_align(boot_img_fa_device_id(&boot_data, 0));
+#ifndef MCUBOOT_SWAP_MOVE
     align = hal_flash_align(boot_scratch_fa_device_id(&boot_data));
     if (align > elem_sz) {
         elem_sz = align;
     }
+#endif
 
     return elem_sz;
 }
@@ -353,6 +429,14 @@ boot_slots_compatible(void)
             BOOT_LOG_WRN("Cannot upgrade: an incompatible sector was found");
             return 0;
         }
+
+#ifdef MCUBOOT_SWAP_MOVE
+        /* Moving the image up by one sector needs a uniform layout. */
+        if (size_0 != boot_img_sector_size(&boot_data, 0, 0)) {
+            BOOT_LOG_WRN("Cannot upgrade: sectors of different sizes");
+            return 0;
+        }
+#endif
     }
 
     return 1;
@@ -384,15 +468,32 @@ boot_read_sectors(void)
     return 0;
 }
 
+#ifdef MCUBOOT_SWAP_MOVE
 static uint32_t
-boot_status_internal_off(int idx, int state, int elem_sz)
+boot_status_internal_off(const struct boot_status *bs, int elem_sz)
+{
+    uint32_t entry;
+
+    if (bs->op == BOOT_STATUS_OP_MOVE) {
+        /* Written once per sector moved; idx is the number of sectors moved. */
+        entry = bs->idx - 1;
+    } else {
+        entry = BOOT_STATUS_MAX_ENTRIES + bs->idx * 2 + bs->state - 1;
+    }
+
+    return entry * elem_sz;
+}
+#else
+static uint32_t
+boot_status_internal_off(const struct boot_status *bs, int elem_sz)
 {
     int idx_sz;
 
     idx_sz = elem_sz * BOOT_STATUS_STATE_COUNT;
 
-    return idx * idx_sz + state * elem_sz;
+    return bs->idx * idx_sz + bs->state * elem_sz;
 }
+#endif
 
 /**
  * Reads the status of a partially-completed swap, if any.  This is necessary
@@ -407,6 +508,9 @@ boot_read_status_bytes(const struct flash_area *fap, struct boot_status *bs)
     int max_entries;
     int found;
     int found_idx;
+#ifdef MCUBOOT_SWAP_MOVE
+    int move_idx;
+#endif
     int invalid;
     int rc;
     int i;
@@ -416,8 +520,21 @@ boot_read_status_bytes(const struct flash_area *fap, struct boot_status *bs)
 
     found = 0;
     found_idx = 0;
+#ifdef MCUBOOT_SWAP_MOVE
+    move_idx = 0;
+#endif
     invalid = 0;
     for (i = 0; i < max_entries; i++) {
+#ifdef MCUBOOT_SWAP_MOVE
+        /* The move pass only uses as many entries as there are sectors to
+         * move; the rest of its region is not a gap in the status.
+         */
+        if (i == BOOT_STATUS_MAX_ENTRIES) {
+            move_idx = found_idx;
+            found_idx = 0;
+        }
+#endif
+
         rc = flash_area_read(fap, off + i * BOOT_WRITE_SZ(&boot_data),
                              &status, 1);
         if (rc != 0) {
@@ -454,9 +571,28 @@ boot_read_status_bytes(const struct flash_area *fap, struct boot_status *bs)
         if (!found_idx) {
             found_idx = i;
         }
+#ifdef MCUBOOT_SWAP_MOVE
+        if (found_idx == BOOT_STATUS_MAX_ENTRIES && move_idx) {
+            /* Nothing swapped yet. */
+            found_idx = move_idx;
+        }
+#endif
         found_idx--;
+#ifdef MCUBOOT_SWAP_MOVE
+        if (found_idx < BOOT_STATUS_MAX_ENTRIES) {
+            bs->op = BOOT_STATUS_OP_MOVE;
+            bs->idx = found_idx + 1;
+            bs->state = 0;
+        } else {
+            found_idx -= BOOT_STATUS_MAX_ENTRIES - 1;
+            bs->op = BOOT_STATUS_OP_SWAP;
+            bs->idx = found_idx / 2;
+            bs->state = found_idx % 2;
+        }
+#else
         bs->idx = found_idx / BOOT_STATUS_STATE_COUNT;
         bs->state = found_idx % BOOT_STATUS_STATE_COUNT;
+#endif
     }
 
     return 0;
@@ -545,8 +681,7 @@ boot_write_status(struct boot_status *bs)
     }
 
     off = boot_status_off(fap) +
-          boot_status_internal_off(bs->idx, bs->state,
-                                   BOOT_WRITE_SZ(&boot_data));
+          boot_status_internal_off(bs, BOOT_WRITE_SZ(&boot_data));
 
     align = hal_flash_align(fap->fa_device_id);
     memset(buf, 0xFF, BOOT_MAX_ALIGN);
@@ -609,12 +744,114 @@ split_image_check(struct image_header *app_hdr,
     return 0;
 }
 
+#ifdef MCUBOOT_VALIDATE_SLOT0_ONCE
+/*
+ * Set while booting right after a swap.  The image is then still on trial
+ * and the swap may be reverted, so its marker is only recorded on a later
+ * boot that performs no swap.
+ */
+static int boot_marker_deferred;
+
+/*
+ * Computes the validation marker of the image in a slot: a SHA-256 over the
+ * location of the slot, the image header and the TLV area.  The TLVs hold
+ * the hash and signature of the image, so changing the image and its TLVs,
+ * the header or the marker itself all make the stored marker mismatch.
+ * Changes to the image body alone that leave the TLVs untouched are not
+ * covered; that is the price of not hashing the image on every boot.
+ */
+static int
+boot_marker_compute(struct image_header *hdr, const struct flash_area *fap,
+                    uint8_t *marker)
+{
+    bootutil_sha256_context sha256_ctx;
+    struct image_tlv_info info;
+    uint8_t buf[64];
+    uint32_t off;
+    uint32_t end;
+    uint32_t blk_sz;
+    int rc;
+
+    if (hdr->ih_img_size >= fap->fa_size) {
+        return BOOT_EBADIMAGE;
+    }
+
+    off = hdr->ih_hdr_size + hdr->ih_img_size;
+    if (off + sizeof info > fap->fa_size) {
+        return BOOT_EBADIMAGE;
+    }
+
+    rc = flash_area_read(fap, off, &info, sizeof info);
+    if (rc != 0) {
+        return BOOT_EFLASH;
+    }
+    if (info.it_magic != IMAGE_TLV_INFO_MAGIC ||
+        info.it_tlv_tot < sizeof info ||
+        off + info.it_tlv_tot > fap->fa_size) {
+        return BOOT_EBADIMAGE;
+    }
+    end = off + info.it_tlv_tot;
+
+    bootutil_sha256_init(&sha256_ctx);
+    bootutil_sha256_update(&sha256_ctx, &fap->fa_off, sizeof fap->fa_off);
+    bootutil_sha256_update(&sha256_ctx, &fap->fa_size, sizeof fap->fa_size);
+    bootutil_sha256_update(&sha256_ctx, hdr, sizeof *hdr);
+    for (; off < end; off += blk_sz) {
+        blk_sz = end - off;
+        if (blk_sz > sizeof buf) {
+            blk_sz = sizeof buf;
+        }
+        rc = flash_area_read(fap, off, buf, blk_sz);
+        if (rc != 0) {
+            return BOOT_EFLASH;
+        }
+        bootutil_sha256_update(&sha256_ctx, buf, blk_sz);
+    }
+    bootutil_sha256_finish(&sha256_ctx, marker);
+
+    return 0;
+}
+
+/*
+ * Records the marker of an image that was just validated in full.  The
+ * marker can only be written to an erased trailer; a stale marker stays
+ * until the next upgrade erases it, and until then slot 0 keeps being
+ * validated in full.  Failing to record it is not fatal either.
+ */
+static void
+boot_marker_record(const struct flash_area *fap, const uint8_t *marker)
+{
+    uint8_t stored[BOOT_MARKER_SZ];
+    int i;
+
+    if (boot_read_marker(fap, stored) != 0) {
+        return;
+    }
+
+    for (i = 0; i < BOOT_MARKER_SZ; i++) {
+        if (stored[i] != 0xff) {
+            BOOT_LOG_WRN("Stale validation marker in slot 0");
+            return;
+        }
+    }
+
+    if (boot_write_marker(fap, marker) != 0) {
+        BOOT_LOG_WRN("Failed to record validation marker in slot 0");
+    }
+}
+#endif /* MCUBOOT_VALIDATE_SLOT0_ONCE */
+
 static int
 boot_validate_slot(int slot)
 {
     const struct flash_area *fap;
     struct image_header *hdr;
     int rc;
+#ifdef MCUBOOT_VALIDATE_SLOT0_ONCE
+    uint8_t marker[BOOT_MARKER_SZ];
+    uint8_t stored[BOOT_MARKER_SZ];
+    int have_marker = 0;
+#endif
 
     hdr = boot_img_hdr(&boot_data, slot);
     if (hdr->ih_magic == 0xffffffff || hdr->ih_flags & IMAGE_F_NON_BOOTABLE) {
@@ -627,6 +864,19 @@ boot_validate_slot(int slot)
         return BOOT_EFLASH;
     }
 
+#ifdef MCUBOOT_VALIDATE_SLOT0_ONCE
+    if (slot == 0 && hdr->ih_magic == IMAGE_MAGIC &&
+        boot_marker_compute(hdr, fap, marker) == 0) {
+        have_marker = 1;
+        if (boot_read_marker(fap, stored) == 0 &&
+            memcmp(marker, stored, BOOT_MARKER_SZ) == 0) {
+            /* Validated in full on an earlier boot and unchanged since. */
+            flash_area_close(fap);
+            return 0;
+        }
+    }
+#endif
+
     if ((hdr->ih_magic != IMAGE_MAGIC || boot_image_check(hdr, fap) != 0)) {
         if (slot != 0) {
             flash_area_erase(fap, 0, fap->fa_size);
@@ -638,6 +888,12 @@ boot_validate_slot(int slot)
         return -1;
     }
 
+#ifdef MCUBOOT_VALIDATE_SLOT0_ONCE
+    if (have_marker && !boot_marker_deferred) {
+        boot_marker_record(fap, marker);
+    }
+#endif
+
     flash_area_close(fap);
 
     /* Image in slot 1 is valid. */
@@ -666,6 +922,13 @@ boot_validated_swap_type(void)
         if (boot_validate_slot(1) != 0) {
             swap_type = BOOT_SWAP_TYPE_FAIL;
         }
+#ifdef MCUBOOT_SWAP_MOVE
+        if (swap_type != BOOT_SWAP_TYPE_FAIL &&
+            boot_move_num_sectors(boot_largest_image_size()) == 0) {
+            BOOT_LOG_ERR("Cannot upgrade: no room to move slot 0 up");
+            swap_type = BOOT_SWAP_TYPE_FAIL;
+        }
+#endif
     }
 
     return swap_type;
@@ -684,7 +947,7 @@ boot_validated_swap_type(void)
  * @return                      The number of bytes comprised by the
  *                                  [first-sector, last-sector] range.
  */
-#ifndef MCUBOOT_OVERWRITE_ONLY
+#if !defined(MCUBOOT_OVERWRITE_ONLY) && !defined(MCUBOOT_SWAP_MOVE)
 static uint32_t
 boot_copy_sz(int last_sector_idx, int *out_first_sector_idx)
 {
@@ -710,7 +973,7 @@ boot_copy_sz(int last_sector_idx, int *out_first_sector_idx)
     *out_first_sector_idx = i + 1;
     return sz;
 }
-#endif /* !MCUBOOT_OVERWRITE_ONLY */
+#endif /* !MCUBOOT_OVERWRITE_ONLY && !MCUBOOT_SWAP_MOVE */
 
 /**
  * Erases a region of flash.
@@ -895,7 +1158,7 @@ boot_erase_last_sector_by_id(int flash_area_id)
  *
  * @return                      0 on success; nonzero on failure.
  */
-#ifndef MCUBOOT_OVERWRITE_ONLY
+#if !defined(MCUBOOT_OVERWRITE_ONLY) && !defined(MCUBOOT_SWAP_MOVE)
 static void
 boot_swap_sectors(int idx, uint32_t sz, struct boot_status *bs)
 {
@@ -1031,7 +1294,98 @@ boot_swap_sectors(int idx, uint32_t sz, struct boot_status *bs)
         BOOT_STATUS_ASSERT(rc == 0);
     }
 }
-#endif /* !MCUBOOT_OVERWRITE_ONLY */
+#endif /* !MCUBOOT_OVERWRITE_ONLY && !MCUBOOT_SWAP_MOVE */
+
+#ifdef MCUBOOT_SWAP_MOVE
+/**
+ * Moves a sector of slot 0 up by one sector.  Sectors are moved starting
+ * from the top of the image, so the destination never holds data that was
+ * not moved yet.
+ *
+ * @param idx                   The index of the sector to move.
+ * @param sz                    The size of a sector.
+ * @param bs                    The current boot status.  This struct gets
+ *                                  updated according to the outcome.
+ */
+static void
+boot_move_sector_up(int idx, uint32_t sz, struct boot_status *bs)
+{
+    uint32_t old_off;
+    uint32_t new_off;
+    int rc;
+
+    old_off = boot_img_sector_off(&boot_data, 0, idx);
+    new_off = boot_img_sector_off(&boot_data, 0, idx + 1);
+
+    rc = boot_erase_sector(FLASH_AREA_IMAGE_0, new_off, sz);
+    assert(rc == 0);
+
+    rc = boot_copy_sector(FLASH_AREA_IMAGE_0, FLASH_AREA_IMAGE_0,
+                          old_off, new_off, sz);
+    assert(rc == 0);
+
+    bs->idx++;
+    rc = boot_write_status(bs);
+    BOOT_STATUS_ASSERT(rc == 0);
+}
+
+/**
+ * Swaps a sector of slot 1 with the sector of slot 0 that was moved up
+ * above it.  Slot 0 sector `idx` is free once the image has been moved,
+ * and slot 1 sector `idx` is free once it has been copied to slot 0, so
+ * each step only overwrites data that is stored elsewhere.
+ *
+ * @param idx                   The index of the sector to swap.
+ * @param sz                    The size of a sector.
+ * @param bs                    The current boot status.  This struct gets
+ *                                  updated according to the outcome.
+ */
+static void
+boot_swap_sectors(int idx, uint32_t sz, struct boot_status *bs)
+{
+    uint32_t img_off;
+    uint32_t moved_off;
+    int rc;
+
+    img_off = boot_img_sector_off(&boot_data, 0, idx);
+    moved_off = boot_img_sector_off(&boot_data, 0, idx + 1);
+
+    if (bs->state == 0) {
+        if (idx == 0) {
+            /* The upgrade request was copied to slot 0 before the move;
+             * clear it so it does not trigger another swap.
+             */
+            rc = boot_erase_last_sector_by_id(FLASH_AREA_IMAGE_1);
+            assert(rc == 0);
+        }
+
+        rc = boot_erase_sector(FLASH_AREA_IMAGE_0, img_off, sz);
+        assert(rc == 0);
+
+        rc = boot_copy_sector(FLASH_AREA_IMAGE_1, FLASH_AREA_IMAGE_0,
+                              img_off, img_off, sz);
+        assert(rc == 0);
+
+        bs->state = 1;
+        rc = boot_write_status(bs);
+        BOOT_STATUS_ASSERT(rc == 0);
+    }
+
+    if (bs->state == 1) {
+        rc = boot_erase_sector(FLASH_AREA_IMAGE_1, img_off, sz);
+        assert(rc == 0);
+
+        rc = boot_copy_sector(FLASH_AREA_IMAGE_0, FLASH_AREA_IMAGE_1,
+                              moved_off, img_off, sz);
+        assert(rc == 0);
+
+        bs->idx++;
+        bs->state = 0;
+        rc = boot_write_status(bs);
+        BOOT_STATUS_ASSERT(rc == 0);
+    }
+}
+#endif /* MCUBOOT_SWAP_MOVE */
 
 /**
  * Swaps the two images in flash.  If a prior copy operation was interrupted
@@ -1084,6 +1438,17 @@ boot_copy_image(struct boot_status *bs)
 #endif
     }
 
+#if defined(MCUBOOT_OVERWRITE_ONLY_FAST) && defined(MCUBOOT_VALIDATE_SLOT0_ONCE)
+    /* The old validation marker must not outlive the old image. */
+    if (sect + 1 < sect_count) {
+        last_sector = sect_count - 1;
+        rc = boot_erase_sector(FLASH_AREA_IMAGE_0,
+                               boot_img_sector_off(&boot_data, 0, last_sector),
+                               boot_img_sector_size(&boot_data, 0, last_sector));
+        assert(rc == 0);
+    }
+#endif
+
     BOOT_LOG_INF("Copying slot 1 to slot 0: 0x%lx bytes", size);
     rc = boot_copy_sector(FLASH_AREA_IMAGE_1, FLASH_AREA_IMAGE_0,
                           0, 0, size);
@@ -1107,6 +1472,59 @@ boot_copy_image(struct boot_status *bs)
 
     return 0;
 }
+#elif defined(MCUBOOT_SWAP_MOVE)
+static int
+boot_copy_image(struct boot_status *bs)
+{
+    int num_sectors;
+    uint32_t sz;
+    int idx;
+    int rc;
+
+    if (bs->op == BOOT_STATUS_OP_MOVE && bs->idx == 0) {
+        bs->swap_size = boot_largest_image_size();
+    } else {
+        rc = boot_read_swap_size(&bs->swap_size);
+        assert(rc == 0);
+    }
+
+    num_sectors = boot_move_num_sectors(bs->swap_size);
+    assert(num_sectors > 0);
+
+    sz = boot_img_sector_size(&boot_data, 0, 0);
+
+    if (bs->op == BOOT_STATUS_OP_MOVE) {
+        if (bs->idx == 0) {
+            /* The trailer is never moved, so the status can live in slot 0
+             * for the whole operation.
+             */
+            rc = boot_erase_last_sector_by_id(FLASH_AREA_IMAGE_0);
+            assert(rc == 0);
+
+            boot_status_init_by_id(FLASH_AREA_IMAGE_0, bs);
+        }
+
+        for (idx = num_sectors - 1 - (int)bs->idx; idx >= 0; idx--) {
+            boot_move_sector_up(idx, sz, bs);
+        }
+
+        bs->op = BOOT_STATUS_OP_SWAP;
+        bs->idx = 0;
+        bs->state = 0;
+    }
+
+    for (idx = bs->idx; idx < num_sectors; idx++) {
+        boot_swap_sectors(idx, sz, bs);
+    }
+
+#ifdef MCUBOOT_VALIDATE_SLOT0
+    if (boot_status_fails > 0) {
+        BOOT_LOG_WRN("%d status write fails performing the swap", boot_status_fails);
+    }
+#endif
+
+    return 0;
+}
 #else
 static int
 boot_copy_image(struct boot_status *bs)
@@ -1115,7 +1533,6 @@ boot_copy_image(struct boot_status *bs)
     int first_sector_idx;
     int last_sector_idx;
     uint32_t swap_idx;
-    struct image_header *hdr;
     uint32_t size;
     uint32_t copy_size;
     int rc;
@@ -1129,22 +1546,7 @@ boot_copy_image(struct boot_status *bs)
          * No swap ever happened, so need to find the largest image which
          * will be used to determine the amount of sectors to swap.
          */
-        hdr = boot_img_hdr(&boot_data, 0);
-        if (hdr->ih_magic == IMAGE_MAGIC) {
-            rc = boot_read_image_size(0, hdr, &copy_size);
-            assert(rc == 0);
-        }
-
-        hdr = boot_img_hdr(&boot_data, 1);
-        if (hdr->ih_magic == IMAGE_MAGIC) {
-            rc = boot_read_image_size(1, hdr, &size);
-            assert(rc == 0);
-        }
-
-        if (size > copy_size) {
-            copy_size = size;
-        }
-
+        copy_size = boot_largest_image_size();
         bs->swap_size = copy_size;
     } else {
         /*
@@ -1335,9 +1737,11 @@ boot_go(struct boot_rsp *rsp)
         rc = flash_area_open(fa_id, &BOOT_IMG_AREA(&boot_data, slot));
         assert(rc == 0);
     }
+#ifndef MCUBOOT_SWAP_MOVE
     rc = flash_area_open(FLASH_AREA_IMAGE_SCRATCH,
                          &BOOT_SCRATCH_AREA(&boot_data));
     assert(rc == 0);
+#endif
 
     /* Determine the sector layout of the image slots and scratch area. */
     rc = boot_read_sectors();
@@ -1432,6 +1836,9 @@ boot_go(struct boot_rsp *rsp)
     }
 
 #ifdef MCUBOOT_VALIDATE_SLOT0
+#ifdef MCUBOOT_VALIDATE_SLOT0_ONCE
+    boot_marker_deferred = (swap_type != BOOT_SWAP_TYPE_NONE);
+#endif
     rc = boot_validate_slot(0);
     ASSERT(rc == 0);
     if (rc != 0) {
@@ -1456,7 +1863,9 @@ boot_go(struct boot_rsp *rsp)
     rsp->br_hdr = boot_img_hdr(&boot_data, slot);
 
  out:
+#ifndef MCUBOOT_SWAP_MOVE
     flash_area_close(BOOT_SCRATCH_AREA(&boot_data));
+#endif
     for (slot = 0; slot < BOOT_NUM_SLOTS; slot++) {
         flash_area_close(BOOT_IMG_AREA(&boot_data, BOOT_NUM_SLOTS - 1 - slot));
     }
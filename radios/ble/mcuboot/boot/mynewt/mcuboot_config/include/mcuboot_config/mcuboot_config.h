@@ -27,6 +27,9 @@
 #if MYNEWT_VAL(BOOTUTIL_VALIDATE_SLOT0)
 #define MCUBOOT_VALIDATE_SLOT0 1
 #endif
+#if MYNEWT_VAL(BOOTUTIL_VALIDATE_SLOT0_ONCE)
+#define MCUBOOT_VALIDATE_SLOT0_ONCE 1
+#endif
 #if MYNEWT_VAL(BOOTUTIL_USE_MBED_TLS)
 #define MCUBOOT_USE_MBED_TLS 1
 #endif
@@ -51,6 +54,9 @@
 #if MYNEWT_VAL(BOOTUTIL_OVERWRITE_ONLY_FAST)
 #define MCUBOOT_OVERWRITE_ONLY_FAST 1
 #endif
+#if MYNEWT_VAL(BOOTUTIL_SWAP_MOVE)
+#define MCUBOOT_SWAP_MOVE 1
+#endif
 
 #define MCUBOOT_MAX_IMG_SECTORS       MYNEWT_VAL(BOOTUTIL_MAX_IMG_SECTORS)
 
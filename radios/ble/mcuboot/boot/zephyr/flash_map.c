@@ -71,6 +71,7 @@ static struct flash_map_entry part_map[] = {
             .fa_size = FLASH_AREA_IMAGE_1_SIZE,
         },
     },
+#if defined(FLASH_AREA_IMAGE_SCRATCH_OFFSET)
     {
         .magic = FLASH_MAP_ENTRY_MAGIC,
         .area = {
@@ -79,7 +80,8 @@ static struct flash_map_entry part_map[] = {
             .fa_off = FLASH_AREA_IMAGE_SCRATCH_OFFSET,
             .fa_size = FLASH_AREA_IMAGE_SCRATCH_SIZE,
         },
-    }
+    },
+#endif
 };
 
 int flash_device_base(uint8_t fd_id, uintptr_t *ret)
@@ -220,10 +222,12 @@ int flash_area_get_bounds(int idx, uint32_t *off, uint32_t *len)
         *off = FLASH_AREA_IMAGE_1_OFFSET;
         *len = FLASH_AREA_IMAGE_1_SIZE;
         break;
+#if defined(FLASH_AREA_IMAGE_SCRATCH_OFFSET)
     case FLASH_AREA_IMAGE_SCRATCH:
         *off = FLASH_AREA_IMAGE_SCRATCH_OFFSET;
         *len = FLASH_AREA_IMAGE_SCRATCH_SIZE;
         break;
+#endif
     default:
         BOOT_LOG_ERR("unknown flash area %d", idx);
         return -1;
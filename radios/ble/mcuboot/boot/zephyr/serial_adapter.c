@@ -15,10 +15,12 @@
  */
 
 #include <stdio.h>
+#include <stdbool.h>
 #include <uart.h>
 #include <assert.h>
 #include <string.h>
 #include <zephyr.h>
+#include <boot_serial/boot_serial.h>
 
 #ifdef CONFIG_UART_CONSOLE
 #error Zephyr UART console must been disabled if serial_adapter module is used.
@@ -38,7 +40,7 @@ struct line_input {
 };
 
 static struct device *uart_dev;
-static struct line_input line_bufs[2];
+static struct line_input line_bufs[CONFIG_BOOT_SERIAL_LINE_BUFS];
 
 static K_FIFO_DEFINE(free_queue);
 static K_FIFO_DEFINE(used_queue);
@@ -48,6 +50,7 @@ static struct k_fifo *lines_queue;
 static u16_t cur;
 
 static int boot_uart_fifo_getline(char **line);
+static bool boot_uart_line_done(struct line_input *cmd, u8_t byte);
 static int boot_uart_fifo_init(void);
 
 int
@@ -138,15 +141,36 @@ boot_uart_fifo_callback(struct device *dev)
             cmd->line[cur++] = byte;
         }
 
-        if (byte ==  '\n') {
+        if (boot_uart_line_done(cmd, byte)) {
             cmd->len = cur;
             k_fifo_put(lines_queue, cmd);
+            cmd = NULL;
             cur = 0;
         }
 
     }
 }
 
+/*
+ * Text lines end at a newline.  Raw frames carry binary data, so they are
+ * delimited by the length following their start bytes instead.
+ */
+static bool
+boot_uart_line_done(struct line_input *cmd, u8_t byte)
+{
+#ifdef CONFIG_BOOT_SERIAL_RAW
+    if (cur >= 2 && cmd->line[0] == BOOT_SERIAL_RAW_START1 &&
+        cmd->line[1] == BOOT_SERIAL_RAW_START2) {
+        if (cur == CONFIG_BOOT_MAX_LINE_INPUT_LEN) {
+            return true;
+        }
+        return cur >= 4 &&
+               cur == 4 + (((u8_t)cmd->line[2] << 8) | (u8_t)cmd->line[3]);
+    }
+#endif
+    return byte == '\n';
+}
+
 static int
 boot_uart_fifo_getline(char **line)
 {
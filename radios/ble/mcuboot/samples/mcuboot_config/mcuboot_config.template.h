@@ -50,6 +50,10 @@
 /* #define MCUBOOT_OVERWRITE_ONLY_FAST */
 #endif
 
+/* Uncomment to swap by moving slot 0 up one sector instead of going
+ * through the scratch area.  Not compatible with overwrite-only. */
+/* #define MCUBOOT_SWAP_MOVE */
+
 /*
  * Cryptographic settings
  *
@@ -70,6 +74,13 @@
  */
 #define MCUBOOT_VALIDATE_SLOT0
 
+/*
+ * Uncomment to validate slot 0 in full only once after it changes, and
+ * afterwards only check its header, TLVs and a marker kept in the
+ * trailer. Changes to the image body alone are then no longer caught.
+ */
+/* #define MCUBOOT_VALIDATE_SLOT0_ONCE */
+
 /*
  * Flash abstraction
  */
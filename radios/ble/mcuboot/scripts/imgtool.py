@@ -85,7 +85,7 @@ def do_sign(args):
     img.sign(key)
 
     if args.pad:
-        img.pad_to(args.pad, args.align)
+        img.pad_to(args.pad, args.align, args.validate_slot0_once)
 
     img.save(args.outfile)
 
@@ -134,6 +134,9 @@ def args():
             help='Image has gap for header')
     sign.add_argument("--pad", type=intparse,
             help='Pad image to this many bytes, adding trailer magic')
+    sign.add_argument("--validate-slot0-once", default=False,
+            action='store_true',
+            help='Boot loader keeps a validation marker in the trailer')
     sign.add_argument("infile")
     sign.add_argument("outfile")
 
@@ -44,12 +44,18 @@ TLV_INFO_SIZE = 4
 TLV_INFO_MAGIC = 0x6907
 TLV_HEADER_SIZE = 4
 
-# Sizes of the image trailer, depending on flash write size.
+# Sizes of the image trailer, depending on flash write size, as computed
+# by boot_slots_trailer_sz(): the swap status for 128 sectors, copy_done,
+# image_ok and swap_size (8 bytes each) and the magic.
 trailer_sizes = {
-    write_size: 128 * 3 * write_size + 8 * 2 + 16
+    write_size: 128 * 3 * write_size + 8 * 3 + 16
     for write_size in [1, 2, 4, 8]
 }
 
+# Extra trailer space for the slot 0 validation marker, when the boot
+# loader is built with MCUBOOT_VALIDATE_SLOT0_ONCE.
+BOOT_MARKER_SZ = 32
+
 boot_magic = bytes([
     0x77, 0xc2, 0x95, 0xf3,
     0x60, 0xd2, 0xef, 0x7f,
@@ -183,9 +189,14 @@ class Image():
         self.payload = bytearray(self.payload)
         self.payload[:len(header)] = header
 
-    def pad_to(self, size, align):
-        """Pad the image to the given size, with the given flash alignment."""
+    def pad_to(self, size, align, validate_once=False):
+        """Pad the image to the given size, with the given flash alignment.
+
+        validate_once leaves room for the validation marker of a boot loader
+        built with MCUBOOT_VALIDATE_SLOT0_ONCE."""
         tsize = trailer_sizes[align]
+        if validate_once:
+            tsize += BOOT_MARKER_SZ
         padding = size - (len(self.payload) + tsize)
         if padding < 0:
             msg = "Image size (0x{:x}) + trailer (0x{:x}) exceeds requested size 0x{:x}".format(
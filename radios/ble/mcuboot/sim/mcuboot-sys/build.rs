@@ -13,6 +13,51 @@ fn main() {
     let sig_ecdsa = env::var("CARGO_FEATURE_SIG_ECDSA").is_ok();
     let overwrite_only = env::var("CARGO_FEATURE_OVERWRITE_ONLY").is_ok();
     let validate_slot0 = env::var("CARGO_FEATURE_VALIDATE_SLOT0").is_ok();
+    let swap_move = env::var("CARGO_FEATURE_SWAP_MOVE").is_ok();
+    let validate_slot0_once = env::var("CARGO_FEATURE_VALIDATE_SLOT0_ONCE").is_ok();
+    let boot_serial = env::var("CARGO_FEATURE_BOOT_SERIAL").is_ok();
+
+    // Serial recovery is built the way the Zephyr port builds it, against
+    // Zephyr's tinycbor, base64 and crc16.  It goes first so it links
+    // ahead of the bootutil code it calls into.
+    if boot_serial {
+        let zephyr = env::var("ZEPHYR_BASE").unwrap_or("../../../zephyr".to_string());
+        let tinycbor = format!("{}/ext/lib/encoding/tinycbor/src", zephyr);
+
+        let mut serial = gcc::Build::new();
+        serial.define("__BOOTSIM__", None);
+        serial.define("__ZEPHYR__", None);
+        serial.define("MCUBOOT_HAVE_ASSERT_H", None);
+        serial.define("CONFIG_BOOT_MAX_LINE_INPUT_LEN", Some("1024"));
+        serial.define("CONFIG_BOOT_SERIAL_LINE_BUFS", Some("4"));
+        serial.define("CONFIG_BOOT_SERIAL_WRITE_BUF_SIZE", Some("1024"));
+        serial.define("CONFIG_BOOT_SERIAL_RAW", None);
+        serial.define("CONFIG_SYS_LOG_DEFAULT_LEVEL", Some("0"));
+        serial.define("CONFIG_SYS_LOG_OVERRIDE_LEVEL", Some("0"));
+        serial.include("csupport/zephyr");
+        serial.include("csupport");
+        serial.include("../../boot/bootutil/include");
+        serial.include("../../boot/zephyr/include");
+        serial.include("../../boot/boot_serial/include");
+        serial.include(&tinycbor);
+        serial.include(format!("{}/ext/lib/mgmt/mcumgr/cborattr/include", zephyr));
+        serial.include(format!("{}/include", zephyr));
+        serial.file("../../boot/boot_serial/src/boot_serial.c");
+        serial.file("csupport/serial.c");
+        serial.file(format!("{}/cborparser.c", tinycbor));
+        serial.file(format!("{}/cborencoder.c", tinycbor));
+        serial.file(format!("{}/cbor_buf_reader.c", tinycbor));
+        serial.file(format!("{}/cbor_buf_writer.c", tinycbor));
+        serial.file(format!("{}/lib/base64/base64.c", zephyr));
+        serial.file(format!("{}/lib/crc/crc16_sw.c", zephyr));
+        serial.debug(true);
+        serial.flag("-Wall");
+        // The Zephyr port leans on its own integer typedefs.
+        serial.flag("-Wno-pointer-sign");
+        serial.flag("-Wno-incompatible-pointer-types");
+        serial.flag("-std=gnu99");
+        serial.compile("libbootserial.a");
+    }
 
     let mut conf = gcc::Build::new();
     conf.define("__BOOTSIM__", None);
@@ -24,6 +69,10 @@ fn main() {
         conf.define("MCUBOOT_VALIDATE_SLOT0", None);
     }
 
+    if validate_slot0_once {
+        conf.define("MCUBOOT_VALIDATE_SLOT0_ONCE", None);
+    }
+
     // Currently, mbed TLS cannot build with both RSA and ECDSA.
     if sig_rsa && sig_ecdsa {
         panic!("mcuboot does not support RSA and ECDSA at the same time");
@@ -71,6 +120,13 @@ fn main() {
         conf.define("MCUBOOT_OVERWRITE_ONLY_FAST", None);
     }
 
+    if swap_move {
+        if overwrite_only {
+            panic!("swap-move and overwrite-only are mutually exclusive");
+        }
+        conf.define("MCUBOOT_SWAP_MOVE", None);
+    }
+
     conf.file("../../boot/bootutil/src/image_validate.c");
     if sig_rsa {
         conf.file("../../boot/bootutil/src/image_rsa.c");
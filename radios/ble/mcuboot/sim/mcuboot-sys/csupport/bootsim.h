@@ -3,4 +3,8 @@
 
 #include "mcuboot_config/mcuboot_assert.h"
 
+/* The flash the C code runs against, set by each invoke_* call. */
+struct area_desc;
+extern struct area_desc *flash_areas;
+
 #endif
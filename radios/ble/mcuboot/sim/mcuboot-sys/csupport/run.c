@@ -63,7 +63,7 @@ struct area_desc {
     uint32_t num_slots;
 };
 
-static struct area_desc *flash_areas;
+struct area_desc *flash_areas;
 
 void *(*mbedtls_calloc)(size_t n, size_t size);
 void (*mbedtls_free)(void *ptr);
@@ -0,0 +1,436 @@
+/* Drive serial recovery through an image upload, the way a host would. */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <crc16.h>
+#include <base64.h>
+#include <cbor.h>
+#include <misc/byteorder.h>
+#include <boot_serial/boot_serial.h>
+
+#include "../../../boot/boot_serial/src/boot_serial_priv.h"
+#include "bootsim.h"
+
+#define SERIAL_LINE_MAX     CONFIG_BOOT_MAX_LINE_INPUT_LEN
+#define SERIAL_PKT_MAX      (SERIAL_LINE_MAX + 64)
+
+#define CRC_CITT_POLYMINAL  0x1021
+
+#define RC_BAD_OFFSET       33
+
+/*
+ * One upload, set up by the caller.  The counters are filled in from what
+ * actually went over the stand-in console.
+ */
+struct serial_upload {
+    const uint8_t *img;
+    uint32_t len;
+    int slot;
+    int line_size;      /* base64 characters per line */
+    int chunk;          /* image bytes per upload request */
+    int window;         /* requests sent per reply waited for */
+    int raw;            /* raw frames instead of base64 lines */
+    uint32_t drop_off;  /* chunk lost on the way once, or UINT32_MAX */
+
+    uint32_t requests;
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    uint32_t replies;
+    uint32_t resumes;
+    uint32_t resume_off;
+    int flash_ops;
+};
+
+struct serial_params {
+    int buf_size;
+    int buf_count;
+    int raw;
+};
+
+extern int flash_counter;
+extern uint8_t sim_flash_align;
+
+/* What the device wrote to the console, one reply at a time. */
+static char out_buf[1024];
+static int out_len;
+static uint32_t out_total;
+
+/* The line buffer and decode buffer boot_serial_start() would own. */
+static char dec_buf[SERIAL_LINE_MAX + 1];
+static int dec_off;
+
+static uint8_t seq;
+
+void console_write(const char *str, int cnt)
+{
+    if (out_len + cnt <= (int)sizeof(out_buf)) {
+        memcpy(&out_buf[out_len], str, cnt);
+    }
+    out_len += cnt;
+    out_total += cnt;
+}
+
+void sys_reboot(int type)
+{
+    (void)type;
+}
+
+void k_sleep(int ms)
+{
+    (void)ms;
+}
+
+/*
+ * Hands a line to boot_serial the way boot_serial_start() does: the
+ * console keeps the newline, and counts the terminating NUL.
+ */
+static void serial_line(const char *data, int len, uint32_t *tx_bytes)
+{
+    char line[SERIAL_LINE_MAX + 1];
+
+    memcpy(line, data, len);
+    line[len] = '\0';
+    boot_serial_input_line(line, len + 1, dec_buf, &dec_off, sizeof(dec_buf));
+    *tx_bytes += len;
+}
+
+/* Sends a packet base64 encoded, with a length and CRC16, over lines. */
+static int serial_tx_b64(const uint8_t *pkt, int len, int line_size,
+                         uint32_t *tx_bytes)
+{
+    uint8_t frame[2 + SERIAL_PKT_MAX + 2];
+    uint8_t enc[(sizeof(frame) + 2) / 3 * 4 + 1];
+    char line[SERIAL_LINE_MAX];
+    size_t enc_len;
+    uint16_t crc;
+    size_t off;
+    int n;
+
+    if (len > SERIAL_PKT_MAX) {
+        return -1;
+    }
+    crc = crc16(pkt, len, CRC_CITT_POLYMINAL, 0, true);
+    frame[0] = (len + 2) >> 8;
+    frame[1] = len + 2;
+    memcpy(&frame[2], pkt, len);
+    frame[2 + len] = crc >> 8;
+    frame[3 + len] = crc;
+    if (base64_encode(enc, sizeof(enc), &enc_len, frame, len + 4)) {
+        return -1;
+    }
+
+    if (2 + line_size + 1 > SERIAL_LINE_MAX) {
+        return -1;
+    }
+    for (off = 0; off < enc_len; off += n) {
+        n = min((int)(enc_len - off), line_size);
+        if (off == 0) {
+            line[0] = SHELL_NLIP_PKT_START1;
+            line[1] = SHELL_NLIP_PKT_START2;
+        } else {
+            line[0] = SHELL_NLIP_DATA_START1;
+            line[1] = SHELL_NLIP_DATA_START2;
+        }
+        memcpy(&line[2], &enc[off], n);
+        line[2 + n] = '\n';
+        serial_line(line, 2 + n + 1, tx_bytes);
+    }
+    return 0;
+}
+
+/* Sends a packet as a raw frame: start bytes, length, packet and CRC32. */
+static int serial_tx_raw(const uint8_t *pkt, int len, uint32_t *tx_bytes)
+{
+    char frame[SERIAL_LINE_MAX];
+    uint32_t crc = 0xffffffff;
+    int i, b;
+
+    if (len + 8 > SERIAL_LINE_MAX) {
+        return -1;
+    }
+    for (i = 0; i < len; i++) {
+        crc ^= pkt[i];
+        for (b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    crc = ~crc;
+
+    frame[0] = BOOT_SERIAL_RAW_START1;
+    frame[1] = BOOT_SERIAL_RAW_START2;
+    frame[2] = (len + 4) >> 8;
+    frame[3] = len + 4;
+    memcpy(&frame[4], pkt, len);
+    frame[4 + len] = crc >> 24;
+    frame[5 + len] = crc >> 16;
+    frame[6 + len] = crc >> 8;
+    frame[7 + len] = crc;
+    serial_line(frame, len + 8, tx_bytes);
+    return 0;
+}
+
+/* Builds a newtmgr request around a CBOR map, returns its length. */
+static int serial_pkt(uint8_t *buf, int op, int group, int id,
+                      const uint8_t *cbor, int cbor_len)
+{
+    struct nmgr_hdr hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.nh_op = op;
+    hdr.nh_len = sys_cpu_to_be16(cbor_len);
+    hdr.nh_group = sys_cpu_to_be16(group);
+    hdr.nh_seq = seq++;
+    hdr.nh_id = id;
+    memcpy(buf, &hdr, sizeof(hdr));
+    memcpy(buf + sizeof(hdr), cbor, cbor_len);
+    return sizeof(hdr) + cbor_len;
+}
+
+/*
+ * Takes the reply the device wrote out, if any.  Returns 1 and the CBOR
+ * payload if there was exactly one well formed reply to the request, 0 if
+ * there was none, -1 if it was malformed.
+ */
+static int serial_reply(int op, int group, int id, uint8_t *cbor, int *cbor_len)
+{
+    uint8_t dec[sizeof(out_buf)];
+    struct nmgr_hdr hdr;
+    size_t dec_len;
+    uint16_t crc;
+    int len;
+
+    if (out_len == 0) {
+        return 0;
+    }
+    len = out_len;
+    out_len = 0;
+
+    /* One line: start bytes, base64, newline. */
+    if (len > (int)sizeof(out_buf) || len < 4 ||
+        out_buf[0] != SHELL_NLIP_PKT_START1 ||
+        out_buf[1] != SHELL_NLIP_PKT_START2 || out_buf[len - 1] != '\n' ||
+        memchr(out_buf, '\n', len - 1) != NULL) {
+        return -1;
+    }
+    if (base64_decode(dec, sizeof(dec), &dec_len, (uint8_t *)&out_buf[2],
+                      len - 3)) {
+        return -1;
+    }
+
+    /* Length, header, payload and CRC16 over the header and payload. */
+    if (dec_len < 2 + sizeof(hdr) + 2 ||
+        ((dec[0] << 8) | dec[1]) != (int)dec_len - 2) {
+        return -1;
+    }
+    crc = crc16(&dec[2], dec_len - 4, CRC_CITT_POLYMINAL, 0, true);
+    if (((dec[dec_len - 2] << 8) | dec[dec_len - 1]) != crc) {
+        return -1;
+    }
+    memcpy(&hdr, &dec[2], sizeof(hdr));
+    *cbor_len = dec_len - 4 - sizeof(hdr);
+    if (hdr.nh_op != op + 1 || sys_be16_to_cpu(hdr.nh_group) != group ||
+        hdr.nh_id != id || sys_be16_to_cpu(hdr.nh_len) != *cbor_len) {
+        return -1;
+    }
+    memcpy(cbor, &dec[2 + sizeof(hdr)], *cbor_len);
+    return 1;
+}
+
+/* Reads an unsigned field of a reply, -1 if it is missing. */
+static int64_t serial_field(CborValue *map, const char *name)
+{
+    CborValue value;
+    int64_t val;
+
+    if (cbor_value_map_find_value(map, name, &value) ||
+        !cbor_value_is_integer(&value) ||
+        cbor_value_get_int64(&value, &val)) {
+        return -1;
+    }
+    return val;
+}
+
+/*
+ * Asks for the input limits, as ble_mcuboot_prog does before choosing its
+ * chunk size and window.
+ */
+int invoke_serial_params(struct serial_params *params)
+{
+    uint8_t pkt[64];
+    uint8_t cbor[128];
+    uint32_t tx_bytes = 0;
+    CborParser parser;
+    CborValue map, value;
+    bool raw;
+    int len, rc;
+
+    out_len = 0;
+    len = serial_pkt(pkt, NMGR_OP_READ, MGMT_GROUP_ID_DEFAULT, NMGR_ID_PARAMS,
+                     (const uint8_t *)"\xa0", 1);
+    if (serial_tx_b64(pkt, len, 124, &tx_bytes)) {
+        return -1;
+    }
+    rc = serial_reply(NMGR_OP_READ, MGMT_GROUP_ID_DEFAULT, NMGR_ID_PARAMS,
+                      cbor, &len);
+    if (rc != 1 || cbor_parser_init(cbor, len, 0, &parser, &map)) {
+        return -1;
+    }
+
+    params->buf_size = serial_field(&map, "buf_size");
+    params->buf_count = serial_field(&map, "buf_count");
+    if (cbor_value_map_find_value(&map, "raw", &value) ||
+        !cbor_value_is_boolean(&value) ||
+        cbor_value_get_boolean(&value, &raw)) {
+        return -1;
+    }
+    params->raw = raw;
+    return 0;
+}
+
+/* Encodes the upload request for the chunk at off. */
+static int serial_upload_pkt(uint8_t *pkt, struct serial_upload *up,
+                             uint32_t off, int cnt, bool ack)
+{
+    uint8_t cbor[SERIAL_PKT_MAX];
+    CborEncoder enc, map;
+
+    cbor_encoder_init(&enc, cbor, sizeof(cbor), 0);
+    cbor_encoder_create_map(&enc, &map, CborIndefiniteLength);
+    cbor_encode_text_stringz(&map, "data");
+    cbor_encode_byte_string(&map, &up->img[off], cnt);
+    cbor_encode_text_stringz(&map, "off");
+    cbor_encode_uint(&map, off);
+    if (off == 0) {
+        // Slot goes in the top byte of the length
+        cbor_encode_text_stringz(&map, "len");
+        cbor_encode_uint(&map, ((uint32_t)up->slot << 24) | up->len);
+    }
+    if (!ack) {
+        cbor_encode_text_stringz(&map, "ack");
+        cbor_encode_boolean(&map, false);
+    }
+    if (cbor_encoder_close_container(&enc, &map)) {
+        return -1;
+    }
+
+    return serial_pkt(pkt, NMGR_OP_WRITE, MGMT_GROUP_ID_IMAGE,
+                      IMGMGR_NMGR_OP_UPLOAD, cbor,
+                      cbor_encoder_get_buffer_size(&enc, cbor));
+}
+
+/*
+ * Uploads the image in windows of chunks, asking for a reply to the last
+ * one of each only.  The chunk at drop_off is lost on the way once; the
+ * reply to the next one must then tell the host to resume from there, and
+ * the rest of that window must get no reply at all.
+ *
+ * Returns 0 when the whole image was acknowledged, or the number of the
+ * check that failed.
+ */
+static int serial_upload(struct serial_upload *up)
+{
+    uint8_t pkt[SERIAL_PKT_MAX];
+    uint8_t cbor[128];
+    uint32_t drop_off = up->drop_off;
+    uint32_t dropped;
+    uint32_t off, next;
+    CborParser parser;
+    CborValue map;
+    int64_t rc, rsp_off;
+    bool last;
+    int cnt, len, res;
+    int i;
+
+    out_len = 0;
+    out_total = 0;
+    dec_off = 0;
+    up->requests = 0;
+    up->tx_bytes = 0;
+    up->replies = 0;
+    up->resumes = 0;
+    up->resume_off = UINT32_MAX;
+
+    off = 0;
+    while (off < up->len) {
+        dropped = UINT32_MAX;
+        for (i = 0; i < up->window; i++) {
+            cnt = min(up->chunk, (int)(up->len - off));
+            // The first chunk erases the slot, always wait for it
+            last = off == 0 || i == up->window - 1 || off + cnt == up->len;
+            len = serial_upload_pkt(pkt, up, off, cnt, last);
+            if (len < 0) {
+                return 1;
+            }
+            if (off == drop_off) {
+                drop_off = UINT32_MAX;
+                dropped = off;
+            } else {
+                res = up->raw ? serial_tx_raw(pkt, len, &up->tx_bytes) :
+                                serial_tx_b64(pkt, len, up->line_size,
+                                              &up->tx_bytes);
+                if (res) {
+                    return 2;
+                }
+                up->requests++;
+
+                // Only the last request of a window, or the first one
+                // after a lost chunk, may be answered
+                res = serial_reply(NMGR_OP_WRITE, MGMT_GROUP_ID_IMAGE,
+                                   IMGMGR_NMGR_OP_UPLOAD, cbor, &len);
+                if (res < 0) {
+                    return 3;
+                }
+                if (res > 0) {
+                    up->replies++;
+                    if (cbor_parser_init(cbor, len, 0, &parser, &map)) {
+                        return 4;
+                    }
+                    rc = serial_field(&map, "rc");
+                    rsp_off = serial_field(&map, "off");
+                    if (dropped != UINT32_MAX) {
+                        if (rc != RC_BAD_OFFSET || rsp_off != dropped ||
+                            off != dropped + up->chunk) {
+                            return 5;
+                        }
+                        up->resumes++;
+                        up->resume_off = rsp_off;
+                    } else if (!last || rc != 0 || rsp_off != off + cnt) {
+                        return 6;
+                    }
+                } else if (last && dropped == UINT32_MAX) {
+                    return 7;
+                }
+            }
+            off += cnt;
+            if (last) {
+                break;
+            }
+        }
+
+        // The host resumes from the offset in the reply
+        next = (dropped != UINT32_MAX) ? up->resume_off : off;
+        if (dropped != UINT32_MAX && up->resume_off != dropped) {
+            return 8;
+        }
+        off = next;
+    }
+
+    return 0;
+}
+
+int invoke_serial_upload(struct area_desc *adesc, uint8_t align,
+                         struct serial_upload *up)
+{
+    int rc;
+
+    flash_areas = adesc;
+    sim_flash_align = align;
+    flash_counter = 0;
+    rc = serial_upload(up);
+    up->rx_bytes = out_total;
+    up->flash_ops = -flash_counter;
+    flash_areas = NULL;
+    return rc;
+}
@@ -0,0 +1,4 @@
+/*
+ * Stand-in for the Zephyr flash driver header.  boot_serial only uses
+ * the flash map, which the simulator provides.
+ */
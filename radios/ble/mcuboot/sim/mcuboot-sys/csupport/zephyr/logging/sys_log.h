@@ -0,0 +1,31 @@
+/*
+ * Stand-in for the Zephyr logging header, for building boot_serial in
+ * the simulator.  Messages go through the simulator's log control.
+ */
+
+#ifndef H_SIM_SYS_LOG_
+#define H_SIM_SYS_LOG_
+
+#include <stdio.h>
+
+#define SYS_LOG_LEVEL_OFF       0
+#define SYS_LOG_LEVEL_ERROR     1
+#define SYS_LOG_LEVEL_WARNING   2
+#define SYS_LOG_LEVEL_INFO      3
+#define SYS_LOG_LEVEL_DEBUG     4
+
+int sim_log_enabled(int level);
+
+#define SIM_SYS_LOG(_level, _tag, _fmt, ...)                            \
+    do {                                                                \
+        if (_level <= SYS_LOG_LEVEL && sim_log_enabled(_level)) {       \
+            fprintf(stderr, "[" _tag "] " _fmt "\n", ##__VA_ARGS__);    \
+        }                                                               \
+    } while (0)
+
+#define SYS_LOG_ERR(...) SIM_SYS_LOG(SYS_LOG_LEVEL_ERROR, "ERR", __VA_ARGS__)
+#define SYS_LOG_WRN(...) SIM_SYS_LOG(SYS_LOG_LEVEL_WARNING, "WRN", __VA_ARGS__)
+#define SYS_LOG_INF(...) SIM_SYS_LOG(SYS_LOG_LEVEL_INFO, "INF", __VA_ARGS__)
+#define SYS_LOG_DBG(...) SIM_SYS_LOG(SYS_LOG_LEVEL_DEBUG, "DBG", __VA_ARGS__)
+
+#endif /* H_SIM_SYS_LOG_ */
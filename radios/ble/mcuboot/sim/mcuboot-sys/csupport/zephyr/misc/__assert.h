@@ -0,0 +1,10 @@
+/*
+ * Stand-in for the Zephyr assert header.
+ */
+
+#ifndef H_SIM_ASSERT_
+#define H_SIM_ASSERT_
+
+#include <assert.h>
+
+#endif /* H_SIM_ASSERT_ */
@@ -0,0 +1,15 @@
+/*
+ * Stand-in for the Zephyr byte order header.  The simulator only runs on
+ * little endian hosts.
+ */
+
+#ifndef H_SIM_BYTEORDER_
+#define H_SIM_BYTEORDER_
+
+#include <stdint.h>
+#include <misc/util.h>
+
+#define sys_be16_to_cpu(x) ((uint16_t)__builtin_bswap16(x))
+#define sys_cpu_to_be16(x) ((uint16_t)__builtin_bswap16(x))
+
+#endif /* H_SIM_BYTEORDER_ */
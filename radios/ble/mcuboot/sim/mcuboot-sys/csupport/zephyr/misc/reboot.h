@@ -0,0 +1,14 @@
+/*
+ * Stand-in for the Zephyr reboot header.  The simulator ignores resets.
+ */
+
+#ifndef H_SIM_REBOOT_
+#define H_SIM_REBOOT_
+
+#define SYS_REBOOT_WARM 0
+#define SYS_REBOOT_COLD 1
+
+void sys_reboot(int type);
+void k_sleep(int ms);
+
+#endif /* H_SIM_REBOOT_ */
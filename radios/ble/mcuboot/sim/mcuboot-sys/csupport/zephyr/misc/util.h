@@ -0,0 +1,16 @@
+/*
+ * Stand-in for the Zephyr utility macros.
+ */
+
+#ifndef H_SIM_UTIL_
+#define H_SIM_UTIL_
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#endif /* H_SIM_UTIL_ */
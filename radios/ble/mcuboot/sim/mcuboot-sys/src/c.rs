@@ -59,6 +59,70 @@ pub fn ecdsa256_sign(privkey: &[u8], hash: &[u8]) -> Result<[u8; 64], &'static s
     }
 }
 
+/// The input limits serial recovery reports to the host.
+#[cfg(feature = "boot-serial")]
+#[repr(C)]
+#[derive(Debug, Default)]
+pub struct SerialParams {
+    pub buf_size: libc::c_int,
+    pub buf_count: libc::c_int,
+    pub raw: libc::c_int,
+}
+
+/// One image upload through serial recovery.  The first fields describe how
+/// the host sends it, the rest are counted while it goes.
+#[cfg(feature = "boot-serial")]
+#[repr(C)]
+#[derive(Debug)]
+pub struct SerialUpload {
+    pub img: *const u8,
+    pub len: u32,
+    pub slot: libc::c_int,
+    pub line_size: libc::c_int,
+    pub chunk: libc::c_int,
+    pub window: libc::c_int,
+    pub raw: libc::c_int,
+    pub drop_off: u32,
+
+    pub requests: u32,
+    pub tx_bytes: u32,
+    pub rx_bytes: u32,
+    pub replies: u32,
+    pub resumes: u32,
+    pub resume_off: u32,
+    pub flash_ops: libc::c_int,
+}
+
+/// Ask serial recovery for its input limits.
+#[cfg(feature = "boot-serial")]
+pub fn serial_params() -> Result<SerialParams, i32> {
+    let _lock = BOOT_LOCK.lock().unwrap();
+    let mut params = SerialParams::default();
+
+    match unsafe { raw::invoke_serial_params(&mut params) } {
+        0 => Ok(params),
+        rc => Err(rc as i32),
+    }
+}
+
+/// Upload an image through serial recovery into this flash device.  Returns
+/// the number of the check that failed on the replies, if any.
+#[cfg(feature = "boot-serial")]
+pub fn serial_upload(flash: &mut Flash, areadesc: &AreaDesc, align: u8,
+                     upload: &mut SerialUpload) -> Result<(), i32> {
+    let _lock = BOOT_LOCK.lock().unwrap();
+
+    unsafe { api::set_flash(flash); }
+    let result = unsafe {
+        raw::invoke_serial_upload(&areadesc.get_c() as *const _, align, upload) as i32
+    };
+    unsafe { api::clear_flash(); }
+    match result {
+        0 => Ok(()),
+        rc => Err(rc),
+    }
+}
+
 mod raw {
     use area::CAreaDesc;
     use libc;
@@ -81,5 +145,11 @@ mod raw {
         pub fn ecdsa256_sign_(privkey: *const u8, hash: *const u8,
                               hash_len: libc::c_uint,
                               signature: *mut u8) -> libc::c_int;
+
+        #[cfg(feature = "boot-serial")]
+        pub fn invoke_serial_params(params: *mut super::SerialParams) -> libc::c_int;
+        #[cfg(feature = "boot-serial")]
+        pub fn invoke_serial_upload(areadesc: *const CAreaDesc, align: u8,
+                                    upload: *mut super::SerialUpload) -> libc::c_int;
     }
 }
@@ -9,6 +9,7 @@ extern crate rand;
 mod pdump;
 
 use rand::distributions::{IndependentSample, Range};
+use std::cell::Cell;
 use std::fs::File;
 use std::io::Write;
 use std::iter::Enumerate;
@@ -72,6 +73,11 @@ pub struct SimFlash {
     // Alignment required for writes.
     align: usize,
     verify_writes: bool,
+    // Bytes erased and written so far, to compare upgrade strategies.
+    erased: usize,
+    written: usize,
+    // Bytes read so far, to compare boot paths.
+    read: Cell<usize>,
 }
 
 impl SimFlash {
@@ -89,9 +95,22 @@ impl SimFlash {
             bad_region: Vec::new(),
             align: align,
             verify_writes: true,
+            erased: 0,
+            written: 0,
+            read: Cell::new(0),
         }
     }
 
+    /// Number of bytes erased and written on this device so far.
+    pub fn usage(&self) -> (usize, usize) {
+        (self.erased, self.written)
+    }
+
+    /// Number of bytes read from this device so far.
+    pub fn bytes_read(&self) -> usize {
+        self.read.get()
+    }
+
     #[allow(dead_code)]
     pub fn dump(&self) {
         self.data.dump();
@@ -143,6 +162,7 @@ impl Flash for SimFlash {
             *x = true;
         }
 
+        self.erased += len;
         Ok(())
     }
 
@@ -188,6 +208,7 @@ impl Flash for SimFlash {
 
         let sub = &mut self.data[offset .. offset + payload.len()];
         sub.copy_from_slice(payload);
+        self.written += payload.len();
         Ok(())
     }
 
@@ -199,6 +220,7 @@ impl Flash for SimFlash {
 
         let sub = &self.data[offset .. offset + data.len()];
         data.copy_from_slice(sub);
+        self.read.set(self.read.get() + data.len());
         Ok(())
     }
 
@@ -9,6 +9,7 @@ pub enum Caps {
     EcdsaP256        = (1 << 2),
     SwapUpgrade      = (1 << 3),
     OverwriteUpgrade = (1 << 4),
+    SwapMove         = (1 << 5),
 }
 
 impl Caps {
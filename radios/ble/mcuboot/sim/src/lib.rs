@@ -18,6 +18,8 @@ use std::fmt;
 use std::mem;
 use std::process;
 use std::slice;
+#[cfg(feature = "validate-slot0-once")]
+use std::time::{Duration, Instant};
 
 mod caps;
 mod tlv;
@@ -59,6 +61,7 @@ struct Args {
 #[derive(Copy, Clone, Debug, Deserialize)]
 pub enum DeviceName { Stm32f4, K64f, K64fBig, Nrf52840 }
 
+#[cfg(not(feature = "swap-move"))]
 pub static ALL_DEVICES: &'static [DeviceName] = &[
     DeviceName::Stm32f4,
     DeviceName::K64f,
@@ -66,6 +69,22 @@ pub static ALL_DEVICES: &'static [DeviceName] = &[
     DeviceName::Nrf52840,
 ];
 
+// Swap-move shifts slot 0 by one sector, so the slots have to be made of
+// several equally sized sectors.
+#[cfg(feature = "swap-move")]
+pub static ALL_DEVICES: &'static [DeviceName] = &[
+    DeviceName::K64f,
+    DeviceName::Nrf52840,
+];
+
+// The validation marker sits in the slot 0 trailer between the swap status
+// and the flags.
+#[cfg(feature = "validate-slot0-once")]
+const BOOT_MARKER_SZ: usize = 32;
+#[cfg(not(feature = "validate-slot0-once"))]
+#[allow(dead_code)]
+const BOOT_MARKER_SZ: usize = 0;
+
 impl fmt::Display for DeviceName {
     fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
         let name = match *self {
@@ -287,6 +306,7 @@ impl RunStatus {
 
         let images = run.make_no_upgrade_image();
         failed |= images.run_norevert_newimage();
+        failed |= images.run_validate_once();
 
         let images = run.make_image();
 
@@ -372,6 +392,12 @@ impl Images {
         let (fl, total_count) = try_upgrade(&self.flash, &self, None);
         info!("Total flash operation count={}", total_count);
 
+        let (erased, written) = fl.usage();
+        let (erased0, written0) = self.flash.usage();
+        info!("Upgrade erased {} bytes, wrote {} bytes, ~{} ms on nRF52840",
+              erased - erased0, written - written0,
+              nrf52840_upgrade_ms(erased - erased0, written - written0));
+
         if !verify_image(&fl, self.slot0.base_off, &self.upgrade) {
             warn!("Image mismatch after first boot");
             Err(())
@@ -667,6 +693,198 @@ impl Images {
         fails > 0
     }
 
+    /// Boots the image in slot 0 twice, checking that the marker recorded
+    /// by the first boot saves hashing the image on the second one, and
+    /// that changes to the header, the TLVs or the marker still lead to a
+    /// full validation.
+    #[cfg(not(feature = "validate-slot0-once"))]
+    pub fn run_validate_once(&self) -> bool { false }
+
+    #[cfg(feature = "validate-slot0-once")]
+    pub fn run_validate_once(&self) -> bool {
+        let mut fl = self.flash.clone();
+        let mut fails = 0;
+
+        info!("Try validating slot 0 once");
+
+        let (result, full_read, full_time) = timed_boot(&mut fl, self);
+        if result != 0 {
+            warn!("Failed first boot");
+            fails += 1;
+        }
+
+        let (result, fast_read, fast_time) = timed_boot(&mut fl, self);
+        if result != 0 {
+            warn!("Failed boot with marker");
+            fails += 1;
+        }
+
+        info!("Boot read {} bytes in {:?} with full validation, {} bytes in {:?} with marker",
+              full_read, full_time, fast_read, fast_time);
+        if fast_read * 4 > full_read {
+            warn!("Marker did not save hashing the image");
+            fails += 1;
+        }
+
+        // The TLVs follow the 32 byte header and the image (ih_img_size).
+        let hdr_off = self.slot0.base_off;
+        let img_size = self.primary[12] as usize | (self.primary[13] as usize) << 8 |
+            (self.primary[14] as usize) << 16 | (self.primary[15] as usize) << 24;
+        let tlv_off = hdr_off + 32 + img_size;
+        let marker_off = self.slot0.trailer_off - c::boot_max_align() - BOOT_MARKER_SZ;
+
+        // A stale marker is not trusted: the image is still good, but it
+        // is validated in full on every boot from now on.
+        let mut tfl = fl.clone();
+        flip_byte(&mut tfl, marker_off, self.align);
+        for _ in 0 .. 2 {
+            let (result, read, _) = timed_boot(&mut tfl, self);
+            if result != 0 {
+                warn!("Failed boot with stale marker");
+                fails += 1;
+            }
+            if read * 2 < full_read {
+                warn!("Stale marker skipped the full validation");
+                fails += 1;
+            }
+        }
+
+        // Changes to the header (ih_ver.iv_revision) or to the hash in the
+        // SHA256 TLV must be caught.
+        for &(off, what) in &[(hdr_off + 22, "header"), (tlv_off + 8, "TLVs")] {
+            let mut tfl = fl.clone();
+            flip_byte(&mut tfl, off, self.align);
+            let (result, asserts) = c::boot_go(&mut tfl, &self.areadesc, None,
+                                               self.align, true);
+            if result == 0 || asserts == 0 {
+                warn!("Booted an image with tampered {}", what);
+                fails += 1;
+            }
+        }
+
+        if fails > 0 {
+            error!("Error validating slot 0 once");
+        }
+
+        fails > 0
+    }
+
+    /// Uploads an image through serial recovery the way ble_mcuboot_prog
+    /// does, with the old one reply per chunk and then with windows sized
+    /// from the reported input limits, over base64 lines and raw frames.
+    /// One chunk of each windowed upload is lost on the way, and the
+    /// replies have to bring the host back to it.
+    #[cfg(not(feature = "boot-serial"))]
+    pub fn run_serial_upload(&self) -> bool { false }
+
+    #[cfg(feature = "boot-serial")]
+    pub fn run_serial_upload(&self) -> bool {
+        // Host side sizing, as in ble_mcuboot_prog.
+        const UPLOAD_OVERHEAD: i32 = 64;
+        const LEGACY_LINE_SIZE: i32 = 124;
+        const LEGACY_CHUNK_SIZE: i32 = 196;
+        const IMAGE_SIZE: usize = 10001;
+
+        let mut fails = 0;
+
+        info!("Try serial upload");
+
+        let params = match c::serial_params() {
+            Ok(p) => p,
+            Err(rc) => {
+                error!("Serial params request failed ({})", rc);
+                return true;
+            }
+        };
+        if params.buf_size != 1024 || params.buf_count != 4 || params.raw == 0 {
+            warn!("Unexpected serial params {:?}", params);
+            fails += 1;
+        }
+
+        let line_size = ((params.buf_size - 3) / 4) * 4;
+        let b64_chunk = (((line_size / 4) * 3) - 4 - UPLOAD_OVERHEAD) & !3;
+        let raw_chunk = (params.buf_size - 8 - UPLOAD_OVERHEAD) & !3;
+        let window = if params.buf_count > 2 { params.buf_count - 1 } else { 1 };
+
+        let image: Vec<u8> = (0 .. IMAGE_SIZE).map(|i| (i * 7 + (i >> 8)) as u8).collect();
+
+        // Drop a chunk in the middle of a window over base64, and the first
+        // of a window over raw frames.
+        let links = [
+            ("legacy", 0, LEGACY_LINE_SIZE, LEGACY_CHUNK_SIZE, 1, false, None),
+            ("windowed base64", 0, line_size, b64_chunk, window, false, Some(5)),
+            ("windowed raw", 1, line_size, raw_chunk, window, true, Some(7)),
+        ];
+
+        let mut legacy_replies = 0;
+        for &(name, slot, line_size, chunk, window, raw, drop) in &links {
+            let mut fl = self.flash.clone();
+            let mut up = c::SerialUpload {
+                img: image.as_ptr(),
+                len: image.len() as u32,
+                slot: slot,
+                line_size: line_size,
+                chunk: chunk,
+                window: window,
+                raw: if raw { 1 } else { 0 },
+                drop_off: drop.map_or(u32::max_value(), |n| (n * chunk) as u32),
+                requests: 0,
+                tx_bytes: 0,
+                rx_bytes: 0,
+                replies: 0,
+                resumes: 0,
+                resume_off: 0,
+                flash_ops: 0,
+            };
+
+            if let Err(rc) = c::serial_upload(&mut fl, &self.areadesc, self.align, &mut up) {
+                warn!("{} upload failed check {}", name, rc);
+                fails += 1;
+                continue;
+            }
+
+            info!("{} upload: {} byte chunks, {} requests, {} round trips, \
+                   {} bytes sent, {} bytes received, {} flash writes and erases",
+                  name, chunk, up.requests, up.replies, up.tx_bytes, up.rx_bytes,
+                  up.flash_ops);
+
+            let base = if slot == 0 { self.slot0.base_off } else { self.slot1.base_off };
+            let mut copy = vec![0u8; image.len()];
+            fl.read(base, &mut copy).unwrap();
+            if copy != image {
+                warn!("{} upload left the wrong data in slot {}", name, slot);
+                fails += 1;
+            }
+
+            let expect_resumes = if drop.is_some() { 1 } else { 0 };
+            if up.resumes != expect_resumes ||
+                (drop.is_some() && up.resume_off != up.drop_off) {
+                warn!("{} upload resumed {} times, at {}", name, up.resumes, up.resume_off);
+                fails += 1;
+            }
+
+            // One erase, then whole write buffers.
+            let writes = (image.len() + 1023) / 1024;
+            if up.flash_ops != 1 + writes as i32 {
+                warn!("{} upload took {} flash operations", name, up.flash_ops);
+                fails += 1;
+            }
+
+            if window == 1 {
+                legacy_replies = up.replies;
+            } else if up.replies * 2 > legacy_replies {
+                warn!("{} upload waited for {} replies", name, up.replies);
+                fails += 1;
+            }
+        }
+
+        if fails > 0 {
+            error!("Error in serial upload");
+        }
+
+        fails > 0
+    }
+
     #[cfg(not(feature = "overwrite-only"))]
     fn trailer_sz(&self) -> usize {
         c::boot_trailer_sz(self.align) as usize
@@ -675,7 +893,7 @@ impl Images {
     // FIXME: could get status sz from bootloader
     #[cfg(not(feature = "overwrite-only"))]
     fn status_sz(&self) -> usize {
-        self.trailer_sz() - (16 + 24)
+        self.trailer_sz() - (16 + 24) - BOOT_MARKER_SZ
     }
 
     /// This test runs a simple upgrade with no fails in the images, but
@@ -963,6 +1181,36 @@ fn try_random_fails(flash: &SimFlash, images: &Images,
     (fl, resets)
 }
 
+/// Run the bootloader once, returning its result, the number of bytes it
+/// read from flash and the time it took.
+#[cfg(feature = "validate-slot0-once")]
+fn timed_boot(flash: &mut SimFlash, images: &Images) -> (i32, usize, Duration) {
+    let read0 = flash.bytes_read();
+    let start = Instant::now();
+    let (result, _) = c::boot_go(flash, &images.areadesc, None, images.align, false);
+    let elapsed = start.elapsed();
+    (result, flash.bytes_read() - read0, elapsed)
+}
+
+/// Invert one byte of already written flash.
+#[cfg(feature = "validate-slot0-once")]
+fn flip_byte(flash: &mut SimFlash, offset: usize, align: u8) {
+    let align = align as usize;
+    let base = offset & !(align - 1);
+    let mut buf = vec![0u8; align];
+    flash.read(base, &mut buf).unwrap();
+    buf[offset - base] = !buf[offset - base];
+    flash.set_verify_writes(false);
+    flash.write(base, &buf).unwrap();
+    flash.set_verify_writes(true);
+}
+
+/// Rough time taken by the flash operations of an upgrade on the nRF52840:
+/// 85 ms per 4 KiB page erase and 41 us per 32-bit word written.
+fn nrf52840_upgrade_ms(erased: usize, written: usize) -> usize {
+    erased / 4096 * 85 + written / 4 * 41 / 1000
+}
+
 /// Show the flash layout.
 #[allow(dead_code)]
 fn show_flash(flash: &Flash) {
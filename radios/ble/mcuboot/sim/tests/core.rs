@@ -22,6 +22,7 @@ macro_rules! sim_test {
 
 sim_test!(bad_slot1, make_bad_slot1_image, run_signfail_upgrade);
 sim_test!(norevert_newimage, make_no_upgrade_image, run_norevert_newimage);
+sim_test!(validate_once, make_no_upgrade_image, run_validate_once);
 sim_test!(basic_revert, make_image, run_basic_revert);
 sim_test!(revert_with_fails, make_image, run_revert_with_fails);
 sim_test!(perm_with_fails, make_image, run_perm_with_fails);
@@ -29,3 +30,4 @@ sim_test!(perm_with_random_fails, make_image, run_perm_with_random_fails_5);
 sim_test!(norevert, make_image, run_norevert);
 sim_test!(status_write_fails_complete, make_image, run_with_status_fails_complete);
 sim_test!(status_write_fails_with_reset, make_image, run_with_status_fails_with_reset);
+sim_test!(serial_upload, make_no_upgrade_image, run_serial_upload);
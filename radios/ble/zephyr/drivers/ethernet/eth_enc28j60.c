@@ -556,7 +556,8 @@ static int eth_enc28j60_rx(struct device *dev)
 			size_t spi_frame_len;
 
 			/* Reserve a data frag to receive the frame */
-			pkt_buf = net_pkt_get_frag(pkt, config->timeout);
+			pkt_buf = net_pkt_get_frag_len(pkt, frm_len,
+						       config->timeout);
 			if (!pkt_buf) {
 				SYS_LOG_ERR("Could not allocate data buffer");
 				net_pkt_unref(pkt);
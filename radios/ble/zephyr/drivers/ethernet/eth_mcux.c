@@ -461,7 +461,7 @@ static void eth_rx(struct device *iface)
 		struct net_buf *pkt_buf;
 		size_t frag_len;
 
-		pkt_buf = net_pkt_get_frag(pkt, K_NO_WAIT);
+		pkt_buf = net_pkt_get_frag_len(pkt, frame_length, K_NO_WAIT);
 		if (!pkt_buf) {
 			irq_unlock(imask);
 			SYS_LOG_ERR("Failed to get fragment buf");
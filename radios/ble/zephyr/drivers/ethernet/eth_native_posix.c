@@ -168,7 +168,7 @@ static int read_data(struct eth_context *ctx, int fd)
 	}
 
 	do {
-		frag = net_pkt_get_frag(pkt, NET_BUF_TIMEOUT);
+		frag = net_pkt_get_frag_len(pkt, ret, NET_BUF_TIMEOUT);
 		if (!frag) {
 			net_pkt_unref(pkt);
 			return -ENOMEM;
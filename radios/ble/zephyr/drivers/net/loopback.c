@@ -34,6 +34,44 @@ static void loopback_init(struct net_if *iface)
 			     NET_LINK_DUMMY);
 }
 
+#if defined(CONFIG_NET_LOOPBACK_ZERO_COPY)
+/* The sent packet can be received as is if the caller gave away the
+ * only reference to it and none of its fragments are shared.
+ */
+static bool loopback_can_steal(struct net_pkt *pkt)
+{
+	struct net_buf *frag;
+
+	if (pkt->ref != 1) {
+		return false;
+	}
+
+	for (frag = pkt->frags; frag; frag = frag->frags) {
+		if (frag->ref != 1) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static struct net_pkt *loopback_steal(struct net_pkt *pkt)
+{
+	/* Forget the TX state, like net_pkt_clone() would */
+	net_pkt_set_sent(pkt, false);
+	net_pkt_set_queued(pkt, false);
+	net_pkt_set_next_hdr(pkt, NULL);
+#if defined(CONFIG_NET_ROUTE)
+	net_pkt_set_forwarding(pkt, false);
+#endif
+
+	return pkt;
+}
+#else
+#define loopback_can_steal(pkt) false
+#define loopback_steal(pkt) NULL
+#endif
+
 static int loopback_send(struct net_if *iface, struct net_pkt *pkt)
 {
 	struct net_pkt *cloned;
@@ -64,6 +102,19 @@ static int loopback_send(struct net_if *iface, struct net_pkt *pkt)
 		net_ipaddr_copy(&NET_IPV4_HDR(pkt)->dst, &addr);
 	}
 
+	if (loopback_can_steal(pkt)) {
+		/* Nobody else can see the packet, so the receive path
+		 * can have it and drop it when done, just like a normal
+		 * driver would drop a sent packet.
+		 */
+		res = net_recv_data(iface, loopback_steal(pkt));
+		if (res < 0) {
+			SYS_LOG_ERR("Data receive failed.");
+		}
+
+		goto out;
+	}
+
 	/* We should simulate normal driver meaning that if the packet is
 	 * properly sent (which is always in this driver), then the packet
 	 * must be dropped. This is very much needed for TCP packets where
@@ -78,6 +129,7 @@ static int loopback_send(struct net_if *iface, struct net_pkt *pkt)
 	res = net_recv_data(iface, cloned);
 	if (res < 0) {
 		SYS_LOG_ERR("Data receive failed.");
+		net_pkt_unref(cloned);
 		goto out;
 	}
 
@@ -45,10 +45,9 @@ struct slip_context {
 	bool first;		/* SLIP received it's byte or not after
 				 * driver initialization or SLIP_END byte.
 				 */
-	u8_t buf[1];		/* SLIP data is read into this buf */
+	u8_t buf[CONFIG_SLIP_RX_BUF_SIZE]; /* SLIP data is read into this buf */
 	struct net_pkt *rx;	/* and then placed into this net_pkt */
 	struct net_buf *last;	/* Pointer to last fragment in the list */
-	u8_t *ptr;		/* Where in net_pkt to add data */
 	struct net_if *iface;
 	u8_t state;
 
@@ -56,10 +55,11 @@ struct slip_context {
 	struct net_linkaddr ll_addr;
 
 #if defined(CONFIG_SLIP_STATISTICS)
-#define SLIP_STATS(statement)
-#else
-	u16_t garbage;
+	u16_t garbage;		/* Frames dropped due to a bad escape */
+	u16_t dropped;		/* Frames dropped due to lack of buffers */
 #define SLIP_STATS(statement) statement
+#else
+#define SLIP_STATS(statement)
 #endif
 };
 
@@ -157,6 +157,35 @@ static void slip_writeb_esc(unsigned char c)
 	}
 }
 
+/**
+ *  @brief Write a span of data to SLIP, escaping END and ESC characters
+ *
+ *  Runs of bytes that need no escaping are passed to the UART in one go.
+ *
+ *  @param ptr  data to write
+ *  @param len  length of the data
+ */
+static void slip_write_esc(const u8_t *ptr, size_t len)
+{
+	const u8_t *end = ptr + len;
+
+	while (ptr < end) {
+		const u8_t *run = ptr;
+
+		while (ptr < end && *ptr != SLIP_END && *ptr != SLIP_ESC) {
+			ptr++;
+		}
+
+		if (ptr > run) {
+			uart_pipe_send(run, ptr - run);
+		}
+
+		if (ptr < end) {
+			slip_writeb_esc(*ptr++);
+		}
+	}
+}
+
 static int slip_send(struct net_if *iface, struct net_pkt *pkt)
 {
 	struct net_buf *frag;
@@ -164,9 +193,6 @@ static int slip_send(struct net_if *iface, struct net_pkt *pkt)
 	u16_t ll_reserve = net_pkt_ll_reserve(pkt);
 	bool send_header_once = false;
 #endif
-	u8_t *ptr;
-	u16_t i;
-	u8_t c;
 
 	if (!pkt->frags) {
 		/* No data? */
@@ -181,13 +207,9 @@ static int slip_send(struct net_if *iface, struct net_pkt *pkt)
 #endif
 
 #if defined(CONFIG_SLIP_TAP)
-		ptr = frag->data - ll_reserve;
-
 		/* This writes ethernet header */
 		if (!send_header_once && ll_reserve) {
-			for (i = 0; i < ll_reserve; i++) {
-				slip_writeb_esc(*ptr++);
-			}
+			slip_write_esc(frag->data - ll_reserve, ll_reserve);
 		}
 
 		if (net_if_get_mtu(iface) > net_buf_headroom(frag)) {
@@ -197,17 +219,10 @@ static int slip_send(struct net_if *iface, struct net_pkt *pkt)
 			 */
 			send_header_once = true;
 			ll_reserve = 0;
-			ptr = frag->data;
 		}
-#else
-		/* There is no ll header in tun device */
-		ptr = frag->data;
 #endif
 
-		for (i = 0; i < frag->len; ++i) {
-			c = *ptr++;
-			slip_writeb_esc(c);
-		}
+		slip_write_esc(frag->data, frag->len);
 
 #if SYS_LOG_LEVEL >= SYS_LOG_LEVEL_DEBUG
 		SYS_LOG_DBG("sent data %d bytes",
@@ -290,154 +305,193 @@ static void process_msg(struct slip_context *slip)
 	slip->last = NULL;
 }
 
-static inline int slip_input_byte(struct slip_context *slip,
-				  unsigned char c)
+static void slip_drop(struct slip_context *slip)
 {
-	switch (slip->state) {
-	case STATE_GARBAGE:
-		if (c == SLIP_END) {
-			slip->state = STATE_OK;
-		}
-
-		return 0;
-	case STATE_ESC:
-		if (c == SLIP_ESC_END) {
-			c = SLIP_END;
-		} else if (c == SLIP_ESC_ESC) {
-			c = SLIP_ESC;
-		} else {
-			slip->state = STATE_GARBAGE;
-			SLIP_STATS(slip->garbage++);
-			return 0;
-		}
+	if (slip->rx) {
+		net_pkt_unref(slip->rx);
+	}
 
-		slip->state = STATE_OK;
+	slip->rx = NULL;
+	slip->last = NULL;
+}
 
-		break;
-	case STATE_OK:
-		if (c == SLIP_ESC) {
-			slip->state = STATE_ESC;
-			return 0;
+/* Copy a run of decoded bytes to the end of the packet being received,
+ * filling the tailroom of the last fragment before adding another one.
+ */
+static void slip_append(struct slip_context *slip, const u8_t *data,
+			size_t len)
+{
+	if (!slip->rx) {
+		if (slip->first) {
+			/* Must have missed buffer allocation on first byte. */
+			return;
 		}
 
-		if (c == SLIP_END) {
-			slip->state = STATE_OK;
-			slip->first = false;
-
-			if (slip->rx) {
-				return 1;
-			}
+		slip->first = true;
 
-			return 0;
+		slip->rx = net_pkt_get_reserve_rx(0, K_NO_WAIT);
+		if (!slip->rx) {
+			SYS_LOG_ERR("[%p] cannot allocate pkt", slip);
+			SLIP_STATS(slip->dropped++);
+			return;
 		}
 
-		if (slip->first && !slip->rx) {
-			/* Must have missed buffer allocation on first byte. */
-			return 0;
+		/* The frame length is not known yet, ask for room for a
+		 * full MTU so that it fits one fragment.
+		 */
+		slip->last = net_pkt_get_frag_len(slip->rx,
+						  net_if_get_mtu(slip->iface),
+						  K_NO_WAIT);
+		if (!slip->last) {
+			SYS_LOG_ERR("[%p] cannot allocate 1st data frag",
+				    slip);
+			SLIP_STATS(slip->dropped++);
+			slip_drop(slip);
+			return;
 		}
 
-		if (!slip->first) {
-			slip->first = true;
+		net_pkt_frag_add(slip->rx, slip->last);
+	}
 
-			slip->rx = net_pkt_get_reserve_rx(0, K_NO_WAIT);
-			if (!slip->rx) {
-				SYS_LOG_ERR("[%p] cannot allocate pkt",
-					    slip);
-				return 0;
-			}
+	while (len) {
+		size_t count = min(len, net_buf_tailroom(slip->last));
+
+		if (!count) {
+			/* We need to allocate a new fragment */
+			struct net_buf *frag;
 
-			slip->last = net_pkt_get_frag(slip->rx, K_NO_WAIT);
-			if (!slip->last) {
-				SYS_LOG_ERR("[%p] cannot allocate 1st data frag",
-					    slip);
-				net_pkt_unref(slip->rx);
-				slip->rx = NULL;
-				return 0;
+			frag = net_pkt_get_frag(slip->rx, K_NO_WAIT);
+			if (!frag) {
+				SYS_LOG_ERR("[%p] cannot allocate next data "
+					    "frag", slip);
+				SLIP_STATS(slip->dropped++);
+				slip_drop(slip);
+				return;
 			}
 
-			net_pkt_frag_add(slip->rx, slip->last);
-			slip->ptr = net_pkt_ip_data(slip->rx);
+			net_buf_frag_insert(slip->last, frag);
+			slip->last = frag;
+			continue;
 		}
 
-		break;
+		net_buf_add_mem(slip->last, data, count);
+		data += count;
+		len -= count;
 	}
+}
 
-	/* It is possible that slip->last is not set during the startup
-	 * of the device. If this happens do not continue and overwrite
-	 * some random memory.
-	 */
-	if (!slip->last) {
-		return 0;
+static void slip_frame_end(struct slip_context *slip)
+{
+	slip->first = false;
+
+	if (!slip->rx) {
+		return;
 	}
 
-	if (!net_buf_tailroom(slip->last)) {
-		/* We need to allocate a new fragment */
-		struct net_buf *frag;
+#if SYS_LOG_LEVEL >= SYS_LOG_LEVEL_DEBUG
+	{
+		struct net_buf *frag = slip->rx->frags;
+		int bytes = net_buf_frags_len(frag);
+		int count = 0;
 
-		frag = net_pkt_get_reserve_rx_data(0, K_NO_WAIT);
-		if (!frag) {
-			SYS_LOG_ERR("[%p] cannot allocate next data frag",
-				    slip);
-			net_pkt_unref(slip->rx);
-			slip->rx = NULL;
-			slip->last = NULL;
+		while (bytes && frag) {
+			char msg[8 + 1];
 
-			return 0;
-		}
+			snprintf(msg, sizeof(msg), ">slip %2d", count);
 
-		net_buf_frag_insert(slip->last, frag);
-		slip->last = frag;
-		slip->ptr = slip->last->data;
-	}
+			hexdump(msg, frag->data, frag->len, 0);
 
-	/* The net_buf_add_u8() cannot add data to ll header so we need
-	 * a way to do it.
-	 */
-	if (slip->ptr < slip->last->data) {
-		*slip->ptr = c;
-	} else {
-		slip->ptr = net_buf_add_u8(slip->last, c);
+			frag = frag->frags;
+			count++;
+		}
+
+		SYS_LOG_DBG("[%p] received data %d bytes", slip, bytes);
 	}
+#endif
 
-	slip->ptr++;
+	process_msg(slip);
 
-	return 0;
+	/* Empty frames are not passed up */
+	slip_drop(slip);
 }
 
-static u8_t *recv_cb(u8_t *buf, size_t *off)
+/* Decode a burst of received bytes. Instead of going through the state
+ * machine byte by byte, scan for the next END or ESC character and copy
+ * everything before it to the packet at once.
+ */
+static void slip_input(struct slip_context *slip, const u8_t *data,
+		       size_t len)
 {
-	struct slip_context *slip =
-		CONTAINER_OF(buf, struct slip_context, buf);
-	size_t i;
-
-	if (!slip->init_done) {
-		*off = 0;
-		return buf;
-	}
-
-	for (i = 0; i < *off; i++) {
-		if (slip_input_byte(slip, buf[i])) {
-#if SYS_LOG_LEVEL >= SYS_LOG_LEVEL_DEBUG
-			struct net_buf *frag = slip->rx->frags;
-			int bytes = net_buf_frags_len(frag);
-			int count = 0;
+	const u8_t *end = data + len;
 
-			while (bytes && frag) {
-				char msg[8 + 1];
+	while (data < end) {
+		const u8_t *run;
+		u8_t c;
 
-				snprintf(msg, sizeof(msg), ">slip %2d", count);
+		switch (slip->state) {
+		case STATE_GARBAGE:
+			while (data < end && *data != SLIP_END) {
+				data++;
+			}
 
-				hexdump(msg, frag->data, frag->len, 0);
+			if (data == end) {
+				return;
+			}
 
-				frag = frag->frags;
-				count++;
+			data++;
+			slip->state = STATE_OK;
+			slip->first = false;
+			continue;
+		case STATE_ESC:
+			c = *data++;
+
+			if (c == SLIP_ESC_END) {
+				c = SLIP_END;
+			} else if (c == SLIP_ESC_ESC) {
+				c = SLIP_ESC;
+			} else {
+				slip->state = STATE_GARBAGE;
+				SLIP_STATS(slip->garbage++);
+				slip_drop(slip);
+				continue;
 			}
 
-			SYS_LOG_DBG("[%p] received data %d bytes", slip, bytes);
-#endif
-			process_msg(slip);
+			slip->state = STATE_OK;
+			slip_append(slip, &c, 1);
+			continue;
+		case STATE_OK:
 			break;
 		}
+
+		run = data;
+
+		while (data < end && *data != SLIP_END && *data != SLIP_ESC) {
+			data++;
+		}
+
+		if (data > run) {
+			slip_append(slip, run, data - run);
+		}
+
+		if (data == end) {
+			return;
+		}
+
+		if (*data++ == SLIP_ESC) {
+			slip->state = STATE_ESC;
+		} else {
+			slip_frame_end(slip);
+		}
+	}
+}
+
+static u8_t *recv_cb(u8_t *buf, size_t *off)
+{
+	struct slip_context *slip =
+		CONTAINER_OF(buf, struct slip_context, buf);
+
+	if (slip->init_done) {
+		slip_input(slip, buf, *off);
 	}
 
 	*off = 0;
@@ -90,9 +90,47 @@ int tc_aes128_set_encrypt_key(TCAesKeySched_t s, const uint8_t *k);
  *  @param in IN -- a plaintext block to encrypt
  *  @param s IN -- initialized AES key schedule
  */
-int tc_aes_encrypt(uint8_t *out, const uint8_t *in, 
+int tc_aes_encrypt(uint8_t *out, const uint8_t *in,
 		   const TCAesKeySched_t s);
 
+/**
+ *  @brief AES-128 Encryption of several independent blocks
+ *  Encrypts nblocks consecutive 16 byte blocks of in into out under key
+ *              schedule s, as nblocks calls to tc_aes_encrypt() would
+ *  @note Lets the modes hand a whole batch (e.g. several CTR counter
+ *              blocks) to a hardware engine in one request; out may be
+ *              equal to in
+ *  @return  returns TC_CRYPTO_SUCCESS (1)
+ *           returns TC_CRYPTO_FAIL (0) if: out == NULL or in == NULL or s == NULL
+ *  @param out IN/OUT -- buffer to receive nblocks ciphertext blocks
+ *  @param in IN -- nblocks plaintext blocks to encrypt
+ *  @param nblocks IN -- number of blocks
+ *  @param s IN -- initialized AES key schedule
+ */
+int tc_aes_encrypt_blocks(uint8_t *out, const uint8_t *in,
+			  unsigned int nblocks, const TCAesKeySched_t s);
+
+/**
+ *  @brief SoC AES-128 ECB engine
+ *  Encrypts nblocks consecutive blocks of in into out using the raw
+ *              128-bit key
+ *  @return  returns TC_CRYPTO_SUCCESS (1) if the blocks were encrypted
+ *           returns TC_CRYPTO_FAIL (0) if the engine is unavailable (e.g.
+ *           busy), in which case the software implementation is used
+ */
+typedef int (*tc_aes_ecb_hw_t)(uint8_t *out, const uint8_t *in,
+			       unsigned int nblocks,
+			       const uint8_t key[TC_AES_KEY_SIZE]);
+
+/**
+ *  @brief Register a SoC AES-128 ECB engine
+ *  All subsequent tc_aes_encrypt() and tc_aes_encrypt_blocks() calls are
+ *              offered to hw first. Pass NULL to unregister.
+ *  @note Only available with CONFIG_TINYCRYPT_AES_ECB_HW
+ *  @param hw IN -- engine callback
+ */
+void tc_aes_ecb_hw_register(tc_aes_ecb_hw_t hw);
+
 /**
  *  @brief Set the AES-128 decryption key
  *  Uses key k to initialize s
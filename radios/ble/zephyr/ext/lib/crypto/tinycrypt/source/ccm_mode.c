@@ -84,52 +84,113 @@ static void ccm_cbc_mac(uint8_t *T, const uint8_t *data, unsigned int dlen,
 }
 
 /**
- * Variation of CTR mode used in CCM.
- * The CTR mode used by CCM is slightly different than the conventional CTR
- * mode (the counter is increased before encryption, instead of after
- * encryption). Besides, it is assumed that the counter is stored in the last
- * 2 bytes of the nonce.
+ * Formats counter block i of the CCM CTR mode: the counter is stored in the
+ * last 2 bytes of the block.
  */
-static int ccm_ctr_mode(uint8_t *out, unsigned int outlen, const uint8_t *in,
-			unsigned int inlen, uint8_t *ctr, const TCAesKeySched_t sched)
+static inline void ccm_ctr_block(uint8_t *a, uint16_t i)
 {
+	a[14] = (uint8_t)(i >> 8);
+	a[15] = (uint8_t)(i);
+}
 
-	uint8_t buffer[TC_AES_BLOCK_SIZE];
-	uint8_t nonce[TC_AES_BLOCK_SIZE];
-	uint16_t block_num;
-	unsigned int i;
+/**
+ * Fused CTR encryption and CBC-MAC of the payload. Both use the same
+ * plaintext block, so the payload is walked once and the counter block and
+ * the MAC state are encrypted with a single tc_aes_encrypt_blocks() call.
+ * b holds counter block A0 on entry; b is left as A0 on return.
+ */
+static int ccm_encrypt_mac(uint8_t *out, const uint8_t *in, unsigned int len,
+			   uint8_t *T, uint8_t *b, const TCAesKeySched_t sched)
+{
+	uint8_t blk[2 * TC_AES_BLOCK_SIZE];
+	uint16_t block_num = 0;
+	unsigned int i, n;
+
+	while (len > 0) {
+		n = (len < TC_AES_BLOCK_SIZE) ? len : TC_AES_BLOCK_SIZE;
+
+		/* blk[0] is the counter block, blk[1] the CBC-MAC state */
+		(void) _copy(blk, TC_AES_BLOCK_SIZE, b, TC_AES_BLOCK_SIZE);
+		ccm_ctr_block(blk, ++block_num);
+		(void) _copy(&blk[TC_AES_BLOCK_SIZE], TC_AES_BLOCK_SIZE, T,
+			     TC_AES_BLOCK_SIZE);
+		for (i = 0; i < n; ++i) {
+			blk[TC_AES_BLOCK_SIZE + i] ^= in[i];
+		}
 
-	/* input sanity check: */
-	if (out == (uint8_t *) 0 ||
-	    in == (uint8_t *) 0 ||
-	    ctr == (uint8_t *) 0 ||
-	    sched == (TCAesKeySched_t) 0 ||
-	    inlen == 0 ||
-	    outlen == 0 ||
-	    outlen != inlen) {
+		if (!tc_aes_encrypt_blocks(blk, blk, 2, sched)) {
+			return TC_CRYPTO_FAIL;
+		}
+
+		(void) _copy(T, TC_AES_BLOCK_SIZE, &blk[TC_AES_BLOCK_SIZE],
+			     TC_AES_BLOCK_SIZE);
+		for (i = 0; i < n; ++i) {
+			*out++ = blk[i] ^ *in++;
+		}
+
+		len -= n;
+	}
+
+	_set(blk, TC_ZERO_BYTE, sizeof(blk));
+
+	return TC_CRYPTO_SUCCESS;
+}
+
+/**
+ * Fused CTR decryption and CBC-MAC of the payload. The MAC needs the
+ * plaintext, so the keystream for the next block is generated together with
+ * the MAC of the current one.
+ */
+static int ccm_decrypt_mac(uint8_t *out, const uint8_t *in, unsigned int len,
+			   uint8_t *T, uint8_t *b, const TCAesKeySched_t sched)
+{
+	uint8_t blk[2 * TC_AES_BLOCK_SIZE];
+	uint16_t block_num = 1;
+	unsigned int i, n;
+	int ret;
+
+	if (len == 0) {
+		return TC_CRYPTO_SUCCESS;
+	}
+
+	(void) _copy(blk, TC_AES_BLOCK_SIZE, b, TC_AES_BLOCK_SIZE);
+	ccm_ctr_block(blk, block_num);
+	if (!tc_aes_encrypt(blk, blk, sched)) {
 		return TC_CRYPTO_FAIL;
 	}
 
-	/* copy the counter to the nonce */
-	(void) _copy(nonce, sizeof(nonce), ctr, sizeof(nonce));
-
-	/* select the last 2 bytes of the nonce to be incremented */
-	block_num = (uint16_t) ((nonce[14] << 8)|(nonce[15]));
-	for (i = 0; i < inlen; ++i) {
-		if ((i % (TC_AES_BLOCK_SIZE)) == 0) {
-			block_num++;
-			nonce[14] = (uint8_t)(block_num >> 8);
-			nonce[15] = (uint8_t)(block_num);
-			if (!tc_aes_encrypt(buffer, nonce, sched)) {
-				return TC_CRYPTO_FAIL;
-			}
+	while (len > 0) {
+		n = (len < TC_AES_BLOCK_SIZE) ? len : TC_AES_BLOCK_SIZE;
+
+		/* blk[0] holds the keystream, blk[1] becomes the MAC state */
+		(void) _copy(&blk[TC_AES_BLOCK_SIZE], TC_AES_BLOCK_SIZE, T,
+			     TC_AES_BLOCK_SIZE);
+		for (i = 0; i < n; ++i) {
+			*out = blk[i] ^ *in++;
+			blk[TC_AES_BLOCK_SIZE + i] ^= *out++;
 		}
-		/* update the output */
-		*out++ = buffer[i % (TC_AES_BLOCK_SIZE)] ^ *in++;
+
+		len -= n;
+
+		/* next counter block, unless this was the last one */
+		if (len > 0) {
+			(void) _copy(blk, TC_AES_BLOCK_SIZE, b, TC_AES_BLOCK_SIZE);
+			ccm_ctr_block(blk, ++block_num);
+			ret = tc_aes_encrypt_blocks(blk, blk, 2, sched);
+		} else {
+			ret = tc_aes_encrypt(&blk[TC_AES_BLOCK_SIZE],
+					     &blk[TC_AES_BLOCK_SIZE], sched);
+		}
+
+		if (!ret) {
+			return TC_CRYPTO_FAIL;
+		}
+
+		(void) _copy(T, TC_AES_BLOCK_SIZE, &blk[TC_AES_BLOCK_SIZE],
+			     TC_AES_BLOCK_SIZE);
 	}
 
-	/* update the counter */
-	ctr[14] = nonce[14]; ctr[15] = nonce[15];
+	_set(blk, TC_ZERO_BYTE, sizeof(blk));
 
 	return TC_CRYPTO_SUCCESS;
 }
@@ -170,9 +231,6 @@ int tc_ccm_generation_encryption(uint8_t *out, unsigned int olen,
 	if (alen > 0) {
 		ccm_cbc_mac(tag, associated_data, alen, 1, c->sched);
 	}
-	if (plen > 0) {
-		ccm_cbc_mac(tag, payload, plen, 0, c->sched);
-	}
 
 	/* ENCRYPTION: */
 
@@ -180,10 +238,10 @@ int tc_ccm_generation_encryption(uint8_t *out, unsigned int olen,
 	b[0] = 1; /* q - 1 = 2 - 1 = 1 */
 	b[14] = b[15] = TC_ZERO_BYTE;
 
-	/* encrypting payload using ctr mode: */
-	ccm_ctr_mode(out, plen, payload, plen, b, c->sched);
-
-	b[14] = b[15] = TC_ZERO_BYTE; /* restoring initial counter for ctr_mode (0):*/
+	/* encrypting payload using ctr mode while completing the tag: */
+	if (!ccm_encrypt_mac(out, payload, plen, tag, b, c->sched)) {
+		return TC_CRYPTO_FAIL;
+	}
 
 	/* encrypting b and adding the tag to the output: */
 	(void) tc_aes_encrypt(b, b, c->sched);
@@ -214,21 +272,34 @@ int tc_ccm_decryption_verification(uint8_t *out, unsigned int olen,
 
 	uint8_t b[Nb * Nk];
 	uint8_t tag[Nb * Nk];
+	uint8_t T[Nb * Nk];
 	unsigned int i;
 
+	/* formatting the sequence b for authentication: */
+	b[0] = ((alen > 0) ? 0x40:0)|(((c->mlen - 2) / 2 << 3)) | (1);
+	for (i = 1; i < 14; ++i) {
+		b[i] = c->nonce[i - 1];
+	}
+	b[14] = (uint8_t)((plen - c->mlen) >> 8);
+	b[15] = (uint8_t)(plen - c->mlen);
+
+	/* starting the authentication tag using cbc-mac: */
+	(void) tc_aes_encrypt(T, b, c->sched);
+	if (alen > 0) {
+		ccm_cbc_mac(T, associated_data, alen, 1, c->sched);
+	}
+
 	/* DECRYPTION: */
 
 	/* formatting the sequence b for decryption: */
 	b[0] = 1; /* q - 1 = 2 - 1 = 1 */
-	for (i = 1; i < 14; ++i) {
-		b[i] = c->nonce[i - 1];
-	}
 	b[14] = b[15] = TC_ZERO_BYTE; /* initial counter value is 0 */
 
-	/* decrypting payload using ctr mode: */
-	ccm_ctr_mode(out, plen - c->mlen, payload, plen - c->mlen, b, c->sched);
-
-	b[14] = b[15] = TC_ZERO_BYTE; /* restoring initial counter value (0) */
+	/* decrypting payload using ctr mode while completing the tag: */
+	if (!ccm_decrypt_mac(out, payload, plen - c->mlen, T, b, c->sched)) {
+		_set(out, 0, plen - c->mlen);
+		return TC_CRYPTO_FAIL;
+	}
 
 	/* encrypting b and restoring the tag from input: */
 	(void) tc_aes_encrypt(b, b, c->sched);
@@ -236,27 +307,8 @@ int tc_ccm_decryption_verification(uint8_t *out, unsigned int olen,
 		tag[i] = *(payload + plen - c->mlen + i) ^ b[i];
 	}
 
-	/* VERIFYING THE AUTHENTICATION TAG: */
-
-	/* formatting the sequence b for authentication: */
-	b[0] = ((alen > 0) ? 0x40:0)|(((c->mlen - 2) / 2 << 3)) | (1);
-	for (i = 1; i < 14; ++i) {
-		b[i] = c->nonce[i - 1];
-	}
-	b[14] = (uint8_t)((plen - c->mlen) >> 8);
-	b[15] = (uint8_t)(plen - c->mlen);
-
-	/* computing the authentication tag using cbc-mac: */
-	(void) tc_aes_encrypt(b, b, c->sched);
-	if (alen > 0) {
-		ccm_cbc_mac(b, associated_data, alen, 1, c->sched);
-	}
-	if (plen > 0) {
-		ccm_cbc_mac(b, out, plen - c->mlen, 0, c->sched);
-	}
-
 	/* comparing the received tag and the computed one: */
-	if (_compare(b, tag, c->mlen) == 0) {
+	if (_compare(T, tag, c->mlen) == 0) {
 		return TC_CRYPTO_SUCCESS;
   	} else {
 		/* erase the decrypted buffer in case of mac validation failure: */
@@ -34,13 +34,17 @@
 #include <tinycrypt/ctr_mode.h>
 #include <tinycrypt/utils.h>
 
+/* number of counter blocks encrypted per tc_aes_encrypt_blocks() call */
+#define CTR_BATCH 4
+
 int tc_ctr_mode(uint8_t *out, unsigned int outlen, const uint8_t *in,
 		unsigned int inlen, uint8_t *ctr, const TCAesKeySched_t sched)
 {
 
-	uint8_t buffer[TC_AES_BLOCK_SIZE];
-	uint8_t nonce[TC_AES_BLOCK_SIZE];
+	uint8_t buffer[CTR_BATCH * TC_AES_BLOCK_SIZE];
 	unsigned int block_num;
+	unsigned int nblocks;
+	unsigned int len;
 	unsigned int i;
 
 	/* input sanity check: */
@@ -54,32 +58,51 @@ int tc_ctr_mode(uint8_t *out, unsigned int outlen, const uint8_t *in,
 		return TC_CRYPTO_FAIL;
 	}
 
-	/* copy the ctr to the nonce */
-	(void)_copy(nonce, sizeof(nonce), ctr, sizeof(nonce));
-
 	/* select the last 4 bytes of the nonce to be incremented */
-	block_num = (nonce[12] << 24) | (nonce[13] << 16) |
-		    (nonce[14] << 8) | (nonce[15]);
-	for (i = 0; i < inlen; ++i) {
-		if ((i % (TC_AES_BLOCK_SIZE)) == 0) {
-			/* encrypt data using the current nonce */
-			if (tc_aes_encrypt(buffer, nonce, sched)) {
-				block_num++;
-				nonce[12] = (uint8_t)(block_num >> 24);
-				nonce[13] = (uint8_t)(block_num >> 16);
-				nonce[14] = (uint8_t)(block_num >> 8);
-				nonce[15] = (uint8_t)(block_num);
-			} else {
-				return TC_CRYPTO_FAIL;
-			}
+	block_num = (ctr[12] << 24) | (ctr[13] << 16) |
+		    (ctr[14] << 8) | (ctr[15]);
+
+	while (inlen > 0) {
+		nblocks = (inlen + TC_AES_BLOCK_SIZE - 1) / TC_AES_BLOCK_SIZE;
+		if (nblocks > CTR_BATCH) {
+			nblocks = CTR_BATCH;
+		}
+
+		/* lay out the counter blocks and generate their keystream */
+		for (i = 0; i < nblocks; ++i) {
+			uint8_t *nonce = &buffer[i * TC_AES_BLOCK_SIZE];
+
+			(void)_copy(nonce, TC_AES_BLOCK_SIZE, ctr, 12);
+			nonce[12] = (uint8_t)(block_num >> 24);
+			nonce[13] = (uint8_t)(block_num >> 16);
+			nonce[14] = (uint8_t)(block_num >> 8);
+			nonce[15] = (uint8_t)(block_num);
+			block_num++;
+		}
+
+		if (!tc_aes_encrypt_blocks(buffer, buffer, nblocks, sched)) {
+			return TC_CRYPTO_FAIL;
 		}
+
 		/* update the output */
-		*out++ = buffer[i%(TC_AES_BLOCK_SIZE)] ^ *in++;
+		len = nblocks * TC_AES_BLOCK_SIZE;
+		if (len > inlen) {
+			len = inlen;
+		}
+
+		for (i = 0; i < len; ++i) {
+			*out++ = buffer[i] ^ *in++;
+		}
+
+		inlen -= len;
 	}
 
 	/* update the counter */
-	ctr[12] = nonce[12]; ctr[13] = nonce[13];
-	ctr[14] = nonce[14]; ctr[15] = nonce[15];
+	ctr[12] = (uint8_t)(block_num >> 24); ctr[13] = (uint8_t)(block_num >> 16);
+	ctr[14] = (uint8_t)(block_num >> 8); ctr[15] = (uint8_t)(block_num);
+
+	/* zeroing out the keystream buffer */
+	_set(buffer, TC_ZERO_BYTE, sizeof(buffer));
 
 	return TC_CRYPTO_SUCCESS;
 }
@@ -50,6 +50,7 @@ typedef enum CborAttrType {
     CborAttrObjectType,
     CborAttrStructObjectType,
     CborAttrNullType,
+    CborAttrByteStringRefType,
 } CborAttrType;
 
 struct cbor_attr_t;
@@ -103,6 +104,13 @@ struct cbor_attr_t {
             uint8_t *data;
             size_t *len;
         } bytestring;
+        /* Points into the decoder's buffer instead of copying the string,
+         * only valid as long as that buffer is.  Chunked strings are
+         * rejected. */
+        struct byte_string_ref {
+            const uint8_t **data;
+            size_t *len;
+        } bytestring_ref;
         struct cbor_array_t array;
         size_t offset;
         struct cbor_attr_t *obj;
@@ -38,6 +38,7 @@ valid_attr_type(CborType ct, CborAttrType at)
         }
         break;
     case CborAttrByteStringType:
+    case CborAttrByteStringRefType:
         if (ct == CborByteStringType) {
             return 1;
         }
@@ -115,6 +116,9 @@ cbor_target_address(const struct cbor_attr_t *cursor,
         case CborAttrByteStringType:
             targetaddr = (char *) cursor->addr.bytestring.data;
             break;
+        case CborAttrByteStringRefType:
+            targetaddr = (char *) cursor->addr.bytestring_ref.data;
+            break;
         case CborAttrTextStringType:
             targetaddr = cursor->addr.string;
             break;
@@ -260,6 +264,14 @@ cbor_internal_read_object(CborValue *root_value,
                 *cursor->addr.bytestring.len = len;
                 break;
             }
+            case CborAttrByteStringRefType:
+                if (!cbor_value_is_length_known(&cur_value)) {
+                    err |= CborErrorUnknownLength;
+                    break;
+                }
+                err |= cbor_value_get_byte_string_chunk(&cur_value, lptr,
+                                   cursor->addr.bytestring_ref.len, NULL);
+                break;
             case CborAttrTextStringType: {
                 size_t len = cursor->len;
                 err |= cbor_value_copy_text_string(&cur_value, lptr,
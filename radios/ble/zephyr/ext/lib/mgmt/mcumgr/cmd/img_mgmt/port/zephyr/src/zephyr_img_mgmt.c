@@ -18,6 +18,7 @@
  */
 
 #include <assert.h>
+#include <string.h>
 #include <flash.h>
 #include <zephyr.h>
 #include <soc.h>
@@ -27,6 +28,7 @@
 #include <mgmt/mgmt.h>
 #include <img_mgmt/img_mgmt_impl.h>
 #include <img_mgmt/img_mgmt.h>
+#include <img_mgmt/image.h>
 #include "../../../src/img_mgmt_priv.h"
 
 static struct device *zephyr_img_mgmt_flash_dev;
@@ -167,6 +169,36 @@ img_mgmt_impl_read(int slot, unsigned int offset, void *dst,
     return 0;
 }
 
+#if defined(CONFIG_IMG_STREAM_SHA256)
+/**
+ * Compares the hash computed during the upload against the image's hash TLV.
+ * Only the header and the TLVs are read back from flash.
+ */
+static int
+zephyr_img_mgmt_check_hash(void)
+{
+    uint8_t expected[IMAGE_HASH_LEN];
+    uint8_t hash[TC_SHA256_DIGEST_SIZE];
+    int rc;
+
+    rc = flash_img_hash_finish(&zephyr_img_mgmt_flash_ctxt, hash);
+    if (rc != 0) {
+        return MGMT_ERR_EINVAL;
+    }
+
+    rc = img_mgmt_read_info(1, NULL, expected, NULL);
+    if (rc != 0) {
+        return rc;
+    }
+
+    if (memcmp(hash, expected, IMAGE_HASH_LEN) != 0) {
+        return MGMT_ERR_EINVAL;
+    }
+
+    return 0;
+}
+#endif
+
 int
 img_mgmt_impl_write_image_data(unsigned int offset, const void *data,
                                unsigned int num_bytes, bool last)
@@ -175,6 +207,17 @@ img_mgmt_impl_write_image_data(unsigned int offset, const void *data,
 
     if (offset == 0) {
         flash_img_init(&zephyr_img_mgmt_flash_ctxt, zephyr_img_mgmt_flash_dev);
+
+#if defined(CONFIG_IMG_STREAM_SHA256)
+        {
+            struct image_header hdr;
+
+            /* The hash TLV covers the header and the image body. */
+            memcpy(&hdr, data, sizeof hdr);
+            flash_img_hash_start(&zephyr_img_mgmt_flash_ctxt,
+                                 hdr.ih_hdr_size + hdr.ih_img_size);
+        }
+#endif
     }
 
     /* Cast away const. */
@@ -190,6 +233,13 @@ img_mgmt_impl_write_image_data(unsigned int offset, const void *data,
         if (rc != 0) {
             return MGMT_ERR_EUNKNOWN;
         }
+
+#if defined(CONFIG_IMG_STREAM_SHA256)
+        rc = zephyr_img_mgmt_check_hash();
+        if (rc != 0) {
+            return rc;
+        }
+#endif
     }
 
     return 0;
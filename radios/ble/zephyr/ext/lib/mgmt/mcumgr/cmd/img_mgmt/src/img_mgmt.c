@@ -290,9 +290,14 @@ img_mgmt_upload_first_chunk(struct mgmt_ctxt *ctxt, const uint8_t *req_data,
         return MGMT_ERR_ENOMEM;
     }
 
-    rc = img_mgmt_impl_erase_slot();
-    if (rc != 0) {
-        return rc;
+    /* Erasing the whole slot takes seconds and blocks the transport.  Leave
+     * it to the implementation if it erases as the writes come in.
+     */
+    if (!IMG_MGMT_LAZY_ERASE) {
+        rc = img_mgmt_impl_erase_slot();
+        if (rc != 0) {
+            return rc;
+        }
     }
 
     img_mgmt_ctxt.uploading = true;
@@ -308,7 +313,7 @@ img_mgmt_upload_first_chunk(struct mgmt_ctxt *ctxt, const uint8_t *req_data,
 static int
 img_mgmt_upload(struct mgmt_ctxt *ctxt)
 {
-    uint8_t img_mgmt_data[IMG_MGMT_UL_CHUNK_SIZE];
+    const uint8_t *img_mgmt_data;
     unsigned long long len;
     unsigned long long off;
     size_t data_len;
@@ -318,11 +323,11 @@ img_mgmt_upload(struct mgmt_ctxt *ctxt)
 
     const struct cbor_attr_t off_attr[4] = {
         [0] = {
+            /* The chunk is written straight from the request buffer. */
             .attribute = "data",
-            .type = CborAttrByteStringType,
-            .addr.bytestring.data = img_mgmt_data,
-            .addr.bytestring.len = &data_len,
-            .len = sizeof(img_mgmt_data)
+            .type = CborAttrByteStringRefType,
+            .addr.bytestring_ref.data = &img_mgmt_data,
+            .addr.bytestring_ref.len = &data_len,
         },
         [1] = {
             .attribute = "len",
@@ -341,9 +346,10 @@ img_mgmt_upload(struct mgmt_ctxt *ctxt)
 
     len = ULLONG_MAX;
     off = ULLONG_MAX;
+    img_mgmt_data = NULL;
     data_len = 0;
     rc = cbor_read_object(&ctxt->it, off_attr);
-    if (rc || off == ULLONG_MAX) {
+    if (rc || off == ULLONG_MAX || data_len > IMG_MGMT_UL_CHUNK_SIZE) {
         return MGMT_ERR_EINVAL;
     }
 
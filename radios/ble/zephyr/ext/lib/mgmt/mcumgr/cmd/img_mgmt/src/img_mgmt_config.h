@@ -25,11 +25,19 @@
 #include "syscfg/syscfg.h"
 
 #define IMG_MGMT_UL_CHUNK_SIZE  MYNEWT_VAL(IMG_MGMT_UL_CHUNK_SIZE)
+#define IMG_MGMT_LAZY_ERASE     0
 
 #elif defined __ZEPHYR__
 
 #define IMG_MGMT_UL_CHUNK_SIZE  CONFIG_IMG_MGMT_UL_CHUNK_SIZE
 
+/* The image writer erases the slot as the upload progresses. */
+#if defined(CONFIG_IMG_ERASE_PROGRESSIVELY)
+#define IMG_MGMT_LAZY_ERASE     1
+#else
+#define IMG_MGMT_LAZY_ERASE     0
+#endif
+
 #else
 
 /* No direct support for this OS.  The application needs to define the above
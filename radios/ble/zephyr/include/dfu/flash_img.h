@@ -8,6 +8,10 @@
 #ifndef __FLASH_IMG_H__
 #define __FLASH_IMG_H__
 
+#if defined(CONFIG_IMG_STREAM_SHA256)
+#include <tinycrypt/sha256.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -17,6 +21,14 @@ struct flash_img_context {
 	struct device *dev;
 	size_t bytes_written;
 	u16_t buf_bytes;
+#if defined(CONFIG_IMG_ERASE_PROGRESSIVELY)
+	off_t off_erased;	/* End of the erased part of the slot */
+#endif
+#if defined(CONFIG_IMG_STREAM_SHA256)
+	struct tc_sha256_state_struct sha256;
+	size_t hash_len;	/* Bytes left to hash */
+	bool hashing;
+#endif
 };
 
 /**
@@ -56,6 +68,31 @@ size_t flash_img_bytes_written(struct flash_img_context *ctx);
 int flash_img_buffered_write(struct flash_img_context *ctx, u8_t *data,
 		    size_t len, bool flush);
 
+#if defined(CONFIG_IMG_STREAM_SHA256)
+/**
+ * @brief Start hashing the image as it is written.
+ *
+ * The SHA-256 digest is computed over the first @a len bytes passed to
+ * flash_img_buffered_write() from now on, so checking the image needs no
+ * second pass over the flash.
+ *
+ * @param ctx context
+ * @param len Number of bytes to hash, e.g. the image header and body
+ */
+void flash_img_hash_start(struct flash_img_context *ctx, size_t len);
+
+/**
+ * @brief Get the digest of the data hashed since flash_img_hash_start().
+ *
+ * @param ctx context
+ * @param digest TC_SHA256_DIGEST_SIZE bytes buffer for the digest
+ *
+ * @return  0 on success, -EAGAIN if not all the data to hash has been
+ * written yet, other negative errno code on fail
+ */
+int flash_img_hash_finish(struct flash_img_context *ctx, u8_t *digest);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -519,6 +519,32 @@ struct net_buf_data_alloc {
 	void *alloc_data;
 };
 
+#if defined(CONFIG_NET_BUF_POOL_STATS)
+/** @brief Network buffer pool statistics. */
+struct net_buf_pool_stats {
+	/** Number of buffers currently allocated. */
+	u16_t used;
+
+	/** Highest number of buffers allocated at the same time. */
+	u16_t peak;
+
+	/** Number of successful allocations. */
+	u32_t allocs;
+
+	/** Number of allocations that returned NULL. */
+	u32_t failures;
+
+	/** Number of allocations that had to wait for a free buffer. */
+	u32_t waits;
+
+	/** Total time spent waiting for free buffers, in milliseconds. */
+	u32_t wait_time;
+
+	/** Longest single wait for a free buffer, in milliseconds. */
+	u32_t max_wait;
+};
+#endif /* CONFIG_NET_BUF_POOL_STATS */
+
 struct net_buf_pool {
 	/** LIFO to place the buffer into when free */
 	struct k_lifo free;
@@ -540,6 +566,11 @@ struct net_buf_pool {
 	const char *name;
 #endif /* CONFIG_NET_BUF_POOL_USAGE */
 
+#if defined(CONFIG_NET_BUF_POOL_STATS)
+	/** Allocation statistics of the pool. */
+	struct net_buf_pool_stats stats;
+#endif /* CONFIG_NET_BUF_POOL_STATS */
+
 	/** Optional destroy callback when buffer is freed. */
 	void (*const destroy)(struct net_buf *buf);
 
@@ -829,6 +860,79 @@ struct net_buf *net_buf_alloc_with_data(struct net_buf_pool *pool,
 					s32_t timeout);
 #endif
 
+/**
+ *  @brief Allocate several buffers from a pool at once.
+ *
+ *  Allocate @a count buffers, each able to fit @a size bytes of data, from
+ *  the same pool. The free buffers are taken from the pool with a single
+ *  lock, which makes this cheaper than calling net_buf_alloc_len() in a
+ *  loop. The allocation is all or nothing: if not all buffers can be
+ *  allocated, the ones already taken are returned to the pool.
+ *
+ *  @param pool Which pool to allocate the buffers from.
+ *  @param size Amount of data each buffer must be able to fit.
+ *  @param bufs Array to store the allocated buffers in.
+ *  @param count Number of buffers to allocate.
+ *  @param timeout Affects the action taken should the pool run out of
+ *         buffers, as for net_buf_alloc_len(). The timeout applies to the
+ *         whole batch.
+ *
+ *  @return 0 on success, -ENOMEM if out of buffers.
+ */
+int net_buf_alloc_batch(struct net_buf_pool *pool, size_t size,
+			struct net_buf **bufs, int count, s32_t timeout);
+
+/**
+ *  @brief Decrements the reference count of several buffers.
+ *
+ *  Same as calling net_buf_unref() for each buffer, but buffers freed back
+ *  to a pool without a custom destroy callback are returned in groups,
+ *  with one lock per group of consecutive buffers from the same pool.
+ *
+ *  @param bufs Array of buffers, including their fragments, to unref.
+ *  @param count Number of buffers in the array.
+ */
+void net_buf_unref_batch(struct net_buf **bufs, int count);
+
+#if defined(CONFIG_NET_BUF_POOL_STATS)
+/**
+ *  @brief Get the allocation statistics of a pool.
+ *
+ *  @param pool Pool to get the statistics of.
+ *  @param stats Where to copy the statistics.
+ */
+void net_buf_pool_stats_get(struct net_buf_pool *pool,
+			    struct net_buf_pool_stats *stats);
+
+/**
+ *  @brief Reset the allocation statistics of a pool.
+ *
+ *  Clears the counters of the pool. The peak is restarted from the number
+ *  of buffers currently allocated.
+ *
+ *  @param pool Pool to reset the statistics of.
+ */
+void net_buf_pool_stats_reset(struct net_buf_pool *pool);
+#endif /* CONFIG_NET_BUF_POOL_STATS */
+
+/**
+ *  @typedef net_buf_pool_cb_t
+ *  @brief Callback used while iterating over buffer pools
+ *
+ *  @param pool A valid pointer on a buffer pool
+ *  @param user_data A valid pointer on some user data or NULL
+ */
+typedef void (*net_buf_pool_cb_t)(struct net_buf_pool *pool, void *user_data);
+
+/**
+ *  @brief Go through all the statically defined buffer pools and call
+ *  callback for each of them.
+ *
+ *  @param cb User-supplied callback function to call
+ *  @param user_data User specified data
+ */
+void net_buf_pool_foreach(net_buf_pool_cb_t cb, void *user_data);
+
 /**
  *  @brief Get a buffer from a FIFO.
  *
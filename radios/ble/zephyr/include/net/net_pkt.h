@@ -90,6 +90,14 @@ struct net_pkt {
 #endif
 	u16_t data_len;         /* amount of payload data that can be added */
 
+#if defined(CONFIG_NET_CHKSUM_COPY)
+	/* Sum of the payload added by net_pkt_append_chksum(), which is at
+	 * the end of the packet.
+	 */
+	u16_t data_chksum;
+	u16_t data_chksum_len;
+#endif
+
 	u16_t appdatalen;
 	u8_t ll_reserve;	/* link layer header length */
 	u8_t ip_hdr_len;	/* pre-filled in order to avoid func call */
@@ -136,6 +144,7 @@ struct net_pkt {
 	u16_t ipv6_fragment_offset;	/* Fragment offset of this packet */
 	u32_t ipv6_fragment_id;	/* Fragment id */
 	u8_t *ipv6_frag_hdr_start;	/* Where starts the fragment header */
+	struct net_pkt *ipv6_frag_next;	/* Next pending fragment */
 #endif /* CONFIG_NET_IPV6_FRAGMENT */
 #endif /* CONFIG_NET_IPV6 */
 
@@ -643,13 +652,54 @@ static inline void net_pkt_set_src_ipv6_addr(struct net_pkt *pkt)
  * define additional custom per-context TX packet pools (see
  * :c:func:`net_context_setup_pools`).
  *
+ * With CONFIG_NET_BUF_VARIABLE_DATA_SIZE the fragments are carved out
+ * of a CONFIG_NET_BUF_DATA_POOL_SIZE byte region in one of three size
+ * classes, instead of each being CONFIG_NET_BUF_DATA_SIZE bytes.
+ *
  * @param name Name of the pool.
  * @param count Number of net_buf in this pool.
  */
+#if defined(CONFIG_NET_BUF_VARIABLE_DATA_SIZE)
+
+/* Fragment size classes. Each class is four times the previous one, so
+ * that they map onto the levels of the k_mem_pool buddy allocator that
+ * backs the data pools.
+ */
+#define NET_PKT_FRAG_SMALL  128
+#define NET_PKT_FRAG_MEDIUM 512
+#define NET_PKT_FRAG_LARGE  2048
+
+/* Bookkeeping stored by net_buf_var_cb in front of each data block */
+#define NET_PKT_FRAG_OVERHEAD (sizeof(struct k_mem_block_id) + 1)
+
+/* Usable size of a fragment allocated without a length hint */
+#define NET_PKT_FRAG_DEFAULT_SIZE (NET_PKT_FRAG_SMALL - NET_PKT_FRAG_OVERHEAD)
+
+#define NET_PKT_DATA_POOL_DEFINE(name, count)				\
+	K_MEM_POOL_DEFINE(net_pkt_mem_pool_##name, NET_PKT_FRAG_SMALL,	\
+			  NET_PKT_FRAG_LARGE,				\
+			  CONFIG_NET_BUF_DATA_POOL_SIZE / NET_PKT_FRAG_LARGE, \
+			  4);						\
+	static const struct net_buf_data_alloc net_pkt_data_alloc_##name = { \
+		.cb = &net_buf_var_cb,					\
+		.alloc_data = &net_pkt_mem_pool_##name,			\
+	};								\
+	static struct net_buf net_pkt_bufs_##name[count] __noinit;	\
+	struct net_buf_pool name __net_buf_align			\
+		__in_section(_net_buf_pool, static, name) =		\
+		NET_BUF_POOL_INITIALIZER(name, &net_pkt_data_alloc_##name, \
+					 net_pkt_bufs_##name, count, NULL)
+
+#else /* CONFIG_NET_BUF_VARIABLE_DATA_SIZE */
+
+#define NET_PKT_FRAG_DEFAULT_SIZE CONFIG_NET_BUF_DATA_SIZE
+
 #define NET_PKT_DATA_POOL_DEFINE(name, count)				\
 	NET_BUF_POOL_DEFINE(name, count, CONFIG_NET_BUF_DATA_SIZE,	\
 			    CONFIG_NET_BUF_USER_DATA_SIZE, NULL)
 
+#endif /* CONFIG_NET_BUF_VARIABLE_DATA_SIZE */
+
 #if defined(CONFIG_NET_DEBUG_NET_PKT)
 
 /* Debug versions of the net_pkt functions that are used when tracking
@@ -725,6 +775,12 @@ struct net_buf *net_pkt_get_frag_debug(struct net_pkt *pkt,
 #define net_pkt_get_frag(pkt, timeout)					\
 	net_pkt_get_frag_debug(pkt, timeout, __func__, __LINE__)
 
+struct net_buf *net_pkt_get_frag_len_debug(struct net_pkt *pkt, size_t len,
+					   s32_t timeout,
+					   const char *caller, int line);
+#define net_pkt_get_frag_len(pkt, len, timeout)				\
+	net_pkt_get_frag_len_debug(pkt, len, timeout, __func__, __LINE__)
+
 void net_pkt_unref_debug(struct net_pkt *pkt, const char *caller, int line);
 #define net_pkt_unref(pkt) net_pkt_unref_debug(pkt, __func__, __LINE__)
 
@@ -928,6 +984,28 @@ struct net_buf *net_pkt_get_reserve_tx_data(u16_t reserve_head,
  */
 struct net_buf *net_pkt_get_frag(struct net_pkt *pkt, s32_t timeout);
 
+/**
+ * @brief Get a data fragment sized for the given amount of data.
+ *
+ * @details Like net_pkt_get_frag() but with a hint of how much data is
+ * going to be stored. With CONFIG_NET_BUF_VARIABLE_DATA_SIZE the
+ * fragment comes from the smallest size class that fits the data and
+ * the link layer reserve, so a whole frame usually ends up in a single
+ * fragment. Otherwise this is the same as net_pkt_get_frag() and the
+ * fragment might have less tailroom than asked for.
+ *
+ * @param pkt Network packet.
+ * @param len Number of data bytes the caller intends to add.
+ * @param timeout Affects the action taken should the net buf pool be empty.
+ *        If K_NO_WAIT, then return immediately. If K_FOREVER, then
+ *        wait as long as necessary. Otherwise, wait up to the specified
+ *        number of milliseconds before timing out.
+ *
+ * @return Network buffer if successful, NULL otherwise.
+ */
+struct net_buf *net_pkt_get_frag_len(struct net_pkt *pkt, size_t len,
+				     s32_t timeout);
+
 /**
  * @brief Place packet back into the available packets slab
  *
@@ -1107,6 +1185,36 @@ bool net_pkt_compact(struct net_pkt *pkt);
 u16_t net_pkt_append(struct net_pkt *pkt, u16_t len, const u8_t *data,
 		     s32_t timeout);
 
+/**
+ * @brief Append payload data to a packet and checksum it while copying
+ *
+ * @details Works like net_pkt_append(). In addition the sum of the data is
+ * kept in the packet, so that the UDP or TCP checksum computed when the
+ * packet is sent does not have to read the payload again. The data must
+ * stay unmodified at the end of the packet until then, which is the case
+ * for payload handed to net_context_send() or net_context_sendto().
+ *
+ * @param pkt Network packet.
+ * @param len Total length of input data
+ * @param data Data to be added
+ * @param timeout Affects the action taken should the net buf pool be empty.
+ *        If K_NO_WAIT, then return immediately. If K_FOREVER, then
+ *        wait as long as necessary. Otherwise, wait up to the specified
+ *        number of milliseconds before timing out.
+ *
+ * @return Length of data actually added.
+ */
+#if defined(CONFIG_NET_CHKSUM_COPY)
+u16_t net_pkt_append_chksum(struct net_pkt *pkt, u16_t len, const u8_t *data,
+			    s32_t timeout);
+#else
+static inline u16_t net_pkt_append_chksum(struct net_pkt *pkt, u16_t len,
+					  const u8_t *data, s32_t timeout)
+{
+	return net_pkt_append(pkt, len, data, timeout);
+}
+#endif
+
 /**
  * @brief Append all data to fragment list of a packet (or fail)
  *
@@ -1540,6 +1648,171 @@ struct net_buf *net_frag_get_pos(struct net_pkt *pkt,
 				 u16_t offset,
 				 u16_t *pos);
 
+/**
+ * @brief Position in the fragment chain of a network packet.
+ *
+ * @details A cursor remembers the fragment and the offset in it between
+ * calls, so that parsing or writing a packet piece by piece does not walk
+ * the fragment chain from its start for every field. A cursor is either
+ * inside a fragment or at the end of the last one.
+ */
+struct net_pkt_cursor {
+	/** Fragment the cursor is in, NULL if the packet has no data */
+	struct net_buf *frag;
+	/** Offset in the fragment */
+	u16_t pos;
+};
+
+/**
+ * @brief Place a cursor at the start of the packet data.
+ *
+ * @param pkt Network packet.
+ * @param cursor Cursor to initialize.
+ */
+static inline void net_pkt_cursor_init(struct net_pkt *pkt,
+				       struct net_pkt_cursor *cursor)
+{
+	cursor->frag = pkt->frags;
+	cursor->pos = 0;
+}
+
+/**
+ * @brief Move a cursor forward without reading.
+ *
+ * @param cursor Cursor.
+ * @param len Number of bytes to skip.
+ *
+ * @return 0 on success, -ENODATA if the packet is too short, in which case
+ *         the cursor is left unchanged.
+ */
+int net_pkt_cursor_skip(struct net_pkt_cursor *cursor, u16_t len);
+
+/**
+ * @brief Place a cursor at an offset from the start of the packet data.
+ *
+ * @param pkt Network packet.
+ * @param cursor Cursor.
+ * @param offset Offset from the start of the packet data.
+ *
+ * @return 0 on success, -ENODATA if the packet is too short.
+ */
+static inline int net_pkt_cursor_seek(struct net_pkt *pkt,
+				      struct net_pkt_cursor *cursor,
+				      u16_t offset)
+{
+	net_pkt_cursor_init(pkt, cursor);
+
+	return net_pkt_cursor_skip(cursor, offset);
+}
+
+/**
+ * @brief Read data at a cursor and move the cursor past it.
+ *
+ * @details Data spread over several fragments is copied one contiguous
+ * span at a time. Caller has to take care of endianness if needed.
+ *
+ * @param cursor Cursor.
+ * @param data Data will be copied here.
+ * @param len Number of bytes to read.
+ *
+ * @return 0 on success, -ENODATA if the packet is too short, in which case
+ *         the cursor is left unchanged.
+ */
+int net_pkt_cursor_read(struct net_pkt_cursor *cursor, void *data,
+			u16_t len);
+
+/**
+ * @brief Read data at a cursor without moving it.
+ *
+ * @param cursor Cursor.
+ * @param data Data will be copied here.
+ * @param len Number of bytes to read.
+ *
+ * @return 0 on success, -ENODATA if the packet is too short.
+ */
+int net_pkt_cursor_peek(const struct net_pkt_cursor *cursor, void *data,
+			u16_t len);
+
+/**
+ * @brief Read a byte at a cursor and move the cursor past it.
+ *
+ * @param cursor Cursor.
+ * @param value Value is returned.
+ *
+ * @return 0 on success, -ENODATA if the packet is too short.
+ */
+static inline int net_pkt_cursor_read_u8(struct net_pkt_cursor *cursor,
+					 u8_t *value)
+{
+	return net_pkt_cursor_read(cursor, value, sizeof(u8_t));
+}
+
+/**
+ * @brief Read a 16 bit big endian value at a cursor and move the cursor
+ * past it.
+ *
+ * @param cursor Cursor.
+ * @param value Value is returned in host byte order.
+ *
+ * @return 0 on success, -ENODATA if the packet is too short.
+ */
+int net_pkt_cursor_read_be16(struct net_pkt_cursor *cursor, u16_t *value);
+
+/**
+ * @brief Read a 32 bit big endian value at a cursor and move the cursor
+ * past it.
+ *
+ * @param cursor Cursor.
+ * @param value Value is returned in host byte order.
+ *
+ * @return 0 on success, -ENODATA if the packet is too short.
+ */
+int net_pkt_cursor_read_be32(struct net_pkt_cursor *cursor, u32_t *value);
+
+/**
+ * @brief Get direct access to contiguous data at a cursor.
+ *
+ * @details Lets parsers use a header in place when it is not split
+ * between fragments, and fall back to net_pkt_cursor_read() otherwise.
+ * The cursor is not moved.
+ *
+ * @param cursor Cursor.
+ * @param len Number of bytes needed.
+ *
+ * @return Pointer to the data if len bytes are available in the current
+ *         fragment, NULL otherwise.
+ */
+static inline void *net_pkt_cursor_data(const struct net_pkt_cursor *cursor,
+					u16_t len)
+{
+	if (!cursor->frag || cursor->pos + len > cursor->frag->len) {
+		return NULL;
+	}
+
+	return cursor->frag->data + cursor->pos;
+}
+
+/**
+ * @brief Write data at a cursor and move the cursor past it.
+ *
+ * @details Existing data is overwritten. Past the end of the packet, the
+ * tailroom of the last fragment is used and new fragments are added as
+ * needed.
+ *
+ * @param pkt Network packet.
+ * @param cursor Cursor.
+ * @param data Data to write.
+ * @param len Number of bytes to write.
+ * @param timeout Affects the action taken should the net buf pool be empty.
+ *        If K_NO_WAIT, then return immediately. If K_FOREVER, then
+ *        wait as long as necessary. Otherwise, wait up to the specified
+ *        number of milliseconds before timing out.
+ *
+ * @return 0 on success, -ENOMEM if a fragment could not be allocated.
+ */
+int net_pkt_cursor_write(struct net_pkt *pkt, struct net_pkt_cursor *cursor,
+			 const void *data, u16_t len, s32_t timeout);
+
 /**
  * @brief Clone pkt and its fragment chain.
  *
@@ -260,6 +260,12 @@ struct net_stats {
 	 */
 	struct net_stats_bytes bytes;
 
+	/*
+	 * Number of packets passed between the drivers and the stack, this
+	 * together with the byte count gives the interface throughput.
+	 */
+	struct net_stats_pkts pkts;
+
 	struct net_stats_ip_errors ip_errors;
 
 #if defined(CONFIG_NET_STATISTICS_IPV6)
@@ -381,6 +387,7 @@ enum net_request_stats_cmd {
 	NET_REQUEST_STATS_CMD_GET_TCP,
 	NET_REQUEST_STATS_CMD_GET_RPL,
 	NET_REQUEST_STATS_CMD_GET_ETHERNET,
+	NET_REQUEST_STATS_CMD_GET_PKTS,
 };
 
 #define NET_REQUEST_STATS_GET_ALL				\
@@ -398,6 +405,11 @@ NET_MGMT_DEFINE_REQUEST_HANDLER(NET_REQUEST_STATS_GET_PROCESSING_ERROR);
 
 NET_MGMT_DEFINE_REQUEST_HANDLER(NET_REQUEST_STATS_GET_BYTES);
 
+#define NET_REQUEST_STATS_GET_PKTS				\
+	(_NET_STATS_BASE | NET_REQUEST_STATS_CMD_GET_PKTS)
+
+NET_MGMT_DEFINE_REQUEST_HANDLER(NET_REQUEST_STATS_GET_PKTS);
+
 #define NET_REQUEST_STATS_GET_IP_ERRORS				\
 	(_NET_STATS_BASE | NET_REQUEST_STATS_CMD_GET_IP_ERRORS)
 
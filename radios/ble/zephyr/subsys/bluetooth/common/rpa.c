@@ -71,6 +71,61 @@ bool bt_rpa_irk_matches(const u8_t irk[16], const bt_addr_t *addr)
 }
 #endif
 
+#if defined(CONFIG_BT_RPA_CACHE)
+int bt_rpa_irk_sched(const u8_t irk[16], struct tc_aes_key_sched_struct *s)
+{
+	u8_t key[16];
+	int err = 0;
+
+	/* TinyCrypt takes the key in big-endian order, see bt_encrypt_le() */
+	sys_memcpy_swap(key, irk, 16);
+
+	if (tc_aes128_set_encrypt_key(s, key) == TC_CRYPTO_FAIL) {
+		err = -EINVAL;
+	}
+
+	memset(key, 0, sizeof(key));
+
+	return err;
+}
+
+/* Match an RPA against a set of expanded IRKs. The padded prand is the
+ * same for every IRK, so it is only prepared once. Returns the index of
+ * the first matching IRK, NULL entries are skipped.
+ */
+int bt_rpa_irk_sched_match(const struct tc_aes_key_sched_struct *s[],
+			   size_t count, const bt_addr_t *addr)
+{
+	u8_t r[16];
+	u8_t res[16];
+	size_t i;
+
+	BT_DBG("%u IRKs bdaddr %s", (unsigned int)count, bt_addr_str(addr));
+
+	/* r' = padding || r, byte swapped for TinyCrypt */
+	memset(r, 0, 13);
+	sys_memcpy_swap(r + 13, addr->val + 3, 3);
+
+	for (i = 0; i < count; i++) {
+		if (!s[i]) {
+			continue;
+		}
+
+		if (tc_aes_encrypt(res, r, s[i]) == TC_CRYPTO_FAIL) {
+			continue;
+		}
+
+		/* ah() is the least significant 24 bits of the result */
+		if (addr->val[0] == res[15] && addr->val[1] == res[14] &&
+		    addr->val[2] == res[13]) {
+			return i;
+		}
+	}
+
+	return -ENOENT;
+}
+#endif /* CONFIG_BT_RPA_CACHE */
+
 #if defined(CONFIG_BT_PRIVACY) || defined(CONFIG_BT_CTLR_PRIVACY)
 int bt_rpa_create(const u8_t irk[16], bt_addr_t *rpa)
 {
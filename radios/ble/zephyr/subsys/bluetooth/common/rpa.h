@@ -14,3 +14,11 @@
 
 bool bt_rpa_irk_matches(const u8_t irk[16], const bt_addr_t *addr);
 int bt_rpa_create(const u8_t irk[16], bt_addr_t *rpa);
+
+#if defined(CONFIG_BT_RPA_CACHE)
+#include <tinycrypt/aes.h>
+
+int bt_rpa_irk_sched(const u8_t irk[16], struct tc_aes_key_sched_struct *s);
+int bt_rpa_irk_sched_match(const struct tc_aes_key_sched_struct *s[],
+			   size_t count, const bt_addr_t *addr);
+#endif
@@ -4837,6 +4837,27 @@ int bt_le_adv_start(const struct bt_le_adv_param *param,
 	return 0;
 }
 
+int bt_le_adv_update_data(const struct bt_data *ad, size_t ad_len,
+			  const struct bt_data *sd, size_t sd_len)
+{
+	int err;
+
+	if (!atomic_test_bit(bt_dev.flags, BT_DEV_ADVERTISING)) {
+		return -EAGAIN;
+	}
+
+	err = set_ad(BT_HCI_OP_LE_SET_ADV_DATA, ad, ad_len);
+	if (err) {
+		return err;
+	}
+
+	if (sd) {
+		return set_ad(BT_HCI_OP_LE_SET_SCAN_RSP_DATA, sd, sd_len);
+	}
+
+	return 0;
+}
+
 int bt_le_adv_stop(void)
 {
 	int err;
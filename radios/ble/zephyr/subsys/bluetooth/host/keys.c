@@ -28,6 +28,178 @@
 
 static struct bt_keys key_pool[CONFIG_BT_MAX_PAIRED];
 
+#if defined(CONFIG_BT_RPA_CACHE)
+#define RPA_CACHE_NO_MATCH   0xff
+#define RPA_CACHE_TIMEOUT    K_SECONDS(CONFIG_BT_RPA_CACHE_TIMEOUT)
+
+struct bt_rpa_cache_stats bt_rpa_cache_stats;
+
+static struct rpa_cache_entry {
+	bt_addr_t rpa;
+	/* Index in key_pool, or RPA_CACHE_NO_MATCH */
+	u8_t      id;
+	u8_t      valid;
+	u32_t     added;
+} rpa_cache[CONFIG_BT_RPA_CACHE_SIZE];
+
+/* Expanded IRKs, along with the IRK they were expanded from so that
+ * changes to key_pool (pairing, settings, unpairing) are noticed.
+ */
+static struct {
+	u8_t irk[16];
+	struct tc_aes_key_sched_struct sched;
+} irk_sched[CONFIG_BT_MAX_PAIRED];
+
+static const struct tc_aes_key_sched_struct *irk_active[CONFIG_BT_MAX_PAIRED];
+
+static void rpa_cache_flush(void)
+{
+	BT_DBG("");
+
+	memset(rpa_cache, 0, sizeof(rpa_cache));
+}
+
+/* Bring the expanded IRKs in line with key_pool. Any change flushes the
+ * cache: a new IRK may resolve addresses cached as unresolvable and a
+ * removed one must not be reported anymore.
+ */
+static void irk_sched_sync(void)
+{
+	bool changed = false;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(key_pool); i++) {
+		struct bt_keys *keys = &key_pool[i];
+
+		if (!(keys->keys & BT_KEYS_IRK)) {
+			if (irk_active[i]) {
+				irk_active[i] = NULL;
+				changed = true;
+			}
+
+			continue;
+		}
+
+		if (irk_active[i] &&
+		    !memcmp(irk_sched[i].irk, keys->irk.val, 16)) {
+			continue;
+		}
+
+		changed = true;
+		memcpy(irk_sched[i].irk, keys->irk.val, 16);
+
+		if (bt_rpa_irk_sched(keys->irk.val, &irk_sched[i].sched)) {
+			irk_active[i] = NULL;
+		} else {
+			irk_active[i] = &irk_sched[i].sched;
+		}
+	}
+
+	if (changed) {
+		rpa_cache_flush();
+	}
+}
+
+static struct rpa_cache_entry *rpa_cache_find(const bt_addr_t *rpa)
+{
+	u32_t now = k_uptime_get_32();
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(rpa_cache); i++) {
+		struct rpa_cache_entry *entry = &rpa_cache[i];
+
+		if (!entry->valid) {
+			continue;
+		}
+
+		if (now - entry->added > RPA_CACHE_TIMEOUT) {
+			entry->valid = 0;
+			continue;
+		}
+
+		if (!bt_addr_cmp(&entry->rpa, rpa)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void rpa_cache_add(const bt_addr_t *rpa, u8_t id)
+{
+	struct rpa_cache_entry *entry = NULL;
+	int i;
+
+	/* Free entry, otherwise the oldest one */
+	for (i = 0; i < ARRAY_SIZE(rpa_cache); i++) {
+		if (!rpa_cache[i].valid) {
+			entry = &rpa_cache[i];
+			break;
+		}
+
+		if (!entry || (s32_t)(rpa_cache[i].added - entry->added) < 0) {
+			entry = &rpa_cache[i];
+		}
+	}
+
+	bt_addr_copy(&entry->rpa, rpa);
+	entry->id = id;
+	entry->valid = 1;
+	entry->added = k_uptime_get_32();
+}
+
+static struct bt_keys *irk_resolve(const bt_addr_le_t *addr)
+{
+	struct rpa_cache_entry *entry;
+	int i;
+
+	irk_sched_sync();
+
+	bt_rpa_cache_stats.lookups++;
+
+	entry = rpa_cache_find(&addr->a);
+	if (entry) {
+		if (entry->id == RPA_CACHE_NO_MATCH) {
+			bt_rpa_cache_stats.neg_hits++;
+			return NULL;
+		}
+
+		bt_rpa_cache_stats.hits++;
+		return &key_pool[entry->id];
+	}
+
+	bt_rpa_cache_stats.resolutions++;
+
+	i = bt_rpa_irk_sched_match(irk_active, ARRAY_SIZE(irk_active),
+				   &addr->a);
+	if (i < 0) {
+		rpa_cache_add(&addr->a, RPA_CACHE_NO_MATCH);
+		return NULL;
+	}
+
+	rpa_cache_add(&addr->a, i);
+
+	return &key_pool[i];
+}
+#else
+static struct bt_keys *irk_resolve(const bt_addr_le_t *addr)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(key_pool); i++) {
+		if (!(key_pool[i].keys & BT_KEYS_IRK)) {
+			continue;
+		}
+
+		if (bt_rpa_irk_matches(key_pool[i].irk.val, &addr->a)) {
+			return &key_pool[i];
+		}
+	}
+
+	return NULL;
+}
+#endif /* CONFIG_BT_RPA_CACHE */
+
 struct bt_keys *bt_keys_get_addr(const bt_addr_le_t *addr)
 {
 	struct bt_keys *keys;
@@ -104,6 +276,7 @@ struct bt_keys *bt_keys_get_type(int type, const bt_addr_le_t *addr)
 
 struct bt_keys *bt_keys_find_irk(const bt_addr_le_t *addr)
 {
+	struct bt_keys *keys;
 	int i;
 
 	BT_DBG("%s", bt_addr_le_str(addr));
@@ -125,20 +298,14 @@ struct bt_keys *bt_keys_find_irk(const bt_addr_le_t *addr)
 		}
 	}
 
-	for (i = 0; i < ARRAY_SIZE(key_pool); i++) {
-		if (!(key_pool[i].keys & BT_KEYS_IRK)) {
-			continue;
-		}
-
-		if (bt_rpa_irk_matches(key_pool[i].irk.val, &addr->a)) {
-			BT_DBG("RPA %s matches %s",
-			       bt_addr_str(&key_pool[i].irk.rpa),
-			       bt_addr_le_str(&key_pool[i].addr));
+	keys = irk_resolve(addr);
+	if (keys) {
+		BT_DBG("RPA %s matches %s", bt_addr_str(&addr->a),
+		       bt_addr_le_str(&keys->addr));
 
-			bt_addr_copy(&key_pool[i].irk.rpa, &addr->a);
+		bt_addr_copy(&keys->irk.rpa, &addr->a);
 
-			return &key_pool[i];
-		}
+		return keys;
 	}
 
 	BT_DBG("No IRK for %s", bt_addr_le_str(addr));
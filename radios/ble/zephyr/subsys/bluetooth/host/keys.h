@@ -71,6 +71,17 @@ struct bt_keys *bt_keys_find(int type, const bt_addr_le_t *addr);
 struct bt_keys *bt_keys_find_irk(const bt_addr_le_t *addr);
 struct bt_keys *bt_keys_find_addr(const bt_addr_le_t *addr);
 
+#if defined(CONFIG_BT_RPA_CACHE)
+struct bt_rpa_cache_stats {
+	u32_t lookups;      /* RPAs not matching a bond's current RPA */
+	u32_t hits;         /* Served from cache, resolved to a bond */
+	u32_t neg_hits;     /* Served from cache, no bond */
+	u32_t resolutions;  /* Matched against all IRKs */
+};
+
+extern struct bt_rpa_cache_stats bt_rpa_cache_stats;
+#endif
+
 void bt_keys_add_type(struct bt_keys *keys, int type);
 void bt_keys_clear(struct bt_keys *keys);
 void bt_keys_clear_all(void);
@@ -7,6 +7,7 @@
  */
 
 #include <zephyr.h>
+#include <string.h>
 #include <errno.h>
 #include <misc/util.h>
 #include <misc/byteorder.h>
@@ -29,6 +30,31 @@
 static const struct bt_mesh_comp *dev_comp;
 static u16_t dev_primary_addr;
 
+#if defined(CONFIG_BT_MESH_ACCESS_INDEX)
+/* All OpCode handlers of the composition, sorted by OpCode. Entries
+ * with equal OpCodes keep composition order (element, then model), so
+ * the first entry of an element is the handler find_op() would pick.
+ */
+static struct op_entry {
+	u32_t opcode;
+	struct bt_mesh_model *model;
+	const struct bt_mesh_model_op *op;
+} op_index[CONFIG_BT_MESH_ACCESS_OP_INDEX_SIZE];
+static u16_t op_index_count;
+static bool op_index_valid;
+
+/* Subscribed group and virtual addresses, sorted by address, with a
+ * bitmap of the elements having at least one model subscribed.
+ */
+static struct group_entry {
+	u16_t addr;
+	u32_t elems;
+} group_index[CONFIG_BT_MESH_ACCESS_GROUP_INDEX_SIZE];
+static u16_t group_index_count;
+static bool group_index_valid;
+static bool group_index_full;
+#endif /* CONFIG_BT_MESH_ACCESS_INDEX */
+
 static const struct {
 	const u16_t id;
 	int (*const init)(struct bt_mesh_model *model, bool primary);
@@ -299,6 +325,184 @@ static void mod_init(struct bt_mesh_model *mod, struct bt_mesh_elem *elem,
 	}
 }
 
+#if defined(CONFIG_BT_MESH_ACCESS_INDEX)
+static void op_index_add(struct bt_mesh_model *mod, struct bt_mesh_elem *elem,
+			 bool vnd, bool primary, void *user_data)
+{
+	const struct bt_mesh_model_op *op, *prev;
+	int i;
+
+	for (op = mod->op; op->func; op++) {
+		struct op_entry *entry;
+
+		/* Vendor OpCodes are only looked up in vendor models and
+		 * SIG OpCodes only in SIG models.
+		 */
+		if (vnd != (op->opcode >= 0x10000)) {
+			continue;
+		}
+
+		/* Only the first handler of a model can ever match */
+		for (prev = mod->op; prev != op; prev++) {
+			if (prev->opcode == op->opcode) {
+				break;
+			}
+		}
+
+		if (prev != op) {
+			continue;
+		}
+
+		if (op_index_count == ARRAY_SIZE(op_index)) {
+			op_index_valid = false;
+			continue;
+		}
+
+		/* Insertion sort; stable for equal OpCodes */
+		for (i = op_index_count; i > 0; i--) {
+			if (op_index[i - 1].opcode <= op->opcode) {
+				break;
+			}
+
+			op_index[i] = op_index[i - 1];
+		}
+
+		entry = &op_index[i];
+		entry->opcode = op->opcode;
+		entry->model = mod;
+		entry->op = op;
+
+		op_index_count++;
+	}
+}
+
+static void op_index_build(void)
+{
+	op_index_count = 0;
+	op_index_valid = true;
+
+	bt_mesh_model_foreach(op_index_add, NULL);
+
+	if (!op_index_valid) {
+		BT_WARN("OpCode index too small, using linear lookup");
+	}
+
+	BT_DBG("%u OpCodes indexed", op_index_count);
+}
+
+/* Index of the first entry with the given OpCode, or op_index_count */
+static u16_t op_index_find(u32_t opcode)
+{
+	u16_t lo = 0, hi = op_index_count;
+
+	while (lo < hi) {
+		u16_t mid = (lo + hi) / 2;
+
+		if (op_index[mid].opcode < opcode) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+void bt_mesh_group_index_invalidate(void)
+{
+	group_index_valid = false;
+}
+
+static void group_index_add(struct bt_mesh_model *mod,
+			    struct bt_mesh_elem *elem, bool vnd, bool primary,
+			    void *user_data)
+{
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(mod->groups); i++) {
+		u16_t addr = mod->groups[i];
+
+		if (addr == BT_MESH_ADDR_UNASSIGNED) {
+			continue;
+		}
+
+		for (j = group_index_count; j > 0; j--) {
+			if (group_index[j - 1].addr <= addr) {
+				break;
+			}
+		}
+
+		if (j > 0 && group_index[j - 1].addr == addr) {
+			group_index[j - 1].elems |= BIT(mod->elem_idx);
+			continue;
+		}
+
+		if (group_index_count == ARRAY_SIZE(group_index)) {
+			group_index_full = true;
+			continue;
+		}
+
+		memmove(&group_index[j + 1], &group_index[j],
+			(group_index_count - j) * sizeof(group_index[0]));
+		group_index[j].addr = addr;
+		group_index[j].elems = BIT(mod->elem_idx);
+
+		group_index_count++;
+	}
+}
+
+static void group_index_build(void)
+{
+	group_index_count = 0;
+	group_index_full = false;
+
+	bt_mesh_model_foreach(group_index_add, NULL);
+
+	if (group_index_full) {
+		BT_WARN("Group index too small, using linear lookup");
+	}
+
+	group_index_valid = true;
+}
+
+/* Returns false if the index can't answer and a linear search is needed */
+static bool group_index_elems(u16_t addr, u32_t *elems)
+{
+	u16_t lo = 0, hi;
+
+	if (dev_comp->elem_count > 32) {
+		return false;
+	}
+
+	if (!group_index_valid) {
+		group_index_build();
+	}
+
+	if (group_index_full) {
+		return false;
+	}
+
+	hi = group_index_count;
+	while (lo < hi) {
+		u16_t mid = (lo + hi) / 2;
+
+		if (group_index[mid].addr < addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo < group_index_count && group_index[lo].addr == addr) {
+		*elems = group_index[lo].elems;
+	} else {
+		*elems = 0;
+	}
+
+	return true;
+}
+#endif /* CONFIG_BT_MESH_ACCESS_INDEX */
+
 int bt_mesh_comp_register(const struct bt_mesh_comp *comp)
 {
 	/* There must be at least one element */
@@ -310,6 +514,11 @@ int bt_mesh_comp_register(const struct bt_mesh_comp *comp)
 
 	bt_mesh_model_foreach(mod_init, NULL);
 
+#if defined(CONFIG_BT_MESH_ACCESS_INDEX)
+	op_index_build();
+	bt_mesh_group_index_invalidate();
+#endif
+
 	return 0;
 }
 
@@ -390,6 +599,20 @@ struct bt_mesh_elem *bt_mesh_elem_find(u16_t addr)
 {
 	int i;
 
+#if defined(CONFIG_BT_MESH_ACCESS_INDEX)
+	if (BT_MESH_ADDR_IS_GROUP(addr) || BT_MESH_ADDR_IS_VIRTUAL(addr)) {
+		u32_t elems;
+
+		if (group_index_elems(addr, &elems)) {
+			if (!elems) {
+				return NULL;
+			}
+
+			return &dev_comp->elem[find_lsb_set(elems) - 1];
+		}
+	}
+#endif
+
 	for (i = 0; i < dev_comp->elem_count; i++) {
 		struct bt_mesh_elem *elem = &dev_comp->elem[i];
 
@@ -503,6 +726,82 @@ bool bt_mesh_fixed_group_match(u16_t addr)
 	}
 }
 
+static void model_dispatch(struct bt_mesh_model *model,
+			   const struct bt_mesh_model_op *op,
+			   struct bt_mesh_net_rx *rx, struct net_buf_simple *buf)
+{
+	struct net_buf_simple_state state;
+
+	if (buf->len < op->min_len) {
+		BT_ERR("Too short message for OpCode 0x%08x", op->opcode);
+		return;
+	}
+
+	/* The callback will likely parse the buffer, so store the parsing
+	 * state in case multiple models receive the message.
+	 */
+	net_buf_simple_save(buf, &state);
+	op->func(model, &rx->ctx, buf);
+	net_buf_simple_restore(buf, &state);
+}
+
+#if defined(CONFIG_BT_MESH_ACCESS_INDEX)
+/* Dispatches through the OpCode and group indexes. Returns false if the
+ * indexes can't be used, in which case the caller does a linear lookup.
+ */
+static bool model_recv_indexed(struct bt_mesh_net_rx *rx,
+			       struct net_buf_simple *buf, u32_t opcode)
+{
+	u16_t dst = rx->ctx.recv_dst;
+	u32_t elems;
+	int last = -1;
+	u16_t i;
+
+	if (!op_index_valid || dev_comp->elem_count > 32) {
+		return false;
+	}
+
+	if (BT_MESH_ADDR_IS_UNICAST(dst)) {
+		u16_t idx = dst - dev_primary_addr;
+
+		if (dst < dev_primary_addr || idx >= dev_comp->elem_count ||
+		    dev_comp->elem[idx].addr != dst) {
+			return true;
+		}
+
+		elems = BIT(idx);
+	} else if (BT_MESH_ADDR_IS_GROUP(dst) ||
+		   BT_MESH_ADDR_IS_VIRTUAL(dst)) {
+		if (!group_index_elems(dst, &elems)) {
+			return false;
+		}
+	} else if (bt_mesh_fixed_group_match(dst)) {
+		elems = BIT(0);
+	} else {
+		return true;
+	}
+
+	for (i = op_index_find(opcode);
+	     i < op_index_count && op_index[i].opcode == opcode; i++) {
+		struct op_entry *entry = &op_index[i];
+		u8_t elem_idx = entry->model->elem_idx;
+
+		if (!(elems & BIT(elem_idx)) || elem_idx == last) {
+			continue;
+		}
+
+		if (!model_has_key(entry->model, rx->ctx.app_idx)) {
+			continue;
+		}
+
+		last = elem_idx;
+		model_dispatch(entry->model, entry->op, rx, buf);
+	}
+
+	return true;
+}
+#endif /* CONFIG_BT_MESH_ACCESS_INDEX */
+
 void bt_mesh_model_recv(struct bt_mesh_net_rx *rx, struct net_buf_simple *buf)
 {
 	struct bt_mesh_model *models, *model;
@@ -522,6 +821,12 @@ void bt_mesh_model_recv(struct bt_mesh_net_rx *rx, struct net_buf_simple *buf)
 
 	BT_DBG("OpCode 0x%08x", opcode);
 
+#if defined(CONFIG_BT_MESH_ACCESS_INDEX)
+	if (model_recv_indexed(rx, buf, opcode)) {
+		return;
+	}
+#endif
+
 	for (i = 0; i < dev_comp->elem_count; i++) {
 		struct bt_mesh_elem *elem = &dev_comp->elem[i];
 
@@ -553,22 +858,7 @@ void bt_mesh_model_recv(struct bt_mesh_net_rx *rx, struct net_buf_simple *buf)
 
 		op = find_op(models, count, rx->ctx.app_idx, opcode, &model);
 		if (op) {
-			struct net_buf_simple_state state;
-
-			if (buf->len < op->min_len) {
-				BT_ERR("Too short message for OpCode 0x%08x",
-				       opcode);
-				continue;
-			}
-
-			/* The callback will likely parse the buffer, so
-			 * store the parsing state in case multiple models
-			 * receive the message.
-			 */
-			net_buf_simple_save(buf, &state);
-			op->func(model, &rx->ctx, buf);
-			net_buf_simple_restore(buf, &state);
-
+			model_dispatch(model, op, rx, buf);
 		} else {
 			BT_DBG("No OpCode 0x%08x for elem %d", opcode, i);
 		}
@@ -29,6 +29,15 @@ u16_t *bt_mesh_model_find_group(struct bt_mesh_model *mod, u16_t addr);
 
 bool bt_mesh_fixed_group_match(u16_t addr);
 
+/* Must be called whenever model subscription lists change */
+#if defined(CONFIG_BT_MESH_ACCESS_INDEX)
+void bt_mesh_group_index_invalidate(void);
+#else
+static inline void bt_mesh_group_index_invalidate(void)
+{
+}
+#endif
+
 void bt_mesh_model_foreach(void (*func)(struct bt_mesh_model *mod,
 					struct bt_mesh_elem *elem,
 					bool vnd, bool primary,
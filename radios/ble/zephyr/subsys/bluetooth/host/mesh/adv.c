@@ -53,10 +53,50 @@
 #define ADV_STACK_SIZE 512
 #endif
 
-static K_FIFO_DEFINE(adv_queue);
+#if defined(CONFIG_BT_MESH_ADV_PRIO)
+#define ADV_PRIO(buf)  (BT_MESH_ADV(buf)->prio)
+#define ADV_QUEUES     BT_MESH_ADV_PRIO_COUNT
+#else
+#define ADV_PRIO(buf)  0
+#define ADV_QUEUES     1
+#endif
+
+/* One queue per priority class, protected by irq_lock(). The adv thread
+ * is woken up through adv_sem whenever something is queued.
+ */
+static sys_slist_t adv_queue[ADV_QUEUES];
+static K_SEM_DEFINE(adv_sem, 0, 1);
+
 static struct k_thread adv_thread_data;
 static BT_STACK_NOINIT(adv_thread_stack, ADV_STACK_SIZE);
 
+static const struct bt_mesh_adv_bearer adv_bearer_hci = {
+	.start  = bt_le_adv_start,
+	.update = bt_le_adv_update_data,
+	.stop   = bt_le_adv_stop,
+};
+
+static const struct bt_mesh_adv_bearer *adv_bearer = &adv_bearer_hci;
+
+/* State of the advertising set as last configured by the adv thread */
+static struct {
+	bool on;
+	u16_t adv_int;
+	struct net_buf *buf;
+} bearer;
+
+/* Number of consecutive slots given to a class while a lower priority
+ * class had PDUs waiting.
+ */
+static u8_t adv_burst;
+
+#if defined(CONFIG_BT_MESH_ADV_STATS)
+static struct bt_mesh_adv_stats adv_stats;
+#define ADV_STATS_INC(field) (adv_stats.field++)
+#else
+#define ADV_STATS_INC(field)
+#endif
+
 static const u8_t adv_type[] = {
 	[BT_MESH_ADV_PROV]   = BT_DATA_MESH_PROV,
 	[BT_MESH_ADV_DATA]   = BT_DATA_MESH_MESSAGE,
@@ -91,33 +131,179 @@ static inline void adv_send_end(int err, const struct bt_mesh_send_cb *cb,
 	}
 }
 
-static inline void adv_send(struct net_buf *buf)
+static inline s32_t adv_int_get(struct net_buf *buf)
 {
 	const s32_t adv_int_min = ((bt_dev.hci_version >= BT_HCI_VERSION_5_0) ?
 				   ADV_INT_FAST_MS : ADV_INT_DEFAULT_MS);
-	const struct bt_mesh_send_cb *cb = BT_MESH_ADV(buf)->cb;
-	void *cb_data = BT_MESH_ADV(buf)->cb_data;
+
+	return max(adv_int_min, BT_MESH_TRANSMIT_INT(BT_MESH_ADV(buf)->xmit));
+}
+
+static void adv_enqueue(struct net_buf *buf, bool head)
+{
+	sys_slist_t *queue = &adv_queue[ADV_PRIO(buf)];
+	unsigned int key;
+
+	key = irq_lock();
+
+	if (head) {
+		sys_slist_prepend(queue, &buf->node);
+	} else {
+		sys_slist_append(queue, &buf->node);
+	}
+
+#if defined(CONFIG_BT_MESH_ADV_STATS)
+	{
+		struct bt_mesh_adv_prio_stats *stats =
+			&adv_stats.prio[BT_MESH_ADV(buf)->prio];
+
+		if (++stats->depth > stats->depth_max) {
+			stats->depth_max = stats->depth;
+		}
+	}
+#endif
+
+	irq_unlock(key);
+}
+
+/* Pick the queue to serve next: the highest priority non-empty one,
+ * unless it has been served CONFIG_BT_MESH_ADV_PRIO_BURST times in a row
+ * while lower priority PDUs were waiting, in which case the next lower
+ * priority non-empty queue gets one slot.
+ */
+static int adv_queue_pick(void)
+{
+	int prio, next;
+
+	for (prio = 0; prio < ADV_QUEUES; prio++) {
+		if (!sys_slist_is_empty(&adv_queue[prio])) {
+			break;
+		}
+	}
+
+	if (prio == ADV_QUEUES) {
+		return -ENOENT;
+	}
+
+	for (next = prio + 1; next < ADV_QUEUES; next++) {
+		if (!sys_slist_is_empty(&adv_queue[next])) {
+			break;
+		}
+	}
+
+	if (next == ADV_QUEUES) {
+		adv_burst = 0;
+		return prio;
+	}
+
+#if defined(CONFIG_BT_MESH_ADV_PRIO)
+	if (++adv_burst > CONFIG_BT_MESH_ADV_PRIO_BURST) {
+		adv_burst = 0;
+		return next;
+	}
+#endif
+
+	return prio;
+}
+
+static struct net_buf *adv_dequeue(void)
+{
+	struct net_buf *buf;
+	unsigned int key;
+	int prio;
+
+	while (1) {
+		key = irq_lock();
+
+		prio = adv_queue_pick();
+		if (prio < 0) {
+			irq_unlock(key);
+			return NULL;
+		}
+
+		buf = CONTAINER_OF(sys_slist_get_not_empty(&adv_queue[prio]),
+				   struct net_buf, node);
+		/* The node shares storage with the fragment pointer */
+		buf->frags = NULL;
+
+#if defined(CONFIG_BT_MESH_ADV_STATS)
+		adv_stats.prio[BT_MESH_ADV(buf)->prio].depth--;
+#endif
+
+		irq_unlock(key);
+
+		/* busy == 0 means this was canceled */
+		if (BT_MESH_ADV(buf)->busy) {
+			return buf;
+		}
+
+		if (bearer.buf == buf) {
+			bearer.buf = NULL;
+		}
+
+		net_buf_unref(buf);
+	}
+}
+
+/* Relays that are already waiting in the queue don't need to go out
+ * again, e.g. when the same PDU was heard from several neighbours.
+ */
+static bool adv_relay_queued(struct net_buf *buf)
+{
+#if defined(CONFIG_BT_MESH_ADV_PRIO)
+	struct net_buf *queued;
+	unsigned int key;
+	bool found = false;
+
+	key = irq_lock();
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&adv_queue[BT_MESH_ADV_PRIO_RELAY],
+				     queued, node) {
+		if (BT_MESH_ADV(queued)->busy && queued->len == buf->len &&
+		    !memcmp(queued->data, buf->data, buf->len)) {
+			found = true;
+			break;
+		}
+	}
+
+	irq_unlock(key);
+
+	return found;
+#else
+	return false;
+#endif
+}
+
+/* Put the PDU on air. Advertising data is replaced in place when the
+ * advertising set is already running with the same interval, so that
+ * back-to-back PDUs don't cost an enable/disable cycle each.
+ */
+static int adv_bearer_set(struct net_buf *buf, s32_t adv_int)
+{
 	struct bt_le_adv_param param;
-	u16_t duration, adv_int;
 	struct bt_data ad;
 	int err;
 
-	adv_int = max(adv_int_min,
-		      BT_MESH_TRANSMIT_INT(BT_MESH_ADV(buf)->xmit));
-	duration = (MESH_SCAN_WINDOW_MS +
-		    ((BT_MESH_TRANSMIT_COUNT(BT_MESH_ADV(buf)->xmit) + 1) *
-		     (adv_int + 10)));
-
-	BT_DBG("type %u len %u: %s", BT_MESH_ADV(buf)->type,
-	       buf->len, bt_hex(buf->data, buf->len));
-	BT_DBG("count %u interval %ums duration %ums",
-	       BT_MESH_TRANSMIT_COUNT(BT_MESH_ADV(buf)->xmit) + 1, adv_int,
-	       duration);
-
 	ad.type = adv_type[BT_MESH_ADV(buf)->type];
 	ad.data_len = buf->len;
 	ad.data = buf->data;
 
+	if (bearer.on && bearer.adv_int == adv_int) {
+		err = adv_bearer->update(&ad, 1, NULL, 0);
+		if (!err) {
+			ADV_STATS_INC(updates);
+			bearer.buf = buf;
+			return 0;
+		}
+
+		BT_WARN("Updating advertising data failed: err %d", err);
+	}
+
+	if (bearer.on) {
+		adv_bearer->stop();
+		bearer.on = false;
+	}
+
 	if (IS_ENABLED(CONFIG_BT_MESH_DEBUG_USE_ID_ADDR)) {
 		param.options = BT_LE_ADV_OPT_USE_IDENTITY;
 	} else {
@@ -127,20 +313,34 @@ static inline void adv_send(struct net_buf *buf)
 	param.interval_min = ADV_SCAN_UNIT(adv_int);
 	param.interval_max = param.interval_min;
 
-	err = bt_le_adv_start(&param, &ad, 1, NULL, 0);
-	net_buf_unref(buf);
-	adv_send_start(duration, err, cb, cb_data);
+	err = adv_bearer->start(&param, &ad, 1, NULL, 0);
 	if (err) {
-		BT_ERR("Advertising failed: err %d", err);
-		return;
+		bearer.buf = NULL;
+		return err;
 	}
 
-	BT_DBG("Advertising started. Sleeping %u ms", duration);
+	ADV_STATS_INC(starts);
 
-	k_sleep(K_MSEC(duration));
+	bearer.on = true;
+	bearer.adv_int = adv_int;
+	bearer.buf = buf;
 
-	err = bt_le_adv_stop();
-	adv_send_end(err, cb, cb_data);
+	return 0;
+}
+
+static void adv_bearer_stop(void)
+{
+	int err;
+
+	bearer.buf = NULL;
+
+	if (!bearer.on) {
+		return;
+	}
+
+	bearer.on = false;
+
+	err = adv_bearer->stop();
 	if (err) {
 		BT_ERR("Stopping advertising failed: err %d", err);
 		return;
@@ -149,6 +349,89 @@ static inline void adv_send(struct net_buf *buf)
 	BT_DBG("Advertising stopped");
 }
 
+static void adv_complete(struct net_buf *buf, int err)
+{
+	const struct bt_mesh_send_cb *cb = BT_MESH_ADV(buf)->cb;
+	void *cb_data = BT_MESH_ADV(buf)->cb_data;
+
+	if (bearer.buf == buf) {
+		bearer.buf = NULL;
+	}
+
+	BT_MESH_ADV(buf)->busy = 0;
+	net_buf_unref(buf);
+	adv_send_end(err, cb, cb_data);
+}
+
+/* Transmit the PDU for one advertising interval. Returns true once all
+ * transmissions requested by the xmit parameter have been done (or the
+ * PDU failed), in which case the buffer has been released.
+ */
+static bool adv_send_slot(struct net_buf *buf)
+{
+	struct bt_mesh_adv *adv = BT_MESH_ADV(buf);
+	u8_t count = BT_MESH_TRANSMIT_COUNT(adv->xmit) + 1;
+	s32_t adv_int = adv_int_get(buf);
+	s32_t slot = adv_int + 10;
+	int err = 0;
+
+	if (bearer.buf != buf) {
+		bool restart = !bearer.on || bearer.adv_int != adv_int;
+
+		BT_DBG("type %u len %u: %s", adv->type, buf->len,
+		       bt_hex(buf->data, buf->len));
+
+		err = adv_bearer_set(buf, adv_int);
+		if (!err && restart) {
+			slot += MESH_SCAN_WINDOW_MS;
+		}
+	}
+
+	if (!adv->sent) {
+		u16_t duration = (MESH_SCAN_WINDOW_MS + count * (adv_int + 10));
+
+		BT_DBG("count %u interval %ums duration %ums", count, adv_int,
+		       duration);
+
+#if defined(CONFIG_BT_MESH_ADV_STATS)
+		if (!err) {
+			struct bt_mesh_adv_prio_stats *stats =
+				&adv_stats.prio[adv->prio];
+			u32_t latency = k_uptime_get_32() - adv->queued;
+
+			stats->sent++;
+			stats->latency_sum += latency;
+			if (latency > stats->latency_max) {
+				stats->latency_max = latency;
+			}
+		}
+#endif
+
+		adv_send_start(duration, err, adv->cb, adv->cb_data);
+	}
+
+	if (err) {
+		BT_ERR("Advertising failed: err %d", err);
+		/* PDUs that failed to start only get the start callback */
+		if (!adv->sent) {
+			adv->cb = NULL;
+		}
+
+		adv_complete(buf, err);
+		return true;
+	}
+
+	k_sleep(K_MSEC(slot));
+
+	if (++adv->sent < count) {
+		return false;
+	}
+
+	adv_complete(buf, 0);
+
+	return true;
+}
+
 static void adv_stack_dump(const struct k_thread *thread, void *user_data)
 {
 #if defined(CONFIG_THREAD_STACK_INFO)
@@ -164,29 +447,31 @@ static void adv_thread(void *p1, void *p2, void *p3)
 	while (1) {
 		struct net_buf *buf;
 
-		if (IS_ENABLED(CONFIG_BT_MESH_PROXY)) {
-			buf = net_buf_get(&adv_queue, K_NO_WAIT);
-			while (!buf) {
+		buf = adv_dequeue();
+		if (!buf) {
+			adv_bearer_stop();
+
+			if (IS_ENABLED(CONFIG_BT_MESH_PROXY)) {
 				s32_t timeout;
 
 				timeout = bt_mesh_proxy_adv_start();
 				BT_DBG("Proxy Advertising up to %d ms",
 				       timeout);
-				buf = net_buf_get(&adv_queue, timeout);
+				k_sem_take(&adv_sem, timeout);
 				bt_mesh_proxy_adv_stop();
+			} else {
+				k_sem_take(&adv_sem, K_FOREVER);
 			}
-		} else {
-			buf = net_buf_get(&adv_queue, K_FOREVER);
-		}
 
-		if (!buf) {
 			continue;
 		}
 
-		/* busy == 0 means this was canceled */
-		if (BT_MESH_ADV(buf)->busy) {
-			BT_MESH_ADV(buf)->busy = 0;
-			adv_send(buf);
+		/* PDUs with transmissions left go to the back of their
+		 * class, so that the retransmissions of queued PDUs are
+		 * interleaved rather than sent back-to-back.
+		 */
+		if (!adv_send_slot(buf)) {
+			adv_enqueue(buf, !IS_ENABLED(CONFIG_BT_MESH_ADV_PRIO));
 		}
 
 		STACK_ANALYZE("adv stack", adv_thread_stack);
@@ -201,7 +486,7 @@ void bt_mesh_adv_update(void)
 {
 	BT_DBG("");
 
-	k_fifo_cancel_wait(&adv_queue);
+	k_sem_give(&adv_sem);
 }
 
 struct net_buf *bt_mesh_adv_create_from_pool(struct net_buf_pool *pool,
@@ -225,6 +510,12 @@ struct net_buf *bt_mesh_adv_create_from_pool(struct net_buf_pool *pool,
 	adv->type         = type;
 	adv->xmit         = xmit;
 
+	if (type == BT_MESH_ADV_BEACON || type == BT_MESH_ADV_URI) {
+		adv->prio = BT_MESH_ADV_PRIO_BEACON;
+	} else {
+		adv->prio = BT_MESH_ADV_PRIO_LOCAL;
+	}
+
 	return buf;
 }
 
@@ -241,12 +532,63 @@ void bt_mesh_adv_send(struct net_buf *buf, const struct bt_mesh_send_cb *cb,
 	BT_DBG("type 0x%02x len %u: %s", BT_MESH_ADV(buf)->type, buf->len,
 	       bt_hex(buf->data, buf->len));
 
+	if (BT_MESH_ADV(buf)->prio == BT_MESH_ADV_PRIO_RELAY && !cb &&
+	    adv_relay_queued(buf)) {
+		BT_DBG("Dropping duplicate relay");
+		ADV_STATS_INC(prio[BT_MESH_ADV_PRIO_RELAY].dropped);
+		return;
+	}
+
 	BT_MESH_ADV(buf)->cb = cb;
 	BT_MESH_ADV(buf)->cb_data = cb_data;
 	BT_MESH_ADV(buf)->busy = 1;
+	BT_MESH_ADV(buf)->sent = 0;
+#if defined(CONFIG_BT_MESH_ADV_STATS)
+	BT_MESH_ADV(buf)->queued = k_uptime_get_32();
+#endif
+
+	adv_enqueue(net_buf_ref(buf), false);
+	k_sem_give(&adv_sem);
+}
+
+#if defined(CONFIG_BT_MESH_ADV_STATS)
+void bt_mesh_adv_stats_get(struct bt_mesh_adv_stats *stats)
+{
+	unsigned int key;
+
+	key = irq_lock();
+	memcpy(stats, &adv_stats, sizeof(*stats));
+	irq_unlock(key);
+}
+
+void bt_mesh_adv_stats_reset(void)
+{
+	unsigned int key;
+	int i;
+
+	key = irq_lock();
+
+	for (i = 0; i < ARRAY_SIZE(adv_stats.prio); i++) {
+		u16_t depth = adv_stats.prio[i].depth;
+
+		memset(&adv_stats.prio[i], 0, sizeof(adv_stats.prio[i]));
+		adv_stats.prio[i].depth = depth;
+		adv_stats.prio[i].depth_max = depth;
+	}
+
+	adv_stats.starts = 0;
+	adv_stats.updates = 0;
 
-	net_buf_put(&adv_queue, net_buf_ref(buf));
+	irq_unlock(key);
 }
+#endif
+
+#if defined(CONFIG_BT_TESTING)
+void bt_mesh_adv_bearer_set(const struct bt_mesh_adv_bearer *bearer)
+{
+	adv_bearer = bearer ? bearer : &adv_bearer_hci;
+}
+#endif
 
 static void bt_mesh_scan_cb(const bt_addr_le_t *addr, s8_t rssi,
 			    u8_t adv_type, struct net_buf_simple *buf)
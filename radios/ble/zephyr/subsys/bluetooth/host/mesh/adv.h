@@ -21,6 +21,16 @@ enum bt_mesh_adv_type {
 	BT_MESH_ADV_URI,
 };
 
+/* Scheduling classes, in decreasing order of priority */
+enum bt_mesh_adv_prio {
+	BT_MESH_ADV_PRIO_FRIEND, /* Friend Queue, bound to the LPN RX window */
+	BT_MESH_ADV_PRIO_LOCAL,  /* Locally originated PDUs and acks */
+	BT_MESH_ADV_PRIO_RELAY,  /* Relayed PDUs */
+	BT_MESH_ADV_PRIO_BEACON, /* Secure Network and unprovisioned beacons */
+
+	BT_MESH_ADV_PRIO_COUNT,
+};
+
 typedef void (*bt_mesh_adv_func_t)(struct net_buf *buf, u16_t duration,
 				   int err, void *user_data);
 
@@ -29,9 +39,18 @@ struct bt_mesh_adv {
 	void *cb_data;
 
 	u8_t      type:2,
-		  busy:1;
+		  busy:1,
+		  prio:2;
 	u8_t      xmit;
 
+	/* Number of transmissions done so far */
+	u8_t      sent;
+
+#if defined(CONFIG_BT_MESH_ADV_STATS)
+	/* Uptime when queued, for latency statistics */
+	u32_t     queued;
+#endif
+
 	union {
 		/* Address, used e.g. for Friend Queue messages */
 		u16_t addr;
@@ -59,6 +78,43 @@ void bt_mesh_adv_send(struct net_buf *buf, const struct bt_mesh_send_cb *cb,
 
 void bt_mesh_adv_update(void);
 
+struct bt_mesh_adv_prio_stats {
+	u16_t depth;       /* PDUs currently queued */
+	u16_t depth_max;   /* Highest queue depth seen */
+	u32_t sent;        /* PDUs that got on air */
+	u32_t dropped;     /* Duplicate relays dropped */
+	u32_t latency_sum; /* Sum of queueing delays, in ms */
+	u32_t latency_max; /* Largest queueing delay, in ms */
+};
+
+struct bt_mesh_adv_stats {
+	struct bt_mesh_adv_prio_stats prio[BT_MESH_ADV_PRIO_COUNT];
+	u32_t starts;  /* Advertising enabled */
+	u32_t updates; /* Advertising data replaced while enabled */
+};
+
+#if defined(CONFIG_BT_MESH_ADV_STATS)
+void bt_mesh_adv_stats_get(struct bt_mesh_adv_stats *stats);
+
+void bt_mesh_adv_stats_reset(void);
+#endif
+
+/* Advertising bearer used by the adv thread, normally the local
+ * controller. Can be replaced for testing purposes.
+ */
+struct bt_mesh_adv_bearer {
+	int (*start)(const struct bt_le_adv_param *param,
+		     const struct bt_data *ad, size_t ad_len,
+		     const struct bt_data *sd, size_t sd_len);
+	int (*update)(const struct bt_data *ad, size_t ad_len,
+		      const struct bt_data *sd, size_t sd_len);
+	int (*stop)(void);
+};
+
+#if defined(CONFIG_BT_TESTING)
+void bt_mesh_adv_bearer_set(const struct bt_mesh_adv_bearer *bearer);
+#endif
+
 void bt_mesh_adv_init(void);
 
 int bt_mesh_scan_enable(void);
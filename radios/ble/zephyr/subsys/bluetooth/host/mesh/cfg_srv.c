@@ -468,6 +468,8 @@ static u8_t app_key_set(u16_t net_idx, u16_t app_idx, const u8_t val[16],
 	key->app_idx = app_idx;
 	memcpy(keys->val, val, 16);
 
+	bt_mesh_app_lut_invalidate();
+
 	if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
 		BT_DBG("Storing AppKey persistently");
 		bt_mesh_store_app_key(key);
@@ -544,6 +546,8 @@ void bt_mesh_app_key_del(struct bt_mesh_app_key *key)
 
 	key->net_idx = BT_MESH_KEY_UNUSED;
 	memset(key->keys, 0, sizeof(key->keys));
+
+	bt_mesh_app_lut_invalidate();
 }
 
 static void app_key_del(struct bt_mesh_model *model,
@@ -1208,6 +1212,8 @@ static void mod_sub_list_clear(struct bt_mesh_model *mod)
 
 	/* Clear all subscriptions (0x0000 is the unassigned address) */
 	memset(mod->groups, 0, sizeof(mod->groups));
+
+	bt_mesh_group_index_invalidate();
 }
 
 static void mod_pub_va_set(struct bt_mesh_model *model,
@@ -1278,6 +1284,8 @@ static void mod_sub_list_clear(struct bt_mesh_model *mod)
 {
 	/* Clear all subscriptions (0x0000 is the unassigned address) */
 	memset(mod->groups, 0, sizeof(mod->groups));
+
+	bt_mesh_group_index_invalidate();
 }
 
 static void mod_pub_va_set(struct bt_mesh_model *model,
@@ -1399,6 +1407,7 @@ static void mod_sub_add(struct bt_mesh_model *model,
 	for (i = 0; i < ARRAY_SIZE(mod->groups); i++) {
 		if (mod->groups[i] == BT_MESH_ADDR_UNASSIGNED) {
 			mod->groups[i] = sub_addr;
+			bt_mesh_group_index_invalidate();
 			break;
 		}
 	}
@@ -1472,6 +1481,7 @@ static void mod_sub_del(struct bt_mesh_model *model,
 	match = bt_mesh_model_find_group(mod, sub_addr);
 	if (match) {
 		*match = BT_MESH_ADDR_UNASSIGNED;
+		bt_mesh_group_index_invalidate();
 
 		if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
 			bt_mesh_store_mod_sub(mod);
@@ -1752,6 +1762,7 @@ static void mod_sub_va_add(struct bt_mesh_model *model,
 	for (i = 0; i < ARRAY_SIZE(mod->groups); i++) {
 		if (mod->groups[i] == BT_MESH_ADDR_UNASSIGNED) {
 			mod->groups[i] = sub_addr;
+			bt_mesh_group_index_invalidate();
 			break;
 		}
 	}
@@ -1824,6 +1835,7 @@ static void mod_sub_va_del(struct bt_mesh_model *model,
 	match = bt_mesh_model_find_group(mod, sub_addr);
 	if (match) {
 		*match = BT_MESH_ADDR_UNASSIGNED;
+		bt_mesh_group_index_invalidate();
 
 		if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
 			bt_mesh_store_mod_sub(mod);
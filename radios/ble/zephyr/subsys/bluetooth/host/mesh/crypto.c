@@ -728,6 +728,59 @@ int bt_mesh_app_decrypt(const u8_t key[16], bool dev_key, u8_t aszmic,
 	return err;
 }
 
+/* Apply the CCM counter mode keystream to msg, i.e. undo a decryption
+ * that was done in place.
+ */
+static int ccm_ctr_apply(const u8_t key[16], const u8_t nonce[13],
+			 u8_t *msg, size_t msg_len)
+{
+	u8_t pmsg[16], cmsg[16];
+	size_t i, j;
+	int err;
+
+	pmsg[0] = 0x01;
+	memcpy(pmsg + 1, nonce, 13);
+
+	for (j = 0; j * 16 < msg_len; j++) {
+		sys_put_be16(j + 1, pmsg + 14);
+
+		err = bt_encrypt_be(key, pmsg, cmsg);
+		if (err) {
+			return err;
+		}
+
+		for (i = 0; i < 16 && (j * 16) + i < msg_len; i++) {
+			msg[(j * 16) + i] ^= cmsg[i];
+		}
+	}
+
+	return 0;
+}
+
+int bt_mesh_app_decrypt_in_place(const u8_t key[16], bool dev_key,
+				 u8_t aszmic, struct net_buf_simple *buf,
+				 const u8_t *ad, u16_t src, u16_t dst,
+				 u32_t seq_num, u32_t iv_index)
+{
+	u8_t nonce[13];
+	int err;
+
+	BT_DBG("EncData (len %u) %s", buf->len, bt_hex(buf->data, buf->len));
+
+	create_app_nonce(nonce, dev_key, aszmic, src, dst, seq_num, iv_index);
+
+	err = bt_mesh_ccm_decrypt(key, nonce, buf->data, buf->len, ad,
+				  ad ? 16 : 0, buf->data, APP_MIC_LEN(aszmic));
+	if (err == -EBADMSG) {
+		/* Restore the encrypted data for the next key candidate */
+		if (ccm_ctr_apply(key, nonce, buf->data, buf->len)) {
+			return -EIO;
+		}
+	}
+
+	return err;
+}
+
 /* reversed, 8-bit, poly=0x07 */
 static const u8_t crc_table[256] = {
 	0x00, 0x91, 0xe3, 0x72, 0x07, 0x96, 0xe4, 0x75,
@@ -136,6 +136,14 @@ int bt_mesh_app_decrypt(const u8_t key[16], bool dev_key, u8_t aszmic,
 			const u8_t *ad, u16_t src, u16_t dst, u32_t seq_num,
 			u32_t iv_index);
 
+/* Like bt_mesh_app_decrypt(), but the data is decrypted in place. If the
+ * MIC doesn't match the encrypted data is restored.
+ */
+int bt_mesh_app_decrypt_in_place(const u8_t key[16], bool dev_key,
+				 u8_t aszmic, struct net_buf_simple *buf,
+				 const u8_t *ad, u16_t src, u16_t dst,
+				 u32_t seq_num, u32_t iv_index);
+
 u8_t bt_mesh_fcs_calc(const u8_t *data, u8_t data_len);
 
 bool bt_mesh_fcs_check(struct net_buf_simple *buf, u8_t received_fcs);
@@ -101,6 +101,7 @@ static struct net_buf *friend_buf_alloc(u16_t src)
 		}
 	} while (!buf);
 
+	BT_MESH_ADV(buf)->prio = BT_MESH_ADV_PRIO_FRIEND;
 	BT_MESH_ADV(buf)->addr = src;
 	FRIEND_ADV(buf)->seq_auth = TRANS_SEQ_AUTH_NVAL;
 
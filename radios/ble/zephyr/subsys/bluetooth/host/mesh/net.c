@@ -72,6 +72,121 @@ static struct friend_cred friend_cred[FRIEND_CRED_COUNT];
 static u64_t msg_cache[CONFIG_BT_MESH_MSG_CACHE_SIZE];
 static u16_t msg_cache_next;
 
+#if defined(CONFIG_BT_MESH_KEY_STATS)
+struct bt_mesh_key_stats bt_mesh_key_stats;
+#endif
+
+#if defined(CONFIG_BT_MESH_KEY_LUT)
+/* Every subnet and every friendship credential has a current and a
+ * new (Key Refresh) set of keys, each of which is a decryption
+ * candidate for the NID it was derived with.
+ */
+#define NET_CAND_COUNT (2 * (CONFIG_BT_MESH_SUBNET_COUNT + FRIEND_CRED_COUNT))
+#define NET_CAND_NO_CRED 0xffff
+
+struct net_cand {
+	u16_t sub;  /* Index into bt_mesh.sub */
+	u16_t cred; /* Index into friend_cred or NET_CAND_NO_CRED */
+	u8_t  key;  /* 0 = current key, 1 = new key */
+};
+
+/* Candidates for NID n are cand[first[n]] ... cand[first[n + 1] - 1],
+ * kept in the same order the linear search would have tried them.
+ */
+static struct {
+	bool            valid;
+	u16_t           first[BIT(7) + 1];
+	struct net_cand cand[NET_CAND_COUNT];
+} net_lut;
+
+void bt_mesh_net_lut_invalidate(void)
+{
+	net_lut.valid = false;
+}
+
+static void net_lut_add(u8_t nid, u16_t sub, u16_t cred, u8_t key, bool fill)
+{
+	struct net_cand *cand;
+
+	nid &= 0x7f;
+
+	if (!fill) {
+		net_lut.first[nid + 1]++;
+		return;
+	}
+
+	cand = &net_lut.cand[net_lut.first[nid]++];
+	cand->sub = sub;
+	cand->cred = cred;
+	cand->key = key;
+}
+
+static void net_lut_walk(bool fill)
+{
+	int i, k;
+
+	for (i = 0; i < ARRAY_SIZE(bt_mesh.sub); i++) {
+		struct bt_mesh_subnet *sub = &bt_mesh.sub[i];
+
+		if (sub->net_idx == BT_MESH_KEY_UNUSED) {
+			continue;
+		}
+
+#if FRIEND_CRED_COUNT > 0
+		{
+			int j;
+
+			for (j = 0; j < ARRAY_SIZE(friend_cred); j++) {
+				struct friend_cred *cred = &friend_cred[j];
+
+				if (cred->net_idx != sub->net_idx) {
+					continue;
+				}
+
+				for (k = 0; k < 2; k++) {
+					net_lut_add(cred->cred[k].nid, i, j, k,
+						    fill);
+				}
+			}
+		}
+#endif
+
+		for (k = 0; k < 2; k++) {
+			net_lut_add(sub->keys[k].nid, i, NET_CAND_NO_CRED, k,
+				    fill);
+		}
+	}
+}
+
+static void net_lut_build(void)
+{
+	int i;
+
+	/* Counting sort: count the candidates per NID, turn the counts
+	 * into start offsets and then place each candidate. Placing
+	 * advances every start offset to the next NID's start, which the
+	 * final shift corrects.
+	 */
+	memset(net_lut.first, 0, sizeof(net_lut.first));
+
+	net_lut_walk(false);
+
+	for (i = 1; i < ARRAY_SIZE(net_lut.first); i++) {
+		net_lut.first[i] += net_lut.first[i - 1];
+	}
+
+	net_lut_walk(true);
+
+	memmove(&net_lut.first[1], &net_lut.first[0],
+		(ARRAY_SIZE(net_lut.first) - 1) * sizeof(net_lut.first[0]));
+	net_lut.first[0] = 0;
+
+	net_lut.valid = true;
+
+	BT_DBG("%u NID candidates", net_lut.first[BIT(7)]);
+}
+#endif /* CONFIG_BT_MESH_KEY_LUT */
+
 /* Singleton network context (the implementation only supports one) */
 struct bt_mesh_net bt_mesh = {
 	.local_queue = SYS_SLIST_STATIC_INIT(&bt_mesh.local_queue),
@@ -176,6 +291,8 @@ int bt_mesh_net_keys_create(struct bt_mesh_subnet_keys *keys,
 
 	keys->nid = nid;
 
+	bt_mesh_net_lut_invalidate();
+
 	BT_DBG("NID 0x%02x EncKey %s", keys->nid, bt_hex(keys->enc, 16));
 	BT_DBG("PrivacyKey %s", bt_hex(keys->privacy, 16));
 
@@ -250,6 +367,8 @@ int friend_cred_set(struct friend_cred *cred, u8_t idx, const u8_t net_key[16])
 	       bt_hex(cred->cred[idx].enc, 16));
 	BT_DBG("Friend PrivacyKey %s", bt_hex(cred->cred[idx].privacy, 16));
 
+	bt_mesh_net_lut_invalidate();
+
 	return 0;
 }
 
@@ -266,6 +385,8 @@ void friend_cred_refresh(u16_t net_idx)
 			       sizeof(cred->cred[0]));
 		}
 	}
+
+	bt_mesh_net_lut_invalidate();
 }
 
 int friend_cred_update(struct bt_mesh_subnet *sub)
@@ -342,6 +463,8 @@ void friend_cred_clear(struct friend_cred *cred)
 	cred->lpn_counter = 0;
 	cred->frnd_counter = 0;
 	memset(cred->cred, 0, sizeof(cred->cred));
+
+	bt_mesh_net_lut_invalidate();
 }
 
 int friend_cred_del(u16_t net_idx, u16_t addr)
@@ -513,6 +636,9 @@ void bt_mesh_net_revoke_keys(struct bt_mesh_subnet *sub)
 		memcpy(&key->keys[0], &key->keys[1], sizeof(key->keys[0]));
 		key->updated = false;
 	}
+
+	bt_mesh_net_lut_invalidate();
+	bt_mesh_app_lut_invalidate();
 }
 
 bool bt_mesh_kr_update(struct bt_mesh_subnet *sub, u8_t new_kr, bool new_key)
@@ -989,6 +1115,8 @@ static int net_decrypt(struct bt_mesh_subnet *sub, const u8_t *enc,
 	BT_DBG("NID 0x%02x net_idx 0x%04x", NID(data), sub->net_idx);
 	BT_DBG("IVI %u net->iv_index 0x%08x", IVI(data), bt_mesh.iv_index);
 
+	BT_MESH_KEY_STATS_INC(net_trials);
+
 	rx->old_iv = (IVI(data) != (bt_mesh.iv_index & 0x01));
 
 	net_buf_simple_reset(buf);
@@ -1021,7 +1149,7 @@ static int net_decrypt(struct bt_mesh_subnet *sub, const u8_t *enc,
 }
 
 #if (defined(CONFIG_BT_MESH_LOW_POWER) || \
-     defined(CONFIG_BT_MESH_FRIEND))
+     defined(CONFIG_BT_MESH_FRIEND)) && !defined(CONFIG_BT_MESH_KEY_LUT)
 static int friend_decrypt(struct bt_mesh_subnet *sub, const u8_t *data,
 			  size_t data_len, struct bt_mesh_net_rx *rx,
 			  struct net_buf_simple *buf)
@@ -1059,6 +1187,70 @@ static int friend_decrypt(struct bt_mesh_subnet *sub, const u8_t *data,
 }
 #endif
 
+#if defined(CONFIG_BT_MESH_KEY_LUT)
+static bool net_find_and_decrypt(const u8_t *data, size_t data_len,
+				 struct bt_mesh_net_rx *rx,
+				 struct net_buf_simple *buf)
+{
+	u8_t nid = NID(data);
+	u16_t i;
+
+	BT_DBG("");
+
+	BT_MESH_KEY_STATS_INC(net_pdus);
+
+	if (!net_lut.valid) {
+		net_lut_build();
+	}
+
+	for (i = net_lut.first[nid]; i < net_lut.first[nid + 1]; i++) {
+		const struct net_cand *cand = &net_lut.cand[i];
+		struct bt_mesh_subnet *sub = &bt_mesh.sub[cand->sub];
+		const u8_t *enc, *priv;
+
+		/* Subnet deletions don't rebuild the table */
+		if (sub->net_idx == BT_MESH_KEY_UNUSED) {
+			continue;
+		}
+
+		/* New keys are only valid during Key Refresh */
+		if (cand->key && sub->kr_phase == BT_MESH_KR_NORMAL) {
+			continue;
+		}
+
+#if FRIEND_CRED_COUNT > 0
+		if (cand->cred != NET_CAND_NO_CRED) {
+			struct friend_cred *cred = &friend_cred[cand->cred];
+
+			if (cred->net_idx != sub->net_idx) {
+				continue;
+			}
+
+			enc = cred->cred[cand->key].enc;
+			priv = cred->cred[cand->key].privacy;
+		} else
+#endif
+		{
+			enc = sub->keys[cand->key].enc;
+			priv = sub->keys[cand->key].privacy;
+		}
+
+		if (net_decrypt(sub, enc, priv, data, data_len, rx, buf)) {
+			continue;
+		}
+
+		rx->friend_cred = (cand->cred != NET_CAND_NO_CRED);
+		rx->new_key = cand->key;
+		rx->ctx.net_idx = sub->net_idx;
+		rx->sub = sub;
+		return true;
+	}
+
+	BT_MESH_KEY_STATS_INC(net_nomatch);
+
+	return false;
+}
+#else
 static bool net_find_and_decrypt(const u8_t *data, size_t data_len,
 				 struct bt_mesh_net_rx *rx,
 				 struct net_buf_simple *buf)
@@ -1068,6 +1260,8 @@ static bool net_find_and_decrypt(const u8_t *data, size_t data_len,
 
 	BT_DBG("");
 
+	BT_MESH_KEY_STATS_INC(net_pdus);
+
 	for (i = 0; i < ARRAY_SIZE(bt_mesh.sub); i++) {
 		sub = &bt_mesh.sub[i];
 		if (sub->net_idx == BT_MESH_KEY_UNUSED) {
@@ -1106,8 +1300,11 @@ static bool net_find_and_decrypt(const u8_t *data, size_t data_len,
 		}
 	}
 
+	BT_MESH_KEY_STATS_INC(net_nomatch);
+
 	return false;
 }
+#endif /* CONFIG_BT_MESH_KEY_LUT */
 
 /* Relaying from advertising to the advertising bearer should only happen
  * if the Relay state is set to enabled. Locally originated packets always
@@ -1176,8 +1373,12 @@ static void bt_mesh_net_relay(struct net_buf_simple *sbuf,
 		return;
 	}
 
-	/* Only decrement TTL for non-locally originated packets */
+	/* Only decrement TTL for non-locally originated packets, which are
+	 * also the only ones queued as relayed traffic.
+	 */
 	if (rx->net_if != BT_MESH_NET_IF_LOCAL) {
+		BT_MESH_ADV(buf)->prio = BT_MESH_ADV_PRIO_RELAY;
+
 		/* Leave CTL bit intact */
 		sbuf->data[1] &= 0x80;
 		sbuf->data[1] |= rx->ctx.recv_ttl - 1;
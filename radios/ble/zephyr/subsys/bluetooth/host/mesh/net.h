@@ -333,6 +333,31 @@ void bt_mesh_net_start(void);
 
 void bt_mesh_net_init(void);
 
+#if defined(CONFIG_BT_MESH_KEY_LUT)
+void bt_mesh_net_lut_invalidate(void);
+#else
+static inline void bt_mesh_net_lut_invalidate(void)
+{
+}
+#endif
+
+/* Trial decryption statistics */
+struct bt_mesh_key_stats {
+	u32_t net_pdus;    /* Network PDUs received */
+	u32_t net_trials;  /* Network decryption attempts */
+	u32_t net_nomatch; /* Network PDUs no NetKey matched */
+	u32_t app_sdus;    /* Access SDUs received with AKF set */
+	u32_t app_trials;  /* AppKey decryption attempts */
+	u32_t app_nomatch; /* Access SDUs no AppKey matched */
+};
+
+#if defined(CONFIG_BT_MESH_KEY_STATS)
+extern struct bt_mesh_key_stats bt_mesh_key_stats;
+#define BT_MESH_KEY_STATS_INC(field) (bt_mesh_key_stats.field++)
+#else
+#define BT_MESH_KEY_STATS_INC(field)
+#endif
+
 /* Friendship Credential Management */
 struct friend_cred {
 	u16_t net_idx;
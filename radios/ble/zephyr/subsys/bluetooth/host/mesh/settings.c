@@ -447,6 +447,8 @@ static int app_key_set(int argc, char **argv, char *val)
 	bt_mesh_app_id(app->keys[0].val, &app->keys[0].id);
 	bt_mesh_app_id(app->keys[1].val, &app->keys[1].id);
 
+	bt_mesh_app_lut_invalidate();
+
 	BT_DBG("AppKeyIndex 0x%03x recovered from storage", app_idx);
 
 	return 0;
@@ -572,6 +574,7 @@ static int mod_set_sub(struct bt_mesh_model *mod, char *val)
 
 	/* Start with empty array regardless of cleared or set value */
 	memset(mod->groups, 0, sizeof(mod->groups));
+	bt_mesh_group_index_invalidate();
 
 	if (!val) {
 		BT_DBG("Cleared subscriptions for model");
@@ -43,6 +43,9 @@
 
 #define APP_MIC_LEN(aszmic)         ((aszmic) ? 8 : 4)
 
+/* Largest unsegmented Upper Transport PDU, excluding the header */
+#define UNSEG_SDU_MAX               15
+
 #define UNSEG_HDR(akf, aid)         ((akf << 6) | (aid & AID_MASK))
 #define SEG_HDR(akf, aid)           (UNSEG_HDR(akf, aid) | 0x80)
 
@@ -85,23 +88,111 @@ static struct seg_rx {
 				 obo:1;
 	u8_t                     hdr;
 	u8_t                     ttl;
+	u8_t                     hash_next;     /* Next in hash bucket */
 	u16_t                    src;
 	u16_t                    dst;
 	u32_t                    block;
 	u32_t                    last;
 	struct k_delayed_work    ack;
 	struct net_buf_simple    buf;
-} seg_rx[CONFIG_BT_MESH_RX_SEG_MSG_COUNT] = {
-	[0 ... (CONFIG_BT_MESH_RX_SEG_MSG_COUNT - 1)] = {
-		.buf.size = CONFIG_BT_MESH_RX_SDU_MAX,
-	},
-};
+} seg_rx[CONFIG_BT_MESH_RX_SEG_MSG_COUNT];
+
+/* RX contexts are hashed by source and destination address, so that
+ * incoming segments don't need to be checked against every context.
+ */
+#define SEG_RX_HASH_SIZE            16
+#define SEG_RX_NONE                 0xff
+
+static u8_t seg_rx_hash[SEG_RX_HASH_SIZE];
 
+#if defined(CONFIG_BT_MESH_RX_SEG_POOL)
+/* Reassembly buffers are carved out of a shared pool as each message
+ * needs them, rather than reserving CONFIG_BT_MESH_RX_SDU_MAX bytes for
+ * every context.
+ */
+static u8_t __noinit seg_rx_pool[CONFIG_BT_MESH_RX_SEG_POOL_SIZE];
+
+struct bt_mesh_rx_seg_stats bt_mesh_rx_seg_stats;
+#else
 static u8_t __noinit seg_rx_buf_data[(CONFIG_BT_MESH_RX_SEG_MSG_COUNT *
 				      CONFIG_BT_MESH_RX_SDU_MAX)];
+#endif
 
 static u16_t hb_sub_dst = BT_MESH_ADDR_UNASSIGNED;
 
+#if defined(CONFIG_BT_MESH_KEY_LUT)
+/* Both the current and the updated value of every AppKey are candidates
+ * for the AID they were derived with. Candidates for AID n are
+ * cand[first[n]] ... cand[first[n + 1] - 1], in app_keys[] order.
+ */
+#define APP_CAND_COUNT (2 * CONFIG_BT_MESH_APP_KEY_COUNT)
+
+struct app_cand {
+	u16_t app_key; /* Index into bt_mesh.app_keys */
+	u8_t  key;     /* 0 = current key, 1 = updated key */
+};
+
+static struct {
+	bool            valid;
+	u16_t           first[BIT(6) + 1];
+	struct app_cand cand[APP_CAND_COUNT];
+} app_lut;
+
+void bt_mesh_app_lut_invalidate(void)
+{
+	app_lut.valid = false;
+}
+
+static void app_lut_walk(bool fill)
+{
+	int i, k;
+
+	for (i = 0; i < ARRAY_SIZE(bt_mesh.app_keys); i++) {
+		struct bt_mesh_app_key *key = &bt_mesh.app_keys[i];
+
+		if (key->net_idx == BT_MESH_KEY_UNUSED) {
+			continue;
+		}
+
+		for (k = 0; k < 2; k++) {
+			u8_t aid = key->keys[k].id & AID_MASK;
+			struct app_cand *cand;
+
+			if (!fill) {
+				app_lut.first[aid + 1]++;
+				continue;
+			}
+
+			cand = &app_lut.cand[app_lut.first[aid]++];
+			cand->app_key = i;
+			cand->key = k;
+		}
+	}
+}
+
+static void app_lut_build(void)
+{
+	int i;
+
+	/* Same counting sort as the NID table in net.c */
+	memset(app_lut.first, 0, sizeof(app_lut.first));
+
+	app_lut_walk(false);
+
+	for (i = 1; i < ARRAY_SIZE(app_lut.first); i++) {
+		app_lut.first[i] += app_lut.first[i - 1];
+	}
+
+	app_lut_walk(true);
+
+	memmove(&app_lut.first[1], &app_lut.first[0],
+		(ARRAY_SIZE(app_lut.first) - 1) * sizeof(app_lut.first[0]));
+	app_lut.first[0] = 0;
+
+	app_lut.valid = true;
+}
+#endif /* CONFIG_BT_MESH_KEY_LUT */
+
 void bt_mesh_set_hb_sub_dst(u16_t addr)
 {
 	hb_sub_dst = addr;
@@ -575,12 +666,36 @@ static bool is_replay(struct bt_mesh_net_rx *rx)
 	return true;
 }
 
+static int sdu_decrypt(const u8_t key[16], bool dev_key, u8_t aszmic,
+		       struct net_buf_simple *buf, struct net_buf_simple *sdu,
+		       const u8_t *ad, struct bt_mesh_net_rx *rx, u32_t seq)
+{
+	if (sdu == buf) {
+		return bt_mesh_app_decrypt_in_place(key, dev_key, aszmic, buf,
+						    ad, rx->ctx.addr,
+						    rx->ctx.recv_dst, seq,
+						    BT_MESH_NET_IVI_RX(rx));
+	}
+
+	net_buf_simple_reset(sdu);
+
+	return bt_mesh_app_decrypt(key, dev_key, aszmic, buf, sdu, ad,
+				   rx->ctx.addr, rx->ctx.recv_dst, seq,
+				   BT_MESH_NET_IVI_RX(rx));
+}
+
+/* The SDU is decrypted into sdu, or in place if sdu is the same buffer
+ * as buf.
+ */
 static int sdu_recv(struct bt_mesh_net_rx *rx, u32_t seq, u8_t hdr,
-		    u8_t aszmic, struct net_buf_simple *buf)
+		    u8_t aszmic, struct net_buf_simple *buf,
+		    struct net_buf_simple *sdu)
 {
-	NET_BUF_SIMPLE_DEFINE(sdu, CONFIG_BT_MESH_RX_SDU_MAX - 4);
 	u8_t *ad;
 	u16_t i;
+#if defined(CONFIG_BT_MESH_KEY_LUT)
+	u16_t j;
+#endif
 	int err;
 
 	BT_DBG("ASZMIC %u AKF %u AID 0x%02x", aszmic, AKF(&hdr), AID(&hdr));
@@ -607,20 +722,46 @@ static int sdu_recv(struct bt_mesh_net_rx *rx, u32_t seq, u8_t hdr,
 	buf->len -= APP_MIC_LEN(aszmic);
 
 	if (!AKF(&hdr)) {
-		err = bt_mesh_app_decrypt(bt_mesh.dev_key, true, aszmic, buf,
-					  &sdu, ad, rx->ctx.addr,
-					  rx->ctx.recv_dst, seq,
-					  BT_MESH_NET_IVI_RX(rx));
+		err = sdu_decrypt(bt_mesh.dev_key, true, aszmic, buf, sdu, ad,
+				  rx, seq);
 		if (err) {
 			BT_ERR("Unable to decrypt with DevKey");
 			return -EINVAL;
 		}
 
 		rx->ctx.app_idx = BT_MESH_KEY_DEV;
-		bt_mesh_model_recv(rx, &sdu);
+		bt_mesh_model_recv(rx, sdu);
 		return 0;
 	}
 
+	BT_MESH_KEY_STATS_INC(app_sdus);
+
+#if defined(CONFIG_BT_MESH_KEY_LUT)
+	if (!app_lut.valid) {
+		app_lut_build();
+	}
+
+	for (j = app_lut.first[AID(&hdr)]; j < app_lut.first[AID(&hdr) + 1];
+	     j++) {
+		const struct app_cand *cand = &app_lut.cand[j];
+		struct bt_mesh_app_key *key;
+		struct bt_mesh_app_keys *keys;
+
+		i = cand->app_key;
+		key = &bt_mesh.app_keys[i];
+
+		/* Check that this AppKey matches received net_idx */
+		if (key->net_idx != rx->sub->net_idx) {
+			continue;
+		}
+
+		/* Only the key the linear search would pick is valid */
+		if (cand->key != (rx->new_key && key->updated)) {
+			continue;
+		}
+
+		keys = &key->keys[cand->key];
+#else
 	for (i = 0; i < ARRAY_SIZE(bt_mesh.app_keys); i++) {
 		struct bt_mesh_app_key *key = &bt_mesh.app_keys[i];
 		struct bt_mesh_app_keys *keys;
@@ -640,12 +781,12 @@ static int sdu_recv(struct bt_mesh_net_rx *rx, u32_t seq, u8_t hdr,
 		if (AID(&hdr) != keys->id) {
 			continue;
 		}
+#endif
+
+		BT_MESH_KEY_STATS_INC(app_trials);
 
-		net_buf_simple_reset(&sdu);
-		err = bt_mesh_app_decrypt(keys->val, false, aszmic, buf,
-					  &sdu, ad, rx->ctx.addr,
-					  rx->ctx.recv_dst, seq,
-					  BT_MESH_NET_IVI_RX(rx));
+		err = sdu_decrypt(keys->val, false, aszmic, buf, sdu, ad, rx,
+				  seq);
 		if (err) {
 			BT_WARN("Unable to decrypt with AppKey %u", i);
 			continue;
@@ -654,12 +795,14 @@ static int sdu_recv(struct bt_mesh_net_rx *rx, u32_t seq, u8_t hdr,
 
 		rx->ctx.app_idx = key->app_idx;
 
-		bt_mesh_model_recv(rx, &sdu);
+		bt_mesh_model_recv(rx, sdu);
 		return 0;
 	}
 
 	BT_WARN("No matching AppKey");
 
+	BT_MESH_KEY_STATS_INC(app_nomatch);
+
 	return -EINVAL;
 }
 
@@ -862,6 +1005,7 @@ static int ctl_recv(struct bt_mesh_net_rx *rx, u8_t hdr,
 static int trans_unseg(struct net_buf_simple *buf, struct bt_mesh_net_rx *rx,
 		       u64_t *seq_auth)
 {
+	NET_BUF_SIMPLE_DEFINE(sdu, UNSEG_SDU_MAX);
 	u8_t hdr;
 
 	BT_DBG("AFK %u AID 0x%02x", AKF(buf->data), AID(buf->data));
@@ -887,7 +1031,11 @@ static int trans_unseg(struct net_buf_simple *buf, struct bt_mesh_net_rx *rx,
 			return 0;
 		}
 
-		return sdu_recv(rx, rx->seq, hdr, 0, buf);
+		/* Unsegmented PDUs are decrypted into a copy, since the
+		 * received PDU may still get relayed or put in the Friend
+		 * Queue.
+		 */
+		return sdu_recv(rx, rx->seq, hdr, 0, buf, &sdu);
 	}
 }
 
@@ -993,6 +1141,112 @@ static int send_ack(struct bt_mesh_subnet *sub, u16_t src, u16_t dst,
 				NULL, NULL, NULL);
 }
 
+static inline u8_t seg_rx_hash_key(u16_t src, u16_t dst)
+{
+	u16_t key = src ^ dst;
+
+	return (key ^ (key >> 8)) % SEG_RX_HASH_SIZE;
+}
+
+static void seg_rx_hash_add(struct seg_rx *rx)
+{
+	u8_t *head = &seg_rx_hash[seg_rx_hash_key(rx->src, rx->dst)];
+
+	rx->hash_next = *head;
+	*head = rx - seg_rx;
+}
+
+static void seg_rx_hash_del(struct seg_rx *rx)
+{
+	u8_t *next;
+
+	if (rx->src == BT_MESH_ADDR_UNASSIGNED) {
+		return;
+	}
+
+	next = &seg_rx_hash[seg_rx_hash_key(rx->src, rx->dst)];
+
+	while (*next != SEG_RX_NONE) {
+		if (&seg_rx[*next] == rx) {
+			*next = rx->hash_next;
+			return;
+		}
+
+		next = &seg_rx[*next].hash_next;
+	}
+}
+
+#if defined(CONFIG_BT_MESH_RX_SEG_POOL)
+/* First fit search for len free bytes between the buffers held by the
+ * other contexts. There are only a handful of contexts, so this is
+ * cheaper than maintaining a free list.
+ */
+static u8_t *seg_rx_pool_find(struct seg_rx *rx, u16_t len)
+{
+	u16_t off = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(seg_rx); i++) {
+		struct seg_rx *other = &seg_rx[i];
+		u16_t start;
+
+		if (off + len > sizeof(seg_rx_pool)) {
+			return NULL;
+		}
+
+		if (other == rx || !other->buf.size) {
+			continue;
+		}
+
+		start = other->buf.__buf - seg_rx_pool;
+		if (start < off + len && off < start + other->buf.size) {
+			/* Overlap: retry right after this buffer */
+			off = start + other->buf.size;
+			i = -1;
+		}
+	}
+
+	if (off + len > sizeof(seg_rx_pool)) {
+		return NULL;
+	}
+
+	return &seg_rx_pool[off];
+}
+#endif
+
+static int seg_rx_buf_alloc(struct seg_rx *rx, u16_t len)
+{
+#if defined(CONFIG_BT_MESH_RX_SEG_POOL)
+	u8_t *data;
+
+	data = seg_rx_pool_find(rx, len);
+	if (!data) {
+		bt_mesh_rx_seg_stats.nomem++;
+		return -ENOMEM;
+	}
+
+	rx->buf.__buf = data;
+	rx->buf.size = len;
+
+	bt_mesh_rx_seg_stats.used += len;
+	if (bt_mesh_rx_seg_stats.used > bt_mesh_rx_seg_stats.peak) {
+		bt_mesh_rx_seg_stats.peak = bt_mesh_rx_seg_stats.used;
+	}
+#endif
+
+	net_buf_simple_reset(&rx->buf);
+
+	return 0;
+}
+
+static void seg_rx_buf_free(struct seg_rx *rx)
+{
+#if defined(CONFIG_BT_MESH_RX_SEG_POOL)
+	bt_mesh_rx_seg_stats.used -= rx->buf.size;
+	rx->buf.size = 0;
+#endif
+}
+
 static void seg_rx_reset(struct seg_rx *rx, bool full_reset)
 {
 	BT_DBG("rx %p", rx);
@@ -1007,12 +1261,14 @@ static void seg_rx_reset(struct seg_rx *rx, bool full_reset)
 	}
 
 	rx->in_use = 0;
+	seg_rx_buf_free(rx);
 
 	/* We don't always reset these values since we need to be able to
 	 * send an ack if we receive a segment after we've already received
 	 * the full SDU.
 	 */
 	if (full_reset) {
+		seg_rx_hash_del(rx);
 		rx->seq_auth = 0;
 		rx->sub = NULL;
 		rx->src = BT_MESH_ADDR_UNASSIGNED;
@@ -1060,11 +1316,15 @@ static inline bool sdu_len_is_ok(bool ctl, u8_t seg_n)
 static struct seg_rx *seg_rx_find(struct bt_mesh_net_rx *net_rx,
 				  const u64_t *seq_auth)
 {
-	int i;
+	u8_t i, next;
 
-	for (i = 0; i < ARRAY_SIZE(seg_rx); i++) {
+	for (i = seg_rx_hash[seg_rx_hash_key(net_rx->ctx.addr,
+					     net_rx->ctx.recv_dst)];
+	     i != SEG_RX_NONE; i = next) {
 		struct seg_rx *rx = &seg_rx[i];
 
+		next = rx->hash_next;
+
 		if (rx->src != net_rx->ctx.addr ||
 		    rx->dst != net_rx->ctx.recv_dst) {
 			continue;
@@ -1128,8 +1388,13 @@ static struct seg_rx *seg_rx_alloc(struct bt_mesh_net_rx *net_rx,
 			continue;
 		}
 
+		if (seg_rx_buf_alloc(rx, (seg_n + 1) * seg_len(net_rx->ctl))) {
+			return NULL;
+		}
+
+		seg_rx_hash_del(rx);
+
 		rx->in_use = 1;
-		net_buf_simple_reset(&rx->buf);
 		rx->sub = net_rx->sub;
 		rx->ctl = net_rx->ctl;
 		rx->seq_auth = *seq_auth;
@@ -1140,6 +1405,8 @@ static struct seg_rx *seg_rx_alloc(struct bt_mesh_net_rx *net_rx,
 		rx->dst = net_rx->ctx.recv_dst;
 		rx->block = 0;
 
+		seg_rx_hash_add(rx);
+
 		BT_DBG("New RX context. Block Complete 0x%08x",
 		       BLOCK_COMPLETE(seg_n));
 
@@ -1257,7 +1524,7 @@ found_rx:
 		BT_DBG("Target len %u * %u + %u = %u", seg_n, seg_len(rx->ctl),
 		       buf->len, rx->buf.len);
 
-		if (rx->buf.len > CONFIG_BT_MESH_RX_SDU_MAX) {
+		if (rx->buf.len > rx->buf.size) {
 			BT_ERR("Too large SDU len");
 			send_ack(net_rx->sub, net_rx->ctx.recv_dst,
 				 net_rx->ctx.addr, net_rx->ctx.send_ttl,
@@ -1295,6 +1562,10 @@ found_rx:
 
 	BT_DBG("Complete SDU");
 
+#if defined(CONFIG_BT_MESH_RX_SEG_POOL)
+	bt_mesh_rx_seg_stats.sdus++;
+#endif
+
 	if (net_rx->local_match && is_replay(net_rx)) {
 		BT_WARN("Replay: src 0x%04x dst 0x%04x seq 0x%06x",
 			net_rx->ctx.addr, net_rx->ctx.recv_dst, net_rx->seq);
@@ -1313,7 +1584,7 @@ found_rx:
 		err = ctl_recv(net_rx, *hdr, &rx->buf, seq_auth);
 	} else {
 		err = sdu_recv(net_rx, (rx->seq_auth & 0xffffff), *hdr,
-			       ASZMIC(hdr), &rx->buf);
+			       ASZMIC(hdr), &rx->buf, &rx->buf);
 	}
 
 	seg_rx_reset(rx, false);
@@ -1443,11 +1714,16 @@ void bt_mesh_trans_init(void)
 		k_delayed_work_init(&seg_tx[i].retransmit, seg_retransmit);
 	}
 
+	memset(seg_rx_hash, SEG_RX_NONE, sizeof(seg_rx_hash));
+
 	for (i = 0; i < ARRAY_SIZE(seg_rx); i++) {
 		k_delayed_work_init(&seg_rx[i].ack, seg_ack);
+#if !defined(CONFIG_BT_MESH_RX_SEG_POOL)
 		seg_rx[i].buf.__buf = (seg_rx_buf_data +
 				       (i * CONFIG_BT_MESH_RX_SDU_MAX));
 		seg_rx[i].buf.data = seg_rx[i].buf.__buf;
+		seg_rx[i].buf.size = CONFIG_BT_MESH_RX_SDU_MAX;
+#endif
 	}
 }
 
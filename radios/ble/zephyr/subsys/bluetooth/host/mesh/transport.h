@@ -78,6 +78,25 @@ void bt_mesh_set_hb_sub_dst(u16_t addr);
 
 struct bt_mesh_app_key *bt_mesh_app_key_find(u16_t app_idx);
 
+#if defined(CONFIG_BT_MESH_KEY_LUT)
+void bt_mesh_app_lut_invalidate(void);
+#else
+static inline void bt_mesh_app_lut_invalidate(void)
+{
+}
+#endif
+
+#if defined(CONFIG_BT_MESH_RX_SEG_POOL)
+struct bt_mesh_rx_seg_stats {
+	u32_t sdus;  /* Segmented messages reassembled */
+	u32_t nomem; /* Messages that didn't fit in the pool */
+	u16_t used;  /* Bytes of the pool currently in use */
+	u16_t peak;  /* Highest pool usage seen */
+};
+
+extern struct bt_mesh_rx_seg_stats bt_mesh_rx_seg_stats;
+#endif
+
 bool bt_mesh_tx_in_progress(void);
 
 void bt_mesh_rx_reset(void);
@@ -16,12 +16,14 @@
 #include <errno.h>
 #include <flash.h>
 #include <board.h>
+#include <misc/util.h>
 #include <dfu/flash_img.h>
 
 BUILD_ASSERT_MSG((CONFIG_IMG_BLOCK_BUF_SIZE % FLASH_WRITE_BLOCK_SIZE == 0),
 		 "CONFIG_IMG_BLOCK_BUF_SIZE is not a multiple of "
 		 "FLASH_WRITE_BLOCK_SIZE");
 
+#if defined(CONFIG_IMG_BLOCK_VERIFY)
 static bool flash_verify(struct device *dev, off_t offset,
 			 u8_t *data, size_t len)
 {
@@ -51,37 +53,167 @@ static bool flash_verify(struct device *dev, off_t offset,
 
 	return (len == 0) ? true : false;
 }
+#else
+#define flash_verify(dev, offset, data, len) true
+#endif
 
-/* buffer data into block writes */
-static int flash_block_write(struct flash_img_context *ctx, off_t offset,
-			     u8_t *data, size_t len, bool finished)
+#if defined(CONFIG_IMG_ERASE_PROGRESSIVELY)
+/* Room MCUboot keeps at the end of the slot, as boot_slots_trailer_sz()
+ * computes it: the swap status, three entries of the flash write size for
+ * each of the sectors the bootloader supports, the slot 0 validation
+ * marker if the bootloader has one, three flags and the magic.
+ */
+#if defined(CONFIG_IMG_BOOT_VALIDATE_SLOT0_ONCE)
+#define IMG_MARKER_SIZE 32
+#else
+#define IMG_MARKER_SIZE 0
+#endif
+
+#define IMG_TRAILER_SIZE (CONFIG_IMG_BOOT_MAX_IMG_SECTORS * 3 *	\
+			  FLASH_WRITE_BLOCK_SIZE + IMG_MARKER_SIZE +	\
+			  8 * 3 + 16)
+
+/* Erase the pages up to the given offset that have not been erased yet */
+static int flash_progressive_erase(struct flash_img_context *ctx, off_t end)
 {
-	int processed = 0;
-	int rc = 0;
+	struct flash_pages_info page;
+	int rc;
 
-	while ((len - processed) >
-	       (CONFIG_IMG_BLOCK_BUF_SIZE - ctx->buf_bytes)) {
-		memcpy(ctx->buf + ctx->buf_bytes, data + processed,
-		       (CONFIG_IMG_BLOCK_BUF_SIZE - ctx->buf_bytes));
+	while (ctx->off_erased < end) {
+		rc = flash_get_page_info_by_offs(ctx->dev, ctx->off_erased,
+						 &page);
+		if (rc) {
+			SYS_LOG_ERR("no page at offset=0x%08x",
+				    ctx->off_erased);
+			return rc;
+		}
 
 		flash_write_protection_set(ctx->dev, false);
-		rc = flash_write(ctx->dev, offset + ctx->bytes_written,
-				 ctx->buf, CONFIG_IMG_BLOCK_BUF_SIZE);
+		rc = flash_erase(ctx->dev, page.start_offset, page.size);
 		flash_write_protection_set(ctx->dev, true);
 		if (rc) {
-			SYS_LOG_ERR("flash_write error %d offset=0x%08x",
-				    rc, offset + ctx->bytes_written);
+			SYS_LOG_ERR("flash_erase error %d offset=0x%08x",
+				    rc, page.start_offset);
 			return rc;
 		}
 
-		if (!flash_verify(ctx->dev, offset + ctx->bytes_written,
-				  ctx->buf, CONFIG_IMG_BLOCK_BUF_SIZE)) {
-			return -EIO;
+		ctx->off_erased = page.start_offset + page.size;
+	}
+
+	return 0;
+}
+
+/* The whole slot is no longer erased up front, so the trailer from an
+ * earlier image has to go once the new image is in place.
+ */
+static int flash_erase_trailer(struct flash_img_context *ctx)
+{
+	off_t end = FLASH_AREA_IMAGE_1_OFFSET + FLASH_AREA_IMAGE_1_SIZE;
+	struct flash_pages_info page;
+	off_t trailer;
+	int rc;
+
+	trailer = end - min(IMG_TRAILER_SIZE, FLASH_AREA_IMAGE_1_SIZE);
+	if (ctx->off_erased < trailer) {
+		rc = flash_get_page_info_by_offs(ctx->dev, trailer, &page);
+		if (rc) {
+			return rc;
 		}
 
-		ctx->bytes_written += CONFIG_IMG_BLOCK_BUF_SIZE;
-		processed += (CONFIG_IMG_BLOCK_BUF_SIZE - ctx->buf_bytes);
-		ctx->buf_bytes = 0;
+		ctx->off_erased = page.start_offset;
+	}
+
+	return flash_progressive_erase(ctx, end);
+}
+#else
+#define flash_progressive_erase(ctx, end) 0
+#define flash_erase_trailer(ctx) 0
+#endif
+
+/* Write whole blocks to flash, erasing the flash ahead of them first */
+static int flash_block_program(struct flash_img_context *ctx, off_t offset,
+			       u8_t *data, size_t len)
+{
+	int rc;
+
+	rc = flash_progressive_erase(ctx, offset + len);
+	if (rc) {
+		return rc;
+	}
+
+	flash_write_protection_set(ctx->dev, false);
+	rc = flash_write(ctx->dev, offset, data, len);
+	flash_write_protection_set(ctx->dev, true);
+	if (rc) {
+		SYS_LOG_ERR("flash_write error %d offset=0x%08x",
+			    rc, offset);
+		return rc;
+	}
+
+	if (!flash_verify(ctx->dev, offset, data, len)) {
+		return -EIO;
+	}
+
+	return 0;
+}
+
+#define IMG_DATA_ALIGNED(ptr) (((uintptr_t)(ptr) & (sizeof(u32_t) - 1)) == 0)
+
+/* buffer data into block writes, whole blocks in the caller's data are
+ * written from there without going through ctx->buf as long as they are
+ * word aligned
+ */
+static int flash_block_write(struct flash_img_context *ctx, off_t offset,
+			     u8_t *data, size_t len, bool finished)
+{
+	size_t processed = 0;
+	size_t count;
+	int rc = 0;
+
+	/* complete the block started by an earlier call */
+	if (ctx->buf_bytes) {
+		count = min(len, CONFIG_IMG_BLOCK_BUF_SIZE - ctx->buf_bytes);
+		memcpy(ctx->buf + ctx->buf_bytes, data, count);
+		ctx->buf_bytes += count;
+		processed = count;
+
+		if (ctx->buf_bytes == CONFIG_IMG_BLOCK_BUF_SIZE) {
+			rc = flash_block_program(ctx,
+						 offset + ctx->bytes_written,
+						 ctx->buf,
+						 CONFIG_IMG_BLOCK_BUF_SIZE);
+			if (rc) {
+				return rc;
+			}
+
+			ctx->bytes_written += CONFIG_IMG_BLOCK_BUF_SIZE;
+			ctx->buf_bytes = 0;
+		}
+	}
+
+	while (len - processed >= CONFIG_IMG_BLOCK_BUF_SIZE) {
+		u8_t *src = data + processed;
+
+		/* flash drivers load the source a word or more at a time,
+		 * so blocks at an unaligned address are copied first
+		 */
+		if (IMG_DATA_ALIGNED(src)) {
+			count = ROUND_DOWN(len - processed,
+					   CONFIG_IMG_BLOCK_BUF_SIZE);
+		} else {
+			count = CONFIG_IMG_BLOCK_BUF_SIZE;
+			memcpy(ctx->buf, src, count);
+			src = ctx->buf;
+		}
+
+		rc = flash_block_program(ctx, offset + ctx->bytes_written,
+					 src, count);
+		if (rc) {
+			return rc;
+		}
+
+		ctx->bytes_written += count;
+		processed += count;
 	}
 
 	/* place rest of the data into ctx->buf */
@@ -96,25 +228,20 @@ static int flash_block_write(struct flash_img_context *ctx, off_t offset,
 		memset(ctx->buf + ctx->buf_bytes, 0xFF,
 		       CONFIG_IMG_BLOCK_BUF_SIZE - ctx->buf_bytes);
 
-		flash_write_protection_set(ctx->dev, false);
-		rc = flash_write(ctx->dev, offset + ctx->bytes_written,
-				 ctx->buf, CONFIG_IMG_BLOCK_BUF_SIZE);
-		flash_write_protection_set(ctx->dev, true);
+		rc = flash_block_program(ctx, offset + ctx->bytes_written,
+					 ctx->buf, CONFIG_IMG_BLOCK_BUF_SIZE);
 		if (rc) {
-			SYS_LOG_ERR("flash_write error %d offset=0x%08x",
-				    rc, offset + ctx->bytes_written);
 			return rc;
 		}
 
-		if (!flash_verify(ctx->dev, offset + ctx->bytes_written,
-				  ctx->buf, CONFIG_IMG_BLOCK_BUF_SIZE)) {
-			return -EIO;
-		}
-
 		ctx->bytes_written = ctx->bytes_written + ctx->buf_bytes;
 		ctx->buf_bytes = 0;
 	}
 
+	if (finished) {
+		rc = flash_erase_trailer(ctx);
+	}
+
 	return rc;
 }
 
@@ -128,11 +255,58 @@ void flash_img_init(struct flash_img_context *ctx, struct device *dev)
 	ctx->dev = dev;
 	ctx->bytes_written = 0;
 	ctx->buf_bytes = 0;
+#if defined(CONFIG_IMG_ERASE_PROGRESSIVELY)
+	ctx->off_erased = FLASH_AREA_IMAGE_1_OFFSET;
+#endif
+#if defined(CONFIG_IMG_STREAM_SHA256)
+	ctx->hashing = false;
+#endif
 }
 
 int flash_img_buffered_write(struct flash_img_context *ctx, u8_t *data,
 			     size_t len, bool flush)
 {
-	return flash_block_write(ctx, FLASH_AREA_IMAGE_1_OFFSET, data, len,
-				 flush);
+	int rc;
+
+	rc = flash_block_write(ctx, FLASH_AREA_IMAGE_1_OFFSET, data, len,
+			       flush);
+
+#if defined(CONFIG_IMG_STREAM_SHA256)
+	if (!rc && ctx->hashing && ctx->hash_len) {
+		size_t count = min(len, ctx->hash_len);
+
+		tc_sha256_update(&ctx->sha256, data, count);
+		ctx->hash_len -= count;
+	}
+#endif
+
+	return rc;
+}
+
+#if defined(CONFIG_IMG_STREAM_SHA256)
+void flash_img_hash_start(struct flash_img_context *ctx, size_t len)
+{
+	tc_sha256_init(&ctx->sha256);
+	ctx->hash_len = len;
+	ctx->hashing = true;
+}
+
+int flash_img_hash_finish(struct flash_img_context *ctx, u8_t *digest)
+{
+	if (!ctx->hashing) {
+		return -EINVAL;
+	}
+
+	if (ctx->hash_len) {
+		return -EAGAIN;
+	}
+
+	ctx->hashing = false;
+
+	if (!tc_sha256_final(digest, &ctx->sha256)) {
+		return -EIO;
+	}
+
+	return 0;
 }
+#endif
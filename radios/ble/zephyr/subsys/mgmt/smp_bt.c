@@ -51,6 +51,15 @@ static ssize_t smp_bt_chr_write(struct bt_conn *conn,
 	struct net_buf *nb;
 
 	nb = mcumgr_buf_alloc();
+	if (!nb) {
+		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+	}
+
+	if (len > net_buf_tailroom(nb)) {
+		mcumgr_buf_free(nb);
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
 	net_buf_add_mem(nb, buf, len);
 
 	addr = bt_conn_get_dst(conn);
@@ -42,8 +42,77 @@
 #define WARN_ALLOC_INTERVAL K_FOREVER
 #endif
 
-/* Linker-defined symbol bound to the static pool structs */
+/* Linker-defined symbols bound to the static pool structs */
 extern struct net_buf_pool _net_buf_pool_list[];
+extern struct net_buf_pool _net_buf_pool_list_end[];
+
+#if defined(CONFIG_NET_BUF_POOL_STATS)
+/* Must be called with interrupts locked */
+static inline void stats_alloc(struct net_buf_pool *pool)
+{
+	pool->stats.allocs++;
+
+	if (++pool->stats.used > pool->stats.peak) {
+		pool->stats.peak = pool->stats.used;
+	}
+}
+
+static void stats_free(struct net_buf_pool *pool)
+{
+	unsigned int key = irq_lock();
+
+	pool->stats.used--;
+
+	irq_unlock(key);
+}
+
+static void stats_fail(struct net_buf_pool *pool)
+{
+	unsigned int key = irq_lock();
+
+	pool->stats.failures++;
+
+	irq_unlock(key);
+}
+
+static void stats_wait(struct net_buf_pool *pool, u32_t wait_time)
+{
+	unsigned int key = irq_lock();
+
+	pool->stats.waits++;
+	pool->stats.wait_time += wait_time;
+	pool->stats.max_wait = max(pool->stats.max_wait, wait_time);
+
+	irq_unlock(key);
+}
+
+void net_buf_pool_stats_get(struct net_buf_pool *pool,
+			    struct net_buf_pool_stats *stats)
+{
+	unsigned int key = irq_lock();
+
+	*stats = pool->stats;
+
+	irq_unlock(key);
+}
+
+void net_buf_pool_stats_reset(struct net_buf_pool *pool)
+{
+	unsigned int key = irq_lock();
+	u16_t used = pool->stats.used;
+
+	memset(&pool->stats, 0, sizeof(pool->stats));
+	pool->stats.used = used;
+	pool->stats.peak = used;
+
+	irq_unlock(key);
+}
+#else
+#define stats_alloc(pool)
+#define stats_free(pool)
+#define stats_fail(pool)
+#define stats_wait(pool, wait_time)
+#endif /* CONFIG_NET_BUF_POOL_STATS */
 
 struct net_buf_pool *net_buf_pool_get(int id)
 {
@@ -55,6 +124,16 @@ static int pool_id(struct net_buf_pool *pool)
 	return pool - _net_buf_pool_list;
 }
 
+void net_buf_pool_foreach(net_buf_pool_cb_t cb, void *user_data)
+{
+	struct net_buf_pool *pool;
+
+	for (pool = _net_buf_pool_list; pool < _net_buf_pool_list_end;
+	     pool++) {
+		cb(pool, user_data);
+	}
+}
+
 int net_buf_id(struct net_buf *buf)
 {
 	struct net_buf_pool *pool = net_buf_pool_get(buf->pool_id);
@@ -74,6 +153,32 @@ static inline struct net_buf *pool_get_uninit(struct net_buf_pool *pool,
 	return buf;
 }
 
+/* Take a free buffer without blocking. Must be called with interrupts
+ * locked.
+ */
+static inline struct net_buf *pool_take(struct net_buf_pool *pool)
+{
+	struct net_buf *buf;
+
+	/* If this is not the first access to the pool, we can
+	 * be opportunistic and try to fetch a previously used
+	 * buffer from the LIFO with K_NO_WAIT.
+	 */
+	if (pool->uninit_count < pool->buf_count) {
+		buf = k_lifo_get(&pool->free, K_NO_WAIT);
+		if (buf) {
+			return buf;
+		}
+	}
+
+	/* Fall back to the buffers that have never been used */
+	if (pool->uninit_count) {
+		return pool_get_uninit(pool, pool->uninit_count--);
+	}
+
+	return NULL;
+}
+
 void net_buf_reset(struct net_buf *buf)
 {
 	NET_BUF_ASSERT(buf->flags == 0);
@@ -223,6 +328,42 @@ static void data_unref(struct net_buf *buf, u8_t *data)
 	pool->alloc->cb->unref(buf, data);
 }
 
+/* Give back a buffer that was taken from the pool but never handed out */
+static void buf_release(struct net_buf_pool *pool, struct net_buf *buf)
+{
+	stats_free(pool);
+	net_buf_destroy(buf);
+}
+
+static struct net_buf *buf_setup(struct net_buf_pool *pool,
+				 struct net_buf *buf, size_t size,
+				 s32_t timeout)
+{
+	if (size) {
+		buf->__buf = data_alloc(buf, &size, timeout);
+		if (!buf->__buf) {
+			buf_release(pool, buf);
+			stats_fail(pool);
+			return NULL;
+		}
+	} else {
+		buf->__buf = NULL;
+	}
+
+	buf->ref   = 1;
+	buf->flags = 0;
+	buf->frags = NULL;
+	buf->size  = size;
+	net_buf_reset(buf);
+
+#if defined(CONFIG_NET_BUF_POOL_USAGE)
+	pool->avail_count--;
+	NET_BUF_ASSERT(pool->avail_count >= 0);
+#endif
+
+	return buf;
+}
+
 #if defined(CONFIG_NET_BUF_LOG)
 struct net_buf *net_buf_alloc_len_debug(struct net_buf_pool *pool, size_t size,
 					s32_t timeout, const char *func,
@@ -232,7 +373,7 @@ struct net_buf *net_buf_alloc_len(struct net_buf_pool *pool, size_t size,
 				  s32_t timeout)
 #endif
 {
-	u32_t alloc_start = k_uptime_get_32();
+	u32_t alloc_start;
 	struct net_buf *buf;
 	unsigned int key;
 
@@ -241,38 +382,29 @@ struct net_buf *net_buf_alloc_len(struct net_buf_pool *pool, size_t size,
 	NET_BUF_DBG("%s():%d: pool %p size %zu timeout %d", func, line, pool,
 		    size, timeout);
 
-	/* We need to lock interrupts temporarily to prevent race conditions
-	 * when accessing pool->uninit_count.
+	/* Fast path: a free buffer is available, which is the common case.
+	 * The buffer is taken and accounted for in a single critical
+	 * section, and the uptime is only read when we need to wait.
 	 */
 	key = irq_lock();
 
-	/* If there are uninitialized buffers we're guaranteed to succeed
-	 * with the allocation one way or another.
-	 */
-	if (pool->uninit_count) {
-		u16_t uninit_count;
-
-		/* If this is not the first access to the pool, we can
-		 * be opportunistic and try to fetch a previously used
-		 * buffer from the LIFO with K_NO_WAIT.
-		 */
-		if (pool->uninit_count < pool->buf_count) {
-			buf = k_lifo_get(&pool->free, K_NO_WAIT);
-			if (buf) {
-				irq_unlock(key);
-				goto success;
-			}
-		}
-
-		uninit_count = pool->uninit_count--;
+	buf = pool_take(pool);
+	if (buf) {
+		stats_alloc(pool);
 		irq_unlock(key);
-
-		buf = pool_get_uninit(pool, uninit_count);
 		goto success;
 	}
 
 	irq_unlock(key);
 
+	if (timeout == K_NO_WAIT) {
+		NET_BUF_ERR("%s():%d: Failed to get free buffer", func, line);
+		stats_fail(pool);
+		return NULL;
+	}
+
+	alloc_start = k_uptime_get_32();
+
 #if defined(CONFIG_NET_BUF_LOG) && SYS_LOG_LEVEL >= SYS_LOG_LEVEL_WARNING
 	if (timeout == K_FOREVER) {
 		u32_t ref = k_uptime_get_32();
@@ -302,42 +434,31 @@ struct net_buf *net_buf_alloc_len(struct net_buf_pool *pool, size_t size,
 #else
 	buf = k_lifo_get(&pool->free, timeout);
 #endif
+	stats_wait(pool, k_uptime_get_32() - alloc_start);
+
 	if (!buf) {
 		NET_BUF_ERR("%s():%d: Failed to get free buffer", func, line);
+		stats_fail(pool);
 		return NULL;
 	}
 
-success:
-	NET_BUF_DBG("allocated buf %p", buf);
-
-	if (size) {
-		if (timeout != K_NO_WAIT && timeout != K_FOREVER) {
-			u32_t diff = k_uptime_get_32() - alloc_start;
+	key = irq_lock();
+	stats_alloc(pool);
+	irq_unlock(key);
 
-			timeout -= min(timeout, diff);
-		}
+	if (timeout != K_FOREVER) {
+		u32_t diff = k_uptime_get_32() - alloc_start;
 
-		buf->__buf = data_alloc(buf, &size, timeout);
-		if (!buf->__buf) {
-			NET_BUF_ERR("%s():%d: Failed to allocate data",
-				    func, line);
-			net_buf_destroy(buf);
-			return NULL;
-		}
-	} else {
-		buf->__buf = NULL;
+		timeout -= min(timeout, diff);
 	}
 
-	buf->ref   = 1;
-	buf->flags = 0;
-	buf->frags = NULL;
-	buf->size  = size;
-	net_buf_reset(buf);
+success:
+	NET_BUF_DBG("allocated buf %p", buf);
 
-#if defined(CONFIG_NET_BUF_POOL_USAGE)
-	pool->avail_count--;
-	NET_BUF_ASSERT(pool->avail_count >= 0);
-#endif
+	if (!buf_setup(pool, buf, size, timeout)) {
+		NET_BUF_ERR("%s():%d: Failed to allocate data", func, line);
+		return NULL;
+	}
 
 	return buf;
 }
@@ -538,6 +659,7 @@ void net_buf_unref(struct net_buf *buf)
 		pool->avail_count++;
 		NET_BUF_ASSERT(pool->avail_count <= pool->buf_count);
 #endif
+		stats_free(pool);
 
 		if (pool->destroy) {
 			pool->destroy(buf);
@@ -549,6 +671,181 @@ void net_buf_unref(struct net_buf *buf)
 	}
 }
 
+int net_buf_alloc_batch(struct net_buf_pool *pool, size_t size,
+			struct net_buf **bufs, int count, s32_t timeout)
+{
+	u32_t alloc_start;
+	unsigned int key;
+	int taken, ready, i;
+
+	NET_BUF_ASSERT(pool);
+	NET_BUF_ASSERT(bufs);
+
+	/* Take whatever is free in one go */
+	key = irq_lock();
+
+	for (taken = 0; taken < count; taken++) {
+		bufs[taken] = pool_take(pool);
+		if (!bufs[taken]) {
+			break;
+		}
+
+		stats_alloc(pool);
+	}
+
+	irq_unlock(key);
+
+	for (ready = 0; ready < taken; ready++) {
+		if (!buf_setup(pool, bufs[ready], size, timeout)) {
+			goto release;
+		}
+	}
+
+	if (ready == count) {
+		return 0;
+	}
+
+	/* The pool ran dry, wait for the rest one buffer at a time */
+	alloc_start = k_uptime_get_32();
+
+	for (; ready < count; ready++) {
+		s32_t remaining = timeout;
+
+		if (timeout != K_NO_WAIT && timeout != K_FOREVER) {
+			u32_t diff = k_uptime_get_32() - alloc_start;
+
+			remaining -= min(timeout, diff);
+		}
+
+		bufs[ready] = net_buf_alloc_len(pool, size, remaining);
+		if (!bufs[ready]) {
+			goto release;
+		}
+	}
+
+	return 0;
+
+release:
+	NET_BUF_ERR("Got %d buffers out of %d", ready, count);
+
+	/* bufs[ready] failed and is already back in the pool */
+	for (i = ready + 1; i < taken; i++) {
+		buf_release(pool, bufs[i]);
+	}
+
+	net_buf_unref_batch(bufs, ready);
+
+	return -ENOMEM;
+}
+
+/* Return a list of buffers to a pool without destroy callback */
+static void pool_put_list(struct net_buf_pool *pool, struct net_buf *head,
+			  struct net_buf *tail, u16_t count)
+{
+	unsigned int key = irq_lock();
+
+#if defined(CONFIG_NET_BUF_POOL_STATS)
+	pool->stats.used -= count;
+#endif
+
+#if defined(CONFIG_POLL)
+	/* With polling only one waiter is signaled per put, so if there
+	 * are threads waiting for buffers they get them one by one.
+	 */
+	if (!sys_dlist_is_empty(&pool->free._queue.poll_events)) {
+		while (head) {
+			struct net_buf *next = head->frags;
+
+			k_lifo_put(&pool->free, head);
+			head = next;
+		}
+
+		irq_unlock(key);
+		return;
+	}
+#endif
+
+	k_queue_append_list(&pool->free._queue, head, tail);
+
+	irq_unlock(key);
+}
+
+void net_buf_unref_batch(struct net_buf **bufs, int count)
+{
+	struct net_buf_pool *list_pool = NULL;
+	struct net_buf *head = NULL;
+	struct net_buf *tail = NULL;
+	u16_t listed = 0;
+	int i;
+
+	NET_BUF_ASSERT(bufs);
+
+	for (i = 0; i < count; i++) {
+		struct net_buf *buf = bufs[i];
+
+		while (buf) {
+			struct net_buf *frags = buf->frags;
+			struct net_buf_pool *pool;
+
+#if defined(CONFIG_NET_BUF_LOG)
+			if (!buf->ref) {
+				NET_BUF_ERR("buf %p double free", buf);
+				break;
+			}
+#endif
+			if (--buf->ref > 0) {
+				break;
+			}
+
+			if (buf->__buf) {
+				data_unref(buf, buf->__buf);
+				buf->__buf = NULL;
+			}
+
+			buf->data = NULL;
+			buf->frags = NULL;
+
+			pool = net_buf_pool_get(buf->pool_id);
+
+#if defined(CONFIG_NET_BUF_POOL_USAGE)
+			pool->avail_count++;
+			NET_BUF_ASSERT(pool->avail_count <= pool->buf_count);
+#endif
+
+			if (pool->destroy) {
+				stats_free(pool);
+				pool->destroy(buf);
+			} else {
+				/* Chain buffers of the same pool through
+				 * their node and return them together.
+				 */
+				if (head && pool != list_pool) {
+					pool_put_list(list_pool, head, tail,
+						      listed);
+					head = NULL;
+				}
+
+				if (head) {
+					tail->frags = buf;
+				} else {
+					head = buf;
+					listed = 0;
+				}
+
+				tail = buf;
+				list_pool = pool;
+				listed++;
+			}
+
+			buf = frags;
+		}
+	}
+
+	if (head) {
+		pool_put_list(list_pool, head, tail, listed);
+	}
+}
+
 struct net_buf *net_buf_ref(struct net_buf *buf)
 {
 	NET_BUF_ASSERT(buf);
@@ -593,7 +890,7 @@ struct net_buf *net_buf_clone(struct net_buf *buf, s32_t timeout)
 
 		clone->__buf = data_alloc(clone, &size, timeout);
 		if (!clone->__buf || size < buf->size) {
-			net_buf_destroy(clone);
+			buf_release(pool, clone);
 			return NULL;
 		}
 
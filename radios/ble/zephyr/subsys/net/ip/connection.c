@@ -48,6 +48,25 @@
 
 static struct net_conn conns[CONFIG_NET_MAX_CONN];
 
+/* Lookup index of the connections, so that a received packet is only
+ * compared against the handlers that can possibly match it. Every used
+ * connection is on exactly one chain:
+ *
+ *   conn_exact  remote address, remote port and local port specified,
+ *               hashed by those and the protocol
+ *   conn_port   other handlers with a local port, hashed by the local
+ *               port and the protocol
+ *   conn_wild   handlers for any local port
+ *
+ * Chains are linked through conn_next, by index in conns.
+ */
+#define CONN_NONE -1
+
+static s16_t conn_exact[CONFIG_NET_CONN_HASH_BUCKETS];
+static s16_t conn_port[CONFIG_NET_CONN_HASH_BUCKETS];
+static s16_t conn_wild;
+static s16_t conn_next[CONFIG_NET_MAX_CONN];
+
 #if defined(CONFIG_NET_CONN_CACHE)
 
 /* Cache the connection so that we do not have to go
@@ -346,6 +365,92 @@ static inline void cache_remove(struct net_conn *conn)
 #define cache_remove(...)
 #endif /* CONFIG_NET_CONN_CACHE */
 
+static inline u32_t conn_hash_addr(sa_family_t family, const void *addr)
+{
+#if defined(CONFIG_NET_IPV6)
+	if (family == AF_INET6) {
+		const struct in6_addr *addr6 = addr;
+
+		return UNALIGNED_GET(&addr6->s6_addr32[0]) ^
+			UNALIGNED_GET(&addr6->s6_addr32[1]) ^
+			UNALIGNED_GET(&addr6->s6_addr32[2]) ^
+			UNALIGNED_GET(&addr6->s6_addr32[3]);
+	}
+#endif
+
+#if defined(CONFIG_NET_IPV4)
+	if (family == AF_INET) {
+		const struct in_addr *addr4 = addr;
+
+		return UNALIGNED_GET(&addr4->s_addr);
+	}
+#endif
+
+	return 0;
+}
+
+/* Ports are in network byte order, like in the packet */
+static inline u16_t conn_hash(u32_t value, u16_t remote_port,
+			      u16_t local_port, u8_t proto)
+{
+	value ^= ((u32_t)remote_port << 16) ^ local_port ^ (proto << 8);
+
+	/* Knuth's multiplicative hash, the upper bits are the best mixed */
+	return ((value * 2654435761U) >> 16) % CONFIG_NET_CONN_HASH_BUCKETS;
+}
+
+static s16_t *conn_chain(struct net_conn *conn)
+{
+	u16_t remote_port = net_sin(&conn->remote_addr)->sin_port;
+	u16_t local_port = net_sin(&conn->local_addr)->sin_port;
+	u32_t value;
+
+	if ((conn->rank & NET_RANK_REMOTE_SPEC_ADDR) && remote_port &&
+	    local_port) {
+		if (conn->remote_addr.sa_family == AF_INET6) {
+			value = conn_hash_addr(AF_INET6,
+					       &net_sin6(&conn->remote_addr)->
+								sin6_addr);
+		} else {
+			value = conn_hash_addr(AF_INET,
+					       &net_sin(&conn->remote_addr)->
+								sin_addr);
+		}
+
+		return &conn_exact[conn_hash(value, remote_port, local_port,
+					     conn->proto)];
+	}
+
+	if (local_port) {
+		return &conn_port[conn_hash(0, 0, local_port, conn->proto)];
+	}
+
+	return &conn_wild;
+}
+
+static void conn_link(int idx)
+{
+	s16_t *head = conn_chain(&conns[idx]);
+
+	conn_next[idx] = *head;
+	*head = idx;
+}
+
+static void conn_unlink(int idx)
+{
+	s16_t *pos = conn_chain(&conns[idx]);
+
+	while (*pos != idx) {
+		if (*pos == CONN_NONE) {
+			return;
+		}
+
+		pos = &conn_next[*pos];
+	}
+
+	*pos = conn_next[idx];
+}
+
 int net_conn_unregister(struct net_conn_handle *handle)
 {
 	struct net_conn *conn = (struct net_conn *)handle;
@@ -359,6 +464,7 @@ int net_conn_unregister(struct net_conn_handle *handle)
 	}
 
 	cache_remove(conn);
+	conn_unlink(conn - conns);
 
 	NET_DBG("[%zu] connection handler %p removed",
 		(conn - conns) / sizeof(*conn), conn);
@@ -676,6 +782,8 @@ int net_conn_register(enum net_ip_protocol proto,
 		conns[i].rank = rank;
 		conns[i].proto = proto;
 
+		conn_link(i);
+
 		/* Cache needs to be cleared if new entries are added. */
 		cache_clear();
 
@@ -803,9 +911,87 @@ static bool is_invalid_packet(struct net_pkt *pkt,
 	return my_src_addr && (src_port == dst_port);
 }
 
+static bool conn_match(struct net_conn *conn, enum net_ip_protocol proto,
+		       struct net_pkt *pkt, u16_t src_port, u16_t dst_port)
+{
+	if (conn->proto != proto) {
+		return false;
+	}
+
+	if (net_sin(&conn->remote_addr)->sin_port) {
+		if (net_sin(&conn->remote_addr)->sin_port != src_port) {
+			return false;
+		}
+	}
+
+	if (net_sin(&conn->local_addr)->sin_port) {
+		if (net_sin(&conn->local_addr)->sin_port != dst_port) {
+			return false;
+		}
+	}
+
+	if (conn->flags & NET_CONN_REMOTE_ADDR_SET) {
+		if (!check_addr(pkt, &conn->remote_addr, true)) {
+			return false;
+		}
+	}
+
+	if (conn->flags & NET_CONN_LOCAL_ADDR_SET) {
+		if (!check_addr(pkt, &conn->local_addr, false)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Add the handlers on a chain that match the packet to matches, which
+ * is kept sorted by index so that ties are resolved in the same order
+ * as a scan of the whole table would.
+ */
+static int conn_collect(s16_t idx, enum net_ip_protocol proto,
+			struct net_pkt *pkt, u16_t src_port, u16_t dst_port,
+			s16_t *matches, int count)
+{
+	int j;
+
+	for (; idx != CONN_NONE; idx = conn_next[idx]) {
+		if (!conn_match(&conns[idx], proto, pkt, src_port, dst_port)) {
+			continue;
+		}
+
+		for (j = count; j > 0 && matches[j - 1] > idx; j--) {
+			matches[j] = matches[j - 1];
+		}
+
+		matches[j] = idx;
+		count++;
+	}
+
+	return count;
+}
+
+static inline u32_t conn_hash_pkt_src(struct net_pkt *pkt)
+{
+#if defined(CONFIG_NET_IPV6)
+	if (net_pkt_family(pkt) == AF_INET6) {
+		return conn_hash_addr(AF_INET6, &NET_IPV6_HDR(pkt)->src);
+	}
+#endif
+
+#if defined(CONFIG_NET_IPV4)
+	if (net_pkt_family(pkt) == AF_INET) {
+		return conn_hash_addr(AF_INET, &NET_IPV4_HDR(pkt)->src);
+	}
+#endif
+
+	return 0;
+}
+
 enum net_verdict net_conn_input(enum net_ip_protocol proto, struct net_pkt *pkt)
 {
-	int i, best_match = -1;
+	s16_t matches[CONFIG_NET_MAX_CONN];
+	int i, j, count, best_match = -1;
 	s16_t best_rank = -1;
 	u16_t src_port, dst_port;
 	u16_t chksum;
@@ -882,40 +1068,17 @@ enum net_verdict net_conn_input(enum net_ip_protocol proto, struct net_pkt *pkt)
 			net_pkt_family(pkt), ntohs(chksum), data_len);
 	}
 
-	for (i = 0; i < CONFIG_NET_MAX_CONN; i++) {
-		if (!(conns[i].flags & NET_CONN_IN_USE)) {
-			continue;
-		}
-
-		if (conns[i].proto != proto) {
-			continue;
-		}
-
-		if (net_sin(&conns[i].remote_addr)->sin_port) {
-			if (net_sin(&conns[i].remote_addr)->sin_port !=
-			    src_port) {
-				continue;
-			}
-		}
-
-		if (net_sin(&conns[i].local_addr)->sin_port) {
-			if (net_sin(&conns[i].local_addr)->sin_port !=
-			    dst_port) {
-				continue;
-			}
-		}
-
-		if (conns[i].flags & NET_CONN_REMOTE_ADDR_SET) {
-			if (!check_addr(pkt, &conns[i].remote_addr, true)) {
-				continue;
-			}
-		}
+	/* Only the chains that can hold a matching handler are searched */
+	count = conn_collect(conn_exact[conn_hash(conn_hash_pkt_src(pkt),
+						  src_port, dst_port, proto)],
+			     proto, pkt, src_port, dst_port, matches, 0);
+	count = conn_collect(conn_port[conn_hash(0, 0, dst_port, proto)],
+			     proto, pkt, src_port, dst_port, matches, count);
+	count = conn_collect(conn_wild, proto, pkt, src_port, dst_port,
+			     matches, count);
 
-		if (conns[i].flags & NET_CONN_LOCAL_ADDR_SET) {
-			if (!check_addr(pkt, &conns[i].local_addr, false)) {
-				continue;
-			}
-		}
+	for (j = 0; j < count; j++) {
+		i = matches[j];
 
 		/* If we have an existing best_match, and that one
 		 * specifies a remote port, then we've matched to a
@@ -1049,13 +1212,18 @@ void net_conn_foreach(net_conn_foreach_cb_t cb, void *user_data)
 
 void net_conn_init(void)
 {
-#if defined(CONFIG_NET_CONN_CACHE)
-	do {
-		int i;
+	int i;
 
-		for (i = 0; i < CONFIG_NET_MAX_CONN; i++) {
-			conn_cache[i].idx = -1;
-		}
-	} while (0);
+	for (i = 0; i < CONFIG_NET_CONN_HASH_BUCKETS; i++) {
+		conn_exact[i] = CONN_NONE;
+		conn_port[i] = CONN_NONE;
+	}
+
+	conn_wild = CONN_NONE;
+
+#if defined(CONFIG_NET_CONN_CACHE)
+	for (i = 0; i < CONFIG_NET_MAX_CONN; i++) {
+		conn_cache[i].idx = -1;
+	}
 #endif /* CONFIG_NET_CONN_CACHE */
 }
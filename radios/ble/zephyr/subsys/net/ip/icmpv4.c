@@ -293,7 +293,7 @@ int net_icmpv4_send_error(struct net_pkt *orig, u8_t type, u8_t code)
 		extra_len = sizeof(struct net_ipv4_hdr);
 		/* FIXME, add TCP header length too */
 	} else {
-		size_t space = CONFIG_NET_BUF_DATA_SIZE -
+		size_t space = NET_PKT_FRAG_DEFAULT_SIZE -
 			net_if_get_ll_reserve(iface, NULL);
 
 		if (reserve > space) {
@@ -160,16 +160,31 @@ struct net_buf *net_icmpv6_set_chksum(struct net_pkt *pkt,
 	return frag;
 }
 
+/* Slow path for headers split between fragments: copy the header out of
+ * the packet, offset bytes after the start of the ICMPv6 header.
+ */
+static void *icmpv6_hdr_read(struct net_pkt *pkt, u16_t offset, void *hdr,
+			     u16_t len)
+{
+	struct net_pkt_cursor cursor;
+
+	if (net_pkt_cursor_seek(pkt, &cursor, net_pkt_ip_hdr_len(pkt) +
+				net_pkt_ipv6_ext_len(pkt) + offset) ||
+	    net_pkt_cursor_read(&cursor, hdr, len)) {
+		return NULL;
+	}
+
+	return hdr;
+}
+
 struct net_icmp_hdr *net_icmpv6_get_hdr(struct net_pkt *pkt,
 					struct net_icmp_hdr *hdr)
 {
 	struct net_icmp_hdr *icmp_hdr;
-	struct net_buf *frag;
-	u16_t pos;
 
 	/* If the ICMP header can fit the first fragment, then access it
-	 * directly (fast path), otherwise read the values one by one
-	 * using net_frag_read*() functions (slow path).
+	 * directly (fast path), otherwise copy it out of the fragments
+	 * (slow path).
 	 */
 
 	icmp_hdr = net_pkt_icmp_data(pkt);
@@ -177,12 +192,7 @@ struct net_icmp_hdr *net_icmpv6_get_hdr(struct net_pkt *pkt,
 		return icmp_hdr;
 	}
 
-	frag = net_frag_read_u8(pkt->frags, net_pkt_ip_hdr_len(pkt) +
-				net_pkt_ipv6_ext_len(pkt), &pos, &hdr->type);
-	frag = net_frag_read_u8(frag, pos, &pos, &hdr->code);
-	frag = net_frag_read(frag, pos, &pos, sizeof(hdr->chksum),
-			     (u8_t *)&hdr->chksum);
-	if (pos > 0 && !frag) {
+	if (!icmpv6_hdr_read(pkt, 0, hdr, sizeof(*hdr))) {
 		NET_ERR("Malformed ICMPv6 packet");
 		return NULL;
 	}
@@ -218,9 +228,7 @@ struct net_icmp_hdr *net_icmpv6_set_hdr(struct net_pkt *pkt,
 struct net_icmpv6_ns_hdr *net_icmpv6_get_ns_hdr(struct net_pkt *pkt,
 						struct net_icmpv6_ns_hdr *hdr)
 {
-	struct net_buf *frag;
 	u8_t *opt_data;
-	u16_t pos;
 
 	/* No helpers for various ICMP sub-options. First get the pointer
 	 * where the sub-option is located, then check if it is located in
@@ -233,12 +241,8 @@ struct net_icmpv6_ns_hdr *net_icmpv6_get_ns_hdr(struct net_pkt *pkt,
 		return (struct net_icmpv6_ns_hdr *)opt_data;
 	}
 
-	frag = net_frag_read(pkt->frags,
-			     net_pkt_ip_hdr_len(pkt) +
-			     net_pkt_ipv6_ext_len(pkt) +
-			     sizeof(struct net_icmp_hdr) + 4 /* reserved */,
-			     &pos, sizeof(struct in6_addr), (u8_t *)&hdr->tgt);
-	if (pos > 0 && !frag) {
+	if (!icmpv6_hdr_read(pkt, sizeof(struct net_icmp_hdr), hdr,
+			     sizeof(*hdr))) {
 		NET_ERR("Cannot get the ICMPv6 NS header");;
 		return NULL;
 	}
@@ -277,9 +281,7 @@ struct net_icmpv6_ns_hdr *net_icmpv6_set_ns_hdr(struct net_pkt *pkt,
 struct net_icmpv6_nd_opt_hdr *net_icmpv6_get_nd_opt_hdr(struct net_pkt *pkt,
 					    struct net_icmpv6_nd_opt_hdr *hdr)
 {
-	struct net_buf *frag;
 	u8_t *opt_data;
-	u16_t pos;
 
 	opt_data = net_pkt_icmp_opt_data(pkt, sizeof(struct net_icmp_hdr) +
 					 net_pkt_ipv6_ext_opt_len(pkt));
@@ -287,14 +289,9 @@ struct net_icmpv6_nd_opt_hdr *net_icmpv6_get_nd_opt_hdr(struct net_pkt *pkt,
 		return (struct net_icmpv6_nd_opt_hdr *)opt_data;
 	}
 
-	frag = net_frag_read_u8(pkt->frags,
-				net_pkt_ip_hdr_len(pkt) +
-				net_pkt_ipv6_ext_len(pkt) +
-				sizeof(struct net_icmp_hdr) +
-				net_pkt_ipv6_ext_opt_len(pkt),
-				&pos, &hdr->type);
-	frag = net_frag_read_u8(frag, pos, &pos, &hdr->len);
-	if (pos > 0 && !frag) {
+	if (!icmpv6_hdr_read(pkt, sizeof(struct net_icmp_hdr) +
+			     net_pkt_ipv6_ext_opt_len(pkt), hdr,
+			     sizeof(*hdr))) {
 		return NULL;
 	}
 
@@ -304,23 +301,15 @@ struct net_icmpv6_nd_opt_hdr *net_icmpv6_get_nd_opt_hdr(struct net_pkt *pkt,
 struct net_icmpv6_na_hdr *net_icmpv6_get_na_hdr(struct net_pkt *pkt,
 						struct net_icmpv6_na_hdr *hdr)
 {
-	struct net_buf *frag;
 	u8_t *opt_data;
-	u16_t pos;
 
 	opt_data = net_pkt_icmp_opt_data(pkt, sizeof(struct net_icmp_hdr));
 	if (net_header_fits(pkt, opt_data, sizeof(*hdr))) {
 		return (struct net_icmpv6_na_hdr *)opt_data;
 	}
 
-	frag = net_frag_read_u8(pkt->frags, net_pkt_ip_hdr_len(pkt) +
-				net_pkt_ipv6_ext_len(pkt) +
-				sizeof(struct net_icmp_hdr),
-				&pos, &hdr->flags);
-	frag = net_frag_skip(frag, pos, &pos, 3); /* reserved */
-	frag = net_frag_read(frag, pos, &pos, sizeof(struct in6_addr),
-			     (u8_t *)&hdr->tgt);
-	if (pos > 0 && !frag) {
+	if (!icmpv6_hdr_read(pkt, sizeof(struct net_icmp_hdr), hdr,
+			     sizeof(*hdr))) {
 		NET_ERR("Cannot get the ICMPv6 NA header");
 		return NULL;
 	}
@@ -362,27 +351,15 @@ struct net_icmpv6_na_hdr *net_icmpv6_set_na_hdr(struct net_pkt *pkt,
 struct net_icmpv6_ra_hdr *net_icmpv6_get_ra_hdr(struct net_pkt *pkt,
 						struct net_icmpv6_ra_hdr *hdr)
 {
-	struct net_buf *frag;
 	u8_t *opt_data;
-	u16_t pos;
 
 	opt_data = net_pkt_icmp_opt_data(pkt, sizeof(struct net_icmp_hdr));
 	if (net_header_fits(pkt, opt_data, sizeof(*hdr))) {
 		return (struct net_icmpv6_ra_hdr *)opt_data;
 	}
 
-	frag = net_frag_read_u8(pkt->frags, net_pkt_ip_hdr_len(pkt) +
-				net_pkt_ipv6_ext_len(pkt) +
-				sizeof(struct net_icmp_hdr),
-				&pos, &hdr->cur_hop_limit);
-	frag = net_frag_read_u8(frag, pos, &pos, &hdr->flags);
-	frag = net_frag_read(frag, pos, &pos, sizeof(hdr->router_lifetime),
-			     (u8_t *)&hdr->router_lifetime);
-	frag = net_frag_read(frag, pos, &pos, sizeof(hdr->reachable_time),
-			     (u8_t *)&hdr->reachable_time);
-	frag = net_frag_read(frag, pos, &pos, sizeof(hdr->retrans_timer),
-			     (u8_t *)&hdr->retrans_timer);
-	if (pos > 0 && !frag) {
+	if (!icmpv6_hdr_read(pkt, sizeof(struct net_icmp_hdr), hdr,
+			     sizeof(*hdr))) {
 		NET_ERR("Cannot get the ICMPv6 RA header");
 		return NULL;
 	}
@@ -540,7 +517,7 @@ int net_icmpv6_send_error(struct net_pkt *orig, u8_t type, u8_t code,
 	} else if (NET_IPV6_HDR(orig)->nexthdr == NET_IPV6_NEXTHDR_FRAG) {
 		extra_len = net_pkt_get_len(orig);
 	} else {
-		size_t space = CONFIG_NET_BUF_DATA_SIZE -
+		size_t space = NET_PKT_FRAG_DEFAULT_SIZE -
 			net_if_get_ll_reserve(iface,
 					      &NET_IPV6_HDR(orig)->dst);
 
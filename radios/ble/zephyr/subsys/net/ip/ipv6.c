@@ -3089,115 +3089,203 @@ static struct net_icmpv6_handler ra_input_handler = {
 
 #define FRAG_BUF_WAIT K_MSEC(10) /* how long to max wait for a buffer */
 
+/* Pending reassemblies are found through a small hash table keyed by
+ * the fragment id and the addresses. The buckets are chained through
+ * the next field, by index in reassembly.
+ */
+#define REASSEMBLY_BUCKETS 8
+#define REASSEMBLY_NONE -1
+
 static void reassembly_timeout(struct k_work *work);
 static bool reassembly_init_done;
 
 static struct net_ipv6_reassembly
 reassembly[CONFIG_NET_IPV6_FRAGMENT_MAX_COUNT];
+static s8_t reassembly_hash[REASSEMBLY_BUCKETS];
+static struct net_ipv6_reassembly_stats reassembly_stats;
 
-static struct net_ipv6_reassembly *reassembly_get(u32_t id,
-						  struct in6_addr *src,
-						  struct in6_addr *dst)
+static void reassembly_init(void)
 {
-	int i, avail = -1;
+	int i;
 
+	/* Static initializing does not work here because of the array
+	 * so we must do it at runtime.
+	 */
 	for (i = 0; i < CONFIG_NET_IPV6_FRAGMENT_MAX_COUNT; i++) {
+		k_delayed_work_init(&reassembly[i].timer, reassembly_timeout);
+	}
+
+	for (i = 0; i < REASSEMBLY_BUCKETS; i++) {
+		reassembly_hash[i] = REASSEMBLY_NONE;
+	}
 
-		if (k_delayed_work_remaining_get(&reassembly[i].timer) &&
-		    reassembly[i].id == id &&
-		    net_ipv6_addr_cmp(src, &reassembly[i].src) &&
-		    net_ipv6_addr_cmp(dst, &reassembly[i].dst)) {
-			return &reassembly[i];
+	reassembly_init_done = true;
+}
+
+static s8_t *reassembly_bucket(u32_t id, const struct in6_addr *src,
+			       const struct in6_addr *dst)
+{
+	u32_t value = id ^ UNALIGNED_GET(&src->s6_addr32[2]) ^
+		UNALIGNED_GET(&src->s6_addr32[3]) ^
+		UNALIGNED_GET(&dst->s6_addr32[3]);
+
+	/* Knuth's multiplicative hash, the upper bits are the best mixed */
+	return &reassembly_hash[((value * 2654435761U) >> 16) %
+				REASSEMBLY_BUCKETS];
+}
+
+static void reassembly_unlink(struct net_ipv6_reassembly *reass)
+{
+	s8_t *pos = reassembly_bucket(reass->id, &reass->src, &reass->dst);
+	s8_t idx = reass - reassembly;
+
+	while (*pos != idx) {
+		if (*pos == REASSEMBLY_NONE) {
+			return;
 		}
 
-		if (k_delayed_work_remaining_get(&reassembly[i].timer)) {
+		pos = &reassembly[*pos].next;
+	}
+
+	*pos = reass->next;
+}
+
+/* The reassembly that has been pending for the longest time */
+static struct net_ipv6_reassembly *reassembly_oldest(void)
+{
+	struct net_ipv6_reassembly *oldest = NULL;
+	int i;
+
+	for (i = 0; i < CONFIG_NET_IPV6_FRAGMENT_MAX_COUNT; i++) {
+		if (!reassembly[i].used) {
 			continue;
 		}
 
-		if (avail < 0) {
-			avail = i;
+		if (!oldest || (s32_t)(reassembly[i].start - oldest->start) < 0) {
+			oldest = &reassembly[i];
 		}
 	}
 
-	if (avail < 0) {
-		return NULL;
-	}
-
-	k_delayed_work_submit(&reassembly[avail].timer,
-			      IPV6_REASSEMBLY_TIMEOUT);
+	return oldest;
+}
 
-	net_ipaddr_copy(&reassembly[avail].src, src);
-	net_ipaddr_copy(&reassembly[avail].dst, dst);
+static void reassembly_info(char *str, struct net_ipv6_reassembly *reass)
+{
+	char out[NET_IPV6_ADDR_LEN];
 
-	reassembly[avail].id = id;
+	snprintk(out, sizeof(out), "%s", net_sprint_ipv6_addr(&reass->dst));
 
-	return &reassembly[avail];
+	NET_DBG("%s id 0x%x src %s dst %s remain %d ms len %u/%u mem %u",
+		str, reass->id, net_sprint_ipv6_addr(&reass->src), out,
+		k_delayed_work_remaining_get(&reass->timer), reass->received,
+		reass->len, reass->mem);
 }
 
-static bool reassembly_cancel(u32_t id,
-			      struct in6_addr *src,
-			      struct in6_addr *dst)
+static void reassembly_free(struct net_ipv6_reassembly *reass)
 {
-	int i, j;
+	struct net_pkt *pkt;
 
-	NET_DBG("Cancel 0x%x", id);
+	NET_DBG("Release 0x%x", reass->id);
 
-	for (i = 0; i < CONFIG_NET_IPV6_FRAGMENT_MAX_COUNT; i++) {
-		s32_t remaining;
+	k_delayed_work_cancel(&reass->timer);
+	reassembly_unlink(reass);
 
-		if (reassembly[i].id != id ||
-		    !net_ipv6_addr_cmp(src, &reassembly[i].src) ||
-		    !net_ipv6_addr_cmp(dst, &reassembly[i].dst)) {
-			continue;
-		}
+	while (reass->pkt) {
+		pkt = reass->pkt;
+		reass->pkt = pkt->ipv6_frag_next;
 
-		remaining = k_delayed_work_remaining_get(&reassembly[i].timer);
-		if (remaining) {
-			k_delayed_work_cancel(&reassembly[i].timer);
-		}
+		NET_DBG("IPv6 reassembly pkt %p offset 0x%x %zd bytes data",
+			pkt, net_pkt_ipv6_fragment_offset(pkt),
+			net_pkt_get_len(pkt));
 
-		NET_DBG("IPv6 reassembly id 0x%x remaining %d ms",
-			reassembly[i].id, remaining);
+		net_pkt_unref(pkt);
+	}
 
-		reassembly[i].id = 0;
+	reassembly_stats.mem -= reass->mem;
+	reass->used = false;
+}
 
-		for (j = 0; j < NET_IPV6_FRAGMENTS_MAX_PKT; j++) {
-			if (!reassembly[i].pkt[j]) {
-				continue;
-			}
+static void reassembly_evict(struct net_ipv6_reassembly *reass)
+{
+	reassembly_info("Reassembly evicted", reass);
 
-			NET_DBG("[%d] IPv6 reassembly pkt %p %zd bytes data",
-				j, reassembly[i].pkt[j],
-				net_pkt_get_len(reassembly[i].pkt[j]));
+	reassembly_stats.evicted++;
+	reassembly_free(reass);
+}
 
-			net_pkt_unref(reassembly[i].pkt[j]);
-			reassembly[i].pkt[j] = NULL;
+static struct net_ipv6_reassembly *reassembly_get(u32_t id,
+						  struct in6_addr *src,
+						  struct in6_addr *dst)
+{
+	struct net_ipv6_reassembly *reass;
+	s8_t *bucket = reassembly_bucket(id, src, dst);
+	s8_t idx;
+
+	for (idx = *bucket; idx != REASSEMBLY_NONE;
+	     idx = reassembly[idx].next) {
+		reass = &reassembly[idx];
+
+		if (reass->id == id &&
+		    net_ipv6_addr_cmp(src, &reass->src) &&
+		    net_ipv6_addr_cmp(dst, &reass->dst)) {
+			return reass;
+		}
+	}
+
+	for (idx = 0; idx < CONFIG_NET_IPV6_FRAGMENT_MAX_COUNT; idx++) {
+		if (!reassembly[idx].used) {
+			break;
 		}
+	}
 
-		return true;
+	if (idx < CONFIG_NET_IPV6_FRAGMENT_MAX_COUNT) {
+		reass = &reassembly[idx];
+	} else {
+		/* All slots are taken, give up the oldest datagram */
+		reass = reassembly_oldest();
+		reassembly_evict(reass);
+		idx = reass - reassembly;
 	}
 
-	return false;
+	net_ipaddr_copy(&reass->src, src);
+	net_ipaddr_copy(&reass->dst, dst);
+
+	reass->id = id;
+	reass->pkt = NULL;
+	reass->start = k_uptime_get_32();
+	reass->len = 0;
+	reass->received = 0;
+	reass->mem = 0;
+	reass->used = true;
+
+	/* The bucket could have been changed by the eviction */
+	bucket = reassembly_bucket(id, src, dst);
+	reass->next = *bucket;
+	*bucket = idx;
+
+	k_delayed_work_submit(&reass->timer, IPV6_REASSEMBLY_TIMEOUT);
+
+	return reass;
 }
 
-static void reassembly_info(char *str, struct net_ipv6_reassembly *reass)
+/* Make room for mem bytes of fragment buffers within the reassembly
+ * budget by giving up the oldest datagrams. Fails if the datagram the
+ * room is needed for is the oldest one.
+ */
+static bool reassembly_reserve(struct net_ipv6_reassembly *reass, u16_t mem)
 {
-	char out[NET_IPV6_ADDR_LEN];
-	int i, len;
-
-	snprintk(out, sizeof(out), "%s", net_sprint_ipv6_addr(&reass->dst));
+	struct net_ipv6_reassembly *oldest;
 
-	for (i = 0, len = 0; i < NET_IPV6_FRAGMENTS_MAX_PKT; i++) {
-		if (!reass->pkt[i]) {
-			continue;
+	while (reassembly_stats.mem + mem > CONFIG_NET_IPV6_FRAGMENT_MAX_MEM) {
+		oldest = reassembly_oldest();
+		if (oldest == reass) {
+			return false;
 		}
 
-		len += net_pkt_get_len(reass->pkt[i]);
+		reassembly_evict(oldest);
 	}
 
-	NET_DBG("%s id 0x%x src %s dst %s remain %d ms len %d",
-		str, reass->id, net_sprint_ipv6_addr(&reass->src), out,
-		k_delayed_work_remaining_get(&reass->timer), len);
+	return true;
 }
 
 static void reassembly_timeout(struct k_work *work)
@@ -3207,87 +3295,73 @@ static void reassembly_timeout(struct k_work *work)
 
 	reassembly_info("Reassembly cancelled", reass);
 
-	reassembly_cancel(reass->id, &reass->src, &reass->dst);
+	reassembly_stats.timeouts++;
+	reassembly_free(reass);
+}
+
+/* Number of payload bytes in a pending fragment */
+static u16_t fragment_len(struct net_pkt *pkt)
+{
+	u16_t len = net_pkt_get_len(pkt);
+
+	if (!net_pkt_ipv6_fragment_offset(pkt)) {
+		len -= net_pkt_ipv6_fragment_start(pkt) +
+			sizeof(struct net_ipv6_frag_hdr) - pkt->frags->data;
+	}
+
+	return len;
 }
 
 static void reassemble_packet(struct net_ipv6_reassembly *reass)
 {
-	struct net_pkt *pkt;
+	struct net_pkt *pkt, *next;
 	struct net_buf *last;
+	u8_t *frag_start;
 	u8_t next_hdr;
-	int i, len, ret;
+	int len, ret;
 	u16_t pos;
 
-	k_delayed_work_cancel(&reass->timer);
+	reassembly_info("Reassembly last pkt", reass);
 
-	NET_ASSERT(reass->pkt[0]);
+	pkt = reass->pkt;
+	reass->pkt = NULL;
 
-	last = net_buf_frag_last(reass->pkt[0]->frags);
+	NET_ASSERT(pkt && !net_pkt_ipv6_fragment_offset(pkt));
 
-	/* We start from 2nd packet which is then appended to
-	 * the first one.
+	/* The other fragments only hold payload, link their buffers to
+	 * the end of the first one.
 	 */
-	for (i = 1; i < NET_IPV6_FRAGMENTS_MAX_PKT; i++) {
-		int removed_len;
-
-		pkt = reass->pkt[i];
-
-		/* Get rid of IPv6 and fragment header which are at
-		 * the beginning of the fragment.
-		 */
-		removed_len = net_pkt_ipv6_fragment_start(pkt) +
-			sizeof(struct net_ipv6_frag_hdr) -
-			pkt->frags->data;
-
-		NET_DBG("Removing %d bytes from start of pkt %p",
-			removed_len, pkt->frags);
+	last = net_buf_frag_last(pkt->frags);
 
-		NET_ASSERT(removed_len >= (sizeof(struct net_ipv6_hdr) +
-					   sizeof(struct net_ipv6_frag_hdr)));
+	while (pkt->ipv6_frag_next) {
+		next = pkt->ipv6_frag_next;
+		pkt->ipv6_frag_next = next->ipv6_frag_next;
 
-		net_buf_pull(pkt->frags, removed_len);
+		last->frags = next->frags;
+		last = net_buf_frag_last(next->frags);
 
-		/* Attach the data to previous pkt */
-		last->frags = pkt->frags;
-		last = net_buf_frag_last(pkt->frags);
-
-		pkt->frags = NULL;
-		reass->pkt[i] = NULL;
-
-		net_pkt_unref(pkt);
+		next->frags = NULL;
+		net_pkt_unref(next);
 	}
 
-	pkt = reass->pkt[0];
-	reass->pkt[0] = NULL;
-
-	/* Next we need to strip away the fragment header from the first packet
-	 * and set the various pointers and values in packet.
-	 */
-
-	next_hdr = net_pkt_ipv6_fragment_start(pkt)[0];
+	reassembly_stats.reassembled++;
+	reassembly_free(reass);
 
-	/* How much data we need to move in order to get rid of the
-	 * fragmentation header.
+	/* Next we need to strip away the fragment header from the first
+	 * packet. The headers in front of it are moved over it, so that
+	 * the payload can stay where it is.
 	 */
-	len = pkt->frags->len - sizeof(struct net_ipv6_frag_hdr) -
-		(net_pkt_ipv6_fragment_start(pkt) - pkt->frags->data);
+	frag_start = net_pkt_ipv6_fragment_start(pkt);
+	next_hdr = frag_start[0];
 
-	memmove(net_pkt_ipv6_fragment_start(pkt),
-		net_pkt_ipv6_fragment_start(pkt) +
-		sizeof(struct net_ipv6_frag_hdr), len);
+	memmove(pkt->frags->data + sizeof(struct net_ipv6_frag_hdr),
+		pkt->frags->data, frag_start - pkt->frags->data);
+	net_buf_pull(pkt->frags, sizeof(struct net_ipv6_frag_hdr));
 
 	/* This one updates the previous header's nexthdr value */
 	net_pkt_write_u8(pkt, pkt->frags, net_pkt_ipv6_hdr_prev(pkt),
 			  &pos, next_hdr);
 
-	pkt->frags->len -= sizeof(struct net_ipv6_frag_hdr);
-
-	if (!net_pkt_compact(pkt)) {
-		NET_ERR("Cannot compact reassembly packet %p", pkt);
-		net_pkt_unref(pkt);
-		return;
-	}
-
 	/* Fix the total length of the IPv6 packet. */
 	len = net_pkt_ipv6_ext_len(pkt);
 	if (len > 0) {
@@ -3321,7 +3395,7 @@ void net_ipv6_frag_foreach(net_ipv6_frag_cb_t cb, void *user_data)
 
 	for (i = 0; reassembly_init_done &&
 		     i < CONFIG_NET_IPV6_FRAGMENT_MAX_COUNT; i++) {
-		if (!k_delayed_work_remaining_get(&reassembly[i].timer)) {
+		if (!reassembly[i].used) {
 			continue;
 		}
 
@@ -3329,66 +3403,9 @@ void net_ipv6_frag_foreach(net_ipv6_frag_cb_t cb, void *user_data)
 	}
 }
 
-/* Verify that we have all the fragments received and in correct order.
- */
-static bool fragment_verify(struct net_ipv6_reassembly *reass)
-{
-	u16_t offset;
-	int i, prev_len;
-
-	prev_len = net_pkt_get_len(reass->pkt[0]);
-	offset = net_pkt_ipv6_fragment_offset(reass->pkt[0]);
-
-	NET_DBG("pkt %p offset %u", reass->pkt[0], offset);
-
-	if (offset != 0) {
-		return false;
-	}
-
-	for (i = 1; i < NET_IPV6_FRAGMENTS_MAX_PKT; i++) {
-		offset = net_pkt_ipv6_fragment_offset(reass->pkt[i]);
-
-		NET_DBG("pkt %p offset %u prev_len %d", reass->pkt[i],
-			offset, prev_len);
-
-		if (prev_len < offset) {
-			/* Something wrong with the offset value */
-			return false;
-		}
-
-		prev_len = net_pkt_get_len(reass->pkt[i]);
-	}
-
-	return true;
-}
-
-static int shift_packets(struct net_ipv6_reassembly *reass, int pos)
+void net_ipv6_frag_stats_get(struct net_ipv6_reassembly_stats *stats)
 {
-	int i;
-
-	for (i = pos + 1; i < NET_IPV6_FRAGMENTS_MAX_PKT; i++) {
-		if (!reass->pkt[i]) {
-			NET_DBG("Moving [%d] %p (offset 0x%x) to [%d]",
-				pos, reass->pkt[pos],
-				net_pkt_ipv6_fragment_offset(reass->pkt[pos]),
-				i);
-
-			/* Do we have enough space in packet array to make
-			 * the move?
-			 */
-			if (((i - pos) + 1) >
-			    (NET_IPV6_FRAGMENTS_MAX_PKT - i)) {
-				return -ENOMEM;
-			}
-
-			memmove(&reass->pkt[i], &reass->pkt[pos],
-				sizeof(void *) * (i - pos));
-
-			return 0;
-		}
-	}
-
-	return -EINVAL;
+	*stats = reassembly_stats;
 }
 
 static enum net_verdict handle_fragment_hdr(struct net_pkt *pkt,
@@ -3396,26 +3413,31 @@ static enum net_verdict handle_fragment_hdr(struct net_pkt *pkt,
 					    int total_len,
 					    u16_t buf_offset)
 {
-	struct net_ipv6_reassembly *reass = NULL;
-	u32_t id;
+	struct net_ipv6_reassembly *reass;
+	struct net_pkt *prev, **pos;
+	struct net_buf *buf;
+	u16_t hdr_len;
 	u16_t loc;
 	u16_t offset;
 	u16_t flag;
+	u16_t len;
+	u16_t mem;
 	u8_t nexthdr;
+	u32_t id;
 	u8_t more;
-	bool found;
-	int i;
 
 	if (!reassembly_init_done) {
-		/* Static initializing does not work here because of the array
-		 * so we must do it at runtime.
-		 */
-		for (i = 0; i < CONFIG_NET_IPV6_FRAGMENT_MAX_COUNT; i++) {
-			k_delayed_work_init(&reassembly[i].timer,
-					    reassembly_timeout);
-		}
+		reassembly_init();
+	}
 
-		reassembly_init_done = true;
+	/* The headers in front of the payload are cut off without copying
+	 * the payload, so they need to be in the first buffer.
+	 */
+	hdr_len = buf_offset + sizeof(struct net_ipv6_frag_hdr);
+	if (frag != pkt->frags || hdr_len > frag->len) {
+		NET_DBG("IPv6 fragment header not in 1st buffer, "
+			"dropping pkt %p", pkt);
+		return NET_DROP;
 	}
 
 	net_pkt_set_ipv6_fragment_start(pkt, frag->data + buf_offset);
@@ -3426,113 +3448,115 @@ static enum net_verdict handle_fragment_hdr(struct net_pkt *pkt,
 	frag = net_frag_read_be16(frag, loc, &loc, &flag);
 	frag = net_frag_read_be32(frag, loc, &loc, &id);
 	if (!frag && loc == 0xffff) {
-		goto drop;
-	}
-
-	reass = reassembly_get(id, &NET_IPV6_HDR(pkt)->src,
-			       &NET_IPV6_HDR(pkt)->dst);
-	if (!reass) {
-		NET_DBG("Cannot get reassembly slot, dropping pkt %p", pkt);
-		goto drop;
+		return NET_DROP;
 	}
 
 	offset = flag & 0xfff8;
 	more = flag & 0x01;
+	len = net_pkt_get_len(pkt) - hdr_len;
 
 	net_pkt_set_ipv6_fragment_offset(pkt, offset);
 
-	if (!reass->pkt[0]) {
-		NET_DBG("Storing pkt %p to slot %d offset 0x%x", pkt, 0,
-			offset);
-		reass->pkt[0] = pkt;
-
-		reassembly_info("Reassembly 1st pkt", reass);
+	if (!len || (u32_t)offset + len > 0xffff) {
+		NET_DBG("Invalid IPv6 fragment length %u offset 0x%x",
+			len, offset);
+		return NET_DROP;
+	}
 
-		/* Wait for more fragments to receive. */
-		goto accept;
+	if (more && len % 8) {
+		/* Fragment length is not multiple of 8, discard
+		 * the packet and send parameter problem error.
+		 */
+		net_icmpv6_send_error(pkt, NET_ICMPV6_PARAM_PROBLEM,
+				      NET_ICMPV6_PARAM_PROB_OPTION, 0);
+		return NET_DROP;
 	}
 
-	/* The fragments might come in wrong order so place them
-	 * in reassembly chain in correct order.
-	 */
-	for (i = 0, found = false; i < NET_IPV6_FRAGMENTS_MAX_PKT; i++) {
-		if (!reass->pkt[i]) {
-			NET_DBG("Storing pkt %p to slot %d offset 0x%x", pkt,
-				i, offset);
-			reass->pkt[i] = pkt;
-			found = true;
-			break;
-		}
+	reass = reassembly_get(id, &NET_IPV6_HDR(pkt)->src,
+			       &NET_IPV6_HDR(pkt)->dst);
 
-		if (net_pkt_ipv6_fragment_offset(reass->pkt[i]) < offset) {
-			continue;
+	if (!more) {
+		if (reass->len && reass->len != offset + len) {
+			goto cancel;
 		}
 
-		/* Make room for this fragment, if there is no room, then
-		 * discard the whole reassembly.
-		 */
-		if (shift_packets(reass, i)) {
+		reass->len = offset + len;
+	}
+
+	if (reass->len && offset + len > reass->len) {
+		goto cancel;
+	}
+
+	/* The fragments might come in wrong order so place them in the
+	 * chain by offset. Overlapping fragments are not allowed
+	 * (RFC 5722), the whole datagram is discarded then.
+	 */
+	for (prev = NULL, pos = &reass->pkt; *pos;
+	     prev = *pos, pos = &(*pos)->ipv6_frag_next) {
+		if (net_pkt_ipv6_fragment_offset(*pos) >= offset) {
 			break;
 		}
-
-		NET_DBG("Storing %p (offset 0x%x) to [%d]", pkt, offset, i);
-		reass->pkt[i] = pkt;
-		found = true;
-		break;
 	}
 
-	if (!found) {
-		/* We could not add this fragment into our saved fragment
-		 * list. We must discard the whole packet at this point.
-		 */
-		NET_DBG("No slots available for 0x%x", reass->id);
-		net_pkt_unref(pkt);
-		goto drop;
+	if ((prev && net_pkt_ipv6_fragment_offset(prev) +
+	     fragment_len(prev) > offset) ||
+	    (*pos && offset + len > net_pkt_ipv6_fragment_offset(*pos))) {
+		NET_DBG("Overlapping fragment offset 0x%x len %u", offset,
+			len);
+		goto cancel;
 	}
 
-	if (more) {
-		if (net_pkt_get_len(pkt) % 8) {
-			/* Fragment length is not multiple of 8, discard
-			 * the packet and send parameter problem error.
-			 */
-			net_icmpv6_send_error(pkt, NET_ICMPV6_PARAM_PROBLEM,
-					      NET_ICMPV6_PARAM_PROB_OPTION, 0);
-			goto drop;
+	/* Only the first fragment keeps its headers, the payload of the
+	 * others is linked in as it is when the packet is reassembled.
+	 */
+	if (offset) {
+		net_buf_pull(pkt->frags, hdr_len);
+
+		if (!pkt->frags->len) {
+			net_pkt_frag_del(pkt, NULL, pkt->frags);
 		}
+	}
 
-		reassembly_info("Reassembly nth pkt", reass);
+	for (buf = pkt->frags, mem = 0; buf; buf = buf->frags) {
+		mem += buf->size;
+	}
 
-		NET_DBG("More fragments to be received");
-		goto accept;
+	if (!reassembly_reserve(reass, mem)) {
+		NET_DBG("No room for %u bytes of fragments for 0x%x", mem,
+			reass->id);
+		goto cancel;
 	}
 
-	reassembly_info("Reassembly last pkt", reass);
+	NET_DBG("Storing pkt %p offset 0x%x len %u", pkt, offset, len);
 
-	if (!fragment_verify(reass)) {
-		NET_DBG("Reassembled IPv6 verify failed, dropping id %u",
-			reass->id);
+	pkt->ipv6_frag_next = *pos;
+	*pos = pkt;
 
-		/* Let the caller release the already inserted pkt */
-		if (i < NET_IPV6_FRAGMENTS_MAX_PKT) {
-			reass->pkt[i] = NULL;
-		}
+	reass->received += len;
+	reass->mem += mem;
 
-		net_pkt_unref(pkt);
-		goto drop;
+	reassembly_stats.mem += mem;
+	if (reassembly_stats.mem > reassembly_stats.mem_peak) {
+		reassembly_stats.mem_peak = reassembly_stats.mem;
+	}
+
+	if (reass->received != reass->len) {
+		reassembly_info("Reassembly nth pkt", reass);
+
+		NET_DBG("More fragments to be received");
+		return NET_OK;
 	}
 
-	/* The last fragment received, reassemble the packet */
+	/* Nothing overlaps, so all the payload is there */
 	reassemble_packet(reass);
 
-accept:
 	return NET_OK;
 
-drop:
-	if (reass) {
-		if (reassembly_cancel(reass->id, &reass->src, &reass->dst)) {
-			return NET_OK;
-		}
-	}
+cancel:
+	NET_DBG("Dropping IPv6 reassembly id 0x%x", reass->id);
+
+	reassembly_stats.dropped++;
+	reassembly_free(reass);
 
 	return NET_DROP;
 }
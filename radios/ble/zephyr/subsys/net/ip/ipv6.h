@@ -362,14 +362,6 @@ static inline void net_ipv6_nbr_set_reachable_timer(struct net_if *iface,
 #endif
 
 #if defined(CONFIG_NET_IPV6_FRAGMENT)
-/* We do not have to accept larger than 1500 byte IPv6 packet (RFC 2460 ch 5).
- * This means that we should receive everything within first two fragments.
- * The first one being 1280 bytes and the second one 220 bytes.
- */
-#if !defined(NET_IPV6_FRAGMENTS_MAX_PKT)
-#define NET_IPV6_FRAGMENTS_MAX_PKT 2
-#endif
-
 /** Store pending IPv6 fragment information that is needed for reassembly. */
 struct net_ipv6_reassembly {
 	/** IPv6 source address of the fragment */
@@ -378,19 +370,66 @@ struct net_ipv6_reassembly {
 	/** IPv6 destination address of the fragment */
 	struct in6_addr dst;
 
+	/** Timeout for cancelling the reassembly. */
+	struct k_delayed_work timer;
+
 	/**
-	 * Timeout for cancelling the reassembly. The timer is used
-	 * also to detect if this reassembly slot is used or not.
+	 * Pending fragments sorted by offset and linked through
+	 * ipv6_frag_next. Only the fragment at offset 0 still has its
+	 * IPv6 headers, the others hold just their part of the payload.
 	 */
-	struct k_delayed_work timer;
+	struct net_pkt *pkt;
 
-	/** Pointers to pending fragments */
-	struct net_pkt *pkt[NET_IPV6_FRAGMENTS_MAX_PKT];
+	/** Uptime when the first fragment arrived, the oldest is evicted */
+	u32_t start;
 
 	/** IPv6 fragment identification */
 	u32_t id;
+
+	/** Payload length, known once the last fragment has arrived */
+	u16_t len;
+
+	/** Payload bytes received so far */
+	u16_t received;
+
+	/** Buffer memory held by the pending fragments */
+	u16_t mem;
+
+	/** Next reassembly in the same hash bucket, by index */
+	s8_t next;
+
+	/** Is this reassembly slot in use */
+	bool used;
 };
 
+/** IPv6 reassembly counters. */
+struct net_ipv6_reassembly_stats {
+	/** Datagrams reassembled and passed up */
+	u32_t reassembled;
+
+	/** Datagrams given up because fragments did not arrive in time */
+	u32_t timeouts;
+
+	/** Datagrams given up to make room for newer ones */
+	u32_t evicted;
+
+	/** Datagrams dropped because of overlapping or invalid fragments */
+	u32_t dropped;
+
+	/** Buffer memory held by pending fragments */
+	u16_t mem;
+
+	/** Highest value of mem */
+	u16_t mem_peak;
+};
+
+/**
+ * @brief Get IPv6 reassembly counters.
+ *
+ * @param stats Where to store the counters.
+ */
+void net_ipv6_frag_stats_get(struct net_ipv6_reassembly_stats *stats);
+
 /**
  * @typedef net_ipv6_frag_cb_t
  * @brief Callback used while iterating over pending IPv6 fragments.
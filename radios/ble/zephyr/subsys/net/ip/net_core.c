@@ -297,6 +297,7 @@ static void net_rx(struct net_if *iface, struct net_pkt *pkt)
 	NET_DBG("Received pkt %p len %zu", pkt, pkt_len);
 
 	net_stats_update_bytes_recv(iface, pkt_len);
+	net_stats_update_pkts_recv(iface);
 
 	processing_data(pkt, false);
 
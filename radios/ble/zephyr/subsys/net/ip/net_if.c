@@ -121,9 +121,16 @@ static inline void net_context_send_cb(struct net_context *context,
 static bool net_if_tx(struct net_if *iface, struct net_pkt *pkt)
 {
 	const struct net_if_api *api = net_if_get_device(iface)->driver_api;
+	u8_t ll_dst_addr[NET_LINK_ADDR_MAX_LENGTH];
+	struct net_linkaddr ll_dst = {
+		.addr = NULL
+	};
 	struct net_linkaddr *dst;
 	struct net_context *context;
 	void *context_token;
+#if defined(CONFIG_NET_STATISTICS)
+	u16_t pkt_len;
+#endif
 	int status;
 
 	if (!pkt) {
@@ -136,6 +143,21 @@ static bool net_if_tx(struct net_if *iface, struct net_pkt *pkt)
 	context = net_pkt_context(pkt);
 	context_token = net_pkt_token(pkt);
 
+	/* The driver owns the packet after a successful send, it can be
+	 * freed or, with loopback, already queued to the RX path. So
+	 * anything needed afterwards is copied out of it here.
+	 */
+#if defined(CONFIG_NET_STATISTICS)
+	pkt_len = pkt->total_pkt_len;
+#endif
+
+	if (dst->addr && dst->len <= sizeof(ll_dst_addr)) {
+		memcpy(ll_dst_addr, dst->addr, dst->len);
+		ll_dst.addr = ll_dst_addr;
+		ll_dst.len = dst->len;
+		ll_dst.type = dst->type;
+	}
+
 	if (atomic_test_bit(iface->if_dev->flags, NET_IF_UP)) {
 		if (IS_ENABLED(CONFIG_NET_TCP)) {
 			net_pkt_set_sent(pkt, true);
@@ -156,7 +178,8 @@ static bool net_if_tx(struct net_if *iface, struct net_pkt *pkt)
 
 		net_pkt_unref(pkt);
 	} else {
-		net_stats_update_bytes_sent(iface, pkt->total_pkt_len);
+		net_stats_update_bytes_sent(iface, pkt_len);
+		net_stats_update_pkts_sent(iface);
 	}
 
 	if (context) {
@@ -166,8 +189,8 @@ static bool net_if_tx(struct net_if *iface, struct net_pkt *pkt)
 		net_context_send_cb(context, context_token, status);
 	}
 
-	if (dst->addr) {
-		net_if_call_link_cb(iface, dst, status);
+	if (ll_dst.addr) {
+		net_if_call_link_cb(iface, &ll_dst, status);
 	}
 
 	return true;
@@ -65,9 +65,11 @@
 
 /* Make sure that IP + TCP/UDP header fit into one
  * fragment. This makes possible to cast a protocol header
- * struct into memory area.
+ * struct into memory area. The smallest size class of variable
+ * sized fragments always has room for them.
  */
-#if CONFIG_NET_BUF_DATA_SIZE < (IP_PROTO_LEN + APP_PROTO_LEN)
+#if !defined(CONFIG_NET_BUF_VARIABLE_DATA_SIZE) && \
+	CONFIG_NET_BUF_DATA_SIZE < (IP_PROTO_LEN + APP_PROTO_LEN)
 #if defined(STRING2)
 #undef STRING2
 #endif
@@ -84,6 +86,11 @@
 NET_PKT_SLAB_DEFINE(rx_pkts, CONFIG_NET_PKT_RX_COUNT);
 NET_PKT_SLAB_DEFINE(tx_pkts, CONFIG_NET_PKT_TX_COUNT);
 
+#if defined(CONFIG_NET_BUF_VARIABLE_DATA_SIZE) && \
+	(CONFIG_NET_BUF_DATA_POOL_SIZE % NET_PKT_FRAG_LARGE)
+#error "CONFIG_NET_BUF_DATA_POOL_SIZE must be a multiple of 2048"
+#endif
+
 /* The data fragment pool is for storing network data. */
 NET_PKT_DATA_POOL_DEFINE(rx_bufs, CONFIG_NET_BUF_RX_COUNT);
 NET_PKT_DATA_POOL_DEFINE(tx_bufs, CONFIG_NET_BUF_TX_COUNT);
@@ -335,16 +342,48 @@ struct net_pkt *net_pkt_get_reserve(struct k_mem_slab *slab,
 	return pkt;
 }
 
+#if defined(CONFIG_NET_BUF_VARIABLE_DATA_SIZE)
+/* Round the request up to the usable size of its class, so the part of
+ * the buddy block that would otherwise be left over becomes tailroom.
+ */
+static size_t frag_class_size(size_t size)
+{
+	if (size <= NET_PKT_FRAG_SMALL - NET_PKT_FRAG_OVERHEAD) {
+		return NET_PKT_FRAG_SMALL - NET_PKT_FRAG_OVERHEAD;
+	}
+
+	if (size <= NET_PKT_FRAG_MEDIUM - NET_PKT_FRAG_OVERHEAD) {
+		return NET_PKT_FRAG_MEDIUM - NET_PKT_FRAG_OVERHEAD;
+	}
+
+	return NET_PKT_FRAG_LARGE - NET_PKT_FRAG_OVERHEAD;
+}
+#endif
+
+static struct net_buf *pkt_data_alloc(struct net_buf_pool *pool, size_t size,
+				      s32_t timeout)
+{
+#if defined(CONFIG_NET_BUF_VARIABLE_DATA_SIZE)
+	/* Per-context pools might still be plain fixed size pools */
+	if (pool->alloc->cb != &net_buf_fixed_cb) {
+		return net_buf_alloc_len(pool, frag_class_size(size), timeout);
+	}
+#else
+	ARG_UNUSED(size);
+#endif
+
+	return net_buf_alloc(pool, timeout);
+}
+
 #if defined(CONFIG_NET_DEBUG_NET_PKT)
-struct net_buf *net_pkt_get_reserve_data_debug(struct net_buf_pool *pool,
-					       u16_t reserve_head,
-					       s32_t timeout,
-					       const char *caller,
-					       int line)
+static struct net_buf *pkt_get_reserve_data(struct net_buf_pool *pool,
+					    u16_t reserve_head, size_t size,
+					    s32_t timeout,
+					    const char *caller, int line)
 #else /* CONFIG_NET_DEBUG_NET_PKT */
-struct net_buf *net_pkt_get_reserve_data(struct net_buf_pool *pool,
-					 u16_t reserve_head,
-					 s32_t timeout)
+static struct net_buf *pkt_get_reserve_data(struct net_buf_pool *pool,
+					    u16_t reserve_head, size_t size,
+					    s32_t timeout)
 #endif /* CONFIG_NET_DEBUG_NET_PKT */
 {
 	struct net_buf *frag;
@@ -355,9 +394,9 @@ struct net_buf *net_pkt_get_reserve_data(struct net_buf_pool *pool,
 	 */
 
 	if (k_is_in_isr()) {
-		frag = net_buf_alloc(pool, K_NO_WAIT);
+		frag = pkt_data_alloc(pool, size, K_NO_WAIT);
 	} else {
-		frag = net_buf_alloc(pool, timeout);
+		frag = pkt_data_alloc(pool, size, timeout);
 	}
 
 	if (!frag) {
@@ -371,61 +410,93 @@ struct net_buf *net_pkt_get_reserve_data(struct net_buf_pool *pool,
 
 	net_pkt_alloc_add(frag, false, caller, line);
 
-	NET_DBG("%s (%s) [%d] frag %p reserve %u ref %d (%s():%d)",
+	NET_DBG("%s (%s) [%d] frag %p reserve %u size %u ref %d (%s():%d)",
 		pool2str(pool), pool->name, get_frees(pool),
-		frag, reserve_head, frag->ref, caller, line);
+		frag, reserve_head, frag->size, frag->ref, caller, line);
 #endif
 
 	return frag;
 }
 
-/* Get a fragment, try to figure out the pool from where to get
- * the data.
- */
 #if defined(CONFIG_NET_DEBUG_NET_PKT)
-struct net_buf *net_pkt_get_frag_debug(struct net_pkt *pkt,
-				       s32_t timeout,
-				       const char *caller, int line)
-#else
-struct net_buf *net_pkt_get_frag(struct net_pkt *pkt,
-				 s32_t timeout)
-#endif
+struct net_buf *net_pkt_get_reserve_data_debug(struct net_buf_pool *pool,
+					       u16_t reserve_head,
+					       s32_t timeout,
+					       const char *caller,
+					       int line)
+{
+	return pkt_get_reserve_data(pool, reserve_head,
+				    NET_PKT_FRAG_DEFAULT_SIZE, timeout,
+				    caller, line);
+}
+#else /* CONFIG_NET_DEBUG_NET_PKT */
+struct net_buf *net_pkt_get_reserve_data(struct net_buf_pool *pool,
+					 u16_t reserve_head,
+					 s32_t timeout)
+{
+	return pkt_get_reserve_data(pool, reserve_head,
+				    NET_PKT_FRAG_DEFAULT_SIZE, timeout);
+}
+#endif /* CONFIG_NET_DEBUG_NET_PKT */
+
+static struct net_buf_pool *pkt_data_pool(struct net_pkt *pkt)
 {
 #if defined(CONFIG_NET_CONTEXT_NET_PKT_POOL)
 	struct net_context *context;
 
 	context = net_pkt_context(pkt);
 	if (context && context->data_pool) {
-#if defined(CONFIG_NET_DEBUG_NET_PKT)
-		return net_pkt_get_reserve_data_debug(context->data_pool(),
-						      net_pkt_ll_reserve(pkt),
-						      timeout, caller, line);
-#else
-		return net_pkt_get_reserve_data(context->data_pool(),
-						net_pkt_ll_reserve(pkt),
-						timeout);
-#endif /* CONFIG_NET_DEBUG_NET_PKT */
+		return context->data_pool();
 	}
 #endif /* CONFIG_NET_CONTEXT_NET_PKT_POOL */
 
 	if (pkt->slab == &rx_pkts) {
-#if defined(CONFIG_NET_DEBUG_NET_PKT)
-		return net_pkt_get_reserve_rx_data_debug(
-			net_pkt_ll_reserve(pkt), timeout, caller, line);
-#else
-		return net_pkt_get_reserve_rx_data(net_pkt_ll_reserve(pkt),
-						   timeout);
-#endif
+		return &rx_bufs;
 	}
 
+	return &tx_bufs;
+}
+
+/* Get a fragment, try to figure out the pool from where to get
+ * the data.
+ */
 #if defined(CONFIG_NET_DEBUG_NET_PKT)
-	return net_pkt_get_reserve_tx_data_debug(net_pkt_ll_reserve(pkt),
-						 timeout, caller, line);
+struct net_buf *net_pkt_get_frag_debug(struct net_pkt *pkt,
+				       s32_t timeout,
+				       const char *caller, int line)
+{
+	return pkt_get_reserve_data(pkt_data_pool(pkt),
+				    net_pkt_ll_reserve(pkt),
+				    NET_PKT_FRAG_DEFAULT_SIZE, timeout,
+				    caller, line);
+}
+
+struct net_buf *net_pkt_get_frag_len_debug(struct net_pkt *pkt, size_t len,
+					   s32_t timeout,
+					   const char *caller, int line)
+{
+	return pkt_get_reserve_data(pkt_data_pool(pkt),
+				    net_pkt_ll_reserve(pkt),
+				    net_pkt_ll_reserve(pkt) + len, timeout,
+				    caller, line);
+}
 #else
-	return net_pkt_get_reserve_tx_data(net_pkt_ll_reserve(pkt),
-					   timeout);
-#endif
+struct net_buf *net_pkt_get_frag(struct net_pkt *pkt,
+				 s32_t timeout)
+{
+	return pkt_get_reserve_data(pkt_data_pool(pkt),
+				    net_pkt_ll_reserve(pkt),
+				    NET_PKT_FRAG_DEFAULT_SIZE, timeout);
+}
+
+struct net_buf *net_pkt_get_frag_len(struct net_pkt *pkt, size_t len,
+				     s32_t timeout)
+{
+	return pkt_get_reserve_data(pkt_data_pool(pkt),
+				    net_pkt_ll_reserve(pkt),
+				    net_pkt_ll_reserve(pkt) + len, timeout);
 }
+#endif
 
 #if defined(CONFIG_NET_DEBUG_NET_PKT)
 struct net_pkt *net_pkt_get_reserve_rx_debug(u16_t reserve_head,
@@ -952,7 +1023,7 @@ struct net_buf *net_pkt_copy(struct net_pkt *pkt, size_t amount,
 
 	orig = pkt->frags;
 
-	frag = net_pkt_get_frag(pkt, timeout);
+	frag = net_pkt_get_frag_len(pkt, reserve + amount, timeout);
 	if (!frag) {
 		return NULL;
 	}
@@ -1006,7 +1077,8 @@ struct net_buf *net_pkt_copy(struct net_pkt *pkt, size_t amount,
 				 * We must allocate a new one.
 				 */
 				struct net_buf *new_frag =
-					net_pkt_get_frag(pkt, timeout);
+					net_pkt_get_frag_len(pkt, amount,
+							     timeout);
 				if (!new_frag) {
 					net_pkt_frag_unref(first);
 					return NULL;
@@ -1206,7 +1278,7 @@ static inline u16_t net_pkt_append_bytes(struct net_pkt *pkt,
 			return added_len;
 		}
 
-		frag = net_pkt_get_frag(pkt, timeout);
+		frag = net_pkt_get_frag_len(pkt, len, timeout);
 		if (!frag) {
 			return added_len;
 		}
@@ -1218,8 +1290,56 @@ static inline u16_t net_pkt_append_bytes(struct net_pkt *pkt,
 	return 0;
 }
 
-u16_t net_pkt_append(struct net_pkt *pkt, u16_t len, const u8_t *data,
-		    s32_t timeout)
+#if defined(CONFIG_NET_CHKSUM_COPY)
+static u16_t net_pkt_append_bytes_chksum(struct net_pkt *pkt,
+					 const u8_t *value,
+					 u16_t len, s32_t timeout)
+{
+	struct net_buf *frag = net_buf_frag_last(pkt->frags);
+	u16_t added_len = 0;
+	u32_t sum = 0;
+
+	do {
+		u16_t count = min(len, net_buf_tailroom(frag));
+		u16_t chksum;
+
+		chksum = net_calc_chksum_copy(net_buf_add(frag, count),
+					      value, count);
+
+		/* Data appended at an odd offset sums byte swapped */
+		if (added_len & 1) {
+			chksum = (chksum << 8) | (chksum >> 8);
+		}
+
+		sum += chksum;
+		len -= count;
+		added_len += count;
+		value += count;
+
+		if (len == 0) {
+			break;
+		}
+
+		frag = net_pkt_get_frag_len(pkt, len, timeout);
+		if (!frag) {
+			break;
+		}
+
+		net_pkt_frag_add(pkt, frag);
+	} while (1);
+
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+
+	pkt->data_chksum = sum;
+	pkt->data_chksum_len = added_len;
+
+	return added_len;
+}
+#endif
+
+static u16_t pkt_append(struct net_pkt *pkt, u16_t len, const u8_t *data,
+			s32_t timeout, bool chksum)
 {
 	struct net_buf *frag;
 	struct net_context *ctx = NULL;
@@ -1230,7 +1350,7 @@ u16_t net_pkt_append(struct net_pkt *pkt, u16_t len, const u8_t *data,
 	}
 
 	if (!pkt->frags) {
-		frag = net_pkt_get_frag(pkt, timeout);
+		frag = net_pkt_get_frag_len(pkt, len, timeout);
 		if (!frag) {
 			return 0;
 		}
@@ -1260,7 +1380,18 @@ u16_t net_pkt_append(struct net_pkt *pkt, u16_t len, const u8_t *data,
 		}
 	}
 
+#if defined(CONFIG_NET_CHKSUM_COPY)
+	if (chksum) {
+		appended = net_pkt_append_bytes_chksum(pkt, data, len,
+						       timeout);
+	} else {
+		/* Whatever was summed before is no longer the tail */
+		pkt->data_chksum_len = 0;
+		appended = net_pkt_append_bytes(pkt, data, len, timeout);
+	}
+#else
 	appended = net_pkt_append_bytes(pkt, data, len, timeout);
+#endif
 
 	if (ctx) {
 		pkt->data_len -= appended;
@@ -1269,29 +1400,19 @@ u16_t net_pkt_append(struct net_pkt *pkt, u16_t len, const u8_t *data,
 	return appended;
 }
 
-/* Helper routine to retrieve single byte from fragment and move
- * offset. If required byte is last byte in fragment then return
- * next fragment and set offset = 0.
- */
-static inline struct net_buf *net_frag_read_byte(struct net_buf *frag,
-						 u16_t offset,
-						 u16_t *pos,
-						 u8_t *data)
+u16_t net_pkt_append(struct net_pkt *pkt, u16_t len, const u8_t *data,
+		    s32_t timeout)
 {
-	if (data) {
-		*data = frag->data[offset];
-	}
-
-	*pos = offset + 1;
-
-	if (*pos >= frag->len) {
-		*pos = 0;
-
-		return frag->frags;
-	}
+	return pkt_append(pkt, len, data, timeout, false);
+}
 
-	return frag;
+#if defined(CONFIG_NET_CHKSUM_COPY)
+u16_t net_pkt_append_chksum(struct net_pkt *pkt, u16_t len, const u8_t *data,
+			    s32_t timeout)
+{
+	return pkt_append(pkt, len, data, timeout, true);
 }
+#endif
 
 /* Helper function to adjust offset in net_frag_read() call
  * if given offset is more than current fragment length.
@@ -1320,25 +1441,40 @@ static inline struct net_buf *adjust_offset(struct net_buf *frag,
 struct net_buf *net_frag_read(struct net_buf *frag, u16_t offset,
 			      u16_t *pos, u16_t len, u8_t *data)
 {
-	u16_t copy = 0;
+	u16_t count;
 
 	frag = adjust_offset(frag, offset, pos);
 	if (!frag) {
 		goto error;
 	}
 
-	while (len-- > 0 && frag) {
+	/* Copy one contiguous span per fragment */
+	while (len > 0) {
+		count = min(len, frag->len - *pos);
+
 		if (data) {
-			frag = net_frag_read_byte(frag, *pos,
-						  pos, data + copy++);
-		} else {
-			frag = net_frag_read_byte(frag, *pos, pos, NULL);
+			memcpy(data, frag->data + *pos, count);
+			data += count;
 		}
 
-		/* Error: Still remaining length to be read, but no data. */
-		if (!frag && len) {
-			NET_ERR("Not enough data to read");
-			goto error;
+		*pos += count;
+		len -= count;
+
+		if (*pos >= frag->len) {
+			*pos = 0;
+			frag = frag->frags;
+
+			/* Error: Still remaining length to be read, but no
+			 * data.
+			 */
+			if (!frag && len) {
+				NET_ERR("Not enough data to read");
+				goto error;
+			}
+		}
+
+		if (!frag) {
+			break;
 		}
 	}
 
@@ -1872,6 +2008,181 @@ struct net_buf *net_frag_get_pos(struct net_pkt *pkt,
 	return frag;
 }
 
+/* Copy len bytes starting at frag/pos into data (or just skip them if data
+ * is NULL). On success frag/pos are moved past the data, to the start of
+ * the next fragment when the current one is exhausted.
+ */
+static int cursor_copy(struct net_buf **frag, u16_t *pos, u8_t *data,
+		       u16_t len)
+{
+	struct net_buf *cur = *frag;
+	u16_t offset = *pos;
+	u16_t count;
+
+	while (len > 0) {
+		if (!cur) {
+			return -ENODATA;
+		}
+
+		if (offset >= cur->len) {
+			cur = cur->frags;
+			offset = 0;
+			continue;
+		}
+
+		count = min(len, cur->len - offset);
+
+		if (data) {
+			memcpy(data, cur->data + offset, count);
+			data += count;
+		}
+
+		offset += count;
+		len -= count;
+	}
+
+	/* Keep the cursor at the end of the last fragment rather than
+	 * running off the chain, so that writes can append there.
+	 */
+	while (cur && offset >= cur->len && cur->frags) {
+		cur = cur->frags;
+		offset = 0;
+	}
+
+	*frag = cur;
+	*pos = offset;
+
+	return 0;
+}
+
+int net_pkt_cursor_skip(struct net_pkt_cursor *cursor, u16_t len)
+{
+	return cursor_copy(&cursor->frag, &cursor->pos, NULL, len);
+}
+
+int net_pkt_cursor_read(struct net_pkt_cursor *cursor, void *data,
+			u16_t len)
+{
+	return cursor_copy(&cursor->frag, &cursor->pos, data, len);
+}
+
+int net_pkt_cursor_peek(const struct net_pkt_cursor *cursor, void *data,
+			u16_t len)
+{
+	struct net_buf *frag = cursor->frag;
+	u16_t pos = cursor->pos;
+
+	return cursor_copy(&frag, &pos, data, len);
+}
+
+int net_pkt_cursor_read_be16(struct net_pkt_cursor *cursor, u16_t *value)
+{
+	u8_t *data = net_pkt_cursor_data(cursor, sizeof(u16_t));
+	u8_t v16[2];
+
+	if (data) {
+		/* Fast path, the value is not split between fragments */
+		*value = data[0] << 8 | data[1];
+		return net_pkt_cursor_skip(cursor, sizeof(u16_t));
+	}
+
+	if (net_pkt_cursor_read(cursor, v16, sizeof(v16))) {
+		return -ENODATA;
+	}
+
+	*value = v16[0] << 8 | v16[1];
+
+	return 0;
+}
+
+int net_pkt_cursor_read_be32(struct net_pkt_cursor *cursor, u32_t *value)
+{
+	u8_t *data = net_pkt_cursor_data(cursor, sizeof(u32_t));
+	u8_t v32[4];
+
+	if (data) {
+		*value = data[0] << 24 | data[1] << 16 | data[2] << 8 |
+			 data[3];
+		return net_pkt_cursor_skip(cursor, sizeof(u32_t));
+	}
+
+	if (net_pkt_cursor_read(cursor, v32, sizeof(v32))) {
+		return -ENODATA;
+	}
+
+	*value = v32[0] << 24 | v32[1] << 16 | v32[2] << 8 | v32[3];
+
+	return 0;
+}
+
+int net_pkt_cursor_write(struct net_pkt *pkt, struct net_pkt_cursor *cursor,
+			 const void *data, u16_t len, s32_t timeout)
+{
+	struct net_buf *frag = cursor->frag;
+	const u8_t *src = data;
+	u16_t pos = cursor->pos;
+	u16_t space, count;
+
+	while (len > 0) {
+		if (!frag) {
+			frag = net_pkt_get_frag(pkt, timeout);
+			if (!frag) {
+				return -ENOMEM;
+			}
+
+			net_pkt_frag_add(pkt, frag);
+			pos = 0;
+		}
+
+		/* Fragments in the middle of the chain are only overwritten,
+		 * the last one also grows into its tailroom.
+		 */
+		if (frag->frags) {
+			space = frag->len > pos ? frag->len - pos : 0;
+		} else {
+			space = frag->size - net_buf_headroom(frag) - pos;
+		}
+
+		if (!space) {
+			if (!frag->frags) {
+				struct net_buf *next;
+
+				next = net_pkt_get_frag(pkt, timeout);
+				if (!next) {
+					return -ENOMEM;
+				}
+
+				net_pkt_frag_add(pkt, next);
+			}
+
+			frag = frag->frags;
+			pos = 0;
+			continue;
+		}
+
+		count = min(len, space);
+		memcpy(frag->data + pos, src, count);
+
+		if (pos + count > frag->len) {
+			net_buf_add(frag, pos + count - frag->len);
+		}
+
+		src += count;
+		pos += count;
+		len -= count;
+	}
+
+	while (frag && pos >= frag->len && frag->frags) {
+		frag = frag->frags;
+		pos = 0;
+	}
+
+	cursor->frag = frag;
+	cursor->pos = pos;
+
+	return 0;
+}
+
 #if defined(CONFIG_NET_DEBUG_NET_PKT)
 static void too_short_msg(char *msg, struct net_pkt *pkt, u16_t offset,
 			  size_t extra_len)
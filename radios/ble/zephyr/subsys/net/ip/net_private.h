@@ -61,6 +61,35 @@ extern char *net_byte_to_hex(char *ptr, u8_t byte, char base, bool pad);
 extern char *net_sprint_ll_addr_buf(const u8_t *ll, u8_t ll_len,
 				    char *buf, int buflen);
 extern u16_t net_calc_chksum(struct net_pkt *pkt, u8_t proto);
+
+/* Copy len bytes from src to dst and return their one's complement sum,
+ * in host byte order and as if the data started at an even offset.
+ */
+extern u16_t net_calc_chksum_copy(u8_t *dst, const u8_t *src, u16_t len);
+
+/* Update a checksum field after one of the 16 bit words it covers was
+ * changed from old_val to new_val (RFC 1624, eqn. 3). All values must be
+ * in the same byte order, network or host.
+ */
+static inline u16_t net_chksum_update16(u16_t chksum, u16_t old_val,
+					u16_t new_val)
+{
+	u32_t sum = (u16_t)~chksum + (u16_t)~old_val + new_val;
+
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+
+	return ~sum;
+}
+
+static inline u16_t net_chksum_update32(u16_t chksum, u32_t old_val,
+					u32_t new_val)
+{
+	chksum = net_chksum_update16(chksum, old_val >> 16, new_val >> 16);
+
+	return net_chksum_update16(chksum, old_val, new_val);
+}
+
 bool net_header_fits(struct net_pkt *pkt, u8_t *hdr, size_t hdr_size);
 
 struct net_icmp_hdr *net_pkt_icmp_data(struct net_pkt *pkt);
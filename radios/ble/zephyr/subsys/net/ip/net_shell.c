@@ -647,6 +647,8 @@ static void net_shell_print_statistics(struct net_if *iface, void *user_data)
 
 	printk("Bytes received %u\n", GET_STAT(iface, bytes.received));
 	printk("Bytes sent     %u\n", GET_STAT(iface, bytes.sent));
+	printk("Pkts received  %u\n", GET_STAT(iface, pkts.rx));
+	printk("Pkts sent      %u\n", GET_STAT(iface, pkts.tx));
 	printk("Processing err %d\n", GET_STAT(iface, processing_error));
 
 #if NET_TC_COUNT > 1
@@ -894,7 +896,7 @@ static void ipv6_frag_cb(struct net_ipv6_reassembly *reass,
 {
 	int *count = user_data;
 	char src[ADDR_LEN];
-	int i;
+	struct net_pkt *pkt;
 
 	if (!*count) {
 		printk("\nIPv6 reassembly Id         Remain Src             \tDst\n");
@@ -906,23 +908,22 @@ static void ipv6_frag_cb(struct net_ipv6_reassembly *reass,
 	       reass, reass->id, k_delayed_work_remaining_get(&reass->timer),
 	       src, net_sprint_ipv6_addr(&reass->dst));
 
-	for (i = 0; i < NET_IPV6_FRAGMENTS_MAX_PKT; i++) {
-		if (reass->pkt[i]) {
-			struct net_buf *frag = reass->pkt[i]->frags;
+	for (pkt = reass->pkt; pkt; pkt = pkt->ipv6_frag_next) {
+		struct net_buf *frag = pkt->frags;
 
-			printk("[%d] pkt %p->", i, reass->pkt[i]);
+		printk("[0x%04x] pkt %p->", net_pkt_ipv6_fragment_offset(pkt),
+		       pkt);
 
-			while (frag) {
-				printk("%p", frag);
+		while (frag) {
+			printk("%p", frag);
 
-				frag = frag->frags;
-				if (frag) {
-					printk("->");
-				}
+			frag = frag->frags;
+			if (frag) {
+				printk("->");
 			}
-
-			printk("\n");
 		}
+
+		printk("\n");
 	}
 
 	(*count)++;
@@ -1344,6 +1345,19 @@ int net_shell_cmd_conn(int argc, char *argv[])
 	net_ipv6_frag_foreach(ipv6_frag_cb, &count);
 
 	/* Do not print anything if no fragments are pending atm */
+	{
+		struct net_ipv6_reassembly_stats stats;
+
+		net_ipv6_frag_stats_get(&stats);
+
+		if (stats.reassembled || stats.timeouts || stats.evicted ||
+		    stats.dropped) {
+			printk("\nIPv6 reassembly: %u done, %u timed out, "
+			       "%u evicted, %u dropped, mem %u peak %u bytes\n",
+			       stats.reassembled, stats.timeouts, stats.evicted,
+			       stats.dropped, stats.mem, stats.mem_peak);
+		}
+	}
 #endif
 
 	return 0;
@@ -1784,6 +1798,25 @@ static void context_info(struct net_context *context, void *user_data)
 #endif /* CONFIG_NET_CONTEXT_NET_PKT_POOL */
 }
 
+#if defined(CONFIG_NET_BUF_POOL_STATS)
+static void pool_stats_cb(struct net_buf_pool *pool, void *user_data)
+{
+	struct net_buf_pool_stats stats;
+
+	net_buf_pool_stats_get(pool, &stats);
+
+#if defined(CONFIG_NET_BUF_POOL_USAGE)
+	printk("%p\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%s\n", pool,
+	       pool->buf_count, stats.used, stats.peak, stats.allocs,
+	       stats.failures, stats.waits, stats.max_wait, pool->name);
+#else
+	printk("%p\t%u\t%u\t%u\t%u\t%u\t%u\t%u\n", pool,
+	       pool->buf_count, stats.used, stats.peak, stats.allocs,
+	       stats.failures, stats.waits, stats.max_wait);
+#endif
+}
+#endif /* CONFIG_NET_BUF_POOL_STATS */
+
 int net_shell_cmd_mem(int argc, char *argv[])
 {
 	struct k_mem_slab *rx, *tx;
@@ -1794,7 +1827,13 @@ int net_shell_cmd_mem(int argc, char *argv[])
 
 	net_pkt_get_info(&rx, &tx, &rx_data, &tx_data);
 
+#if defined(CONFIG_NET_BUF_VARIABLE_DATA_SIZE)
+	printk("Fragment length %d/%d/%d bytes from %d byte pools\n",
+	       NET_PKT_FRAG_SMALL, NET_PKT_FRAG_MEDIUM, NET_PKT_FRAG_LARGE,
+	       CONFIG_NET_BUF_DATA_POOL_SIZE);
+#else
 	printk("Fragment length %d bytes\n", CONFIG_NET_BUF_DATA_SIZE);
+#endif
 
 	printk("Network buffer pools:\n");
 
@@ -1835,6 +1874,15 @@ int net_shell_cmd_mem(int argc, char *argv[])
 		}
 	}
 
+#if defined(CONFIG_NET_BUF_POOL_STATS)
+	printk("\nBuffer pool statistics (all subsystems):\n");
+	printk("Address\t\tTotal\tUsed\tPeak\tAllocs\tFails\tWaits\t"
+	       "MaxWait%s\n",
+	       IS_ENABLED(CONFIG_NET_BUF_POOL_USAGE) ? "\tName" : "");
+
+	net_buf_pool_foreach(pool_stats_cb, NULL);
+#endif
+
 	return 0;
 }
 
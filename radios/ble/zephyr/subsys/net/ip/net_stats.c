@@ -182,6 +182,8 @@ static inline void stats(struct net_if *iface)
 
 		NET_INFO("Bytes received %u", GET_STAT(iface, bytes.received));
 		NET_INFO("Bytes sent     %u", GET_STAT(iface, bytes.sent));
+		NET_INFO("Pkts received  %u", GET_STAT(iface, pkts.rx));
+		NET_INFO("Pkts sent      %u", GET_STAT(iface, pkts.tx));
 		NET_INFO("Processing err %d",
 			 GET_STAT(iface, processing_error));
 
@@ -278,6 +280,10 @@ static int net_stats_get(u32_t mgmt_request, struct net_if *iface,
 		len_chk = sizeof(struct net_stats_bytes);
 		src = GET_STAT_ADDR(iface, bytes);
 		break;
+	case NET_REQUEST_STATS_CMD_GET_PKTS:
+		len_chk = sizeof(struct net_stats_pkts);
+		src = GET_STAT_ADDR(iface, pkts);
+		break;
 	case NET_REQUEST_STATS_CMD_GET_IP_ERRORS:
 		len_chk = sizeof(struct net_stats_ip_errors);
 		src = GET_STAT_ADDR(iface, ip_errors);
@@ -344,6 +350,9 @@ NET_MGMT_REGISTER_REQUEST_HANDLER(NET_REQUEST_STATS_GET_PROCESSING_ERROR,
 NET_MGMT_REGISTER_REQUEST_HANDLER(NET_REQUEST_STATS_GET_BYTES,
 				  net_stats_get);
 
+NET_MGMT_REGISTER_REQUEST_HANDLER(NET_REQUEST_STATS_GET_PKTS,
+				  net_stats_get);
+
 NET_MGMT_REGISTER_REQUEST_HANDLER(NET_REQUEST_STATS_GET_IP_ERRORS,
 				  net_stats_get);
 
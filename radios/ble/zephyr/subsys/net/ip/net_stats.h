@@ -57,12 +57,24 @@ static inline void net_stats_update_bytes_sent(struct net_if *iface,
 {
 	UPDATE_STAT(iface, stats.bytes.sent += bytes);
 }
+
+static inline void net_stats_update_pkts_recv(struct net_if *iface)
+{
+	UPDATE_STAT(iface, stats.pkts.rx++);
+}
+
+static inline void net_stats_update_pkts_sent(struct net_if *iface)
+{
+	UPDATE_STAT(iface, stats.pkts.tx++);
+}
 #else
 #define net_stats_update_processing_error(iface)
 #define net_stats_update_ip_errors_protoerr(iface)
 #define net_stats_update_ip_errors_vhlerr(iface)
 #define net_stats_update_bytes_recv(iface, bytes)
 #define net_stats_update_bytes_sent(iface, bytes)
+#define net_stats_update_pkts_recv(iface)
+#define net_stats_update_pkts_sent(iface)
 #endif /* CONFIG_NET_STATISTICS */
 
 #if defined(CONFIG_NET_STATISTICS_IPV6)
@@ -52,6 +52,8 @@ static struct tcp_backlog_entry {
 	u32_t send_seq;
 	u32_t send_ack;
 	u16_t send_mss;
+	s8_t send_wscale;
+	bool sack_permitted;
 	struct k_delayed_work ack_timer;
 } tcp_backlog[CONFIG_NET_TCP_BACKLOG_SIZE];
 
@@ -154,10 +156,15 @@ static void net_tcp_trace(struct net_pkt *pkt, struct net_tcp *tcp)
 #define net_tcp_trace(...)
 #endif /* CONFIG_NET_DEBUG_TCP */
 
+#if defined(CONFIG_NET_TCP_CONGESTION_CONTROL)
+#define tcp_rto(tcp) ((tcp)->rto)
+#else
+#define tcp_rto(tcp) CONFIG_NET_TCP_INIT_RETRANSMISSION_TIMEOUT
+#endif
+
 static inline u32_t retry_timeout(const struct net_tcp *tcp)
 {
-	return ((u32_t)1 << tcp->retry_timeout_shift) *
-				CONFIG_NET_TCP_INIT_RETRANSMISSION_TIMEOUT;
+	return ((u32_t)1 << tcp->retry_timeout_shift) * tcp_rto(tcp);
 }
 
 #define is_6lo_technology(pkt)						    \
@@ -200,6 +207,83 @@ static void abort_connection(struct net_tcp *tcp)
 	net_context_unref(ctx);
 }
 
+/* Send a segment of the sent list again */
+static void resend_pkt(struct net_tcp *tcp, struct net_pkt *pkt)
+{
+	if (net_pkt_sent(pkt)) {
+		do_ref_if_needed(tcp, pkt);
+		net_pkt_set_sent(pkt, false);
+	}
+
+	net_pkt_set_queued(pkt, true);
+
+	if (net_tcp_send_pkt(pkt) < 0 && !is_6lo_technology(pkt)) {
+		NET_DBG("retry %u: [%p] pkt %p send failed",
+			tcp->retry_timeout_shift, tcp, pkt);
+		net_pkt_unref(pkt);
+	} else {
+		NET_DBG("retry %u: [%p] sent pkt %p",
+			tcp->retry_timeout_shift, tcp, pkt);
+		if (IS_ENABLED(CONFIG_NET_STATISTICS_TCP) &&
+		    !is_6lo_technology(pkt)) {
+			net_stats_update_tcp_seg_rexmit(net_pkt_iface(pkt));
+		}
+	}
+}
+
+#if defined(CONFIG_NET_TCP_CONGESTION_CONTROL)
+#define MAX_RTO K_SECONDS(60)
+
+/* Bytes sent and not acknowledged yet */
+static u32_t flight_size(struct net_tcp *tcp)
+{
+	struct net_pkt *pkt;
+	u32_t flight = 0;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&tcp->sent_list, pkt, sent_list) {
+		if (net_pkt_queued(pkt) || net_pkt_sent(pkt)) {
+			flight += net_pkt_appdatalen(pkt);
+		}
+	}
+
+	return flight;
+}
+
+/* Retransmission timeout, RFC 5681 chapter 3.1 and RFC 6582 chapter 4.
+ * Everything after the first segment is sent again as the congestion
+ * window opens up.
+ */
+static void congestion_timeout(struct net_tcp *tcp)
+{
+	struct net_pkt *pkt;
+
+	/* The threshold is only lowered at the first timeout */
+	if (tcp->retry_timeout_shift == 1) {
+		tcp->ssthresh = max(flight_size(tcp) / 2, 2 * tcp->send_mss);
+	}
+
+	tcp->cwnd = tcp->send_mss;
+	tcp->recover = tcp->send_seq;
+	tcp->dupacks = 0;
+	tcp->in_recovery = 0;
+	tcp->rtt_active = 0;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&tcp->sent_list, pkt, sent_list) {
+		if (&pkt->sent_list == sys_slist_peek_head(&tcp->sent_list)) {
+			continue;
+		}
+
+		/* Packets the driver still holds count as sent */
+		if (net_pkt_sent(pkt) && !net_pkt_queued(pkt)) {
+			do_ref_if_needed(tcp, pkt);
+			net_pkt_set_sent(pkt, false);
+		}
+	}
+}
+#else
+#define congestion_timeout(...)
+#endif /* CONFIG_NET_TCP_CONGESTION_CONTROL */
+
 static void tcp_retry_expired(struct k_work *work)
 {
 	struct net_tcp *tcp = CONTAINER_OF(work, struct net_tcp, retry_timer);
@@ -218,29 +302,12 @@ static void tcp_retry_expired(struct k_work *work)
 
 		k_delayed_work_submit(&tcp->retry_timer, retry_timeout(tcp));
 
+		congestion_timeout(tcp);
+
 		pkt = CONTAINER_OF(sys_slist_peek_head(&tcp->sent_list),
 				   struct net_pkt, sent_list);
 
-		if (net_pkt_sent(pkt)) {
-			do_ref_if_needed(tcp, pkt);
-			net_pkt_set_sent(pkt, false);
-		}
-
-		net_pkt_set_queued(pkt, true);
-
-		if (net_tcp_send_pkt(pkt) < 0 && !is_6lo_technology(pkt)) {
-			NET_DBG("retry %u: [%p] pkt %p send failed",
-				tcp->retry_timeout_shift, tcp, pkt);
-			net_pkt_unref(pkt);
-		} else {
-			NET_DBG("retry %u: [%p] sent pkt %p",
-				tcp->retry_timeout_shift, tcp, pkt);
-			if (IS_ENABLED(CONFIG_NET_STATISTICS_TCP) &&
-			    !is_6lo_technology(pkt)) {
-				net_stats_update_tcp_seg_rexmit(
-							net_pkt_iface(pkt));
-			}
-		}
+		resend_pkt(tcp, pkt);
 	} else if (CONFIG_NET_TCP_TIME_WAIT_DELAY != 0) {
 		if (tcp->fin_sent && tcp->fin_rcvd) {
 			NET_DBG("[%p] Closing connection (context %p)",
@@ -274,9 +341,16 @@ struct net_tcp *net_tcp_alloc(struct net_context *context)
 	tcp_context[i].context = context;
 
 	tcp_context[i].send_seq = tcp_init_isn();
-	tcp_context[i].recv_wnd = min(NET_TCP_MAX_WIN, NET_TCP_BUF_MAX_LEN);
+	tcp_context[i].recv_wnd = CONFIG_NET_TCP_RECV_WINDOW;
+	tcp_context[i].send_wnd = NET_TCP_DEFAULT_MSS;
 	tcp_context[i].send_mss = NET_TCP_DEFAULT_MSS;
 
+#if defined(CONFIG_NET_TCP_CONGESTION_CONTROL)
+	tcp_context[i].rto = CONFIG_NET_TCP_INIT_RETRANSMISSION_TIMEOUT;
+	tcp_context[i].ssthresh = NET_TCP_MAX_WIN;
+	tcp_context[i].recover = tcp_context[i].send_seq;
+#endif
+
 	tcp_context[i].accept_cb = NULL;
 
 	k_delayed_work_init(&tcp_context[i].retry_timer, tcp_retry_expired);
@@ -321,6 +395,13 @@ int net_tcp_release(struct net_tcp *tcp)
 		net_pkt_unref(pkt);
 	}
 
+#if defined(CONFIG_NET_TCP_NAGLE)
+	if (tcp->unsent) {
+		net_pkt_unref(tcp->unsent);
+		tcp->unsent = NULL;
+	}
+#endif
+
 	retry_timer_cancel(tcp);
 	k_sem_reset(&tcp->connect_wait);
 
@@ -332,7 +413,7 @@ int net_tcp_release(struct net_tcp *tcp)
 	tcp->context = NULL;
 
 	key = irq_lock();
-	tcp->flags &= ~(NET_TCP_IN_USE | NET_TCP_RECV_MSS_SET);
+	tcp->flags &= ~NET_TCP_IN_USE;
 	irq_unlock(key);
 
 	NET_DBG("[%p] Disposed of TCP connection state", tcp);
@@ -375,6 +456,95 @@ static int finalize_segment(struct net_context *context, struct net_pkt *pkt)
 	return 0;
 }
 
+#if defined(CONFIG_NET_TCP_FAST_PATH)
+/* Once connected, the addresses, ports and the IP header fields of the
+ * segments sent to the peer do not change, so the first option-less
+ * segment's headers are saved and copied into the following ones.
+ */
+static bool hdr_template_match(struct net_tcp *tcp,
+			       struct tcp_segment *segment)
+{
+	struct net_tcp_hdr *tcp_hdr;
+
+	if (!tcp->hdr_len || segment->optlen ||
+	    segment->src_addr != &tcp->context->local) {
+		return false;
+	}
+
+	tcp_hdr = (struct net_tcp_hdr *)(tcp->hdr + tcp->hdr_len -
+					 NET_TCPH_LEN);
+
+#if defined(CONFIG_NET_IPV4)
+	if (segment->dst_addr->sa_family == AF_INET) {
+		struct net_ipv4_hdr *hdr = (struct net_ipv4_hdr *)tcp->hdr;
+
+		return tcp_hdr->dst_port ==
+				net_sin(segment->dst_addr)->sin_port &&
+			net_ipv4_addr_cmp(&hdr->dst,
+				&net_sin(segment->dst_addr)->sin_addr);
+	}
+#endif
+#if defined(CONFIG_NET_IPV6)
+	if (segment->dst_addr->sa_family == AF_INET6) {
+		struct net_ipv6_hdr *hdr = (struct net_ipv6_hdr *)tcp->hdr;
+
+		return tcp_hdr->dst_port ==
+				net_sin6(segment->dst_addr)->sin6_port &&
+			net_ipv6_addr_cmp(&hdr->dst,
+				&net_sin6(segment->dst_addr)->sin6_addr);
+	}
+#endif
+
+	return false;
+}
+
+static void hdr_template_save(struct net_tcp *tcp,
+			      struct tcp_segment *segment,
+			      struct net_pkt *pkt,
+			      struct net_tcp_hdr *tcp_hdr)
+{
+	u8_t ip_hdr_len = net_pkt_ip_hdr_len(pkt);
+
+	if (tcp->hdr_len || segment->optlen ||
+	    segment->src_addr != &tcp->context->local ||
+	    net_tcp_get_state(tcp) != NET_TCP_ESTABLISHED ||
+	    pkt->frags->len != ip_hdr_len) {
+		return;
+	}
+
+	memcpy(tcp->hdr, pkt->frags->data, ip_hdr_len);
+	memcpy(tcp->hdr + ip_hdr_len, tcp_hdr, NET_TCPH_LEN);
+	tcp->hdr_len = ip_hdr_len + NET_TCPH_LEN;
+}
+
+static struct net_tcp_hdr *hdr_template_apply(struct net_tcp *tcp,
+					      struct net_pkt *pkt)
+{
+	u8_t ip_hdr_len = tcp->hdr_len - NET_TCPH_LEN;
+	struct net_buf *header;
+
+	header = net_pkt_get_frag(pkt, ALLOC_TIMEOUT);
+	if (!header) {
+		return NULL;
+	}
+
+	net_pkt_frag_insert(pkt, header);
+	memcpy(net_buf_add(header, tcp->hdr_len), tcp->hdr, tcp->hdr_len);
+
+	net_pkt_set_family(pkt, net_context_get_family(tcp->context));
+	net_pkt_set_ip_hdr_len(pkt, ip_hdr_len);
+#if defined(CONFIG_NET_IPV6)
+	net_pkt_set_ipv6_ext_len(pkt, 0);
+#endif
+
+	return (struct net_tcp_hdr *)(header->data + ip_hdr_len);
+}
+#else
+#define hdr_template_match(...) false
+#define hdr_template_save(...)
+#define hdr_template_apply(...) NULL
+#endif /* CONFIG_NET_TCP_FAST_PATH */
+
 static int prepare_segment(struct net_tcp *tcp,
 			   struct tcp_segment *segment,
 			   struct net_pkt *pkt,
@@ -408,6 +578,16 @@ static int prepare_segment(struct net_tcp *tcp,
 		pkt_allocated = true;
 	}
 
+	if (hdr_template_match(tcp, segment)) {
+		tcp_hdr = hdr_template_apply(tcp, pkt);
+		if (!tcp_hdr) {
+			NET_WARN("[%p] Unable to alloc TCP header", tcp);
+			goto nomem;
+		}
+
+		goto fill;
+	}
+
 #if defined(CONFIG_NET_IPV4)
 	if (net_pkt_family(pkt) == AF_INET) {
 		net_ipv4_create(context, pkt,
@@ -446,13 +626,7 @@ static int prepare_segment(struct net_tcp *tcp,
 	header = net_pkt_get_data(context, ALLOC_TIMEOUT);
 	if (!header) {
 		NET_WARN("[%p] Unable to alloc TCP header", tcp);
-		if (pkt_allocated) {
-			net_pkt_unref(pkt);
-		} else {
-			pkt->frags = tail;
-		}
-
-		return -ENOMEM;
+		goto nomem;
 	}
 
 	net_pkt_frag_add(pkt, header);
@@ -464,16 +638,19 @@ static int prepare_segment(struct net_tcp *tcp,
 					segment->options);
 	}
 
-	tcp_hdr->offset = (NET_TCPH_LEN + optlen) << 2;
-
 	tcp_hdr->src_port = src_port;
 	tcp_hdr->dst_port = dst_port;
+	tcp_hdr->urg[0] = 0;
+	tcp_hdr->urg[1] = 0;
+
+fill:
+	tcp_hdr->offset = (NET_TCPH_LEN + optlen) << 2;
 	sys_put_be32(segment->seq, tcp_hdr->seq);
 	sys_put_be32(segment->ack, tcp_hdr->ack);
 	tcp_hdr->flags = segment->flags;
 	sys_put_be16(segment->wnd, tcp_hdr->wnd);
-	tcp_hdr->urg[0] = 0;
-	tcp_hdr->urg[1] = 0;
+
+	hdr_template_save(tcp, segment, pkt, tcp_hdr);
 
 	if (tail) {
 		net_pkt_frag_add(pkt, tail);
@@ -493,6 +670,19 @@ static int prepare_segment(struct net_tcp *tcp,
 	*out_pkt = pkt;
 
 	return 0;
+
+nomem:
+	if (pkt_allocated) {
+		net_pkt_unref(pkt);
+	} else {
+		if (pkt->frags) {
+			net_pkt_frag_unref(pkt->frags);
+		}
+
+		pkt->frags = tail;
+	}
+
+	return -ENOMEM;
 }
 
 u32_t net_tcp_get_recv_wnd(const struct net_tcp *tcp)
@@ -500,6 +690,22 @@ u32_t net_tcp_get_recv_wnd(const struct net_tcp *tcp)
 	return tcp->recv_wnd;
 }
 
+/* Window field of a segment. The window in SYN segments is never
+ * scaled (RFC 7323, chapter 2.2).
+ */
+static u16_t advertised_wnd(const struct net_tcp *tcp, u8_t flags)
+{
+	u32_t wnd = net_tcp_get_recv_wnd(tcp);
+
+#if defined(CONFIG_NET_TCP_WINDOW_SCALE)
+	if (!(flags & NET_TCP_SYN)) {
+		wnd >>= tcp->recv_wscale;
+	}
+#endif
+
+	return min(wnd, UINT16_MAX);
+}
+
 int net_tcp_prepare_segment(struct net_tcp *tcp, u8_t flags,
 			    void *options, size_t optlen,
 			    const struct sockaddr_ptr *local,
@@ -554,7 +760,7 @@ int net_tcp_prepare_segment(struct net_tcp *tcp, u8_t flags,
 		}
 	}
 
-	wnd = net_tcp_get_recv_wnd(tcp);
+	wnd = advertised_wnd(tcp, flags);
 
 	segment.src_addr = (struct sockaddr_ptr *)local;
 	segment.dst_addr = remote;
@@ -647,39 +853,159 @@ u16_t net_tcp_get_recv_mss(const struct net_tcp *tcp)
 	return 0;
 }
 
+#if defined(CONFIG_NET_TCP_WINDOW_SCALE)
+/* Smallest shift that lets the whole receive window be advertised */
+static u8_t recv_wscale(void)
+{
+	u8_t shift = 0;
+
+	while (shift < NET_TCP_MAX_WSCALE &&
+	       (CONFIG_NET_TCP_RECV_WINDOW >> shift) > UINT16_MAX) {
+		shift++;
+	}
+
+	return shift;
+}
+#endif
+
+/* Options of a SYN segment. A SYN-ACK only carries the options that
+ * were present in the SYN of the peer, given in peer.
+ */
 static void net_tcp_set_syn_opt(struct net_tcp *tcp, u8_t *options,
-				u8_t *optionlen)
+				u8_t *optionlen,
+				const struct net_tcp_options *peer)
 {
-	u32_t recv_mss;
+	u32_t opt;
 
 	*optionlen = 0;
 
-	if (!(tcp->flags & NET_TCP_RECV_MSS_SET)) {
-		recv_mss = net_tcp_get_recv_mss(tcp);
-		tcp->flags |= NET_TCP_RECV_MSS_SET;
+	opt = net_tcp_get_recv_mss(tcp);
+	if (opt) {
+		opt |= (NET_TCP_MSS_OPT << 24) | (NET_TCP_MSS_SIZE << 16);
+		UNALIGNED_PUT(htonl(opt), (u32_t *)(options + *optionlen));
+		*optionlen += NET_TCP_MSS_SIZE;
+	}
+
+#if defined(CONFIG_NET_TCP_WINDOW_SCALE)
+	if (!peer || peer->wscale >= 0) {
+		opt = (NET_TCP_NOP_OPT << 24) |
+		      (NET_TCP_WINDOW_SCALE_OPT << 16) |
+		      (NET_TCP_WINDOW_SCALE_SIZE << 8) | recv_wscale();
+		UNALIGNED_PUT(htonl(opt), (u32_t *)(options + *optionlen));
+		*optionlen += NET_TCP_NOP_SIZE + NET_TCP_WINDOW_SCALE_SIZE;
+	}
+#endif
+
+#if defined(CONFIG_NET_TCP_SACK)
+	if (!peer || peer->sack_permitted) {
+		opt = (NET_TCP_NOP_OPT << 24) | (NET_TCP_NOP_OPT << 16) |
+		      (NET_TCP_SACK_PERMITTED_OPT << 8) |
+		      NET_TCP_SACK_PERMITTED_SIZE;
+		UNALIGNED_PUT(htonl(opt), (u32_t *)(options + *optionlen));
+		*optionlen += 2 * NET_TCP_NOP_SIZE +
+			      NET_TCP_SACK_PERMITTED_SIZE;
+	}
+#endif
+}
+
+#if defined(CONFIG_NET_TCP_CONGESTION_CONTROL)
+/* Initial congestion window, RFC 5681 chapter 3.1 */
+static u32_t initial_cwnd(u16_t mss)
+{
+	if (mss > 2190) {
+		return 2 * mss;
+	} else if (mss > 1095) {
+		return 3 * mss;
+	}
+
+	return 4 * mss;
+}
+#endif
+
+/* Apply what was negotiated in the SYN segments */
+static void set_peer_opts(struct net_tcp *tcp, u16_t mss, s8_t wscale,
+			  bool sack_permitted)
+{
+	tcp->send_mss = mss;
+
+#if defined(CONFIG_NET_TCP_WINDOW_SCALE)
+	if (wscale >= 0) {
+		tcp->send_wscale = wscale;
+		tcp->recv_wscale = recv_wscale();
 	} else {
-		recv_mss = 0;
+		tcp->send_wscale = 0;
+		tcp->recv_wscale = 0;
 	}
+#endif
 
-	recv_mss |= (NET_TCP_MSS_OPT << 24) | (NET_TCP_MSS_SIZE << 16);
-	UNALIGNED_PUT(htonl(recv_mss),
-		      (u32_t *)(options + *optionlen));
+	tcp->sack_permitted = IS_ENABLED(CONFIG_NET_TCP_SACK) && sack_permitted;
 
-	*optionlen += NET_TCP_MSS_SIZE;
+#if defined(CONFIG_NET_TCP_CONGESTION_CONTROL)
+	tcp->cwnd = initial_cwnd(mss);
+#endif
+}
+
+/* Options the peer sent in its SYN, as stored in the backlog entry of
+ * the half open connection. Without an entry none are assumed.
+ */
+static void tcp_backlog_peer_opts(struct net_tcp *tcp,
+				  const struct sockaddr *remote,
+				  struct net_tcp_options *opts)
+{
+	int i;
+
+	opts->wscale = -1;
+	opts->sack_permitted = false;
+
+	for (i = 0; i < CONFIG_NET_TCP_BACKLOG_SIZE; i++) {
+		if (tcp_backlog[i].tcp != tcp ||
+		    tcp_backlog[i].remote.sa_family != remote->sa_family) {
+			continue;
+		}
+
+#if defined(CONFIG_NET_IPV6)
+		if (remote->sa_family == AF_INET6 &&
+		    (net_sin6(&tcp_backlog[i].remote)->sin6_port !=
+		     net_sin6(remote)->sin6_port ||
+		     !net_ipv6_addr_cmp(
+			     &net_sin6(&tcp_backlog[i].remote)->sin6_addr,
+			     &net_sin6(remote)->sin6_addr))) {
+			continue;
+		}
+#endif
+
+#if defined(CONFIG_NET_IPV4)
+		if (remote->sa_family == AF_INET &&
+		    (net_sin(&tcp_backlog[i].remote)->sin_port !=
+		     net_sin(remote)->sin_port ||
+		     !net_ipv4_addr_cmp(
+			     &net_sin(&tcp_backlog[i].remote)->sin_addr,
+			     &net_sin(remote)->sin_addr))) {
+			continue;
+		}
+#endif
+
+		opts->wscale = tcp_backlog[i].send_wscale;
+		opts->sack_permitted = tcp_backlog[i].sack_permitted;
+
+		return;
+	}
 }
 
 int net_tcp_prepare_ack(struct net_tcp *tcp, const struct sockaddr *remote,
 			struct net_pkt **pkt)
 {
-	u8_t options[NET_TCP_MAX_OPT_SIZE];
+	struct net_tcp_options peer;
+	u8_t options[NET_TCP_MAX_SYN_OPT_SIZE];
 	u8_t optionlen;
 
 	switch (net_tcp_get_state(tcp)) {
 	case NET_TCP_SYN_RCVD:
 		/* In the SYN_RCVD state acknowledgment must be with the
-		 * SYN flag.
+		 * SYN flag, and carry the same options as the first SYN-ACK.
 		 */
-		net_tcp_set_syn_opt(tcp, options, &optionlen);
+		tcp_backlog_peer_opts(tcp, remote, &peer);
+		net_tcp_set_syn_opt(tcp, options, &optionlen, &peer);
 
 		return net_tcp_prepare_segment(tcp, NET_TCP_SYN | NET_TCP_ACK,
 					       options, optionlen, NULL, remote,
@@ -792,24 +1118,13 @@ const char *net_tcp_state_str(enum net_tcp_state state)
 	return "";
 }
 
-int net_tcp_queue_data(struct net_context *context, struct net_pkt *pkt)
+static int queue_segment(struct net_context *context, struct net_pkt *pkt)
 {
 	struct net_conn *conn = (struct net_conn *)context->conn_handler;
 	size_t data_len = net_pkt_get_len(pkt);
 	int ret;
 
-	NET_DBG("[%p] Queue %p len %zd", context->tcp, pkt, data_len);
-
-	if (net_context_get_state(context) != NET_CONTEXT_CONNECTED) {
-		return -ENOTCONN;
-	}
-
-	NET_ASSERT(context->tcp);
-	if (context->tcp->flags & NET_TCP_IS_SHUTDOWN) {
-		return -ESHUTDOWN;
-	}
-
-	net_pkt_set_appdatalen(pkt, net_pkt_get_len(pkt));
+	net_pkt_set_appdatalen(pkt, data_len);
 
 	/* Set PSH on all packets, our window is so small that there's
 	 * no point in the remote side trying to finesse things and
@@ -838,11 +1153,132 @@ int net_tcp_queue_data(struct net_context *context, struct net_pkt *pkt)
 	return 0;
 }
 
+#if defined(CONFIG_NET_TCP_NAGLE)
+static struct net_pkt *take_unsent(struct net_tcp *tcp)
+{
+	struct net_pkt *pkt;
+	int key;
+
+	key = irq_lock();
+	pkt = tcp->unsent;
+	tcp->unsent = NULL;
+	irq_unlock(key);
+
+	return pkt;
+}
+
+/* Send the data held back by the Nagle algorithm */
+static void flush_unsent(struct net_context *context)
+{
+	struct net_pkt *pkt = take_unsent(context->tcp);
+
+	if (!pkt) {
+		return;
+	}
+
+	if (queue_segment(context, pkt) < 0) {
+		NET_DBG("[%p] Cannot send held data %p", context->tcp, pkt);
+		net_pkt_unref(pkt);
+		return;
+	}
+
+	net_tcp_send_data(context, NULL, NULL, NULL);
+}
+
+/* Put the held data in front of the data in pkt. The caller still owns
+ * pkt, so it is the one that is kept.
+ */
+static void merge_unsent(struct net_pkt *pkt, struct net_pkt *unsent)
+{
+#if defined(CONFIG_NET_CHKSUM_COPY)
+	size_t unsent_len = net_pkt_get_len(unsent);
+
+	/* Both payload sums can be combined if they cover all the data */
+	if (unsent->data_chksum_len == unsent_len &&
+	    pkt->data_chksum_len == net_pkt_get_len(pkt)) {
+		u32_t sum = pkt->data_chksum;
+
+		if (unsent_len & 1) {
+			sum = ((sum & 0xff) << 8) | (sum >> 8);
+		}
+
+		sum += unsent->data_chksum;
+		sum = (sum & 0xffff) + (sum >> 16);
+
+		pkt->data_chksum = sum;
+		pkt->data_chksum_len += unsent_len;
+	}
+#endif
+
+	net_pkt_frag_insert(pkt, unsent->frags);
+	unsent->frags = NULL;
+	net_pkt_unref(unsent);
+}
+
+/* Returns true if pkt was held back */
+static bool nagle_hold(struct net_context *context, struct net_pkt *pkt)
+{
+	struct net_tcp *tcp = context->tcp;
+	struct net_pkt *unsent = take_unsent(tcp);
+
+	if (unsent) {
+		if (net_pkt_get_len(unsent) + net_pkt_get_len(pkt) >
+		    tcp->send_mss) {
+			if (queue_segment(context, unsent) < 0) {
+				net_pkt_unref(unsent);
+			}
+		} else {
+			merge_unsent(pkt, unsent);
+		}
+	}
+
+	if (net_pkt_get_len(pkt) >= tcp->send_mss ||
+	    sys_slist_is_empty(&tcp->sent_list)) {
+		return false;
+	}
+
+	tcp->unsent = pkt;
+
+	/* The last ACK might have arrived after the check above, in
+	 * which case nobody else is going to send this.
+	 */
+	if (sys_slist_is_empty(&tcp->sent_list)) {
+		flush_unsent(context);
+	}
+
+	return true;
+}
+#else
+#define flush_unsent(...)
+#define nagle_hold(...) false
+#endif /* CONFIG_NET_TCP_NAGLE */
+
+int net_tcp_queue_data(struct net_context *context, struct net_pkt *pkt)
+{
+	NET_DBG("[%p] Queue %p len %zd", context->tcp, pkt,
+		net_pkt_get_len(pkt));
+
+	if (net_context_get_state(context) != NET_CONTEXT_CONNECTED) {
+		return -ENOTCONN;
+	}
+
+	NET_ASSERT(context->tcp);
+	if (context->tcp->flags & NET_TCP_IS_SHUTDOWN) {
+		return -ESHUTDOWN;
+	}
+
+	if (nagle_hold(context, pkt)) {
+		return 0;
+	}
+
+	return queue_segment(context, pkt);
+}
+
 int net_tcp_send_pkt(struct net_pkt *pkt)
 {
 	struct net_context *ctx = net_pkt_context(pkt);
 	struct net_tcp_hdr hdr, *tcp_hdr;
-	bool calc_chksum = false;
+	u32_t ack;
 
 	tcp_hdr = net_tcp_get_hdr(pkt, &hdr);
 	if (!tcp_hdr) {
@@ -850,9 +1286,15 @@ int net_tcp_send_pkt(struct net_pkt *pkt)
 		return -EMSGSIZE;
 	}
 
-	if (sys_get_be32(tcp_hdr->ack) != ctx->tcp->send_ack) {
+	/* Only a few header words change here, so the checksum is updated
+	 * incrementally instead of reading the whole segment again.
+	 */
+	ack = sys_get_be32(tcp_hdr->ack);
+	if (ack != ctx->tcp->send_ack) {
 		sys_put_be32(ctx->tcp->send_ack, tcp_hdr->ack);
-		calc_chksum = true;
+		tcp_hdr->chksum = htons(net_chksum_update32(
+						ntohs(tcp_hdr->chksum), ack,
+						ctx->tcp->send_ack));
 	}
 
 	/* The data stream code always sets this flag, because
@@ -862,12 +1304,12 @@ int net_tcp_send_pkt(struct net_pkt *pkt)
 	 */
 	if (ctx->tcp->sent_ack != ctx->tcp->send_ack &&
 		(tcp_hdr->flags & NET_TCP_ACK) == 0) {
-		tcp_hdr->flags |= NET_TCP_ACK;
-		calc_chksum = true;
-	}
+		u16_t old = (tcp_hdr->offset << 8) | tcp_hdr->flags;
 
-	if (calc_chksum) {
-		net_tcp_set_chksum(pkt, pkt->frags);
+		tcp_hdr->flags |= NET_TCP_ACK;
+		tcp_hdr->chksum = htons(net_chksum_update16(
+						ntohs(tcp_hdr->chksum), old,
+						old | NET_TCP_ACK));
 	}
 
 	if (tcp_hdr->flags & NET_TCP_FIN) {
@@ -875,6 +1317,7 @@ int net_tcp_send_pkt(struct net_pkt *pkt)
 	}
 
 	ctx->tcp->sent_ack = ctx->tcp->send_ack;
+	ctx->tcp->segs_unacked = 0;
 
 	/* As we modified the header, we need to write it back.
 	 */
@@ -925,66 +1368,153 @@ int net_tcp_send_pkt(struct net_pkt *pkt)
 							net_pkt_iface(pkt));
 			}
 
-			return ret;
-		}
+			return ret;
+		}
+	}
+
+	return net_send_data(pkt);
+}
+
+static void restart_timer(struct net_tcp *tcp)
+{
+	if (!sys_slist_is_empty(&tcp->sent_list)) {
+		tcp->flags |= NET_TCP_RETRYING;
+		tcp->retry_timeout_shift = 0;
+		k_delayed_work_submit(&tcp->retry_timer, retry_timeout(tcp));
+	} else if (CONFIG_NET_TCP_TIME_WAIT_DELAY != 0) {
+		if (tcp->fin_sent && tcp->fin_rcvd) {
+			/* We know sent_list is empty, which means if
+			 * fin_sent is true it must have been ACKd
+			 */
+			k_delayed_work_submit(&tcp->retry_timer,
+					      CONFIG_NET_TCP_TIME_WAIT_DELAY);
+			net_context_ref(tcp->context);
+		}
+	} else {
+		k_delayed_work_cancel(&tcp->retry_timer);
+		tcp->flags &= ~NET_TCP_RETRYING;
+	}
+}
+
+#if defined(CONFIG_NET_TCP_CONGESTION_CONTROL)
+/* Smallest of the congestion window and the window of the peer */
+static u32_t send_window(struct net_tcp *tcp)
+{
+	return min(tcp->cwnd, tcp->send_wnd);
+}
+
+/* Start a round trip time measurement unless one is running already.
+ * Retransmitted data is not timed (Karn's algorithm).
+ */
+static void rtt_start(struct net_tcp *tcp, struct net_pkt *pkt)
+{
+	struct net_tcp_hdr hdr, *tcp_hdr;
+	u32_t seq;
+
+	if (tcp->rtt_active) {
+		return;
+	}
+
+	tcp_hdr = net_tcp_get_hdr(pkt, &hdr);
+	if (!tcp_hdr) {
+		return;
+	}
+
+	seq = sys_get_be32(tcp_hdr->seq);
+	if (net_tcp_seq_cmp(seq, tcp->recover) < 0) {
+		return;
 	}
 
-	return net_send_data(pkt);
+	tcp->rtt_seq = seq + net_pkt_appdatalen(pkt) +
+		       !!(tcp_hdr->flags & NET_TCP_FIN);
+	tcp->rtt_start = k_uptime_get_32();
+	tcp->rtt_active = 1;
 }
 
-static void restart_timer(struct net_tcp *tcp)
+/* Update the retransmission timeout with a new measurement, RFC 6298
+ * chapter 2. The clock granularity is 1 ms.
+ */
+static void rtt_update(struct net_tcp *tcp, u32_t rtt)
 {
-	if (!sys_slist_is_empty(&tcp->sent_list)) {
-		tcp->flags |= NET_TCP_RETRYING;
-		tcp->retry_timeout_shift = 0;
-		k_delayed_work_submit(&tcp->retry_timer, retry_timeout(tcp));
-	} else if (CONFIG_NET_TCP_TIME_WAIT_DELAY != 0) {
-		if (tcp->fin_sent && tcp->fin_rcvd) {
-			/* We know sent_list is empty, which means if
-			 * fin_sent is true it must have been ACKd
-			 */
-			k_delayed_work_submit(&tcp->retry_timer,
-					      CONFIG_NET_TCP_TIME_WAIT_DELAY);
-			net_context_ref(tcp->context);
-		}
+	if (!tcp->srtt) {
+		tcp->srtt = rtt << 3;
+		tcp->rttvar = rtt << 1;
 	} else {
-		k_delayed_work_cancel(&tcp->retry_timer);
-		tcp->flags &= ~NET_TCP_RETRYING;
+		s32_t delta = rtt - (tcp->srtt >> 3);
+
+		tcp->srtt += delta;
+
+		if (delta < 0) {
+			delta = -delta;
+		}
+
+		tcp->rttvar += delta - (tcp->rttvar >> 2);
 	}
+
+	tcp->rto = (tcp->srtt >> 3) + max(tcp->rttvar, 1);
+	tcp->rto = max(tcp->rto, CONFIG_NET_TCP_INIT_RETRANSMISSION_TIMEOUT);
+	tcp->rto = min(tcp->rto, MAX_RTO);
+
+	NET_DBG("[%p] RTT %u ms, SRTT %u ms, RTO %u ms", tcp, rtt,
+		tcp->srtt >> 3, tcp->rto);
 }
+#else
+#define send_window(...) UINT32_MAX
+#define rtt_start(...)
+#endif /* CONFIG_NET_TCP_CONGESTION_CONTROL */
 
-int net_tcp_send_data(struct net_context *context, net_context_send_cb_t cb,
-		      void *token, void *user_data)
+/* Send the packets of the sent list that have not been sent yet. The
+ * data in flight is kept within the send window, but one segment can
+ * always be sent.
+ */
+static void send_queued(struct net_tcp *tcp)
 {
+	u32_t wnd = send_window(tcp);
+	u32_t offset = 0;
 	struct net_pkt *pkt;
 
-	/* For now, just send all queued data synchronously.  Need to
-	 * add window handling and retry/ACK logic.
-	 */
-	SYS_SLIST_FOR_EACH_CONTAINER(&context->tcp->sent_list, pkt, sent_list) {
+	SYS_SLIST_FOR_EACH_CONTAINER(&tcp->sent_list, pkt, sent_list) {
+		u32_t len = net_pkt_appdatalen(pkt);
+
 		/* Do not resend packets that were sent by expire timer */
 		if (net_pkt_queued(pkt)) {
 			NET_DBG("[%p] Skipping pkt %p because it was already "
-				"sent.", context->tcp, pkt);
+				"sent.", tcp, pkt);
+			offset += len;
 			continue;
 		}
 
 		if (!net_pkt_sent(pkt)) {
 			int ret;
 
-			NET_DBG("[%p] Sending pkt %p (%zd bytes)", context->tcp,
+			if (offset && offset + len > wnd) {
+				NET_DBG("[%p] Send window %u full", tcp, wnd);
+				break;
+			}
+
+			NET_DBG("[%p] Sending pkt %p (%zd bytes)", tcp,
 				pkt, net_pkt_get_len(pkt));
 
+			rtt_start(tcp, pkt);
+
 			ret = net_tcp_send_pkt(pkt);
 			if (ret < 0 && !is_6lo_technology(pkt)) {
 				NET_DBG("[%p] pkt %p not sent (%d)",
-					context->tcp, pkt, ret);
+					tcp, pkt, ret);
 				net_pkt_unref(pkt);
 			}
 
 			net_pkt_set_queued(pkt, true);
 		}
+
+		offset += len;
 	}
+}
+
+int net_tcp_send_data(struct net_context *context, net_context_send_cb_t cb,
+		      void *token, void *user_data)
+{
+	send_queued(context->tcp);
 
 	/* Just make the callback synchronously even if it didn't
 	 * go over the wire.  In theory it would be nice to track
@@ -999,13 +1529,177 @@ int net_tcp_send_data(struct net_context *context, net_context_send_cb_t cb,
 	return 0;
 }
 
-bool net_tcp_ack_received(struct net_context *ctx, u32_t ack)
+#if defined(CONFIG_NET_TCP_CONGESTION_CONTROL)
+static bool sack_covered(const struct net_tcp_options *opts,
+			 u32_t start, u32_t end)
+{
+	int i;
+
+	for (i = 0; i < opts->sack_blocks; i++) {
+		if (net_tcp_seq_cmp(start, opts->sack[i].left) >= 0 &&
+		    net_tcp_seq_cmp(end, opts->sack[i].right) <= 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Retransmit the first segment from high_rxt on that the peer is missing.
+ * Without SACK blocks this is the first one, with them only holes below
+ * data that the peer has received are retransmitted.
+ */
+static void retransmit_hole(struct net_tcp *tcp,
+			    const struct net_tcp_options *opts)
+{
+	struct net_tcp_hdr hdr, *tcp_hdr;
+	struct net_pkt *pkt;
+	u32_t sacked = 0;
+	int i;
+
+	for (i = 0; opts && i < opts->sack_blocks; i++) {
+		if (!i || net_tcp_seq_greater(opts->sack[i].right, sacked)) {
+			sacked = opts->sack[i].right;
+		}
+	}
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&tcp->sent_list, pkt, sent_list) {
+		u32_t seq, end;
+
+		tcp_hdr = net_tcp_get_hdr(pkt, &hdr);
+		if (!tcp_hdr) {
+			continue;
+		}
+
+		seq = sys_get_be32(tcp_hdr->seq);
+		end = seq + net_pkt_appdatalen(pkt);
+
+		if (net_tcp_seq_cmp(seq, tcp->high_rxt) < 0) {
+			continue;
+		}
+
+		if (opts && opts->sack_blocks) {
+			if (net_tcp_seq_greater(end, sacked)) {
+				return;
+			}
+
+			if (sack_covered(opts, seq, end)) {
+				continue;
+			}
+		}
+
+		/* The driver has not let go of the previous copy yet */
+		if (net_pkt_queued(pkt) && !is_6lo_technology(pkt)) {
+			return;
+		}
+
+		resend_pkt(tcp, pkt);
+		tcp->high_rxt = end;
+
+		return;
+	}
+}
+
+/* Fast retransmit after three duplicate ACKs, RFC 5681 chapter 3.2 */
+static void enter_recovery(struct net_tcp *tcp, u32_t ack,
+			   const struct net_tcp_options *opts)
+{
+	u32_t flight = flight_size(tcp);
+
+	tcp->ssthresh = max(flight / 2, 2 * tcp->send_mss);
+	tcp->cwnd = tcp->ssthresh + 3 * tcp->send_mss;
+	tcp->recover = ack + flight;
+	tcp->high_rxt = ack;
+	tcp->in_recovery = 1;
+	tcp->rtt_active = 0;
+
+	NET_DBG("[%p] Fast retransmit at %u, ssthresh %u", tcp, ack,
+		tcp->ssthresh);
+
+	retransmit_hole(tcp, opts);
+}
+
+/* Update the congestion state for an acceptable ACK that acknowledges
+ * acked new bytes. Duplicate ACKs are as defined in RFC 5681, chapter 2.
+ */
+static void congestion_ack(struct net_tcp *tcp, u32_t ack, u32_t acked,
+			   bool dup, const struct net_tcp_options *opts)
+{
+	u16_t mss = tcp->send_mss;
+
+	if (tcp->rtt_active && net_tcp_seq_cmp(ack, tcp->rtt_seq) >= 0) {
+		rtt_update(tcp, k_uptime_get_32() - tcp->rtt_start);
+		tcp->rtt_active = 0;
+	}
+
+	if (dup) {
+		if (tcp->in_recovery) {
+			/* Each of these means a segment has left the network */
+			tcp->cwnd += mss;
+
+			if (opts && opts->sack_blocks) {
+				retransmit_hole(tcp, opts);
+			}
+		} else if (tcp->dupacks < 3 && ++tcp->dupacks == 3 &&
+			   net_tcp_seq_cmp(ack, tcp->recover) >= 0) {
+			enter_recovery(tcp, ack, opts);
+		}
+
+		return;
+	}
+
+	if (!acked) {
+		return;
+	}
+
+	tcp->dupacks = 0;
+
+	if (tcp->in_recovery) {
+		if (net_tcp_seq_cmp(ack, tcp->recover) >= 0) {
+			/* Full ACK, RFC 6582 chapter 3.2 step 3 */
+			tcp->cwnd = min(tcp->ssthresh, flight_size(tcp) + mss);
+			tcp->in_recovery = 0;
+		} else {
+			/* Partial ACK: the next segment got lost as well.
+			 * Deflate the window by the data that has left.
+			 */
+			tcp->cwnd -= min(tcp->cwnd - mss, acked);
+			if (acked >= mss) {
+				tcp->cwnd += mss;
+			}
+
+			retransmit_hole(tcp, opts);
+		}
+
+		return;
+	}
+
+	if (net_tcp_seq_greater(ack, tcp->recover)) {
+		tcp->recover = ack;
+	}
+
+	if (tcp->cwnd < tcp->ssthresh) {
+		/* Slow start, RFC 5681 chapter 3.1 */
+		tcp->cwnd += min(acked, mss);
+	} else {
+		/* Congestion avoidance, about one MSS per round trip */
+		tcp->cwnd += max(mss * mss / tcp->cwnd, 1);
+	}
+
+	tcp->cwnd = min(tcp->cwnd, NET_TCP_MAX_WIN);
+}
+#else
+#define congestion_ack(...)
+#endif /* CONFIG_NET_TCP_CONGESTION_CONTROL */
+
+static bool ack_received(struct net_context *ctx, u32_t ack, bool dup,
+			 const struct net_tcp_options *opts)
 {
 	struct net_tcp *tcp = ctx->tcp;
 	sys_slist_t *list = &ctx->tcp->sent_list;
 	sys_snode_t *head;
 	struct net_pkt *pkt;
-	u32_t seq;
+	u32_t seq, acked = 0;
 	bool valid_ack = false;
 
 	if (net_tcp_seq_greater(ack, ctx->tcp->send_seq)) {
@@ -1037,7 +1731,15 @@ bool net_tcp_ack_received(struct net_context *ctx, u32_t ack)
 
 		seq = sys_get_be32(tcp_hdr->seq) + net_pkt_appdatalen(pkt) - 1;
 
+		/* A FIN takes up one sequence number of its own */
+		if (tcp_hdr->flags & NET_TCP_FIN) {
+			seq++;
+		}
+
 		if (!net_tcp_seq_greater(ack, seq)) {
+			/* Only an ACK for the oldest data is a duplicate */
+			dup = dup && !valid_ack &&
+			      ack == sys_get_be32(tcp_hdr->seq);
 			break;
 		}
 
@@ -1051,11 +1753,17 @@ bool net_tcp_ack_received(struct net_context *ctx, u32_t ack)
 			}
 		}
 
+		acked += net_pkt_appdatalen(pkt);
+
 		sys_slist_remove(list, NULL, head);
 		net_pkt_unref(pkt);
 		valid_ack = true;
 	}
 
+	if (sys_slist_is_empty(list)) {
+		dup = false;
+	}
+
 	/* Restart the timer on a valid inbound ACK.  This isn't quite the
 	 * same behavior as per-packet retry timers, but is close in practice
 	 * (it starts retries one timer period after the connection
@@ -1066,9 +1774,24 @@ bool net_tcp_ack_received(struct net_context *ctx, u32_t ack)
 		restart_timer(ctx->tcp);
 	}
 
+	congestion_ack(tcp, ack, acked, dup, opts);
+
+	/* Everything is acknowledged, data held back can go now */
+	if (valid_ack && sys_slist_is_empty(list)) {
+		flush_unsent(ctx);
+	} else if (IS_ENABLED(CONFIG_NET_TCP_CONGESTION_CONTROL)) {
+		/* The send window might have opened up */
+		send_queued(tcp);
+	}
+
 	return true;
 }
 
+bool net_tcp_ack_received(struct net_context *ctx, u32_t ack)
+{
+	return ack_received(ctx, ack, false, NULL);
+}
+
 void net_tcp_init(void)
 {
 }
@@ -1200,9 +1923,8 @@ bool net_tcp_validate_seq(struct net_tcp *tcp, struct net_pkt *pkt)
 struct net_tcp_hdr *net_tcp_get_hdr(struct net_pkt *pkt,
 				    struct net_tcp_hdr *hdr)
 {
+	struct net_pkt_cursor cursor;
 	struct net_tcp_hdr *tcp_hdr;
-	struct net_buf *frag;
-	u16_t pos;
 
 	tcp_hdr = net_pkt_tcp_data(pkt);
 	if (!tcp_hdr) {
@@ -1214,28 +1936,15 @@ struct net_tcp_hdr *net_tcp_get_hdr(struct net_pkt *pkt,
 		return tcp_hdr;
 	}
 
-	frag = net_frag_read(pkt->frags, net_pkt_ip_hdr_len(pkt) +
-			     net_pkt_ipv6_ext_len(pkt),
-			     &pos, sizeof(hdr->src_port),
-			     (u8_t *)&hdr->src_port);
-	frag = net_frag_read(frag, pos, &pos, sizeof(hdr->dst_port),
-			     (u8_t *)&hdr->dst_port);
-	frag = net_frag_read(frag, pos, &pos, sizeof(hdr->seq), hdr->seq);
-	frag = net_frag_read(frag, pos, &pos, sizeof(hdr->ack), hdr->ack);
-	frag = net_frag_read_u8(frag, pos, &pos, &hdr->offset);
-	frag = net_frag_read_u8(frag, pos, &pos, &hdr->flags);
-	frag = net_frag_read(frag, pos, &pos, sizeof(hdr->wnd), hdr->wnd);
-	frag = net_frag_read(frag, pos, &pos, sizeof(hdr->chksum),
-			     (u8_t *)&hdr->chksum);
-	frag = net_frag_read(frag, pos, &pos, sizeof(hdr->urg), hdr->urg);
-
-	if (!frag && pos == 0xffff) {
+	if (net_pkt_cursor_seek(pkt, &cursor, net_pkt_ip_hdr_len(pkt) +
+				net_pkt_ipv6_ext_len(pkt)) ||
+	    net_pkt_cursor_read(&cursor, hdr, NET_TCPH_LEN)) {
 		/* If the pkt is compressed, then this is the typical outcome
 		 * so no use printing error in this case.
 		 */
 		if (IS_ENABLED(CONFIG_NET_DEBUG_TCP) &&
 		    !is_6lo_technology(pkt)) {
-			NET_ASSERT(frag);
+			NET_ASSERT_INFO(0, "Truncated TCP header");
 		}
 
 		return NULL;
@@ -1247,36 +1956,17 @@ struct net_tcp_hdr *net_tcp_get_hdr(struct net_pkt *pkt,
 struct net_tcp_hdr *net_tcp_set_hdr(struct net_pkt *pkt,
 				    struct net_tcp_hdr *hdr)
 {
-	struct net_buf *frag;
-	u16_t pos;
+	struct net_pkt_cursor cursor;
 
 	if (net_tcp_header_fits(pkt, hdr)) {
 		return hdr;
 	}
 
-	frag = net_pkt_write(pkt, pkt->frags, net_pkt_ip_hdr_len(pkt) +
-			     net_pkt_ipv6_ext_len(pkt),
-			     &pos, sizeof(hdr->src_port),
-			     (u8_t *)&hdr->src_port, ALLOC_TIMEOUT);
-	frag = net_pkt_write(pkt, frag, pos, &pos, sizeof(hdr->dst_port),
-			     (u8_t *)&hdr->dst_port, ALLOC_TIMEOUT);
-	frag = net_pkt_write(pkt, frag, pos, &pos, sizeof(hdr->seq), hdr->seq,
-			     ALLOC_TIMEOUT);
-	frag = net_pkt_write(pkt, frag, pos, &pos, sizeof(hdr->ack), hdr->ack,
-			     ALLOC_TIMEOUT);
-	frag = net_pkt_write(pkt, frag, pos, &pos, sizeof(hdr->offset),
-			     &hdr->offset, ALLOC_TIMEOUT);
-	frag = net_pkt_write(pkt, frag, pos, &pos, sizeof(hdr->flags),
-			     &hdr->flags, ALLOC_TIMEOUT);
-	frag = net_pkt_write(pkt, frag, pos, &pos, sizeof(hdr->wnd), hdr->wnd,
-			     ALLOC_TIMEOUT);
-	frag = net_pkt_write(pkt, frag, pos, &pos, sizeof(hdr->chksum),
-			     (u8_t *)&hdr->chksum, ALLOC_TIMEOUT);
-	frag = net_pkt_write(pkt, frag, pos, &pos, sizeof(hdr->urg), hdr->urg,
-			     ALLOC_TIMEOUT);
-
-	if (!frag) {
-		NET_ASSERT(frag);
+	if (net_pkt_cursor_seek(pkt, &cursor, net_pkt_ip_hdr_len(pkt) +
+				net_pkt_ipv6_ext_len(pkt)) ||
+	    net_pkt_cursor_write(pkt, &cursor, hdr, NET_TCPH_LEN,
+				 ALLOC_TIMEOUT)) {
+		NET_ASSERT_INFO(0, "Cannot set the TCP header");
 		return NULL;
 	}
 
@@ -1341,11 +2031,12 @@ struct net_buf *net_tcp_set_chksum(struct net_pkt *pkt, struct net_buf *frag)
 int net_tcp_parse_opts(struct net_pkt *pkt, int opt_totlen,
 		       struct net_tcp_options *opts)
 {
-	struct net_buf *frag = pkt->frags;
+	struct net_pkt_cursor cursor;
 	u16_t pos = net_pkt_ip_hdr_len(pkt)
 		  + net_pkt_ipv6_ext_len(pkt)
 		  + sizeof(struct net_tcp_hdr);
 	u8_t opt, optlen;
+	int i;
 
 	/* TODO: this should be done for each TCP pkt, on reception */
 	if (pos + opt_totlen > net_pkt_get_len(pkt)) {
@@ -1354,8 +2045,12 @@ int net_tcp_parse_opts(struct net_pkt *pkt, int opt_totlen,
 		return -EINVAL;
 	}
 
+	if (net_pkt_cursor_seek(pkt, &cursor, pos)) {
+		return -EINVAL;
+	}
+
 	while (opt_totlen) {
-		frag = net_frag_read(frag, pos, &pos, sizeof(opt), &opt);
+		net_pkt_cursor_read_u8(&cursor, &opt);
 		opt_totlen--;
 
 		/* https://www.iana.org/assignments/tcp-parameters/tcp-parameters.xhtml#tcp-parameters-1 */
@@ -1375,7 +2070,7 @@ int net_tcp_parse_opts(struct net_pkt *pkt, int opt_totlen,
 			goto error;
 		}
 
-		frag = net_frag_read(frag, pos, &pos, sizeof(optlen), &optlen);
+		net_pkt_cursor_read_u8(&cursor, &optlen);
 		opt_totlen--;
 		if (optlen < 2) {
 			goto error;
@@ -1394,11 +2089,43 @@ int net_tcp_parse_opts(struct net_pkt *pkt, int opt_totlen,
 			if (optlen != 2) {
 				goto error;
 			}
-			frag = net_frag_read_be16(frag, pos, &pos,
-						  &opts->mss);
+			net_pkt_cursor_read_be16(&cursor, &opts->mss);
+			break;
+		case NET_TCP_WINDOW_SCALE_OPT: {
+			u8_t wscale;
+
+			if (optlen != 1) {
+				goto error;
+			}
+
+			net_pkt_cursor_read_u8(&cursor, &wscale);
+			/* RFC 7323, 2.3: larger values are used as 14 */
+			opts->wscale = min(wscale, NET_TCP_MAX_WSCALE);
+			break;
+		}
+		case NET_TCP_SACK_PERMITTED_OPT:
+			if (optlen != 0) {
+				goto error;
+			}
+
+			opts->sack_permitted = true;
+			break;
+		case NET_TCP_SACK_OPT:
+			if (optlen % 8 || optlen > 8 * NET_TCP_MAX_SACK_BLOCKS) {
+				goto error;
+			}
+
+			opts->sack_blocks = optlen / 8;
+
+			for (i = 0; i < opts->sack_blocks; i++) {
+				net_pkt_cursor_read_be32(&cursor,
+							 &opts->sack[i].left);
+				net_pkt_cursor_read_be32(&cursor,
+							 &opts->sack[i].right);
+			}
 			break;
 		default:
-			frag = net_frag_skip(frag, pos, &pos, optlen);
+			net_pkt_cursor_skip(&cursor, optlen);
 			break;
 		}
 
@@ -1441,21 +2168,32 @@ int net_tcp_recv(struct net_context *context, net_context_recv_cb_t cb,
 	return 0;
 }
 
+/* The FIN is queued behind the data still waiting for the send window,
+ * so it goes out once that data has, and is retransmitted like it.
+ */
 static void queue_fin(struct net_context *ctx)
 {
+	struct net_tcp *tcp = ctx->tcp;
 	struct net_pkt *pkt = NULL;
 	int ret;
 
-	ret = net_tcp_prepare_segment(ctx->tcp, NET_TCP_FIN, NULL, 0,
+	ret = net_tcp_prepare_segment(tcp, NET_TCP_FIN, NULL, 0,
 				      NULL, &ctx->remote, &pkt);
 	if (ret || !pkt) {
 		return;
 	}
 
-	ret = net_tcp_send_pkt(pkt);
-	if (ret < 0) {
-		net_pkt_unref(pkt);
+	net_pkt_set_appdatalen(pkt, 0);
+
+	sys_slist_append(&tcp->sent_list, &pkt->sent_list);
+
+	if (k_delayed_work_remaining_get(&tcp->retry_timer) == 0) {
+		k_delayed_work_submit(&tcp->retry_timer, retry_timeout(tcp));
 	}
+
+	do_ref_if_needed(tcp, pkt);
+
+	send_queued(tcp);
 }
 
 int net_tcp_put(struct net_context *context)
@@ -1468,6 +2206,7 @@ int net_tcp_put(struct net_context *context)
 				"disposing yet (waiting %dms)", FIN_TIMEOUT);
 			k_delayed_work_submit(&context->tcp->fin_timer,
 					      FIN_TIMEOUT);
+			flush_unsent(context);
 			queue_fin(context);
 			return 0;
 		}
@@ -1500,7 +2239,8 @@ int net_tcp_update_recv_wnd(struct net_context *context, s32_t delta)
 	}
 
 	new_win = context->tcp->recv_wnd + delta;
-	if (new_win < 0 || new_win > UINT16_MAX) {
+	if (new_win < 0 || new_win > (IS_ENABLED(CONFIG_NET_TCP_WINDOW_SCALE) ?
+				      NET_TCP_MAX_WIN : UINT16_MAX)) {
 		return -EINVAL;
 	}
 
@@ -1593,7 +2333,7 @@ static int tcp_backlog_find(struct net_pkt *pkt, int *empty_slot)
 }
 
 static int tcp_backlog_syn(struct net_pkt *pkt, struct net_context *context,
-			   u16_t send_mss)
+			   const struct net_tcp_options *opts)
 {
 	int empty_slot = -1;
 	int ret;
@@ -1619,7 +2359,9 @@ static int tcp_backlog_syn(struct net_pkt *pkt, struct net_context *context,
 
 	tcp_backlog[empty_slot].send_seq = context->tcp->send_seq;
 	tcp_backlog[empty_slot].send_ack = context->tcp->send_ack;
-	tcp_backlog[empty_slot].send_mss = send_mss;
+	tcp_backlog[empty_slot].send_mss = opts->mss;
+	tcp_backlog[empty_slot].send_wscale = opts->wscale;
+	tcp_backlog[empty_slot].sack_permitted = opts->sack_permitted;
 
 	k_delayed_work_init(&tcp_backlog[empty_slot].ack_timer,
 			    backlog_ack_timeout);
@@ -1653,7 +2395,15 @@ static int tcp_backlog_ack(struct net_pkt *pkt, struct net_context *context)
 		sizeof(struct sockaddr));
 	context->tcp->send_seq = tcp_backlog[r].send_seq + 1;
 	context->tcp->send_ack = tcp_backlog[r].send_ack;
-	context->tcp->send_mss = tcp_backlog[r].send_mss;
+
+	set_peer_opts(context->tcp, tcp_backlog[r].send_mss,
+		      tcp_backlog[r].send_wscale,
+		      tcp_backlog[r].sack_permitted);
+
+	context->tcp->send_wnd = sys_get_be16(tcp_hdr->wnd);
+#if defined(CONFIG_NET_TCP_WINDOW_SCALE)
+	context->tcp->send_wnd <<= context->tcp->send_wscale;
+#endif
 
 	k_delayed_work_cancel(&tcp_backlog[r].ack_timer);
 	memset(&tcp_backlog[r], 0, sizeof(struct tcp_backlog_entry));
@@ -1697,6 +2447,9 @@ static void handle_fin_timeout(struct k_work *work)
 	net_context_unref(tcp->context);
 }
 
+static int send_ack(struct net_context *context,
+		    struct sockaddr *remote, bool force);
+
 static void handle_ack_timeout(struct k_work *work)
 {
 	/* This means that we did not receive ACK response in time. */
@@ -1714,6 +2467,9 @@ static void handle_ack_timeout(struct k_work *work)
 		net_tcp_change_state(tcp, NET_TCP_CLOSED);
 
 		net_context_unref(tcp->context);
+	} else if (tcp->send_ack != tcp->sent_ack) {
+		/* The timer also runs for delayed ACKs, see ack_data() */
+		send_ack(tcp->context, &tcp->context->remote, false);
 	}
 }
 
@@ -1822,16 +2578,21 @@ static void print_send_info(struct net_pkt *pkt, const char *msg)
 	}
 }
 
-/* Send SYN or SYN/ACK. */
+/* Send SYN or SYN/ACK, peer has the options of the SYN being answered */
 static inline int send_syn_segment(struct net_context *context,
-				       const struct sockaddr_ptr *local,
-				       const struct sockaddr *remote,
-				       int flags, const char *msg)
+				   const struct sockaddr_ptr *local,
+				   const struct sockaddr *remote,
+				   int flags, const char *msg,
+				   const struct net_tcp_options *peer)
 {
+	u8_t options[NET_TCP_MAX_SYN_OPT_SIZE];
 	struct net_pkt *pkt = NULL;
+	u8_t optionlen;
 	int ret;
 
-	ret = net_tcp_prepare_segment(context->tcp, flags, NULL, 0,
+	net_tcp_set_syn_opt(context->tcp, options, &optionlen, peer);
+
+	ret = net_tcp_prepare_segment(context->tcp, flags, options, optionlen,
 				      local, remote, &pkt);
 	if (ret) {
 		return ret;
@@ -1855,16 +2616,17 @@ static inline int send_syn(struct net_context *context,
 {
 	net_tcp_change_state(context->tcp, NET_TCP_SYN_SENT);
 
-	return send_syn_segment(context, NULL, remote, NET_TCP_SYN, "SYN");
+	return send_syn_segment(context, NULL, remote, NET_TCP_SYN, "SYN",
+				NULL);
 }
 
 static inline int send_syn_ack(struct net_context *context,
 			       struct sockaddr_ptr *local,
-			       struct sockaddr *remote)
+			       struct sockaddr *remote,
+			       const struct net_tcp_options *peer)
 {
 	return send_syn_segment(context, local, remote,
-				    NET_TCP_SYN | NET_TCP_ACK,
-				    "SYN_ACK");
+				NET_TCP_SYN | NET_TCP_ACK, "SYN_ACK", peer);
 }
 
 static int send_ack(struct net_context *context,
@@ -1917,6 +2679,123 @@ static int send_reset(struct net_context *context,
 	return ret;
 }
 
+/* Acknowledge received in-order data. Every second segment is ACKed
+ * right away, otherwise the ACK timer sends it unless data sent in the
+ * meantime carried it already.
+ */
+static void ack_data(struct net_context *context, struct sockaddr *remote,
+		     u16_t data_len)
+{
+	struct net_tcp *tcp = context->tcp;
+
+	/* No point in waiting if our window cannot take a second segment
+	 * of that size.
+	 */
+	if (CONFIG_NET_TCP_ACK_DELAY && !tcp->segs_unacked &&
+	    2 * data_len <= net_tcp_get_recv_wnd(tcp)) {
+		tcp->segs_unacked = 1;
+		k_delayed_work_submit(&tcp->ack_timer,
+				      K_MSEC(CONFIG_NET_TCP_ACK_DELAY));
+		return;
+	}
+
+	send_ack(context, remote, false);
+}
+
+/* Window advertised by the peer in a received segment */
+static u32_t peer_wnd(struct net_tcp *tcp, struct net_tcp_hdr *tcp_hdr)
+{
+	u32_t wnd = sys_get_be16(tcp_hdr->wnd);
+
+#if defined(CONFIG_NET_TCP_WINDOW_SCALE)
+	wnd <<= tcp->send_wscale;
+#endif
+
+	return wnd;
+}
+
+/* Process the ACK and window fields of a received segment that carries
+ * data_len bytes of data.
+ */
+static bool handle_ack(struct net_context *context, struct net_pkt *pkt,
+		       struct net_tcp_hdr *tcp_hdr, u16_t data_len)
+{
+	struct net_tcp *tcp = context->tcp;
+	struct net_tcp_options opts = {
+		.wscale = -1,
+	};
+	u32_t ack = sys_get_be32(tcp_hdr->ack);
+	u32_t wnd = peer_wnd(tcp, tcp_hdr);
+	bool dup;
+
+	dup = !data_len && wnd == tcp->send_wnd &&
+	      !(NET_TCP_FLAGS(tcp_hdr) & (NET_TCP_SYN | NET_TCP_FIN));
+
+	if (tcp->sack_permitted && NET_TCP_HDR_LEN(tcp_hdr) > NET_TCPH_LEN) {
+		net_tcp_parse_opts(pkt, NET_TCP_HDR_LEN(tcp_hdr) - NET_TCPH_LEN,
+				   &opts);
+	}
+
+	if (!net_tcp_seq_greater(ack, tcp->send_seq)) {
+		tcp->send_wnd = wnd;
+	}
+
+	return ack_received(context, ack, dup, &opts);
+}
+
+#if defined(CONFIG_NET_TCP_FAST_PATH)
+/* Header prediction: in the ESTABLISHED state nearly every segment is
+ * either a pure ACK for data we sent, or the next in-order data segment
+ * while none of our data is outstanding. These are handled here without
+ * going through the state machine. Returns false if the segment needs
+ * the full processing.
+ */
+static bool tcp_predicted(struct net_conn *conn, struct net_context *context,
+			  struct net_pkt *pkt, struct net_tcp_hdr *tcp_hdr,
+			  enum net_verdict *verdict)
+{
+	struct net_tcp *tcp = context->tcp;
+	u32_t ack = sys_get_be32(tcp_hdr->ack);
+	u16_t data_len;
+
+	if (net_tcp_get_state(tcp) != NET_TCP_ESTABLISHED ||
+	    (NET_TCP_FLAGS(tcp_hdr) & ~NET_TCP_PSH) != NET_TCP_ACK ||
+	    sys_get_be32(tcp_hdr->seq) != tcp->send_ack ||
+	    net_tcp_seq_greater(ack, tcp->send_seq)) {
+		return false;
+	}
+
+	net_context_set_appdata_values(pkt, IPPROTO_TCP);
+	data_len = net_pkt_appdatalen(pkt);
+
+	if (!data_len) {
+		handle_ack(context, pkt, tcp_hdr, 0);
+		net_pkt_unref(pkt);
+		*verdict = NET_OK;
+
+		return true;
+	}
+
+	if (!sys_slist_is_empty(&tcp->sent_list) ||
+	    data_len > net_tcp_get_recv_wnd(tcp)) {
+		return false;
+	}
+
+	/* Nothing of ours is in flight, so the ACK carries no news, but
+	 * the window can have changed.
+	 */
+	tcp->send_wnd = peer_wnd(tcp, tcp_hdr);
+
+	*verdict = net_context_packet_received(conn, pkt,
+					       tcp->recv_user_data);
+	tcp->send_ack += data_len;
+
+	ack_data(context, &conn->remote_addr, data_len);
+
+	return true;
+}
+#endif /* CONFIG_NET_TCP_FAST_PATH */
+
 /* This is called when we receive data after the connection has been
  * established. The core TCP logic is located here.
  */
@@ -1943,6 +2822,12 @@ NET_CONN_CB(tcp_established)
 
 	net_tcp_print_recv_info("DATA", pkt, tcp_hdr->src_port);
 
+#if defined(CONFIG_NET_TCP_FAST_PATH)
+	if (tcp_predicted(conn, context, pkt, tcp_hdr, &ret)) {
+		return ret;
+	}
+#endif
+
 	tcp_flags = NET_TCP_FLAGS(tcp_hdr);
 
 	if (net_tcp_seq_cmp(sys_get_be32(tcp_hdr->seq),
@@ -1962,8 +2847,10 @@ NET_CONN_CB(tcp_established)
 			    context->tcp->send_ack) > 0) {
 		/* Don't try to reorder packets.  If it doesn't
 		 * match the next segment exactly, drop and wait for
-		 * retransmit
+		 * retransmit. The duplicate ACK sent right away lets
+		 * the peer detect the loss early (RFC 5681, 4.2).
 		 */
+		send_ack(context, &conn->remote_addr, true);
 		return NET_DROP;
 	}
 
@@ -1992,10 +2879,13 @@ NET_CONN_CB(tcp_established)
 		return NET_DROP;
 	}
 
+	net_context_set_appdata_values(pkt, IPPROTO_TCP);
+
+	data_len = net_pkt_appdatalen(pkt);
+
 	/* Handle TCP state transition */
 	if (tcp_flags & NET_TCP_ACK) {
-		if (!net_tcp_ack_received(context,
-				     sys_get_be32(tcp_hdr->ack))) {
+		if (!handle_ack(context, pkt, tcp_hdr, data_len)) {
 			return NET_DROP;
 		}
 
@@ -2004,8 +2894,11 @@ NET_CONN_CB(tcp_established)
 		 */
 
 		if (net_tcp_get_state(context->tcp)
-			   == NET_TCP_FIN_WAIT_1) {
-			/* Active close: step to FIN_WAIT_2 */
+			   == NET_TCP_FIN_WAIT_1 &&
+		    sys_slist_is_empty(&context->tcp->sent_list)) {
+			/* Active close: step to FIN_WAIT_2 once our FIN,
+			 * queued behind the data, is acknowledged too.
+			 */
 			net_tcp_change_state(context->tcp, NET_TCP_FIN_WAIT_2);
 		} else if (net_tcp_get_state(context->tcp)
 			   == NET_TCP_LAST_ACK) {
@@ -2040,9 +2933,6 @@ NET_CONN_CB(tcp_established)
 		context->tcp->fin_rcvd = 1;
 	}
 
-	net_context_set_appdata_values(pkt, IPPROTO_TCP);
-
-	data_len = net_pkt_appdatalen(pkt);
 	if (data_len > net_tcp_get_recv_wnd(context->tcp)) {
 		NET_ERR("Context %p: overflow of recv window (%d vs %d), "
 			"pkt dropped",
@@ -2066,7 +2956,11 @@ NET_CONN_CB(tcp_established)
 		context->tcp->send_ack += 1;
 	}
 
-	send_ack(context, &conn->remote_addr, false);
+	if (data_len && !(tcp_flags & NET_TCP_FIN)) {
+		ack_data(context, &conn->remote_addr, data_len);
+	} else {
+		send_ack(context, &conn->remote_addr, false);
+	}
 
 clean_up:
 	if (net_tcp_get_state(context->tcp) == NET_TCP_TIME_WAIT) {
@@ -2144,6 +3038,16 @@ NET_CONN_CB(tcp_synack_received)
 		 */
 		struct sockaddr local_addr;
 		struct sockaddr remote_addr;
+		struct net_tcp_options tcp_opts = {
+			.mss = NET_TCP_DEFAULT_MSS,
+			.wscale = -1,
+		};
+
+		if (net_tcp_parse_opts(pkt, NET_TCP_HDR_LEN(tcp_hdr) -
+				       sizeof(struct net_tcp_hdr),
+				       &tcp_opts) < 0) {
+			return NET_DROP;
+		}
 
 		if (net_pkt_get_src_addr(
 			pkt, &remote_addr, sizeof(remote_addr)) < 0) {
@@ -2173,6 +3077,10 @@ NET_CONN_CB(tcp_synack_received)
 			return NET_DROP;
 		}
 
+		set_peer_opts(context->tcp, tcp_opts.mss, tcp_opts.wscale,
+			      tcp_opts.sack_permitted);
+		context->tcp->send_wnd = sys_get_be16(tcp_hdr->wnd);
+
 		net_tcp_change_state(context->tcp, NET_TCP_ESTABLISHED);
 		net_context_set_state(context, NET_CONTEXT_CONNECTED);
 
@@ -2292,6 +3200,7 @@ NET_CONN_CB(tcp_syn_rcvd)
 		int opt_totlen;
 		struct net_tcp_options tcp_opts = {
 			.mss = NET_TCP_DEFAULT_MSS,
+			.wscale = -1,
 		};
 
 		net_tcp_print_recv_info("SYN", pkt, tcp_hdr->src_port);
@@ -2314,7 +3223,7 @@ NET_CONN_CB(tcp_syn_rcvd)
 
 		/* Get MSS from TCP options here*/
 
-		r = tcp_backlog_syn(pkt, context, tcp_opts.mss);
+		r = tcp_backlog_syn(pkt, context, &tcp_opts);
 		if (r < 0) {
 			if (r == -EADDRINUSE) {
 				NET_DBG("TCP connection already exists");
@@ -2327,7 +3236,7 @@ NET_CONN_CB(tcp_syn_rcvd)
 
 		pkt_get_sockaddr(net_context_get_family(context),
 				 pkt, &pkt_src_addr);
-		send_syn_ack(context, &pkt_src_addr, &remote_addr);
+		send_syn_ack(context, &pkt_src_addr, &remote_addr, &tcp_opts);
 
 		return NET_DROP;
 	}
@@ -41,9 +41,6 @@ extern "C" {
 /** A retransmitted packet has been sent and not yet ack'd */
 #define NET_TCP_RETRYING BIT(4)
 
-/** MSS option has been set already */
-#define NET_TCP_RECV_MSS_SET BIT(5)
-
 /*
  * TCP connection states
  */
@@ -81,34 +78,52 @@ enum net_tcp_state {
  */
 #define NET_TCP_DEFAULT_MSS   536
 
+/* Largest window scale shift, RFC 7323 chapter 2.3 */
+#define NET_TCP_MAX_WSCALE 14
+
 /* TCP max window size */
-#define NET_TCP_MAX_WIN   (4 * 1024)
+#define NET_TCP_MAX_WIN   ((u32_t)UINT16_MAX << NET_TCP_MAX_WSCALE)
 
 /* Maximal value of the sequence number */
 #define NET_TCP_MAX_SEQ   0xffffffff
 
 #define NET_TCP_MAX_OPT_SIZE  8
 
+/* MSS, window scale and SACK permitted, each padded to 4 bytes */
+#define NET_TCP_MAX_SYN_OPT_SIZE  12
+
 /* TCP Option codes */
-#define NET_TCP_END_OPT          0
-#define NET_TCP_NOP_OPT          1
-#define NET_TCP_MSS_OPT          2
-#define NET_TCP_WINDOW_SCALE_OPT 3
+#define NET_TCP_END_OPT            0
+#define NET_TCP_NOP_OPT            1
+#define NET_TCP_MSS_OPT            2
+#define NET_TCP_WINDOW_SCALE_OPT   3
+#define NET_TCP_SACK_PERMITTED_OPT 4
+#define NET_TCP_SACK_OPT           5
 
 /* TCP Option sizes */
-#define NET_TCP_END_SIZE          1
-#define NET_TCP_NOP_SIZE          1
-#define NET_TCP_MSS_SIZE          4
-#define NET_TCP_WINDOW_SCALE_SIZE 3
+#define NET_TCP_END_SIZE            1
+#define NET_TCP_NOP_SIZE            1
+#define NET_TCP_MSS_SIZE            4
+#define NET_TCP_WINDOW_SCALE_SIZE   3
+#define NET_TCP_SACK_PERMITTED_SIZE 2
+
+/* Max number of SACK blocks in a segment, RFC 2018 chapter 3 */
+#define NET_TCP_MAX_SACK_BLOCKS 4
 
 /** Parsed TCP option values for net_tcp_parse_opts()  */
 struct net_tcp_options {
 	u16_t mss;
+	/** Window scale shift of the peer, -1 if not present */
+	s8_t wscale;
+	bool sack_permitted;
+	/** Number of valid entries in sack */
+	u8_t sack_blocks;
+	struct {
+		u32_t left;
+		u32_t right;
+	} sack[NET_TCP_MAX_SACK_BLOCKS];
 };
 
-/* Max received bytes to buffer internally */
-#define NET_TCP_BUF_MAX_LEN 1280
-
 /* Max segment lifetime, in seconds */
 #define NET_TCP_MAX_SEG_LIFETIME 60
 
@@ -155,8 +170,18 @@ struct net_tcp {
 	u32_t fin_sent : 1;
 	/* An inbound FIN packet has been received */
 	u32_t fin_rcvd : 1;
+	/* In-order data segments received since the last ACK we sent */
+	u32_t segs_unacked : 2;
+	/* Duplicate ACKs received in a row, saturates at 3 */
+	u32_t dupacks : 2;
+	/* Fast recovery is in progress */
+	u32_t in_recovery : 1;
+	/* An RTT measurement is running */
+	u32_t rtt_active : 1;
+	/* The peer accepts SACK options */
+	u32_t sack_permitted : 1;
 	/** Remaining bits in this u32_t */
-	u32_t _padding : 13;
+	u32_t _padding : 6;
 
 	/** Accept callback to be called when the connection has been
 	 * established.
@@ -171,12 +196,85 @@ struct net_tcp {
 	/**
 	 * Current TCP receive window for our side
 	 */
-	u16_t recv_wnd;
+	u32_t recv_wnd;
+
+	/**
+	 * Receive window last advertised by the peer
+	 */
+	u32_t send_wnd;
 
 	/**
 	 * Send MSS for the peer
 	 */
 	u16_t send_mss;
+
+#if defined(CONFIG_NET_TCP_WINDOW_SCALE)
+	/**
+	 * Window scale shifts for the windows of the peer and ours, 0 if
+	 * the peer did not agree to scaling.
+	 */
+	u8_t send_wscale;
+	u8_t recv_wscale;
+#endif
+
+#if defined(CONFIG_NET_TCP_CONGESTION_CONTROL)
+	/**
+	 * Smoothed round trip time and its mean deviation, in 1/8 ms
+	 * and 1/4 ms units (RFC 6298)
+	 */
+	u32_t srtt;
+	u32_t rttvar;
+
+	/**
+	 * Retransmission timeout in ms, doubled for each retry
+	 */
+	u32_t rto;
+
+	/**
+	 * Sequence number whose ACK completes the running RTT
+	 * measurement, and the uptime in ms when it was started
+	 */
+	u32_t rtt_seq;
+	u32_t rtt_start;
+
+	/**
+	 * Congestion window and slow start threshold, in bytes
+	 */
+	u32_t cwnd;
+	u32_t ssthresh;
+
+	/**
+	 * Highest sequence number sent when loss was last detected
+	 * (RFC 6582), fast recovery ends once it is acknowledged.
+	 */
+	u32_t recover;
+
+	/**
+	 * End of the data retransmitted during fast recovery
+	 */
+	u32_t high_rxt;
+#endif
+
+#if defined(CONFIG_NET_TCP_NAGLE)
+	/**
+	 * Small writes held back while data is in flight, sent once
+	 * everything is acknowledged or a full segment has accumulated.
+	 */
+	struct net_pkt *unsent;
+#endif
+
+#if defined(CONFIG_NET_TCP_FAST_PATH)
+	/**
+	 * IP and TCP header of the segments sent to the connected peer,
+	 * copied into each new segment instead of building it again.
+	 */
+	u8_t hdr[NET_IPV6TCPH_LEN];
+
+	/**
+	 * Length of the header template, 0 if not built yet
+	 */
+	u8_t hdr_len;
+#endif
 };
 
 typedef void (*net_tcp_cb_t)(struct net_tcp *tcp, void *user_data);
@@ -341,6 +439,10 @@ int net_tcp_send_data(struct net_context *context, net_context_send_cb_t cb,
 /**
  * @brief Enqueue a single packet for transmission
  *
+ * With CONFIG_NET_TCP_NAGLE, a packet smaller than the MSS may be held
+ * back and merged with the following ones while sent data is not yet
+ * acknowledged.
+ *
  * @param context TCP context
  * @param pkt Packet
  *
@@ -15,6 +15,7 @@
 #endif
 
 #include <stdlib.h>
+#include <limits.h>
 #include <zephyr/types.h>
 #include <stdbool.h>
 #include <string.h>
@@ -373,31 +374,144 @@ int net_addr_pton(sa_family_t family, const char *src,
 	return 0;
 }
 
-static u16_t calc_chksum(u16_t sum, const u8_t *ptr, u16_t len)
+/* Fold a one's complement sum with deferred carries down to 16 bits */
+static inline u16_t chksum_fold(u64_t acc)
 {
-	u16_t tmp;
-	const u8_t *end;
+	acc = (acc & 0xffffffff) + (acc >> 32);
+	acc = (acc & 0xffffffff) + (acc >> 32);
+	acc = (acc & 0xffff) + (acc >> 16);
+	acc = (acc & 0xffff) + (acc >> 16);
 
-	end = ptr + len - 1;
+	return acc;
+}
 
-	while (ptr < end) {
-		tmp = (ptr[0] << 8) + ptr[1];
-		sum += tmp;
-		if (sum < tmp) {
-			sum++;
-		}
+/* A sum taken over data that starts at an odd offset of the checksummed
+ * area is byte swapped with regard to the sum of the area (RFC 1071).
+ */
+static inline u16_t chksum_swap(u16_t sum)
+{
+	return (sum << 8) | (sum >> 8);
+}
+
+/* Sum of the 16 bit words of a 16 bit aligned area, in network byte
+ * order. Words are loaded in host byte order 32 bits at a time and the
+ * carries are only folded at the end.
+ */
+static u16_t chksum_words(const u8_t *ptr, u16_t len)
+{
+	const u32_t *p32;
+	u64_t acc = 0;
+
+	if (((uintptr_t)ptr & 2) && len >= 2) {
+		acc += *(const u16_t *)ptr;
 		ptr += 2;
+		len -= 2;
 	}
 
-	if (ptr == end) {
-		tmp = ptr[0] << 8;
-		sum += tmp;
-		if (sum < tmp) {
-			sum++;
-		}
+	p32 = (const u32_t *)ptr;
+
+	while (len >= 16) {
+		acc += p32[0];
+		acc += p32[1];
+		acc += p32[2];
+		acc += p32[3];
+		p32 += 4;
+		len -= 16;
 	}
 
-	return sum;
+	while (len >= 4) {
+		acc += *p32++;
+		len -= 4;
+	}
+
+	ptr = (const u8_t *)p32;
+
+	if (len >= 2) {
+		acc += *(const u16_t *)ptr;
+		ptr += 2;
+		len -= 2;
+	}
+
+	/* Trailing byte is the first byte of a zero padded word */
+	if (len) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		acc += ptr[0];
+#else
+		acc += ptr[0] << 8;
+#endif
+	}
+
+	return ntohs(chksum_fold(acc));
+}
+
+static u16_t calc_chksum(u16_t sum, const u8_t *ptr, u16_t len)
+{
+	u32_t acc = sum;
+
+	if (!len) {
+		return sum;
+	}
+
+	if ((uintptr_t)ptr & 1) {
+		/* The first byte is the high half of a word, the rest is
+		 * summed one byte off.
+		 */
+		acc += ptr[0] << 8;
+		acc += chksum_swap(chksum_words(ptr + 1, len - 1));
+	} else {
+		acc += chksum_words(ptr, len);
+	}
+
+	return chksum_fold(acc);
+}
+
+u16_t net_calc_chksum_copy(u8_t *dst, const u8_t *src, u16_t len)
+{
+	const u32_t *s32;
+	u32_t *d32;
+	u64_t acc = 0;
+	u32_t sum;
+	u16_t head, words;
+
+	if (((uintptr_t)dst ^ (uintptr_t)src) & 3) {
+		/* No word access possible on both sides, sum the copy
+		 * while it is still hot in the cache.
+		 */
+		memcpy(dst, src, len);
+
+		return calc_chksum(0, dst, len);
+	}
+
+	head = min(len, (4 - ((uintptr_t)src & 3)) & 3);
+	memcpy(dst, src, head);
+	sum = calc_chksum(0, dst, head);
+
+	s32 = (const u32_t *)(src + head);
+	d32 = (u32_t *)(dst + head);
+
+	for (words = (len - head) / 4; words; words--) {
+		u32_t word = *s32++;
+
+		*d32++ = word;
+		acc += word;
+	}
+
+	if (head & 1) {
+		sum += chksum_swap(ntohs(chksum_fold(acc)));
+	} else {
+		sum += ntohs(chksum_fold(acc));
+	}
+
+	head += (len - head) & ~3;
+	memcpy(dst + head, src + head, len - head);
+
+	if (head & 1) {
+		sum += chksum_swap(calc_chksum(0, dst + head, len - head));
+	} else {
+		sum += calc_chksum(0, dst + head, len - head);
+	}
+
+	return chksum_fold(sum);
 }
 
 static inline u16_t calc_chksum_pkt(u16_t sum, struct net_pkt *pkt,
@@ -405,12 +519,25 @@ static inline u16_t calc_chksum_pkt(u16_t sum, struct net_pkt *pkt,
 {
 	u16_t proto_len = net_pkt_ip_hdr_len(pkt) +
 		net_pkt_ipv6_ext_len(pkt);
+	u16_t left = USHRT_MAX;
 	struct net_buf *frag;
+	bool odd = false;
+	u32_t acc = sum;
 	u16_t offset;
-	s16_t len;
-	u8_t *ptr;
-
-	ARG_UNUSED(upper_layer_len);
+	u16_t len;
+
+#if defined(CONFIG_NET_CHKSUM_COPY)
+	/* The payload was summed while it was copied in, only the
+	 * transport header needs to be read.
+	 */
+	if (pkt->data_chksum_len &&
+	    pkt->data_chksum_len <= upper_layer_len &&
+	    !((upper_layer_len - pkt->data_chksum_len) & 1) &&
+	    net_pkt_get_len(pkt) == proto_len + upper_layer_len) {
+		left = upper_layer_len - pkt->data_chksum_len;
+		acc += pkt->data_chksum;
+	}
+#endif
 
 	frag = net_frag_skip(pkt->frags, proto_len, &offset, 0);
 	if (!frag) {
@@ -421,33 +548,26 @@ static inline u16_t calc_chksum_pkt(u16_t sum, struct net_pkt *pkt,
 
 	NET_ASSERT(offset <= frag->len);
 
-	ptr = frag->data + offset;
-	len = frag->len - offset;
-
-	while (frag) {
-		sum = calc_chksum(sum, ptr, len);
-		frag = frag->frags;
-		if (!frag) {
-			break;
-		}
-
-		ptr = frag->data;
+	/* Odd sized fragments just flip the byte order of the sums that
+	 * follow, no need to pair bytes across the boundary.
+	 */
+	while (frag && left) {
+		len = min(frag->len - offset, left);
 
-		/* Do we need to take first byte from next fragment */
-		if (len % 2) {
-			u16_t tmp = *ptr;
-			sum += tmp;
-			if (sum < tmp) {
-				sum++;
-			}
-			len = frag->len - 1;
-			ptr++;
+		if (odd) {
+			acc += chksum_swap(calc_chksum(0, frag->data + offset,
+						       len));
 		} else {
-			len = frag->len;
+			acc += calc_chksum(0, frag->data + offset, len);
 		}
+
+		odd ^= len & 1;
+		left -= len;
+		offset = 0;
+		frag = frag->frags;
 	}
 
-	return sum;
+	return chksum_fold(acc);
 }
 
 u16_t net_calc_chksum(struct net_pkt *pkt, u8_t proto)
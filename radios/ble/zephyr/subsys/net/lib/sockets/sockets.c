@@ -253,7 +253,7 @@ ssize_t zsock_sendto(int sock, const void *buf, size_t len, int flags,
 		return -1;
 	}
 
-	len = net_pkt_append(send_pkt, len, buf, timeout);
+	len = net_pkt_append_chksum(send_pkt, len, buf, timeout);
 	if (!len) {
 		net_pkt_unref(send_pkt);
 		errno = EAGAIN;
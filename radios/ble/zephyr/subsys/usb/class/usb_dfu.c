@@ -396,7 +396,9 @@ static int dfu_class_handle_req(struct usb_setup_packet *pSetup,
 				break;
 			}
 
-			if (boot_erase_img_bank(FLASH_AREA_IMAGE_1_OFFSET)) {
+			/* The image writer erases the slot as it goes */
+			if (!IS_ENABLED(CONFIG_IMG_ERASE_PROGRESSIVELY) &&
+			    boot_erase_img_bank(FLASH_AREA_IMAGE_1_OFFSET)) {
 				dfu_data.state = dfuERROR;
 				dfu_data.status = errERASE;
 				break;
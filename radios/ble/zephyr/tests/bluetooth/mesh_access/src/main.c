@@ -0,0 +1,340 @@
+/* main.c - Bluetooth Mesh access layer dispatch tests */
+
+/*
+ * Copyright (c) 2019 Arcus Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <ztest.h>
+#include <tc_util.h>
+
+#include <net/buf.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/mesh.h>
+
+#include "mesh.h"
+#include "net.h"
+#include "access.h"
+
+#define PRIMARY_ADDR 0x0010
+#define CID          0x0059
+
+#define OP_A         BT_MESH_MODEL_OP_1(0x01)
+#define OP_B         BT_MESH_MODEL_OP_2(0x82, 0x01)
+#define OP_C         BT_MESH_MODEL_OP_2(0x82, 0x02)
+#define OP_VND       BT_MESH_MODEL_OP_3(0x01, CID)
+#define OP_UNKNOWN   BT_MESH_MODEL_OP_2(0x82, 0x7f)
+
+#define GROUP_1      0xc001
+#define GROUP_2      0xc002
+#define GROUP_3      0xc003
+#define VIRTUAL_1    0x8123
+
+#define BENCH_ROUNDS 1000
+
+static struct bt_mesh_model *calls[16];
+static int call_count;
+
+static void record(struct bt_mesh_model *model, struct bt_mesh_msg_ctx *ctx,
+		   struct net_buf_simple *buf)
+{
+	zassert_true(call_count < ARRAY_SIZE(calls), "Too many calls");
+	calls[call_count++] = model;
+}
+
+static const struct bt_mesh_model_op ops_ab[] = {
+	{ OP_A, 0, record },
+	{ OP_B, 2, record },
+	BT_MESH_MODEL_OP_END,
+};
+
+static const struct bt_mesh_model_op ops_bc[] = {
+	{ OP_B, 0, record },
+	{ OP_C, 0, record },
+	/* Shadowed by the first OP_B handler */
+	{ OP_B, 0, record },
+	BT_MESH_MODEL_OP_END,
+};
+
+static const struct bt_mesh_model_op ops_vnd[] = {
+	{ OP_VND, 0, record },
+	BT_MESH_MODEL_OP_END,
+};
+
+static struct bt_mesh_model elem0_models[] = {
+	BT_MESH_MODEL(0x1000, ops_ab, NULL, NULL),
+	BT_MESH_MODEL(0x1001, ops_bc, NULL, NULL),
+};
+
+static struct bt_mesh_model elem1_models[] = {
+	BT_MESH_MODEL(0x1000, ops_bc, NULL, NULL),
+	BT_MESH_MODEL(0x1001, ops_ab, NULL, NULL),
+	BT_MESH_MODEL(0x1002, ops_ab, NULL, NULL),
+};
+
+static struct bt_mesh_model elem1_vnd_models[] = {
+	BT_MESH_MODEL_VND(CID, 0x0001, ops_vnd, NULL, NULL),
+};
+
+static struct bt_mesh_model elem2_models[] = {
+	BT_MESH_MODEL(0x1003, ops_ab, NULL, NULL),
+};
+
+static struct bt_mesh_model elem2_vnd_models[] = {
+	BT_MESH_MODEL_VND(CID, 0x0001, ops_vnd, NULL, NULL),
+	BT_MESH_MODEL_VND(CID, 0x0002, ops_vnd, NULL, NULL),
+};
+
+static struct bt_mesh_elem elements[] = {
+	BT_MESH_ELEM(0, elem0_models, BT_MESH_MODEL_NONE),
+	BT_MESH_ELEM(0, elem1_models, elem1_vnd_models),
+	BT_MESH_ELEM(0, elem2_models, elem2_vnd_models),
+};
+
+static const struct bt_mesh_comp comp = {
+	.cid = CID,
+	.elem = elements,
+	.elem_count = ARRAY_SIZE(elements),
+};
+
+static void model_setup(struct bt_mesh_model *mod, u16_t key0, u16_t key1,
+			u16_t group0, u16_t group1)
+{
+	mod->keys[0] = key0;
+	mod->keys[1] = key1;
+	mod->groups[0] = group0;
+	mod->groups[1] = group1;
+}
+
+static void setup(void)
+{
+	zassert_equal(bt_mesh_comp_register(&comp), 0,
+		      "Composition register failed");
+	bt_mesh_comp_provision(PRIMARY_ADDR);
+
+	model_setup(&elem0_models[0], 0, BT_MESH_KEY_UNUSED, GROUP_1, 0);
+	model_setup(&elem0_models[1], 1, 0, 0, 0);
+	model_setup(&elem1_models[0], 1, BT_MESH_KEY_UNUSED, GROUP_2, 0);
+	model_setup(&elem1_models[1], 0, 1, 0, VIRTUAL_1);
+	model_setup(&elem1_models[2], 0, BT_MESH_KEY_UNUSED, GROUP_1, 0);
+	model_setup(&elem1_vnd_models[0], 0, 1, 0, 0);
+	model_setup(&elem2_models[0], 1, BT_MESH_KEY_UNUSED, GROUP_1,
+		    GROUP_2);
+	model_setup(&elem2_vnd_models[0], 1, BT_MESH_KEY_UNUSED, 0, 0);
+	model_setup(&elem2_vnd_models[1], 0, BT_MESH_KEY_UNUSED, VIRTUAL_1,
+		    0);
+
+	bt_mesh_group_index_invalidate();
+}
+
+/* Straightforward reimplementation of the access layer lookup rules, as
+ * a reference for what bt_mesh_model_recv() must do.
+ */
+static bool ref_has_key(struct bt_mesh_model *mod, u16_t app_idx)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mod->keys); i++) {
+		if (mod->keys[i] == app_idx) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool ref_elem_match(struct bt_mesh_elem *elem, int idx, u16_t dst)
+{
+	int i, j;
+
+	if (BT_MESH_ADDR_IS_UNICAST(dst)) {
+		return elem->addr == dst;
+	}
+
+	if (!BT_MESH_ADDR_IS_GROUP(dst) && !BT_MESH_ADDR_IS_VIRTUAL(dst)) {
+		return idx == 0 && bt_mesh_fixed_group_match(dst);
+	}
+
+	for (i = 0; i < elem->model_count + elem->vnd_model_count; i++) {
+		struct bt_mesh_model *mod = (i < elem->model_count) ?
+			&elem->models[i] :
+			&elem->vnd_models[i - elem->model_count];
+
+		for (j = 0; j < ARRAY_SIZE(mod->groups); j++) {
+			if (mod->groups[j] == dst) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static int ref_dispatch(u32_t opcode, u16_t app_idx, u16_t dst,
+			u16_t payload_len, struct bt_mesh_model **out)
+{
+	int count = 0;
+	int i, j;
+
+	for (i = 0; i < comp.elem_count; i++) {
+		struct bt_mesh_elem *elem = &comp.elem[i];
+		struct bt_mesh_model *models;
+		u8_t model_count;
+
+		if (!ref_elem_match(elem, i, dst)) {
+			continue;
+		}
+
+		if (opcode < 0x10000) {
+			models = elem->models;
+			model_count = elem->model_count;
+		} else {
+			models = elem->vnd_models;
+			model_count = elem->vnd_model_count;
+		}
+
+		for (j = 0; j < model_count; j++) {
+			const struct bt_mesh_model_op *op;
+
+			if (!ref_has_key(&models[j], app_idx)) {
+				continue;
+			}
+
+			for (op = models[j].op; op->func; op++) {
+				if (op->opcode == opcode) {
+					break;
+				}
+			}
+
+			if (!op->func) {
+				continue;
+			}
+
+			if (payload_len >= op->min_len) {
+				out[count++] = &models[j];
+			}
+
+			break;
+		}
+	}
+
+	return count;
+}
+
+static void recv(u32_t opcode, u16_t app_idx, u16_t dst, u16_t payload_len)
+{
+	NET_BUF_SIMPLE_DEFINE(buf, 16);
+	struct bt_mesh_net_rx rx = {
+		.ctx = {
+			.app_idx = app_idx,
+			.addr = 0x0001,
+			.recv_dst = dst,
+		},
+	};
+
+	bt_mesh_model_msg_init(&buf, opcode);
+	memset(net_buf_simple_add(&buf, payload_len), 0, payload_len);
+
+	bt_mesh_model_recv(&rx, &buf);
+}
+
+void test_dispatch(void)
+{
+	static const u32_t opcodes[] = {
+		OP_A, OP_B, OP_C, OP_VND, OP_UNKNOWN,
+	};
+	static const u16_t dsts[] = {
+		PRIMARY_ADDR, PRIMARY_ADDR + 1, PRIMARY_ADDR + 2,
+		PRIMARY_ADDR + 3, GROUP_1, GROUP_2, GROUP_3, VIRTUAL_1,
+		BT_MESH_ADDR_ALL_NODES, BT_MESH_ADDR_RELAYS,
+	};
+	static const u16_t app_idxs[] = { 0, 1, 2 };
+	struct bt_mesh_model *expected[ARRAY_SIZE(calls)];
+	int o, d, a, len, count;
+
+	setup();
+
+	for (o = 0; o < ARRAY_SIZE(opcodes); o++) {
+		for (d = 0; d < ARRAY_SIZE(dsts); d++) {
+			for (a = 0; a < ARRAY_SIZE(app_idxs); a++) {
+				for (len = 0; len <= 2; len += 2) {
+					count = ref_dispatch(opcodes[o],
+							     app_idxs[a],
+							     dsts[d], len,
+							     expected);
+
+					call_count = 0;
+					recv(opcodes[o], app_idxs[a], dsts[d],
+					     len);
+
+					zassert_equal(call_count, count,
+						      "Wrong number of calls");
+					zassert_true(!memcmp(calls, expected,
+						count * sizeof(calls[0])),
+						"Wrong models called");
+				}
+			}
+		}
+	}
+}
+
+void test_subscription_change(void)
+{
+	setup();
+
+	call_count = 0;
+	recv(OP_A, 0, GROUP_3, 0);
+	zassert_equal(call_count, 0, "Unsubscribed group dispatched");
+
+	elem0_models[0].groups[1] = GROUP_3;
+	bt_mesh_group_index_invalidate();
+
+	call_count = 0;
+	recv(OP_A, 0, GROUP_3, 0);
+	zassert_equal(call_count, 1, "Subscribed group not dispatched");
+	zassert_equal_ptr(calls[0], &elem0_models[0], "Wrong model called");
+
+	zassert_equal_ptr(bt_mesh_elem_find(GROUP_3), &elements[0],
+			  "Wrong element for group");
+	zassert_equal_ptr(bt_mesh_elem_find(VIRTUAL_1), &elements[1],
+			  "Wrong element for virtual address");
+	zassert_is_null(bt_mesh_elem_find(0xc0ff), "Unexpected element");
+
+	elem0_models[0].groups[1] = BT_MESH_ADDR_UNASSIGNED;
+	bt_mesh_group_index_invalidate();
+}
+
+void test_dispatch_benchmark(void)
+{
+	u32_t start, cycles;
+	int i;
+
+	setup();
+
+	call_count = 0;
+	start = k_cycle_get_32();
+
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		recv(OP_VND, 0, GROUP_1 + (i & 1), 0);
+		call_count = 0;
+	}
+
+	cycles = k_cycle_get_32() - start;
+
+	TC_PRINT("access index %s: %u cycles per message\n",
+		 IS_ENABLED(CONFIG_BT_MESH_ACCESS_INDEX) ? "on" : "off",
+		 cycles / BENCH_ROUNDS);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(test_mesh_access,
+			 ztest_unit_test(test_dispatch),
+			 ztest_unit_test(test_subscription_change),
+			 ztest_unit_test(test_dispatch_benchmark));
+
+	ztest_run_test_suite(test_mesh_access);
+}
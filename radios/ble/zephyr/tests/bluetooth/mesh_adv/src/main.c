@@ -0,0 +1,301 @@
+/* main.c - Bluetooth Mesh advertising scheduler tests */
+
+/*
+ * Copyright (c) 2019 Arcus Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <ztest.h>
+#include <tc_util.h>
+
+#include <net/buf.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/mesh.h>
+
+#include "host/hci_core.h"
+
+#include "adv.h"
+#include "mesh.h"
+
+#define XMIT          BT_MESH_TRANSMIT(2, 20)
+#define XMIT_COUNT    (BT_MESH_TRANSMIT_COUNT(XMIT) + 1)
+
+#define RELAY_PDUS    6
+#define BENCH_PDUS    24
+
+#define TAG_LOCAL     0x80
+
+static struct bt_mesh_cfg_srv cfg_srv = {
+	.relay = BT_MESH_RELAY_NOT_SUPPORTED,
+	.beacon = BT_MESH_BEACON_DISABLED,
+	.frnd = BT_MESH_FRIEND_NOT_SUPPORTED,
+	.gatt_proxy = BT_MESH_GATT_PROXY_NOT_SUPPORTED,
+	.default_ttl = 7,
+	.net_transmit = BT_MESH_TRANSMIT(0, 20),
+	.relay_retransmit = BT_MESH_TRANSMIT(0, 20),
+};
+
+static struct bt_mesh_model root_models[] = {
+	BT_MESH_MODEL_CFG_SRV(&cfg_srv),
+};
+
+static struct bt_mesh_elem elements[] = {
+	BT_MESH_ELEM(0, root_models, BT_MESH_MODEL_NONE),
+};
+
+static const struct bt_mesh_comp comp = {
+	.cid = BT_COMP_ID_LF,
+	.elem = elements,
+	.elem_count = ARRAY_SIZE(elements),
+};
+
+/* Simulated bearer: records which PDU is on air, identified by its first
+ * byte, each time the advertising data changes.
+ */
+static struct {
+	bool on;
+	u32_t starts;
+	u32_t updates;
+	u8_t log[BENCH_PDUS * XMIT_COUNT];
+	int log_len;
+} sim;
+
+static void sim_log(const struct bt_data *ad)
+{
+	if (sim.log_len < ARRAY_SIZE(sim.log)) {
+		sim.log[sim.log_len++] = ad->data[0];
+	}
+}
+
+static int sim_start(const struct bt_le_adv_param *param,
+		     const struct bt_data *ad, size_t ad_len,
+		     const struct bt_data *sd, size_t sd_len)
+{
+	if (sim.on) {
+		return -EALREADY;
+	}
+
+	sim.on = true;
+	sim.starts++;
+	sim_log(ad);
+
+	return 0;
+}
+
+static int sim_update(const struct bt_data *ad, size_t ad_len,
+		      const struct bt_data *sd, size_t sd_len)
+{
+	if (!sim.on) {
+		return -EAGAIN;
+	}
+
+	sim.updates++;
+	sim_log(ad);
+
+	return 0;
+}
+
+static int sim_stop(void)
+{
+	sim.on = false;
+
+	return 0;
+}
+
+static const struct bt_mesh_adv_bearer sim_bearer = {
+	.start  = sim_start,
+	.update = sim_update,
+	.stop   = sim_stop,
+};
+
+static K_SEM_DEFINE(sent_sem, 0, BENCH_PDUS);
+static u32_t local_start;
+
+static void local_started(u16_t duration, int err, void *cb_data)
+{
+	local_start = k_uptime_get_32();
+}
+
+static void pdu_sent(int err, void *cb_data)
+{
+	if (!err) {
+		k_sem_give(&sent_sem);
+	}
+}
+
+static const struct bt_mesh_send_cb local_cb = {
+	.start = local_started,
+	.end = pdu_sent,
+};
+
+static const struct bt_mesh_send_cb bench_cb = {
+	.end = pdu_sent,
+};
+
+static void setup(void)
+{
+	static bool initialized;
+
+	if (!initialized) {
+		/* Allow 20 ms advertising intervals */
+		bt_dev.hci_version = BT_HCI_VERSION_5_0;
+		bt_mesh_adv_bearer_set(&sim_bearer);
+		zassert_equal(bt_mesh_init(NULL, &comp), 0,
+			      "Mesh init failed");
+		initialized = true;
+	}
+
+	memset(&sim, 0, sizeof(sim));
+	k_sem_reset(&sent_sem);
+	bt_mesh_adv_stats_reset();
+}
+
+static void send(u8_t tag, enum bt_mesh_adv_prio prio,
+		 const struct bt_mesh_send_cb *cb)
+{
+	struct net_buf *buf;
+
+	buf = bt_mesh_adv_create(BT_MESH_ADV_DATA, XMIT, K_NO_WAIT);
+	zassert_not_null(buf, "Out of advertising buffers");
+
+	BT_MESH_ADV(buf)->prio = prio;
+	memset(net_buf_add(buf, 16), tag, 16);
+
+	bt_mesh_adv_send(buf, cb, NULL);
+	net_buf_unref(buf);
+}
+
+static void wait_idle(void)
+{
+	struct bt_mesh_adv_stats stats;
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		bt_mesh_adv_stats_get(&stats);
+		if (!stats.prio[BT_MESH_ADV_PRIO_LOCAL].depth &&
+		    !stats.prio[BT_MESH_ADV_PRIO_RELAY].depth && !sim.on) {
+			return;
+		}
+
+		k_sleep(K_MSEC(50));
+	}
+
+	zassert_unreachable("Advertising queue did not drain");
+}
+
+void test_local_priority(void)
+{
+	u32_t queued;
+	int i, pos;
+
+	setup();
+
+	for (i = 0; i < RELAY_PDUS; i++) {
+		send(i, BT_MESH_ADV_PRIO_RELAY, NULL);
+	}
+
+	queued = k_uptime_get_32();
+	send(TAG_LOCAL, BT_MESH_ADV_PRIO_LOCAL, &local_cb);
+
+	zassert_equal(k_sem_take(&sent_sem, K_SECONDS(5)), 0,
+		      "Local PDU not sent");
+	wait_idle();
+
+	for (pos = 0; pos < sim.log_len; pos++) {
+		if (sim.log[pos] == TAG_LOCAL) {
+			break;
+		}
+	}
+
+	zassert_true(pos < sim.log_len, "Local PDU never on air");
+
+	TC_PRINT("local PDU on air after %u relay slots, %u ms\n", pos,
+		 local_start - queued);
+
+	if (IS_ENABLED(CONFIG_BT_MESH_ADV_PRIO)) {
+		zassert_true(pos <= 1, "Local PDU waited behind relays");
+	} else {
+		/* Each relay stays on air for all of its transmissions */
+		zassert_equal(pos, RELAY_PDUS, "FIFO order not kept");
+	}
+
+	zassert_equal(sim.starts, 1, "Advertising restarted between PDUs");
+}
+
+void test_relay_dedup(void)
+{
+	struct bt_mesh_adv_stats stats;
+
+	setup();
+
+	/* Keep the bearer busy so that the relays stay queued */
+	send(TAG_LOCAL, BT_MESH_ADV_PRIO_LOCAL, &bench_cb);
+	send(1, BT_MESH_ADV_PRIO_RELAY, NULL);
+	send(1, BT_MESH_ADV_PRIO_RELAY, NULL);
+	send(2, BT_MESH_ADV_PRIO_RELAY, NULL);
+
+	bt_mesh_adv_stats_get(&stats);
+
+	wait_idle();
+
+	if (IS_ENABLED(CONFIG_BT_MESH_ADV_PRIO)) {
+		zassert_equal(stats.prio[BT_MESH_ADV_PRIO_RELAY].dropped, 1,
+			      "Duplicate relay not dropped");
+	} else {
+		zassert_equal(stats.prio[BT_MESH_ADV_PRIO_RELAY].dropped, 0,
+			      "Relay dropped without priority scheduling");
+	}
+}
+
+void test_throughput_benchmark(void)
+{
+	struct bt_mesh_adv_stats stats;
+	struct bt_mesh_adv_prio_stats *local;
+	u32_t start, elapsed;
+	int i;
+
+	setup();
+
+	start = k_uptime_get_32();
+
+	for (i = 0; i < BENCH_PDUS; i++) {
+		send(i, BT_MESH_ADV_PRIO_LOCAL, &bench_cb);
+	}
+
+	for (i = 0; i < BENCH_PDUS; i++) {
+		zassert_equal(k_sem_take(&sent_sem, K_SECONDS(10)), 0,
+			      "PDU not sent");
+	}
+
+	elapsed = k_uptime_get_32() - start;
+
+	wait_idle();
+	bt_mesh_adv_stats_get(&stats);
+	local = &stats.prio[BT_MESH_ADV_PRIO_LOCAL];
+
+	zassert_equal(local->sent, BENCH_PDUS, "Wrong number of PDUs sent");
+	zassert_true(local->depth_max >= BENCH_PDUS - 1, "Wrong queue depth");
+
+	TC_PRINT("priority scheduling %s: %u PDUs x %u in %u ms (%u PDU/s)\n",
+		 IS_ENABLED(CONFIG_BT_MESH_ADV_PRIO) ? "on" : "off",
+		 BENCH_PDUS, XMIT_COUNT, elapsed,
+		 BENCH_PDUS * 1000 / elapsed);
+	TC_PRINT("%u advertising starts, %u data updates\n", stats.starts,
+		 stats.updates);
+	TC_PRINT("queueing latency: avg %u ms, max %u ms\n",
+		 local->latency_sum / local->sent, local->latency_max);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(test_mesh_adv,
+			 ztest_unit_test(test_local_priority),
+			 ztest_unit_test(test_relay_dedup),
+			 ztest_unit_test(test_throughput_benchmark));
+
+	ztest_run_test_suite(test_mesh_adv);
+}
@@ -0,0 +1,233 @@
+/* main.c - Bluetooth Mesh NetKey/AppKey lookup tests */
+
+/*
+ * Copyright (c) 2019 Arcus Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <ztest.h>
+#include <tc_util.h>
+
+#include <net/buf.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/mesh.h>
+
+#include "crypto.h"
+#include "adv.h"
+#include "mesh.h"
+#include "net.h"
+#include "transport.h"
+#include "access.h"
+
+#define SUBNETS      CONFIG_BT_MESH_SUBNET_COUNT
+#define APP_KEYS     CONFIG_BT_MESH_APP_KEY_COUNT
+#define ROUNDS       8
+
+#define LOCAL_ADDR   0x0001
+#define REMOTE_ADDR  0x0100
+
+static struct bt_mesh_cfg_srv cfg_srv = {
+	.relay = BT_MESH_RELAY_NOT_SUPPORTED,
+	.beacon = BT_MESH_BEACON_DISABLED,
+	.frnd = BT_MESH_FRIEND_NOT_SUPPORTED,
+	.gatt_proxy = BT_MESH_GATT_PROXY_NOT_SUPPORTED,
+	.default_ttl = 7,
+	.net_transmit = BT_MESH_TRANSMIT(0, 20),
+	.relay_retransmit = BT_MESH_TRANSMIT(0, 20),
+};
+
+static struct bt_mesh_model root_models[] = {
+	BT_MESH_MODEL_CFG_SRV(&cfg_srv),
+};
+
+static struct bt_mesh_elem elements[] = {
+	BT_MESH_ELEM(0, root_models, BT_MESH_MODEL_NONE),
+};
+
+static const struct bt_mesh_comp comp = {
+	.cid = BT_COMP_ID_LF,
+	.elem = elements,
+	.elem_count = ARRAY_SIZE(elements),
+};
+
+static void key_fill(u8_t key[16], u8_t seed)
+{
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		key[i] = seed * 31 + i * 7;
+	}
+}
+
+static void setup(void)
+{
+	u8_t key[16];
+	int i;
+
+	zassert_equal(bt_mesh_init(NULL, &comp), 0, "Mesh init failed");
+
+	key_fill(key, 0);
+	zassert_equal(bt_mesh_net_create(0, 0, key, 0), 0,
+		      "Net create failed");
+	bt_mesh_comp_provision(LOCAL_ADDR);
+
+	for (i = 1; i < SUBNETS; i++) {
+		struct bt_mesh_subnet *sub = &bt_mesh.sub[i];
+
+		key_fill(key, i);
+		zassert_equal(bt_mesh_net_keys_create(&sub->keys[0], key), 0,
+			      "NetKey create failed");
+		sub->net_idx = i;
+		sub->kr_phase = BT_MESH_KR_NORMAL;
+	}
+
+	for (i = 0; i < APP_KEYS; i++) {
+		struct bt_mesh_app_key *app = &bt_mesh.app_keys[i];
+
+		key_fill(app->keys[0].val, 0x80 + i);
+		zassert_equal(bt_mesh_app_id(app->keys[0].val,
+					     &app->keys[0].id), 0,
+			      "AppKey ID failed");
+		app->net_idx = i % SUBNETS;
+		app->app_idx = i;
+		app->updated = false;
+	}
+
+	bt_mesh_app_lut_invalidate();
+}
+
+/* Number of decryption attempts the lookup is expected to make: every
+ * earlier key with the same identifier is tried (and fails) first.
+ */
+static u32_t net_expected(int idx)
+{
+	u32_t trials = 1;
+	int i;
+
+	for (i = 0; i < idx; i++) {
+		if (bt_mesh.sub[i].keys[0].nid == bt_mesh.sub[idx].keys[0].nid) {
+			trials++;
+		}
+	}
+
+	return trials;
+}
+
+static u32_t app_expected(int idx)
+{
+	struct bt_mesh_app_key *app = &bt_mesh.app_keys[idx];
+	u32_t trials = 1;
+	int i;
+
+	for (i = 0; i < idx; i++) {
+		if (bt_mesh.app_keys[i].net_idx == app->net_idx &&
+		    bt_mesh.app_keys[i].keys[0].id == app->keys[0].id) {
+			trials++;
+		}
+	}
+
+	return trials;
+}
+
+static void encode(struct net_buf_simple *pdu, struct bt_mesh_app_key *app)
+{
+	NET_BUF_SIMPLE_DEFINE(sdu, 16);
+	struct bt_mesh_msg_ctx ctx = {
+		.net_idx = app->net_idx,
+		.app_idx = app->app_idx,
+		.addr = LOCAL_ADDR,
+		.send_ttl = 0,
+	};
+	struct bt_mesh_net_tx tx = {
+		.sub = bt_mesh_subnet_get(app->net_idx),
+		.ctx = &ctx,
+		.src = REMOTE_ADDR,
+	};
+	int err;
+
+	/* Health Fault Get opcode, which no local model handles */
+	net_buf_simple_add_be16(&sdu, 0x8031);
+	net_buf_simple_add_le16(&sdu, BT_COMP_ID_LF);
+
+	err = bt_mesh_app_encrypt(app->keys[0].val, false, 0, &sdu, NULL,
+				  REMOTE_ADDR, LOCAL_ADDR, bt_mesh.seq,
+				  BT_MESH_NET_IVI_TX);
+	zassert_equal(err, 0, "App encrypt failed");
+
+	net_buf_simple_reset(pdu);
+	net_buf_simple_reserve(pdu, BT_MESH_NET_HDR_LEN);
+	net_buf_simple_add_u8(pdu, BIT(6) | app->keys[0].id);
+	memcpy(net_buf_simple_add(pdu, sdu.len), sdu.data, sdu.len);
+
+	err = bt_mesh_net_encode(&tx, pdu, false);
+	zassert_equal(err, 0, "Net encode failed");
+}
+
+void test_key_lookup(void)
+{
+	NET_BUF_SIMPLE_DEFINE(pdu, 29);
+	NET_BUF_SIMPLE_DEFINE(buf, 29);
+	u32_t net_trials = 0, app_trials = 0;
+	u32_t cycles = 0;
+	int round, i;
+
+	setup();
+
+	memset(&bt_mesh_key_stats, 0, sizeof(bt_mesh_key_stats));
+
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 0; i < APP_KEYS; i++) {
+			struct bt_mesh_app_key *app = &bt_mesh.app_keys[i];
+			struct bt_mesh_net_rx rx = { 0 };
+			u32_t start;
+			int err;
+
+			encode(&pdu, app);
+
+			start = k_cycle_get_32();
+
+			err = bt_mesh_net_decode(&pdu, BT_MESH_NET_IF_ADV,
+						 &rx, &buf);
+			zassert_equal(err, 0, "Net decode failed");
+			zassert_equal(rx.sub->net_idx, app->net_idx,
+				      "Decrypted with the wrong NetKey");
+
+			rx.local_match = 1;
+			err = bt_mesh_trans_recv(&buf, &rx);
+			zassert_equal(err, 0, "Trans recv failed");
+			zassert_equal(rx.ctx.app_idx, app->app_idx,
+				      "Decrypted with the wrong AppKey");
+
+			cycles += k_cycle_get_32() - start;
+
+			net_trials += net_expected(app->net_idx);
+			app_trials += app_expected(i);
+		}
+	}
+
+	zassert_equal(bt_mesh_key_stats.net_nomatch, 0, "Unmatched PDUs");
+	zassert_equal(bt_mesh_key_stats.app_nomatch, 0, "Unmatched SDUs");
+	zassert_equal(bt_mesh_key_stats.net_trials, net_trials,
+		      "Unexpected NetKey trial count");
+	zassert_equal(bt_mesh_key_stats.app_trials, app_trials,
+		      "Unexpected AppKey trial count");
+
+	TC_PRINT("%u subnets, %u app keys, lookup tables %s\n", SUBNETS,
+		 APP_KEYS, IS_ENABLED(CONFIG_BT_MESH_KEY_LUT) ? "on" : "off");
+	TC_PRINT("%u PDUs: %u net trials, %u app trials\n",
+		 bt_mesh_key_stats.net_pdus, bt_mesh_key_stats.net_trials,
+		 bt_mesh_key_stats.app_trials);
+	TC_PRINT("%u cycles per PDU\n",
+		 cycles / bt_mesh_key_stats.net_pdus);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(test_mesh_keys,
+			 ztest_unit_test(test_key_lookup));
+
+	ztest_run_test_suite(test_mesh_keys);
+}
@@ -0,0 +1,280 @@
+/* main.c - Bluetooth Mesh segmented message reassembly tests */
+
+/*
+ * Copyright (c) 2019 Arcus Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <ztest.h>
+#include <tc_util.h>
+
+#include <net/buf.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/mesh.h>
+
+#include "crypto.h"
+#include "adv.h"
+#include "mesh.h"
+#include "net.h"
+#include "transport.h"
+#include "access.h"
+
+#define SENDERS      CONFIG_BT_MESH_RX_SEG_MSG_COUNT
+#define ROUNDS       8
+
+/* 8 segments: 3 byte OpCode, 89 bytes of payload and a 4 byte MIC */
+#define PAYLOAD_LEN  89
+#define SEGS         ((3 + PAYLOAD_LEN + 4 + 11) / 12)
+
+#define LOCAL_ADDR   0x0001
+#define REMOTE_ADDR  0x0100
+#define GROUP_ADDR   0xc000
+
+#define CID          0x0059
+#define OP_BLOB      BT_MESH_MODEL_OP_3(0x01, CID)
+
+static struct bt_mesh_cfg_srv cfg_srv = {
+	.relay = BT_MESH_RELAY_NOT_SUPPORTED,
+	.beacon = BT_MESH_BEACON_DISABLED,
+	.frnd = BT_MESH_FRIEND_NOT_SUPPORTED,
+	.gatt_proxy = BT_MESH_GATT_PROXY_NOT_SUPPORTED,
+	.default_ttl = 7,
+	.net_transmit = BT_MESH_TRANSMIT(0, 20),
+	.relay_retransmit = BT_MESH_TRANSMIT(0, 20),
+};
+
+static u32_t received[SENDERS];
+static u32_t corrupted;
+
+static void blob_recv(struct bt_mesh_model *model,
+		      struct bt_mesh_msg_ctx *ctx,
+		      struct net_buf_simple *buf)
+{
+	int sender = ctx->addr - REMOTE_ADDR;
+	int i;
+
+	if (sender < 0 || sender >= SENDERS || buf->len != PAYLOAD_LEN) {
+		corrupted++;
+		return;
+	}
+
+	for (i = 0; i < buf->len; i++) {
+		if (buf->data[i] != (u8_t)(sender * 16 + i)) {
+			corrupted++;
+			return;
+		}
+	}
+
+	received[sender]++;
+}
+
+static const struct bt_mesh_model_op blob_ops[] = {
+	{ OP_BLOB, 0, blob_recv },
+	BT_MESH_MODEL_OP_END,
+};
+
+static struct bt_mesh_model root_models[] = {
+	BT_MESH_MODEL_CFG_SRV(&cfg_srv),
+};
+
+static struct bt_mesh_model vnd_models[] = {
+	BT_MESH_MODEL_VND(CID, 0x0001, blob_ops, NULL, NULL),
+};
+
+static struct bt_mesh_elem elements[] = {
+	BT_MESH_ELEM(0, root_models, vnd_models),
+};
+
+static const struct bt_mesh_comp comp = {
+	.cid = CID,
+	.elem = elements,
+	.elem_count = ARRAY_SIZE(elements),
+};
+
+static u8_t pdu_data[SENDERS][SEGS][29];
+static struct net_buf_simple pdus[SENDERS][SEGS];
+
+static void setup(void)
+{
+	struct bt_mesh_app_key *app = &bt_mesh.app_keys[0];
+	u8_t key[16];
+	int i;
+
+	zassert_equal(bt_mesh_init(NULL, &comp), 0, "Mesh init failed");
+
+	memset(key, 0x11, sizeof(key));
+	zassert_equal(bt_mesh_net_create(0, 0, key, 0), 0,
+		      "Net create failed");
+	bt_mesh_comp_provision(LOCAL_ADDR);
+
+	for (i = 0; i < 16; i++) {
+		app->keys[0].val[i] = 0x80 + i;
+	}
+
+	zassert_equal(bt_mesh_app_id(app->keys[0].val, &app->keys[0].id), 0,
+		      "AppKey ID failed");
+	app->net_idx = 0;
+	app->app_idx = 0;
+	app->updated = false;
+	bt_mesh_app_lut_invalidate();
+
+	vnd_models[0].keys[0] = 0;
+	vnd_models[0].groups[0] = GROUP_ADDR;
+	bt_mesh_group_index_invalidate();
+
+	for (i = 0; i < SENDERS; i++) {
+		int j;
+
+		for (j = 0; j < SEGS; j++) {
+			pdus[i][j].__buf = pdu_data[i][j];
+			pdus[i][j].size = sizeof(pdu_data[i][j]);
+		}
+	}
+}
+
+/* Encrypt one SDU and split it into Network PDUs, the way a remote node
+ * would send it.
+ */
+static void encode(int sender)
+{
+	NET_BUF_SIMPLE_DEFINE(sdu, SEGS * 12);
+	struct bt_mesh_app_key *app = &bt_mesh.app_keys[0];
+	struct bt_mesh_msg_ctx ctx = {
+		.net_idx = 0,
+		.app_idx = 0,
+		.addr = GROUP_ADDR,
+		.send_ttl = 0,
+	};
+	struct bt_mesh_net_tx tx = {
+		.sub = bt_mesh_subnet_get(0),
+		.ctx = &ctx,
+		.src = REMOTE_ADDR + sender,
+	};
+	u16_t seq_zero = bt_mesh.seq & 0x1fff;
+	int i, err;
+
+	bt_mesh_model_msg_init(&sdu, OP_BLOB);
+	for (i = 0; i < PAYLOAD_LEN; i++) {
+		net_buf_simple_add_u8(&sdu, sender * 16 + i);
+	}
+
+	err = bt_mesh_app_encrypt(app->keys[0].val, false, 0, &sdu, NULL,
+				  tx.src, GROUP_ADDR, bt_mesh.seq,
+				  BT_MESH_NET_IVI_TX);
+	zassert_equal(err, 0, "App encrypt failed");
+	zassert_equal((sdu.len + 11) / 12, SEGS, "Unexpected segment count");
+
+	for (i = 0; i < SEGS; i++) {
+		struct net_buf_simple *pdu = &pdus[sender][i];
+		u32_t seg_hdr = (seq_zero << 10) | (i << 5) | (SEGS - 1);
+		u16_t len = min(12, sdu.len - i * 12);
+
+		net_buf_simple_init(pdu, BT_MESH_NET_HDR_LEN);
+		net_buf_simple_add_u8(pdu, 0xc0 | app->keys[0].id);
+		net_buf_simple_add_u8(pdu, seg_hdr >> 16);
+		net_buf_simple_add_be16(pdu, seg_hdr);
+		memcpy(net_buf_simple_add(pdu, len), &sdu.data[i * 12], len);
+
+		err = bt_mesh_net_encode(&tx, pdu, false);
+		zassert_equal(err, 0, "Net encode failed");
+	}
+}
+
+static u32_t receive(struct net_buf_simple *pdu)
+{
+	NET_BUF_SIMPLE_DEFINE(buf, 29);
+	struct bt_mesh_net_rx rx = { 0 };
+	u32_t start;
+	int err;
+
+	start = k_cycle_get_32();
+
+	err = bt_mesh_net_decode(pdu, BT_MESH_NET_IF_ADV, &rx, &buf);
+	zassert_equal(err, 0, "Net decode failed");
+
+	rx.local_match = 1;
+	err = bt_mesh_trans_recv(&buf, &rx);
+	zassert_equal(err, 0, "Trans recv failed");
+
+	return k_cycle_get_32() - start;
+}
+
+void test_concurrent_reassembly(void)
+{
+	u32_t cycles = 0;
+	int round, seg, i;
+
+	setup();
+
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 0; i < SENDERS; i++) {
+			encode(i);
+		}
+
+		/* Interleave the segments of all senders, last to first
+		 * to keep the reassembly out of order.
+		 */
+		for (seg = SEGS - 1; seg >= 0; seg--) {
+			for (i = 0; i < SENDERS; i++) {
+				cycles += receive(&pdus[i][seg]);
+			}
+		}
+	}
+
+	zassert_equal(corrupted, 0, "Corrupted SDUs delivered");
+
+	for (i = 0; i < SENDERS; i++) {
+		zassert_equal(received[i], ROUNDS, "SDUs lost");
+	}
+
+	TC_PRINT("%u senders x %u rounds, %u segments each, pool %s\n",
+		 SENDERS, ROUNDS, SEGS,
+		 IS_ENABLED(CONFIG_BT_MESH_RX_SEG_POOL) ? "on" : "off");
+	TC_PRINT("%u cycles per SDU\n", cycles / (SENDERS * ROUNDS));
+
+#if defined(CONFIG_BT_MESH_RX_SEG_POOL)
+	TC_PRINT("reassembly memory: peak %u of %u bytes\n",
+		 bt_mesh_rx_seg_stats.peak, CONFIG_BT_MESH_RX_SEG_POOL_SIZE);
+
+	zassert_equal(bt_mesh_rx_seg_stats.sdus, SENDERS * ROUNDS,
+		      "Wrong number of reassembled SDUs");
+	zassert_equal(bt_mesh_rx_seg_stats.used, 0, "Reassembly memory leak");
+	zassert_equal(bt_mesh_rx_seg_stats.peak, SENDERS * SEGS * 12,
+		      "Unexpected reassembly memory usage");
+#else
+	TC_PRINT("reassembly memory: %u bytes\n",
+		 CONFIG_BT_MESH_RX_SEG_MSG_COUNT * CONFIG_BT_MESH_RX_SDU_MAX);
+#endif
+}
+
+void test_memory_accounting(void)
+{
+#if defined(CONFIG_BT_MESH_RX_SEG_POOL)
+	int i;
+
+	/* Start a message from every sender without completing any */
+	for (i = 0; i < SENDERS; i++) {
+		encode(i);
+		receive(&pdus[i][0]);
+	}
+
+	zassert_equal(bt_mesh_rx_seg_stats.used, SENDERS * SEGS * 12,
+		      "Wrong pool usage for incomplete messages");
+
+	bt_mesh_rx_reset();
+
+	zassert_equal(bt_mesh_rx_seg_stats.used, 0, "Pool not released");
+#endif
+}
+
+void test_main(void)
+{
+	ztest_test_suite(test_mesh_reassembly,
+			 ztest_unit_test(test_concurrent_reassembly),
+			 ztest_unit_test(test_memory_accounting));
+
+	ztest_run_test_suite(test_mesh_reassembly);
+}
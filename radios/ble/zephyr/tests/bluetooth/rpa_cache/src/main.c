@@ -0,0 +1,213 @@
+/* main.c - Resolvable Private Address cache tests */
+
+/*
+ * Copyright (c) 2019 Arcus Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <ztest.h>
+#include <tc_util.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/crypto.h>
+
+#include "host/keys.h"
+
+#define BONDS        CONFIG_BT_MAX_PAIRED
+/* Bonded devices that show up in the trace */
+#define BONDED_SEEN  4
+/* Unrelated devices, e.g. phones, advertising with their own RPAs */
+#define STRANGERS    28
+#define DEVICES      (BONDED_SEEN + STRANGERS)
+#define REPORTS      2048
+
+struct device {
+	u8_t irk[16];
+	bt_addr_le_t rpa;
+	bool seen;
+};
+
+static struct device devices[DEVICES];
+static bt_addr_le_t identities[BONDS];
+static u32_t distinct;
+
+static u32_t rand_state = 0x12345678;
+
+static u32_t trace_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+
+	return rand_state >> 8;
+}
+
+/* Generate a fresh RPA for the device, as its controller would */
+static void rpa_rotate(struct device *dev)
+{
+	u8_t res[16] = { 0 };
+	u32_t prand = trace_rand();
+
+	dev->rpa.type = BT_ADDR_LE_RANDOM;
+	dev->rpa.a.val[3] = prand;
+	dev->rpa.a.val[4] = prand >> 8;
+	dev->rpa.a.val[5] = prand >> 16;
+	BT_ADDR_SET_RPA(&dev->rpa.a);
+
+	memcpy(res, dev->rpa.a.val + 3, 3);
+	zassert_equal(bt_encrypt_le(dev->irk, res, res), 0, "AES failed");
+	memcpy(dev->rpa.a.val, res, 3);
+
+	dev->seen = false;
+}
+
+static void bond_add(int i, const u8_t irk[16])
+{
+	struct bt_keys *keys;
+
+	keys = bt_keys_get_type(BT_KEYS_IRK, &identities[i]);
+	zassert_not_null(keys, "No room for keys");
+	memcpy(keys->irk.val, irk, 16);
+}
+
+static void setup(void)
+{
+	int i, j;
+
+	for (i = 0; i < BONDS; i++) {
+		identities[i].type = BT_ADDR_LE_PUBLIC;
+		for (j = 0; j < 6; j++) {
+			identities[i].a.val[j] = 0xa0 + i;
+		}
+	}
+
+	for (i = 0; i < DEVICES; i++) {
+		for (j = 0; j < 16; j++) {
+			devices[i].irk[j] = trace_rand();
+		}
+
+		rpa_rotate(&devices[i]);
+	}
+
+	/* All pairing slots are in use, most bonds are not around */
+	for (i = 0; i < BONDS; i++) {
+		u8_t irk[16];
+
+		if (i < BONDED_SEEN) {
+			bond_add(i, devices[i].irk);
+		} else {
+			memset(irk, 0x40 + i, sizeof(irk));
+			bond_add(i, irk);
+		}
+	}
+}
+
+/* Replay one advertising report through the same lookup that
+ * le_adv_report() does.
+ */
+static void report(struct device *dev)
+{
+	int i = dev - devices;
+	struct bt_keys *keys;
+
+	keys = bt_keys_find_irk(&dev->rpa);
+
+	if (i < BONDED_SEEN) {
+		zassert_not_null(keys, "Bonded device not resolved");
+		zassert_equal(bt_addr_le_cmp(&keys->addr, &identities[i]), 0,
+			      "Resolved to the wrong identity");
+	} else {
+		zassert_is_null(keys, "Unrelated device resolved");
+	}
+
+	if (!dev->seen) {
+		dev->seen = true;
+		distinct++;
+	}
+}
+
+void test_trace_replay(void)
+{
+	u32_t start, cycles;
+	int i;
+
+	setup();
+
+#if defined(CONFIG_BT_RPA_CACHE)
+	memset(&bt_rpa_cache_stats, 0, sizeof(bt_rpa_cache_stats));
+#endif
+
+	start = k_cycle_get_32();
+
+	for (i = 0; i < REPORTS; i++) {
+		int dev;
+
+		/* Bonded devices rotate their address half way through */
+		if (i == REPORTS / 2) {
+			for (dev = 0; dev < BONDED_SEEN; dev++) {
+				rpa_rotate(&devices[dev]);
+			}
+		}
+
+		report(&devices[trace_rand() % DEVICES]);
+	}
+
+	cycles = k_cycle_get_32() - start;
+
+	TC_PRINT("%u reports from %u addresses, %u IRKs, cache %s\n",
+		 REPORTS, distinct, BONDS,
+		 IS_ENABLED(CONFIG_BT_RPA_CACHE) ? "on" : "off");
+	TC_PRINT("%u cycles per report\n", cycles / REPORTS);
+
+#if defined(CONFIG_BT_RPA_CACHE)
+	TC_PRINT("%u lookups: %u resolved, %u hits, %u negative hits\n",
+		 bt_rpa_cache_stats.lookups, bt_rpa_cache_stats.resolutions,
+		 bt_rpa_cache_stats.hits, bt_rpa_cache_stats.neg_hits);
+
+	zassert_equal(bt_rpa_cache_stats.lookups,
+		      bt_rpa_cache_stats.resolutions +
+		      bt_rpa_cache_stats.hits + bt_rpa_cache_stats.neg_hits,
+		      "Inconsistent counters");
+	/* Everything fits in the cache: each address is resolved once */
+	zassert_equal(bt_rpa_cache_stats.resolutions, distinct,
+		      "Addresses resolved more than once");
+#endif
+}
+
+void test_bond_change(void)
+{
+	struct device *stranger = &devices[BONDED_SEEN];
+	struct bt_keys *keys;
+
+	/* Known as unresolvable after the trace */
+	zassert_is_null(bt_keys_find_irk(&stranger->rpa), "Stranger resolved");
+
+	/* Pair with it: the negative entry must not stick */
+	keys = bt_keys_find_addr(&identities[BONDS - 1]);
+	zassert_not_null(keys, "Bond missing");
+	memcpy(keys->irk.val, stranger->irk, 16);
+
+	keys = bt_keys_find_irk(&stranger->rpa);
+	zassert_not_null(keys, "New bond not resolved");
+	zassert_equal(bt_addr_le_cmp(&keys->addr, &identities[BONDS - 1]), 0,
+		      "Resolved to the wrong identity");
+
+	/* Unpair a device seen before: its entries must go too */
+	keys = bt_keys_find_addr(&identities[0]);
+	zassert_not_null(keys, "Bond missing");
+	bt_keys_clear(keys);
+
+	zassert_is_null(bt_keys_find_irk(&devices[0].rpa),
+			"Removed bond still resolved");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(test_rpa_cache,
+			 ztest_unit_test(test_trace_replay),
+			 ztest_unit_test(test_bond_change));
+
+	ztest_run_test_suite(test_rpa_cache);
+}
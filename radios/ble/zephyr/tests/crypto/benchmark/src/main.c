@@ -0,0 +1,293 @@
+/* main.c - TinyCrypt AES mode benchmarks */
+
+/*
+ * Copyright (c) 2019 Arcus Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <ztest.h>
+#include <tc_util.h>
+
+#include <tinycrypt/aes.h>
+#include <tinycrypt/ctr_mode.h>
+#include <tinycrypt/ccm_mode.h>
+#include <tinycrypt/cmac_mode.h>
+#include <tinycrypt/constants.h>
+
+#define DATA_LEN     1024
+#define ROUNDS       16
+
+/* Bluetooth Mesh sized CCM payload: 12 byte segment plus OpCode */
+#define CCM_LEN      15
+#define CCM_MIC_LEN  8
+
+static const u8_t key[TC_AES_KEY_SIZE] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+};
+
+/* FIPS-197 Appendix C.1 */
+static const u8_t fips_pt[TC_AES_BLOCK_SIZE] = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+	0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+};
+
+static const u8_t fips_ct[TC_AES_BLOCK_SIZE] = {
+	0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+	0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a,
+};
+
+static struct tc_aes_key_sched_struct sched;
+static u8_t data[DATA_LEN];
+static u8_t out[DATA_LEN + CCM_MIC_LEN];
+
+#if defined(CONFIG_TINYCRYPT_AES_ECB_HW)
+static u32_t hw_calls;
+static u32_t hw_blocks;
+
+/* Engine that is always busy: counts the requests and lets software do
+ * the work.
+ */
+static int busy_hw(u8_t *out, const u8_t *in, unsigned int nblocks,
+		   const u8_t k[TC_AES_KEY_SIZE])
+{
+	zassert_true(!memcmp(k, key, sizeof(key)), "Wrong key for engine");
+
+	hw_calls++;
+	hw_blocks += nblocks;
+
+	return TC_CRYPTO_FAIL;
+}
+#endif
+
+static void setup(void)
+{
+	int i;
+
+	for (i = 0; i < sizeof(data); i++) {
+		data[i] = i;
+	}
+
+	zassert_true(tc_aes128_set_encrypt_key(&sched, key), "Key setup failed");
+}
+
+/* Cycles per byte, in hundredths */
+static void report(const char *name, u32_t cycles, u32_t bytes)
+{
+	u32_t cpb = (u64_t)cycles * 100 / bytes;
+
+	TC_PRINT("%-12s %6u.%02u cycles/byte\n", name, cpb / 100, cpb % 100);
+}
+
+void test_aes_vector(void)
+{
+	u8_t blocks[3 * TC_AES_BLOCK_SIZE];
+	u8_t ct[TC_AES_BLOCK_SIZE];
+	int i;
+
+	setup();
+
+	zassert_true(tc_aes_encrypt(ct, fips_pt, &sched), "Encrypt failed");
+	zassert_true(!memcmp(ct, fips_ct, sizeof(ct)), "Wrong ciphertext");
+
+	for (i = 0; i < 3; i++) {
+		memcpy(&blocks[i * TC_AES_BLOCK_SIZE], fips_pt,
+		       TC_AES_BLOCK_SIZE);
+	}
+
+	zassert_true(tc_aes_encrypt_blocks(blocks, blocks, 3, &sched),
+		     "Multi-block encrypt failed");
+
+	for (i = 0; i < 3; i++) {
+		zassert_true(!memcmp(&blocks[i * TC_AES_BLOCK_SIZE], fips_ct,
+				     TC_AES_BLOCK_SIZE),
+			     "Wrong multi-block ciphertext");
+	}
+}
+
+void test_ctr_batches(void)
+{
+	u8_t ctr[TC_AES_BLOCK_SIZE] = { 0 };
+	u8_t ref[TC_AES_BLOCK_SIZE];
+	u8_t nonce[TC_AES_BLOCK_SIZE];
+	int i, j;
+
+	setup();
+
+	/* Start close to the 32-bit counter wrap */
+	ctr[12] = ctr[13] = ctr[14] = 0xff;
+	ctr[15] = 0xfd;
+	memcpy(nonce, ctr, sizeof(nonce));
+
+	zassert_true(tc_ctr_mode(out, 100, data, 100, ctr, &sched),
+		     "CTR failed");
+
+	/* Reference: one block at a time */
+	for (i = 0; i < 100; i += TC_AES_BLOCK_SIZE) {
+		tc_aes_encrypt(ref, nonce, &sched);
+
+		for (j = 0; j < TC_AES_BLOCK_SIZE && i + j < 100; j++) {
+			zassert_equal(out[i + j], ref[j] ^ data[i + j],
+				      "Wrong keystream");
+		}
+
+		for (j = TC_AES_BLOCK_SIZE - 1; j >= 12; j--) {
+			if (++nonce[j]) {
+				break;
+			}
+		}
+	}
+
+	zassert_true(!memcmp(ctr, nonce, sizeof(ctr)), "Wrong final counter");
+}
+
+void test_ccm_roundtrip(void)
+{
+	static const u16_t lens[] = { 0, 1, CCM_LEN, 16, 17, 380 };
+	struct tc_ccm_mode_struct ccm;
+	u8_t nonce[13] = { 0 };
+	u8_t plain[380];
+	u8_t aad[4] = { 0x12, 0x34, 0x56, 0x78 };
+	int i;
+
+	setup();
+
+	tc_ccm_config(&ccm, &sched, nonce, sizeof(nonce), CCM_MIC_LEN);
+
+	for (i = 0; i < ARRAY_SIZE(lens); i++) {
+		u16_t len = lens[i];
+
+		zassert_true(tc_ccm_generation_encryption(out, sizeof(out),
+							  aad, sizeof(aad),
+							  data, len, &ccm),
+			     "CCM encrypt failed");
+		zassert_true(tc_ccm_decryption_verification(plain,
+							    sizeof(plain),
+							    aad, sizeof(aad),
+							    out,
+							    len + CCM_MIC_LEN,
+							    &ccm),
+			     "CCM decrypt failed");
+		zassert_true(!memcmp(plain, data, len), "Wrong plaintext");
+
+		out[len / 2] ^= 0x01;
+		zassert_false(tc_ccm_decryption_verification(plain,
+							     sizeof(plain),
+							     aad, sizeof(aad),
+							     out,
+							     len + CCM_MIC_LEN,
+							     &ccm),
+			      "Tampered message accepted");
+	}
+}
+
+void test_benchmark(void)
+{
+	struct tc_ccm_mode_struct ccm;
+	struct tc_cmac_struct cmac;
+	u8_t nonce[13] = { 0 };
+	u8_t ctr[TC_AES_BLOCK_SIZE] = { 0 };
+	u8_t tag[TC_AES_BLOCK_SIZE];
+	u32_t start, cycles;
+	int i, j;
+
+	setup();
+
+	TC_PRINT("AES implementation: %s\n",
+		 IS_ENABLED(CONFIG_TINYCRYPT_AES_TTABLE) ? "T-table" :
+		 "byte-oriented");
+
+	start = k_cycle_get_32();
+	for (i = 0; i < ROUNDS; i++) {
+		for (j = 0; j < DATA_LEN; j += TC_AES_BLOCK_SIZE) {
+			tc_aes_encrypt(&out[j], &data[j], &sched);
+		}
+	}
+	cycles = k_cycle_get_32() - start;
+	report("AES-ECB", cycles, ROUNDS * DATA_LEN);
+
+	start = k_cycle_get_32();
+	for (i = 0; i < ROUNDS; i++) {
+		tc_ctr_mode(out, DATA_LEN, data, DATA_LEN, ctr, &sched);
+	}
+	cycles = k_cycle_get_32() - start;
+	report("AES-CTR", cycles, ROUNDS * DATA_LEN);
+
+	tc_ccm_config(&ccm, &sched, nonce, sizeof(nonce), CCM_MIC_LEN);
+
+	start = k_cycle_get_32();
+	for (i = 0; i < ROUNDS; i++) {
+		tc_ccm_generation_encryption(out, sizeof(out), NULL, 0, data,
+					     DATA_LEN, &ccm);
+	}
+	cycles = k_cycle_get_32() - start;
+	report("AES-CCM enc", cycles, ROUNDS * DATA_LEN);
+
+	start = k_cycle_get_32();
+	for (i = 0; i < ROUNDS; i++) {
+		tc_ccm_decryption_verification(data, sizeof(data), NULL, 0,
+					       out, DATA_LEN + CCM_MIC_LEN,
+					       &ccm);
+	}
+	cycles = k_cycle_get_32() - start;
+	report("AES-CCM dec", cycles, ROUNDS * DATA_LEN);
+
+	/* Short messages, where the per-call overhead dominates */
+	start = k_cycle_get_32();
+	for (i = 0; i < ROUNDS * 64; i++) {
+		tc_ccm_generation_encryption(out, sizeof(out), NULL, 0, data,
+					     CCM_LEN, &ccm);
+	}
+	cycles = k_cycle_get_32() - start;
+	report("AES-CCM 15B", cycles, ROUNDS * 64 * CCM_LEN);
+
+	tc_cmac_setup(&cmac, key, &sched);
+
+	start = k_cycle_get_32();
+	for (i = 0; i < ROUNDS; i++) {
+		tc_cmac_init(&cmac);
+		tc_cmac_update(&cmac, data, DATA_LEN);
+		tc_cmac_final(tag, &cmac);
+	}
+	cycles = k_cycle_get_32() - start;
+	report("AES-CMAC", cycles, ROUNDS * DATA_LEN);
+}
+
+void test_ecb_hw_hook(void)
+{
+#if defined(CONFIG_TINYCRYPT_AES_ECB_HW)
+	u8_t ctr[TC_AES_BLOCK_SIZE] = { 0 };
+
+	setup();
+
+	tc_aes_ecb_hw_register(busy_hw);
+
+	/* 100 bytes is 7 counter blocks: one full batch and a partial one */
+	hw_calls = hw_blocks = 0;
+	zassert_true(tc_ctr_mode(out, 100, data, 100, ctr, &sched),
+		     "CTR failed");
+	zassert_equal(hw_blocks, 7, "Blocks not offered to the engine");
+	zassert_equal(hw_calls, 2, "Counter blocks not batched");
+
+	tc_aes_ecb_hw_register(NULL);
+
+	hw_calls = 0;
+	tc_aes_encrypt(out, data, &sched);
+	zassert_equal(hw_calls, 0, "Engine still registered");
+#endif
+}
+
+void test_main(void)
+{
+	ztest_test_suite(test_tinycrypt_benchmark,
+			 ztest_unit_test(test_aes_vector),
+			 ztest_unit_test(test_ctr_batches),
+			 ztest_unit_test(test_ccm_roundtrip),
+			 ztest_unit_test(test_benchmark),
+			 ztest_unit_test(test_ecb_hw_hook));
+
+	ztest_run_test_suite(test_tinycrypt_benchmark);
+}
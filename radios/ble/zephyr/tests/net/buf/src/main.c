@@ -14,6 +14,7 @@
 #include <net/buf.h>
 
 #include <ztest.h>
+#include <tc_util.h>
 
 #define TEST_TIMEOUT SECONDS(1)
 
@@ -66,6 +67,7 @@ static void var_destroy(struct net_buf *buf);
 NET_BUF_POOL_HEAP_DEFINE(bufs_pool, 10, buf_destroy);
 NET_BUF_POOL_FIXED_DEFINE(fixed_pool, 10, 128, fixed_destroy);
 NET_BUF_POOL_VAR_DEFINE(var_pool, 10, 1024, var_destroy);
+NET_BUF_POOL_FIXED_DEFINE(batch_pool, 16, 64, NULL);
 
 static void buf_destroy(struct net_buf *buf)
 {
@@ -457,6 +459,154 @@ static void net_buf_test_var_pool(void)
 	zassert_equal(destroy_called, 3, "Incorrect destroy callback count");
 }
 
+static void net_buf_test_batch(void)
+{
+	struct net_buf *bufs[16];
+	int i, j;
+
+	destroy_called = 0;
+
+	zassert_equal(net_buf_alloc_batch(&fixed_pool, 20, bufs, 10,
+					  K_NO_WAIT), 0,
+		      "Failed to get buffers");
+
+	for (i = 0; i < 10; i++) {
+		zassert_not_null(bufs[i]->data, "Buffer without data");
+		zassert_equal(bufs[i]->ref, 1, "Invalid refcount");
+
+		for (j = 0; j < i; j++) {
+			zassert_not_equal(bufs[i], bufs[j], "Buffer twice");
+		}
+	}
+
+	/* All or nothing when the pool is exhausted */
+	zassert_equal(net_buf_alloc_batch(&fixed_pool, 20, &bufs[10], 1,
+					  K_NO_WAIT), -ENOMEM,
+		      "Got a buffer from an empty pool");
+
+	net_buf_unref_batch(bufs, 10);
+	zassert_equal(destroy_called, 10, "Incorrect destroy callback count");
+
+	/* Pool without destroy callback, buffers go back as a list */
+	zassert_equal(net_buf_alloc_batch(&batch_pool, 64, bufs, 12,
+					  K_NO_WAIT), 0,
+		      "Failed to get buffers");
+	net_buf_frag_add(bufs[0], bufs[1]);
+	net_buf_ref(bufs[2]);
+
+	zassert_equal(net_buf_alloc_batch(&batch_pool, 64, &bufs[12], 5,
+					  K_NO_WAIT), -ENOMEM,
+		      "Got more buffers than the pool has");
+
+	/* bufs[1] is released as a fragment of bufs[0] */
+	bufs[1] = NULL;
+	net_buf_unref_batch(bufs, 12);
+	net_buf_unref(bufs[2]);
+
+	zassert_equal(net_buf_alloc_batch(&batch_pool, 64, bufs, 16,
+					  K_NO_WAIT), 0,
+		      "Buffers not returned to the pool");
+	net_buf_unref_batch(bufs, 16);
+}
+
+static void net_buf_test_pool_stats(void)
+{
+#if defined(CONFIG_NET_BUF_POOL_STATS)
+	struct net_buf_pool_stats stats;
+	struct net_buf *bufs[16];
+
+	net_buf_pool_stats_reset(&batch_pool);
+
+	zassert_equal(net_buf_alloc_batch(&batch_pool, 64, bufs, 6,
+					  K_NO_WAIT), 0,
+		      "Failed to get buffers");
+	net_buf_unref(bufs[5]);
+
+	net_buf_pool_stats_get(&batch_pool, &stats);
+	zassert_equal(stats.used, 5, "Wrong number of used buffers");
+	zassert_equal(stats.peak, 6, "Wrong peak");
+	zassert_equal(stats.allocs, 6, "Wrong allocation count");
+	zassert_equal(stats.failures, 0, "Wrong failure count");
+
+	/* 11 left, wait for the 12th */
+	zassert_equal(net_buf_alloc_batch(&batch_pool, 64, &bufs[5], 11,
+					  K_NO_WAIT), 0,
+		      "Failed to get buffers");
+	zassert_is_null(net_buf_alloc_len(&batch_pool, 64, 10),
+			"Got a buffer from an empty pool");
+
+	net_buf_pool_stats_get(&batch_pool, &stats);
+	zassert_equal(stats.used, 16, "Wrong number of used buffers");
+	zassert_equal(stats.peak, 16, "Wrong peak");
+	zassert_equal(stats.failures, 1, "Wrong failure count");
+	zassert_equal(stats.waits, 1, "Wrong wait count");
+	zassert_true(stats.max_wait > 0, "Wait time not accounted");
+
+	net_buf_unref_batch(bufs, 16);
+
+	net_buf_pool_stats_get(&batch_pool, &stats);
+	zassert_equal(stats.used, 0, "Buffers still accounted as used");
+	zassert_equal(stats.peak, 16, "Wrong peak");
+#endif
+}
+
+/* Cycles per allocated and freed buffer, in hundredths */
+static void report(const char *name, u32_t cycles, u32_t ops)
+{
+	u32_t cpo = (u64_t)cycles * 100 / ops;
+
+	TC_PRINT("%-20s %6u.%02u cycles/buffer\n", name, cpo / 100,
+		 cpo % 100);
+}
+
+#define BENCH_ROUNDS 256
+#define BENCH_BATCH  8
+
+static void net_buf_test_benchmark(void)
+{
+	struct net_buf *bufs[BENCH_BATCH];
+	u32_t start, cycles;
+	int i, j;
+
+	TC_PRINT("pool statistics %s\n",
+		 IS_ENABLED(CONFIG_NET_BUF_POOL_STATS) ? "on" : "off");
+
+	start = k_cycle_get_32();
+	for (i = 0; i < BENCH_ROUNDS * BENCH_BATCH; i++) {
+		net_buf_unref(net_buf_alloc_len(&batch_pool, 64, K_NO_WAIT));
+	}
+	cycles = k_cycle_get_32() - start;
+	report("alloc/unref", cycles, BENCH_ROUNDS * BENCH_BATCH);
+
+	start = k_cycle_get_32();
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		for (j = 0; j < BENCH_BATCH; j++) {
+			bufs[j] = net_buf_alloc_len(&batch_pool, 64, K_NO_WAIT);
+		}
+
+		for (j = 0; j < BENCH_BATCH; j++) {
+			net_buf_unref(bufs[j]);
+		}
+	}
+	cycles = k_cycle_get_32() - start;
+	report("alloc/unref x8", cycles, BENCH_ROUNDS * BENCH_BATCH);
+
+	start = k_cycle_get_32();
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		net_buf_alloc_batch(&batch_pool, 64, bufs, BENCH_BATCH,
+				    K_NO_WAIT);
+		net_buf_unref_batch(bufs, BENCH_BATCH);
+	}
+	cycles = k_cycle_get_32() - start;
+	report("batch x8", cycles, BENCH_ROUNDS * BENCH_BATCH);
+
+	/* Everything went back to the pool */
+	zassert_equal(net_buf_alloc_batch(&batch_pool, 64, bufs, BENCH_BATCH,
+					  K_NO_WAIT), 0,
+		      "Buffers leaked");
+	net_buf_unref_batch(bufs, BENCH_BATCH);
+}
+
 void test_main(void)
 {
 	ztest_test_suite(net_buf_test,
@@ -468,7 +618,10 @@ void test_main(void)
 			 ztest_unit_test(net_buf_test_multi_frags),
 			 ztest_unit_test(net_buf_test_clone),
 			 ztest_unit_test(net_buf_test_fixed_pool),
-			 ztest_unit_test(net_buf_test_var_pool)
+			 ztest_unit_test(net_buf_test_var_pool),
+			 ztest_unit_test(net_buf_test_batch),
+			 ztest_unit_test(net_buf_test_pool_stats),
+			 ztest_unit_test(net_buf_test_benchmark)
 			 );
 
 	ztest_run_test_suite(net_buf_test);
@@ -72,6 +72,7 @@ static struct net_context *udp_v4_ctx_2;
 
 static bool test_failed;
 static bool test_started;
+static bool test_rewrite;
 static bool start_receiving;
 
 static K_SEM_DEFINE(wait_data, 0, UINT_MAX);
@@ -103,6 +104,63 @@ static void eth_iface_init(struct net_if *iface)
 	ethernet_init(iface);
 }
 
+/* Rewrite the source address and port of an outgoing UDP packet in place,
+ * as a NAT or relay would, updating the checksums incrementally
+ * (RFC 1624), and check the result against a full recompute.
+ */
+static void chksum_rewrite_check(struct net_pkt *pkt)
+{
+	struct net_udp_hdr hdr, *udp_hdr;
+	u16_t chksum, port;
+
+	udp_hdr = net_udp_get_hdr(pkt, &hdr);
+	zassert_not_null(udp_hdr, "UDP header missing");
+
+	chksum = ntohs(udp_hdr->chksum);
+
+	if (net_pkt_family(pkt) == AF_INET6) {
+		struct in6_addr *src = &NET_IPV6_HDR(pkt)->src;
+		int i;
+
+		for (i = 0; i < 8; i++) {
+			chksum = net_chksum_update16(
+				chksum, ntohs(UNALIGNED_GET(&src->s6_addr16[i])),
+				ntohs(my_addr2.s6_addr16[i]));
+		}
+
+		net_ipaddr_copy(src, &my_addr2);
+	} else {
+		struct net_ipv4_hdr *ipv4 = NET_IPV4_HDR(pkt);
+		u32_t old = ntohl(UNALIGNED_GET(&ipv4->src.s_addr));
+		u32_t new = ntohl(in4addr_my2.s_addr);
+		u16_t ip_chksum;
+
+		chksum = net_chksum_update32(chksum, old, new);
+		ip_chksum = net_chksum_update32(ntohs(ipv4->chksum), old, new);
+
+		net_ipaddr_copy(&ipv4->src, &in4addr_my2);
+
+		ipv4->chksum = 0;
+		ipv4->chksum = ~net_calc_chksum_ipv4(pkt);
+
+		zassert_equal(ntohs(ipv4->chksum), ip_chksum,
+			      "IPv4 checksum update 0x%x, recomputed 0x%x",
+			      ip_chksum, ntohs(ipv4->chksum));
+	}
+
+	port = ntohs(udp_hdr->src_port);
+	chksum = net_chksum_update16(chksum, port, port + 1);
+	udp_hdr->src_port = htons(port + 1);
+	udp_hdr->chksum = htons(chksum);
+	net_udp_set_hdr(pkt, udp_hdr);
+
+	net_udp_set_chksum(pkt, pkt->frags);
+
+	zassert_equal(ntohs(net_udp_get_chksum(pkt, pkt->frags)), chksum,
+		      "UDP checksum update 0x%x, recomputed 0x%x", chksum,
+		      ntohs(net_udp_get_chksum(pkt, pkt->frags)));
+}
+
 static int eth_tx_offloading_disabled(struct net_if *iface, struct net_pkt *pkt)
 {
 	struct eth_context *context = net_if_get_device(iface)->driver_data;
@@ -179,6 +237,10 @@ static int eth_tx_offloading_disabled(struct net_if *iface, struct net_pkt *pkt)
 
 		zassert_not_equal(chksum, 0, "Checksum calculated");
 
+		if (test_rewrite) {
+			chksum_rewrite_check(pkt);
+		}
+
 		k_sem_give(&wait_data);
 	}
 
@@ -549,6 +611,20 @@ static void tx_chksum_offload_disabled_test_v4(void)
 	net_context_unref(udp_v4_ctx_1);
 }
 
+static void tx_chksum_rewrite_test_v6(void)
+{
+	test_rewrite = true;
+	tx_chksum_offload_disabled_test_v6();
+	test_rewrite = false;
+}
+
+static void tx_chksum_rewrite_test_v4(void)
+{
+	test_rewrite = true;
+	tx_chksum_offload_disabled_test_v4();
+	test_rewrite = false;
+}
+
 static void tx_chksum_offload_enabled_test_v6(void)
 {
 	struct eth_context *ctx; /* This is interface context */
@@ -975,6 +1051,8 @@ void test_main(void)
 			 ztest_unit_test(address_setup),
 			 ztest_unit_test(tx_chksum_offload_disabled_test_v6),
 			 ztest_unit_test(tx_chksum_offload_disabled_test_v4),
+			 ztest_unit_test(tx_chksum_rewrite_test_v6),
+			 ztest_unit_test(tx_chksum_rewrite_test_v4),
 			 ztest_unit_test(tx_chksum_offload_enabled_test_v6),
 			 ztest_unit_test(tx_chksum_offload_enabled_test_v4),
 			 ztest_unit_test(rx_chksum_offload_disabled_test_v6),
@@ -423,7 +423,8 @@ static enum net_verdict udp_data_received(struct net_conn *conn,
 static void setup_udp_handler(const struct in6_addr *raddr,
 			      const struct in6_addr *laddr,
 			      u16_t remote_port,
-			      u16_t local_port)
+			      u16_t local_port,
+			      net_conn_cb_t cb)
 {
 	static struct net_conn_handle *handle;
 	struct sockaddr remote_addr = { 0 };
@@ -437,8 +438,7 @@ static void setup_udp_handler(const struct in6_addr *raddr,
 	remote_addr.sa_family = AF_INET6;
 
 	ret = net_udp_register(&remote_addr, &local_addr, remote_port,
-			       local_port, udp_data_received,
-			       NULL, &handle);
+			       local_port, cb, NULL, &handle);
 	zassert_equal(ret, 0, "Cannot register UDP handler");
 }
 
@@ -492,7 +492,8 @@ static void test_setup(void)
 	/* Remote and local are swapped so that we can receive the sent
 	 * packet.
 	 */
-	setup_udp_handler(&my_addr1, &my_addr2, 4352, 25348);
+	setup_udp_handler(&my_addr1, &my_addr2, 4352, 25348,
+			  udp_data_received);
 
 	/* The interface might receive data which might fail the checks
 	 * in the iface sending function, so we need to reset the failure
@@ -681,11 +682,257 @@ static void test_send_ipv6_fragment(void)
 	}
 }
 
+#define RECV_PORT_SRC     5353
+#define RECV_PORT_DST     6363
+#define RECV_DATA_LEN     600
+#define RECV_UDP_LEN      (sizeof(struct net_udp_hdr) + RECV_DATA_LEN)
+#define RECV_FRAG_LEN     160
+#define RECV_FRAG_COUNT   ((int)(RECV_UDP_LEN + RECV_FRAG_LEN - 1) / RECV_FRAG_LEN)
+#define RECV_PENDING      CONFIG_NET_IPV6_FRAGMENT_MAX_COUNT
+#define RECV_ROUNDS       16
+#define RECV_WAIT         K_MSEC(100)
+
+static u8_t recv_dgram[RECV_PENDING][RECV_UDP_LEN];
+static u8_t recv_buf[sizeof(struct net_ipv6_hdr) + RECV_UDP_LEN];
+static struct k_sem recv_data;
+static int recv_count;
+static int recv_errors;
+
+static enum net_verdict udp_recv_fragmented(struct net_conn *conn,
+					    struct net_pkt *pkt,
+					    void *user_data)
+{
+	int len = net_pkt_get_len(pkt);
+	u8_t *data = recv_buf + sizeof(struct net_ipv6_hdr) +
+		sizeof(struct net_udp_hdr);
+	int i;
+
+	if (len != sizeof(recv_buf) ||
+	    net_frag_linearize(recv_buf, sizeof(recv_buf), pkt, 0, len) !=
+	    len) {
+		DBG("Reassembled pkt %p has %d bytes\n", pkt, len);
+		recv_errors++;
+		goto out;
+	}
+
+	/* The first data byte tells which datagram this was */
+	for (i = 1; i < RECV_DATA_LEN; i++) {
+		if (data[i] != (u8_t)(data[0] + i)) {
+			DBG("Wrong data at %d in pkt %p\n", i, pkt);
+			recv_errors++;
+			goto out;
+		}
+	}
+
+	recv_count++;
+
+out:
+	net_pkt_unref(pkt);
+	k_sem_give(&recv_data);
+
+	return NET_OK;
+}
+
+static u16_t recv_chksum(const u8_t *udp)
+{
+	u32_t sum = IPPROTO_UDP + RECV_UDP_LEN;
+	int i;
+
+	for (i = 0; i < sizeof(struct in6_addr); i += 2) {
+		sum += (my_addr2.s6_addr[i] << 8) | my_addr2.s6_addr[i + 1];
+		sum += (my_addr1.s6_addr[i] << 8) | my_addr1.s6_addr[i + 1];
+	}
+
+	for (i = 0; i < RECV_UDP_LEN; i += 2) {
+		sum += (udp[i] << 8) | udp[i + 1];
+	}
+
+	while (sum >> 16) {
+		sum = (sum & 0xffff) + (sum >> 16);
+	}
+
+	return ~sum;
+}
+
+/* Fill in a UDP datagram from my_addr2 to my_addr1 */
+static void recv_dgram_setup(u8_t *udp, u8_t seq)
+{
+	struct net_udp_hdr *hdr = (struct net_udp_hdr *)udp;
+	u16_t chksum;
+	int i;
+
+	hdr->src_port = htons(RECV_PORT_SRC);
+	hdr->dst_port = htons(RECV_PORT_DST);
+	hdr->len = htons(RECV_UDP_LEN);
+	hdr->chksum = 0;
+
+	for (i = 0; i < RECV_DATA_LEN; i++) {
+		udp[sizeof(*hdr) + i] = seq + i;
+	}
+
+	chksum = recv_chksum(udp);
+	hdr->chksum = htons(chksum);
+}
+
+static void recv_fragment(const u8_t *udp, u32_t id, int idx)
+{
+	u16_t offset = idx * RECV_FRAG_LEN;
+	u16_t len = min(RECV_FRAG_LEN, RECV_UDP_LEN - offset);
+	struct net_ipv6_frag_hdr frag_hdr;
+	struct net_ipv6_hdr hdr;
+	struct net_pkt *pkt;
+	bool ok;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.vtc = 0x60;
+	hdr.len[0] = (sizeof(frag_hdr) + len) >> 8;
+	hdr.len[1] = (sizeof(frag_hdr) + len) & 0xff;
+	hdr.nexthdr = NET_IPV6_NEXTHDR_FRAG;
+	hdr.hop_limit = 64;
+	net_ipaddr_copy(&hdr.src, &my_addr2);
+	net_ipaddr_copy(&hdr.dst, &my_addr1);
+
+	frag_hdr.nexthdr = IPPROTO_UDP;
+	frag_hdr.reserved = 0;
+	frag_hdr.offset = htons(offset | (idx < RECV_FRAG_COUNT - 1));
+	frag_hdr.id = htonl(id);
+
+	pkt = net_pkt_get_reserve_rx(0, ALLOC_TIMEOUT);
+	zassert_not_null(pkt, "No RX packet");
+
+	ok = net_pkt_append_all(pkt, sizeof(hdr), (u8_t *)&hdr,
+				ALLOC_TIMEOUT) &&
+		net_pkt_append_all(pkt, sizeof(frag_hdr), (u8_t *)&frag_hdr,
+				   ALLOC_TIMEOUT) &&
+		net_pkt_append_all(pkt, len, udp + offset, ALLOC_TIMEOUT);
+	zassert_true(ok, "Cannot build fragment");
+
+	zassert_equal(net_recv_data(iface1, pkt), 0, "Cannot receive");
+}
+
 static void test_recv_ipv6_fragment(void)
 {
-	/* TODO: Verify that we can receive individual fragments and
-	 * then reassemble them back.
+	struct net_ipv6_reassembly_stats before, after;
+	int i;
+
+	k_sem_init(&recv_data, 0, UINT_MAX);
+	setup_udp_handler(&my_addr2, &my_addr1, RECV_PORT_SRC, RECV_PORT_DST,
+			  udp_recv_fragmented);
+
+	net_ipv6_frag_stats_get(&before);
+
+	/* Last fragment first, so the length is known early */
+	recv_dgram_setup(recv_dgram[0], 0x10);
+	for (i = RECV_FRAG_COUNT - 1; i >= 0; i--) {
+		recv_fragment(recv_dgram[0], 0x1000, i);
+	}
+
+	zassert_equal(k_sem_take(&recv_data, WAIT_TIME), 0, "Timeout");
+	zassert_equal(recv_count, 1, "Datagram not reassembled");
+	zassert_equal(recv_errors, 0, "Reassembled datagram corrupted");
+
+	net_ipv6_frag_stats_get(&after);
+	zassert_equal(after.reassembled, before.reassembled + 1,
+		      "Reassembly not counted");
+	zassert_equal(after.mem, 0, "Fragment memory not released");
+}
+
+static void test_recv_ipv6_fragment_interleaved(void)
+{
+	struct net_ipv6_reassembly_stats before, after;
+	u32_t start, cycles;
+	int round, i, d;
+
+	recv_count = 0;
+	net_ipv6_frag_stats_get(&before);
+
+	start = k_cycle_get_32();
+
+	for (round = 0; round < RECV_ROUNDS; round++) {
+		for (d = 0; d < RECV_PENDING; d++) {
+			recv_dgram_setup(recv_dgram[d],
+					 round * RECV_PENDING + d);
+		}
+
+		/* One fragment of each datagram in turn, every other
+		 * datagram in reverse order.
+		 */
+		for (i = 0; i < RECV_FRAG_COUNT; i++) {
+			for (d = 0; d < RECV_PENDING; d++) {
+				int idx = (d & 1) ? RECV_FRAG_COUNT - 1 - i : i;
+
+				recv_fragment(recv_dgram[d],
+					      0x2000 + round * RECV_PENDING + d,
+					      idx);
+			}
+		}
+
+		for (d = 0; d < RECV_PENDING; d++) {
+			zassert_equal(k_sem_take(&recv_data, WAIT_TIME), 0,
+				      "Timeout");
+		}
+	}
+
+	cycles = k_cycle_get_32() - start;
+
+	net_ipv6_frag_stats_get(&after);
+
+	TC_PRINT("%d datagrams of %d fragments, %d pending at a time\n",
+		 RECV_ROUNDS * RECV_PENDING, RECV_FRAG_COUNT, RECV_PENDING);
+	TC_PRINT("%u cycles per datagram, peak fragment memory %u of %d\n",
+		 cycles / (RECV_ROUNDS * RECV_PENDING), after.mem_peak,
+		 CONFIG_NET_IPV6_FRAGMENT_MAX_MEM);
+
+	zassert_equal(recv_errors, 0, "Reassembled datagram corrupted");
+	zassert_equal(recv_count, RECV_ROUNDS * RECV_PENDING,
+		      "Datagrams lost");
+	zassert_equal(after.reassembled - before.reassembled,
+		      RECV_ROUNDS * RECV_PENDING, "Wrong reassembly count");
+	zassert_equal(after.evicted, before.evicted, "Datagram evicted");
+	zassert_equal(after.mem, 0, "Fragment memory not released");
+	zassert_true(after.mem_peak <= CONFIG_NET_IPV6_FRAGMENT_MAX_MEM,
+		     "Memory budget exceeded");
+}
+
+static void test_recv_ipv6_fragment_limits(void)
+{
+	struct net_ipv6_reassembly_stats before, after;
+	int d;
+
+	recv_count = 0;
+	net_ipv6_frag_stats_get(&before);
+
+	/* Start one datagram more than there are slots for, the oldest
+	 * one has to make room.
 	 */
+	for (d = 0; d <= RECV_PENDING; d++) {
+		recv_dgram_setup(recv_dgram[d % RECV_PENDING], d);
+		recv_fragment(recv_dgram[d % RECV_PENDING], 0x3000 + d, 0);
+	}
+
+	k_sleep(RECV_WAIT);
+
+	net_ipv6_frag_stats_get(&after);
+	zassert_equal(after.evicted, before.evicted + 1,
+		      "Oldest datagram not evicted");
+
+	/* An overlapping fragment drops its datagram */
+	recv_fragment(recv_dgram[0], 0x3000 + RECV_PENDING, 0);
+
+	k_sleep(RECV_WAIT);
+
+	net_ipv6_frag_stats_get(&after);
+	zassert_equal(after.dropped, before.dropped + 1,
+		      "Overlapping fragment accepted");
+
+	/* The rest time out */
+	k_sleep(K_SECONDS(CONFIG_NET_IPV6_FRAGMENT_TIMEOUT) + RECV_WAIT);
+
+	net_ipv6_frag_stats_get(&after);
+	zassert_equal(after.timeouts, before.timeouts + RECV_PENDING - 1,
+		      "Pending datagrams not timed out");
+	zassert_equal(after.mem, 0, "Fragment memory not released");
+	zassert_equal(recv_count, 0, "Incomplete datagram passed up");
 }
 
 void test_main(void)
@@ -696,7 +943,9 @@ void test_main(void)
 			 ztest_unit_test(test_find_last_ipv6_fragment_hbho_udp),
 			 ztest_unit_test(test_find_last_ipv6_fragment_hbho_frag),
 			 ztest_unit_test(test_send_ipv6_fragment),
-			 ztest_unit_test(test_recv_ipv6_fragment)
+			 ztest_unit_test(test_recv_ipv6_fragment),
+			 ztest_unit_test(test_recv_ipv6_fragment_interleaved),
+			 ztest_unit_test(test_recv_ipv6_fragment_limits)
 			 );
 
 	ztest_run_test_suite(net_ipv6_fragment_test);
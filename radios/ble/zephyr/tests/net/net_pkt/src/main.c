@@ -11,6 +11,7 @@
 #include <string.h>
 #include <errno.h>
 #include <misc/printk.h>
+#include <misc/byteorder.h>
 
 #include <ztest.h>
 
@@ -1072,6 +1073,167 @@ static void test_fragment_split(void)
 		      "Frag_b data mismatch");
 }
 
+#define CURSOR_FRAG_LEN 5
+#define CURSOR_ROUNDS 64
+
+/* Packet with its data spread over many small fragments, the way a
+ * radio with a small MTU hands it to the stack.
+ */
+static struct net_pkt *cursor_pkt_create(u16_t len)
+{
+	struct net_pkt *pkt;
+	struct net_buf *frag = NULL;
+	u16_t i;
+
+	pkt = net_pkt_get_reserve_rx(0, K_FOREVER);
+
+	for (i = 0; i < len; i++) {
+		if (!(i % CURSOR_FRAG_LEN)) {
+			frag = net_pkt_get_reserve_rx_data(0, K_FOREVER);
+			net_pkt_frag_add(pkt, frag);
+		}
+
+		net_buf_add_u8(frag, i);
+	}
+
+	return pkt;
+}
+
+static void test_pkt_cursor(void)
+{
+	struct net_pkt_cursor cursor;
+	struct net_pkt *pkt;
+	struct net_buf *frag;
+	u8_t data[64], ref[64];
+	u16_t pos, val16;
+	u32_t val32;
+	u8_t val8;
+	int i;
+
+	pkt = cursor_pkt_create(sizeof(data));
+
+	/* Byte by byte, across every fragment boundary */
+	net_pkt_cursor_init(pkt, &cursor);
+	for (i = 0; i < sizeof(data); i++) {
+		zassert_equal(net_pkt_cursor_read_u8(&cursor, &val8), 0,
+			      "Cursor read failed");
+		zassert_equal(val8, i, "Wrong byte");
+	}
+
+	zassert_equal(net_pkt_cursor_read_u8(&cursor, &val8), -ENODATA,
+		      "Read past the end");
+
+	/* Same data as the offset based API */
+	for (i = 0; i < sizeof(data) - 8; i++) {
+		zassert_equal(net_pkt_cursor_seek(pkt, &cursor, i), 0,
+			      "Cursor seek failed");
+		zassert_equal(net_pkt_cursor_peek(&cursor, data, 8), 0,
+			      "Cursor peek failed");
+
+		frag = net_frag_read(pkt->frags, i, &pos, 8, ref);
+		zassert_false(!frag && pos == 0xffff, "Frag read failed");
+		zassert_false(memcmp(data, ref, 8), "Data mismatch");
+
+		zassert_equal(net_pkt_cursor_read_be16(&cursor, &val16), 0,
+			      "Cursor be16 failed");
+		zassert_equal(val16, (ref[0] << 8) | ref[1], "Wrong be16");
+
+		zassert_equal(net_pkt_cursor_read_be32(&cursor, &val32), 0,
+			      "Cursor be32 failed");
+		zassert_equal(val32, sys_get_be32(&ref[2]), "Wrong be32");
+	}
+
+	/* A failed read leaves the cursor where it was */
+	net_pkt_cursor_seek(pkt, &cursor, sizeof(data) - 2);
+	zassert_equal(net_pkt_cursor_read_be32(&cursor, &val32), -ENODATA,
+		      "Truncated be32 read");
+	zassert_equal(net_pkt_cursor_read_be16(&cursor, &val16), 0,
+		      "Cursor moved by a failed read");
+	zassert_equal(val16, ((sizeof(data) - 2) << 8) | (sizeof(data) - 1),
+		      "Wrong be16 at the end");
+	zassert_equal(net_pkt_cursor_seek(pkt, &cursor, sizeof(data) + 1),
+		      -ENODATA, "Seek past the end");
+
+	/* Contiguous access only within one fragment */
+	net_pkt_cursor_seek(pkt, &cursor, 1);
+	zassert_not_null(net_pkt_cursor_data(&cursor, CURSOR_FRAG_LEN - 1),
+			 "No direct access within a fragment");
+	zassert_is_null(net_pkt_cursor_data(&cursor, CURSOR_FRAG_LEN),
+			"Direct access across fragments");
+
+	/* Overwrite across fragments, then append past the end */
+	for (i = 0; i < sizeof(data); i++) {
+		data[i] = 0xff - i;
+	}
+
+	net_pkt_cursor_seek(pkt, &cursor, 3);
+	zassert_equal(net_pkt_cursor_write(pkt, &cursor, data, 20, K_FOREVER),
+		      0, "Cursor write failed");
+	zassert_equal(net_pkt_get_len(pkt), sizeof(data),
+		      "Overwrite changed the length");
+
+	net_pkt_cursor_seek(pkt, &cursor, sizeof(data));
+	zassert_equal(net_pkt_cursor_write(pkt, &cursor, data, sizeof(data),
+					   K_FOREVER),
+		      0, "Cursor append failed");
+	zassert_equal(net_pkt_get_len(pkt), 2 * sizeof(data),
+		      "Wrong length after append");
+
+	net_pkt_cursor_seek(pkt, &cursor, 3);
+	net_pkt_cursor_read(&cursor, ref, 20);
+	zassert_false(memcmp(ref, data, 20), "Overwritten data mismatch");
+
+	net_pkt_cursor_seek(pkt, &cursor, sizeof(data));
+	net_pkt_cursor_read(&cursor, ref, sizeof(data));
+	zassert_false(memcmp(ref, data, sizeof(data)),
+		      "Appended data mismatch");
+
+	net_pkt_unref(pkt);
+}
+
+static void test_pkt_cursor_benchmark(void)
+{
+	struct net_pkt_cursor cursor;
+	struct net_pkt *pkt;
+	struct net_buf *frag;
+	u32_t start, by_offset, by_cursor;
+	u16_t pos, val16;
+	u8_t val8;
+	int i, j;
+
+	/* A TCP header with options, 5 bytes per fragment */
+	pkt = cursor_pkt_create(60);
+
+	start = k_cycle_get_32();
+	for (i = 0; i < CURSOR_ROUNDS; i++) {
+		for (j = 0; j < 60; j += 3) {
+			frag = net_frag_read_u8(pkt->frags, j, &pos, &val8);
+			frag = net_frag_read_be16(pkt->frags, j + 1, &pos,
+						  &val16);
+		}
+	}
+	by_offset = k_cycle_get_32() - start;
+
+	start = k_cycle_get_32();
+	for (i = 0; i < CURSOR_ROUNDS; i++) {
+		net_pkt_cursor_init(pkt, &cursor);
+
+		for (j = 0; j < 60; j += 3) {
+			net_pkt_cursor_read_u8(&cursor, &val8);
+			net_pkt_cursor_read_be16(&cursor, &val16);
+		}
+	}
+	by_cursor = k_cycle_get_32() - start;
+
+	TC_PRINT("60 byte header in %u fragments: %u cycles by offset, "
+		 "%u cycles by cursor\n", 60 / CURSOR_FRAG_LEN,
+		 by_offset / CURSOR_ROUNDS, by_cursor / CURSOR_ROUNDS);
+
+	zassert_true(by_cursor <= by_offset, "Cursor slower than offsets");
+
+	net_pkt_unref(pkt);
+}
+
 void test_main(void)
 {
 	ztest_test_suite(net_pkt_tests,
@@ -1080,7 +1242,9 @@ void test_main(void)
 			 ztest_unit_test(test_pkt_read_append),
 			 ztest_unit_test(test_pkt_read_write_insert),
 			 ztest_unit_test(test_fragment_compact),
-			 ztest_unit_test(test_fragment_split)
+			 ztest_unit_test(test_fragment_split),
+			 ztest_unit_test(test_pkt_cursor),
+			 ztest_unit_test(test_pkt_cursor_benchmark)
 			 );
 
 	ztest_run_test_suite(net_pkt_tests);
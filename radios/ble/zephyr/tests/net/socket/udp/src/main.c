@@ -8,12 +8,17 @@
 #include <ztest_assert.h>
 
 #include <net/socket.h>
+#include <net/net_mgmt.h>
+#include <net/net_stats.h>
 
 #define BUF_AND_SIZE(buf) buf, sizeof(buf) - 1
 #define STRLEN(buf) (sizeof(buf) - 1)
 
 #define TEST_STR_SMALL "test"
 
+#define LOOPBACK_ROUNDS 64
+#define LOOPBACK_LEN 256
+
 #define ANY_PORT 0
 #define SERVER_PORT 4242
 #define CLIENT_PORT 9898
@@ -322,6 +327,77 @@ void test_send_recv_2_sock(void)
 	zassert_equal(rv, 0, "close failed");
 }
 
+void test_loopback_throughput(void)
+{
+#if defined(CONFIG_NET_STATISTICS_USER_API)
+	struct net_if *iface = net_if_get_default();
+	struct net_stats_pkts pkts_before, pkts_after;
+	struct sockaddr_in bind_addr, conn_addr;
+	static char data[LOOPBACK_LEN], buf[LOOPBACK_LEN];
+	u32_t start, cycles;
+	int sock1, sock2;
+	int i, len, rv;
+
+	for (i = 0; i < sizeof(data); i++) {
+		data[i] = i;
+	}
+
+	sock1 = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	sock2 = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	zassert_true(sock1 >= 0, "cannot create sock1");
+	zassert_true(sock2 >= 0, "cannot create sock2");
+
+	bind_addr.sin_family = AF_INET;
+	bind_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	bind_addr.sin_port = htons(55556);
+	rv = bind(sock1, (struct sockaddr *)&bind_addr, sizeof(bind_addr));
+	zassert_equal(rv, 0, "bind failed");
+
+	conn_addr.sin_family = AF_INET;
+	conn_addr.sin_addr.s_addr = htonl(0xc0000201);
+	conn_addr.sin_port = htons(55556);
+	rv = connect(sock2, (struct sockaddr *)&conn_addr, sizeof(conn_addr));
+	zassert_equal(rv, 0, "connect failed");
+
+	rv = net_mgmt(NET_REQUEST_STATS_GET_PKTS, iface, &pkts_before,
+		      sizeof(pkts_before));
+	zassert_equal(rv, 0, "cannot get packet counters");
+
+	start = k_cycle_get_32();
+
+	for (i = 0; i < LOOPBACK_ROUNDS; i++) {
+		len = send(sock2, data, sizeof(data), 0);
+		zassert_equal(len, sizeof(data), "invalid send len");
+
+		len = recv(sock1, buf, sizeof(buf), 0);
+		zassert_equal(len, sizeof(data), "Invalid recv len");
+		zassert_equal(memcmp(buf, data, sizeof(data)), 0,
+			      "Invalid recv data");
+	}
+
+	cycles = k_cycle_get_32() - start;
+
+	rv = net_mgmt(NET_REQUEST_STATS_GET_PKTS, iface, &pkts_after,
+		      sizeof(pkts_after));
+	zassert_equal(rv, 0, "cannot get packet counters");
+
+	printk("%d datagrams of %d bytes, %u cycles each, zero copy %s\n",
+	       LOOPBACK_ROUNDS, LOOPBACK_LEN, cycles / LOOPBACK_ROUNDS,
+	       IS_ENABLED(CONFIG_NET_LOOPBACK_ZERO_COPY) ? "on" : "off");
+
+	zassert_true(pkts_after.tx - pkts_before.tx >= LOOPBACK_ROUNDS,
+		     "Sent packets not counted");
+	zassert_true(pkts_after.rx - pkts_before.rx >= LOOPBACK_ROUNDS,
+		     "Received packets not counted");
+
+	rv = close(sock1);
+	zassert_equal(rv, 0, "close failed");
+
+	rv = close(sock2);
+	zassert_equal(rv, 0, "close failed");
+#endif
+}
+
 void test_main(void)
 {
 	ztest_test_suite(socket_udp,
@@ -329,7 +405,8 @@ void test_main(void)
 			 ztest_unit_test(test_v4_sendto_recvfrom),
 			 ztest_unit_test(test_v6_sendto_recvfrom),
 			 ztest_unit_test(test_v4_bind_sendto),
-			 ztest_unit_test(test_v6_bind_sendto));
+			 ztest_unit_test(test_v6_bind_sendto),
+			 ztest_unit_test(test_loopback_throughput));
 
 	ztest_run_test_suite(socket_udp);
 }
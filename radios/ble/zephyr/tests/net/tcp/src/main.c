@@ -132,12 +132,189 @@ static void v6_send_syn_ack(struct net_if *iface, struct net_pkt *req)
 
 static int send_status = -EINVAL;
 
+/* Loopback throughput benchmark: two connected contexts, one on each
+ * interface, whose segments are handed back to the receiving interface
+ * by the drivers below.
+ */
+#define BENCH_CLIENT_PORT 5546
+#define BENCH_SERVER_PORT 9877
+#define BENCH_BYTES (32 * 1024)
+#define BENCH_WINDOW 2560
+#define BENCH_WRITE_MAX 1024
+
+/* Emulated lossy link: every BENCH_LOSS_NTH data segment is dropped and
+ * everything else is delivered BENCH_DELAY_MS later.
+ */
+#define BENCH_LOSSY_WINDOW 8192
+#define BENCH_LOSS_NTH 20
+#define BENCH_DELAY_MS 10
+#define BENCH_LINK_SLOTS 64
+
+static bool bench_running;
+static struct k_sem bench_wait;
+static struct net_context *bench_client;
+static struct net_context *bench_listen;
+static struct net_context *bench_server;
+static size_t bench_received;
+static u32_t bench_segs;
+static u32_t bench_acks;
+
+static bool bench_lossy;
+static u32_t bench_drops;
+static u32_t bench_rexmits;
+static u32_t bench_high_seq;
+static struct k_delayed_work bench_link_work;
+static u32_t bench_link_head;
+static u32_t bench_link_tail;
+static struct {
+	struct net_pkt *pkt;
+	struct net_if *iface;
+	s64_t due;
+} bench_link[BENCH_LINK_SLOTS];
+
+static void bench_link_deliver(struct k_work *work)
+{
+	while (1) {
+		struct net_pkt *pkt;
+		struct net_if *iface;
+		unsigned int key;
+		s64_t delay;
+
+		key = irq_lock();
+
+		if (bench_link_tail == bench_link_head) {
+			irq_unlock(key);
+			return;
+		}
+
+		pkt = bench_link[bench_link_tail % BENCH_LINK_SLOTS].pkt;
+		iface = bench_link[bench_link_tail % BENCH_LINK_SLOTS].iface;
+		delay = bench_link[bench_link_tail % BENCH_LINK_SLOTS].due -
+			k_uptime_get();
+
+		if (delay > 0) {
+			irq_unlock(key);
+			k_delayed_work_submit(&bench_link_work, delay);
+			return;
+		}
+
+		bench_link_tail++;
+
+		irq_unlock(key);
+
+		if (net_recv_data(iface, pkt) < 0) {
+			net_pkt_unref(pkt);
+		}
+	}
+}
+
+/* Returns false if the segment is lost on the way */
+static bool bench_link_send(struct net_if *iface, struct net_pkt *pkt,
+			    u32_t seq, size_t len)
+{
+	unsigned int key;
+	bool submit;
+
+	if (len) {
+		if (bench_high_seq && (s32_t)(seq + len - bench_high_seq) <= 0) {
+			bench_rexmits++;
+		} else {
+			bench_high_seq = seq + len;
+
+			if (!(bench_segs % BENCH_LOSS_NTH)) {
+				bench_drops++;
+				return false;
+			}
+		}
+	}
+
+	key = irq_lock();
+
+	if (bench_link_head - bench_link_tail == BENCH_LINK_SLOTS) {
+		irq_unlock(key);
+		bench_drops++;
+		return false;
+	}
+
+	bench_link[bench_link_head % BENCH_LINK_SLOTS].pkt = pkt;
+	bench_link[bench_link_head % BENCH_LINK_SLOTS].iface = iface;
+	bench_link[bench_link_head % BENCH_LINK_SLOTS].due = k_uptime_get() +
+		BENCH_DELAY_MS;
+	submit = bench_link_head++ == bench_link_tail;
+
+	irq_unlock(key);
+
+	if (submit) {
+		k_delayed_work_submit(&bench_link_work, BENCH_DELAY_MS);
+	}
+
+	return true;
+}
+
+static int bench_forward(struct net_pkt *pkt)
+{
+	struct net_tcp_hdr hdr, *tcp_hdr;
+	struct net_if *iface = NULL;
+	struct net_pkt *rx;
+	size_t len = 0;
+	u32_t seq = 0;
+
+	tcp_hdr = net_tcp_get_hdr(pkt, &hdr);
+	if (tcp_hdr) {
+		len = net_pkt_get_len(pkt) - net_pkt_ip_hdr_len(pkt) -
+			net_pkt_ipv6_ext_len(pkt) - NET_TCP_HDR_LEN(tcp_hdr);
+		seq = sys_get_be32(tcp_hdr->seq);
+
+		if (len) {
+			bench_segs++;
+		} else {
+			bench_acks++;
+		}
+	}
+
+	net_if_ipv6_addr_lookup(&NET_IPV6_HDR(pkt)->dst, &iface);
+
+	/* The sender keeps the original for retransmission */
+	rx = net_pkt_clone(pkt, K_NO_WAIT);
+	net_pkt_unref(pkt);
+
+	if (!rx || !iface) {
+		DBG("Loopback drop\n");
+		if (rx) {
+			net_pkt_unref(rx);
+		}
+
+		return 0;
+	}
+
+	net_pkt_set_iface(rx, iface);
+
+	if (bench_lossy) {
+		if (!bench_link_send(iface, rx, seq, len)) {
+			net_pkt_unref(rx);
+		}
+
+		return 0;
+	}
+
+	if (net_recv_data(iface, rx) < 0) {
+		net_pkt_unref(rx);
+	}
+
+	return 0;
+}
+
 static int tester_send(struct net_if *iface, struct net_pkt *pkt)
 {
 	if (!pkt->frags) {
 		DBG("No data to send!\n");
 		return -ENODATA;
 	}
+
+	if (bench_running) {
+		return bench_forward(pkt);
+	}
+
 	if (syn_v6_sent && net_pkt_family(pkt) == AF_INET6) {
 		DBG("v6 SYN was sent successfully\n");
 		syn_v6_sent = false;
@@ -158,6 +335,10 @@ static int tester_send_peer(struct net_if *iface, struct net_pkt *pkt)
 		return -ENODATA;
 	}
 
+	if (bench_running) {
+		return bench_forward(pkt);
+	}
+
 	DBG("Peer data was sent successfully\n");
 
 	net_pkt_unref(pkt);
@@ -1418,10 +1599,9 @@ static inline u32_t get_recv_wnd(struct net_tcp *tcp)
 	/* We don't queue received data inside the stack, we hand off
 	 * packets to synchronous callbacks (who can queue if they
 	 * want, but it's not our business).  So the available window
-	 * size is always the same.  There are two configurables to
-	 * check though.
+	 * size is always the configured one.
 	 */
-	return min(NET_TCP_MAX_WIN, NET_TCP_BUF_MAX_LEN);
+	return CONFIG_NET_TCP_RECV_WINDOW;
 }
 
 static bool test_tcp_seq_validity(void)
@@ -1658,6 +1838,275 @@ static bool test_init_tcp_connect(void)
 }
 #endif
 
+static void bench_accept_cb(struct net_context *new_context,
+			    struct sockaddr *addr,
+			    socklen_t addrlen,
+			    int error,
+			    void *user_data)
+{
+	bench_server = new_context;
+	k_sem_give(&bench_wait);
+}
+
+static void bench_recv_cb(struct net_context *context,
+			  struct net_pkt *pkt,
+			  int status,
+			  void *user_data)
+{
+	if (pkt) {
+		bench_received += net_pkt_appdatalen(pkt);
+		net_pkt_unref(pkt);
+	}
+
+	k_sem_give(&bench_wait);
+}
+
+static bool test_bench_connect(void)
+{
+	struct sockaddr_in6 client_addr = my_v6_addr;
+	struct sockaddr_in6 server_addr = peer_v6_addr;
+	int ret;
+
+	k_sem_init(&bench_wait, 0, UINT_MAX);
+	k_delayed_work_init(&bench_link_work, bench_link_deliver);
+	bench_running = true;
+
+	client_addr.sin6_port = htons(BENCH_CLIENT_PORT);
+	server_addr.sin6_port = htons(BENCH_SERVER_PORT);
+
+	ret = net_context_get(AF_INET6, SOCK_STREAM, IPPROTO_TCP,
+			      &bench_listen);
+	if (ret) {
+		TC_ERROR("Cannot get server context (%d)\n", ret);
+		return false;
+	}
+
+	ret = net_context_bind(bench_listen, (struct sockaddr *)&server_addr,
+			       sizeof(server_addr));
+	if (ret) {
+		TC_ERROR("Cannot bind server context (%d)\n", ret);
+		return false;
+	}
+
+	ret = net_context_listen(bench_listen, 0);
+	if (ret) {
+		TC_ERROR("Cannot listen (%d)\n", ret);
+		return false;
+	}
+
+	ret = net_context_accept(bench_listen, bench_accept_cb, K_NO_WAIT,
+				 NULL);
+	if (ret) {
+		TC_ERROR("Cannot accept (%d)\n", ret);
+		return false;
+	}
+
+	ret = net_context_get(AF_INET6, SOCK_STREAM, IPPROTO_TCP,
+			      &bench_client);
+	if (ret) {
+		TC_ERROR("Cannot get client context (%d)\n", ret);
+		return false;
+	}
+
+	ret = net_context_bind(bench_client, (struct sockaddr *)&client_addr,
+			       sizeof(client_addr));
+	if (ret) {
+		TC_ERROR("Cannot bind client context (%d)\n", ret);
+		return false;
+	}
+
+	ret = net_context_connect(bench_client,
+				  (struct sockaddr *)&server_addr,
+				  sizeof(server_addr), NULL,
+				  WAIT_TIME_LONG, NULL);
+	if (ret) {
+		TC_ERROR("Cannot connect (%d)\n", ret);
+		return false;
+	}
+
+	if (k_sem_take(&bench_wait, WAIT_TIME_LONG) || !bench_server) {
+		TC_ERROR("Connection not accepted\n");
+		return false;
+	}
+
+	ret = net_context_recv(bench_server, bench_recv_cb, K_NO_WAIT, NULL);
+	if (ret) {
+		TC_ERROR("Cannot receive (%d)\n", ret);
+		return false;
+	}
+
+	return true;
+}
+
+static bool bench_transfer(size_t write_len, size_t window)
+{
+	static u8_t data[BENCH_WRITE_MAX];
+	u32_t start, cycles, writes = 0;
+	size_t sent = 0;
+	int ret;
+
+	bench_received = 0;
+	bench_segs = 0;
+	bench_acks = 0;
+	bench_drops = 0;
+	bench_rexmits = 0;
+	bench_high_seq = 0;
+
+	start = k_cycle_get_32();
+
+	while (sent < BENCH_BYTES) {
+		struct net_pkt *pkt;
+
+		while (sent - bench_received > window) {
+			if (k_sem_take(&bench_wait, WAIT_TIME_LONG)) {
+				TC_ERROR("Transfer stalled at %zu bytes\n",
+					 bench_received);
+				return false;
+			}
+		}
+
+		pkt = net_pkt_get_tx(bench_client, K_FOREVER);
+		if (net_pkt_append(pkt, write_len, data, K_FOREVER) !=
+		    write_len) {
+			TC_ERROR("Cannot append data\n");
+			net_pkt_unref(pkt);
+			return false;
+		}
+
+		ret = net_context_send(pkt, NULL, K_NO_WAIT, NULL, NULL);
+		if (ret < 0) {
+			TC_ERROR("Send failed (%d)\n", ret);
+			net_pkt_unref(pkt);
+			return false;
+		}
+
+		sent += write_len;
+		writes++;
+	}
+
+	while (bench_received < sent) {
+		if (k_sem_take(&bench_wait, WAIT_TIME_LONG)) {
+			TC_ERROR("Transfer stalled at %zu bytes\n",
+				 bench_received);
+			return false;
+		}
+	}
+
+	cycles = k_cycle_get_32() - start;
+
+	TC_PRINT("%4zu byte writes: %u segments, %u ACKs, %u KiB/s, "
+		 "%u kcycles/MiB\n", write_len, bench_segs, bench_acks,
+		 (u32_t)((u64_t)sent * sys_clock_hw_cycles_per_sec /
+			 cycles / 1024),
+		 (u32_t)((u64_t)cycles * 1024 / sent));
+
+	if (bench_received != sent) {
+		TC_ERROR("Received %zu bytes, sent %zu\n", bench_received,
+			 sent);
+		return false;
+	}
+
+	/* Small writes must have been merged while data was in flight */
+	if (IS_ENABLED(CONFIG_NET_TCP_NAGLE) && write_len < 128 &&
+	    bench_segs >= writes) {
+		TC_ERROR("%u writes sent in %u segments\n", writes, bench_segs);
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_bench_throughput(void)
+{
+	static const size_t write_lens[] = { 64, 512, BENCH_WRITE_MAX };
+	struct net_buf_pool *rx_data, *tx_data;
+	struct k_mem_slab *rx, *tx;
+	bool ok = true;
+	int i;
+
+	TC_PRINT("fast path %s, Nagle %s, ACK delay %d ms\n",
+		 IS_ENABLED(CONFIG_NET_TCP_FAST_PATH) ? "on" : "off",
+		 IS_ENABLED(CONFIG_NET_TCP_NAGLE) ? "on" : "off",
+		 CONFIG_NET_TCP_ACK_DELAY);
+
+	net_pkt_get_info(&rx, &tx, &rx_data, &tx_data);
+
+#if defined(CONFIG_NET_BUF_POOL_STATS)
+	net_buf_pool_stats_reset(tx_data);
+#endif
+
+	for (i = 0; i < ARRAY_SIZE(write_lens) && ok; i++) {
+		ok = bench_transfer(write_lens[i], BENCH_WINDOW);
+	}
+
+#if defined(CONFIG_NET_BUF_VARIABLE_DATA_SIZE)
+	TC_PRINT("TX data: %d byte pool, size classes %d/%d/%d\n",
+		 CONFIG_NET_BUF_DATA_POOL_SIZE, NET_PKT_FRAG_SMALL,
+		 NET_PKT_FRAG_MEDIUM, NET_PKT_FRAG_LARGE);
+#else
+	TC_PRINT("TX data: %d byte pool, %d byte fragments\n",
+		 CONFIG_NET_BUF_TX_COUNT * CONFIG_NET_BUF_DATA_SIZE,
+		 CONFIG_NET_BUF_DATA_SIZE);
+#endif
+
+#if defined(CONFIG_NET_BUF_POOL_STATS)
+	{
+		struct net_buf_pool_stats stats;
+
+		net_buf_pool_stats_get(tx_data, &stats);
+
+		TC_PRINT("TX data: %u fragments at peak, %u allocations, "
+			 "%u failed\n", stats.peak, stats.allocs,
+			 stats.failures);
+	}
+#endif
+
+	return ok;
+}
+
+static bool test_bench_lossy(void)
+{
+	bool ok;
+
+	TC_PRINT("congestion control %s, window scaling %s, SACK %s\n",
+		 IS_ENABLED(CONFIG_NET_TCP_CONGESTION_CONTROL) ? "on" : "off",
+		 IS_ENABLED(CONFIG_NET_TCP_WINDOW_SCALE) ? "on" : "off",
+		 IS_ENABLED(CONFIG_NET_TCP_SACK) ? "on" : "off");
+
+	bench_lossy = true;
+	ok = bench_transfer(BENCH_WRITE_MAX, BENCH_LOSSY_WINDOW);
+	bench_lossy = false;
+
+	TC_PRINT("%u segments lost, %u retransmitted\n", bench_drops,
+		 bench_rexmits);
+
+	if (ok && bench_drops && !bench_rexmits) {
+		TC_ERROR("Lost segments were not retransmitted\n");
+		return false;
+	}
+
+	/* Let the link drain before the connection is closed */
+	k_sleep(2 * BENCH_DELAY_MS);
+
+	return ok;
+}
+
+static bool test_bench_close(void)
+{
+	net_context_put(bench_client);
+	net_context_put(bench_listen);
+
+	if (bench_server) {
+		net_context_put(bench_server);
+	}
+
+	/* Let the connection close before the drivers stop looping */
+	k_sleep(WAIT_TIME);
+	bench_running = false;
+
+	return true;
+}
+
 static bool test_init(void)
 {
 	struct net_if_addr *ifaddr;
@@ -1737,6 +2186,10 @@ static const struct {
 	{ "test TCP seq validity", test_tcp_seq_validity },
 	{ "test TCP reply context init", test_init_tcp_reply_context },
 	{ "test TCP accept init", test_init_tcp_accept },
+	{ "test TCP loopback connection", test_bench_connect },
+	{ "test TCP loopback throughput", test_bench_throughput },
+	{ "test TCP lossy link goodput", test_bench_lossy },
+	{ "test TCP loopback close", test_bench_close },
 #if 0
 	/* TBD: more tests are needed */
 	{ "test TCP connect init", test_init_tcp_connect },
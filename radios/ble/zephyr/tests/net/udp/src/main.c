@@ -746,9 +746,100 @@ void test_udp(void)
 	zassert_false(test_failed, "udp tests failed");
 }
 
+#define BENCH_PKTS 128
+#define BENCH_SERVER_PORT 5683
+
+static u32_t bench_hits;
+
+static enum net_verdict bench_recv(struct net_conn *conn,
+				   struct net_pkt *pkt,
+				   void *user_data)
+{
+	if (POINTER_TO_UINT(user_data) ==
+	    ntohs(NET_UDP_HDR(pkt)->src_port)) {
+		bench_hits++;
+	}
+
+	return NET_OK;
+}
+
+void test_demux_benchmark(void)
+{
+	struct net_conn_handle *handles[CONFIG_NET_MAX_CONN];
+	struct in6_addr in6addr_my = { { { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+					   0, 0, 0, 0, 0, 0, 0, 0x1 } } };
+	struct in6_addr in6addr_peer = { { { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0,
+					     0, 0, 0, 0, 0x4e, 0x11, 0, 0,
+					     0x2 } } };
+	struct sockaddr_in6 peer_addr6 = { .sin6_family = AF_INET6 };
+	struct sockaddr_in6 my_addr6 = { .sin6_family = AF_INET6 };
+	struct net_conn_handle *listener;
+	struct net_pkt *pkt;
+	u32_t start, cycles;
+	int n, i, ret;
+
+	net_ipaddr_copy(&peer_addr6.sin6_addr, &in6addr_peer);
+	net_ipaddr_copy(&my_addr6.sin6_addr, &in6addr_my);
+
+	pkt = net_pkt_get_reserve_rx(0, K_FOREVER);
+	net_pkt_frag_add(pkt, net_pkt_get_frag(pkt, K_FOREVER));
+	net_pkt_set_iface(pkt, net_if_get_default());
+	net_pkt_set_family(pkt, AF_INET6);
+	setup_ipv6_udp(pkt, &in6addr_peer, &in6addr_my, 0, BENCH_SERVER_PORT);
+
+	/* A server socket, plus one connected socket per client */
+	ret = net_udp_register(NULL, (struct sockaddr *)&my_addr6, 0,
+			       BENCH_SERVER_PORT, test_fail, NULL, &listener);
+	zassert_equal(ret, 0, "Cannot register listener");
+
+	for (n = 1; n < CONFIG_NET_MAX_CONN; n++) {
+		ret = net_udp_register((struct sockaddr *)&peer_addr6,
+				       (struct sockaddr *)&my_addr6,
+				       1000 + n, BENCH_SERVER_PORT,
+				       bench_recv, UINT_TO_POINTER(1000 + n),
+				       &handles[n]);
+		zassert_equal(ret, 0, "Cannot register client");
+
+		if (n != 1 && n != 8 && n != 32 &&
+		    n != CONFIG_NET_MAX_CONN - 1) {
+			continue;
+		}
+
+		bench_hits = 0;
+		cycles = 0;
+
+		for (i = 0; i < BENCH_PKTS; i++) {
+			NET_UDP_HDR(pkt)->src_port = htons(1000 + 1 + i % n);
+
+			start = k_cycle_get_32();
+			ret = net_conn_input(IPPROTO_UDP, pkt);
+			cycles += k_cycle_get_32() - start;
+
+			zassert_equal(ret, NET_OK, "Packet not delivered");
+		}
+
+		zassert_equal(bench_hits, BENCH_PKTS, "Wrong handler");
+
+		TC_PRINT("%2d connections: %u cycles per packet\n", n + 1,
+			 cycles / BENCH_PKTS);
+	}
+
+	/* Removing the clients leaves the listener */
+	for (n = 1; n < CONFIG_NET_MAX_CONN; n++) {
+		zassert_equal(net_udp_unregister(handles[n]), 0,
+			      "Cannot unregister client");
+	}
+
+	zassert_equal(net_udp_unregister(listener), 0,
+		      "Cannot unregister listener");
+
+	net_pkt_unref(pkt);
+}
+
 void test_main(void)
 {
 	ztest_test_suite(test_udp_fn,
-		ztest_unit_test(test_udp));
+		ztest_unit_test(test_udp),
+		ztest_unit_test(test_demux_benchmark));
 	ztest_run_test_suite(test_udp_fn);
 }
@@ -5,9 +5,13 @@
  */
 
 #include <ztest.h>
+#include <tc_util.h>
 #include <flash.h>
 #include <dfu/flash_img.h>
 
+#define UPLOAD_LEN	(16 * 1024)
+#define UPLOAD_CHUNK	128
+
 void test_collecting(void)
 {
 	struct device *flash_dev;
@@ -46,9 +50,151 @@ void test_collecting(void)
 	}
 }
 
+/* Spans larger than the block buffer, which are partly written from the
+ * caller's buffer and partly collected in the context, from an aligned
+ * and from an odd address
+ */
+void test_spans(void)
+{
+	struct device *flash_dev;
+	struct flash_img_context ctx;
+	static u8_t buf[CONFIG_IMG_BLOCK_BUF_SIZE * 2 + 100 + 1] __aligned(4);
+	size_t len = sizeof(buf) - 1;
+	u32_t i, j, odd;
+	u8_t *data;
+	u8_t temp;
+
+	flash_dev = device_get_binding(FLASH_DEV_NAME);
+
+	for (odd = 0; odd < 2; odd++) {
+		data = buf + odd;
+
+		flash_write_protection_set(flash_dev, false);
+		flash_erase(flash_dev, FLASH_AREA_IMAGE_1_OFFSET,
+			    FLASH_AREA_IMAGE_1_SIZE);
+		flash_write_protection_set(flash_dev, true);
+
+		flash_img_init(&ctx, flash_dev);
+
+		for (i = 0; i < 3; i++) {
+			for (j = 0; j < len; j++) {
+				data[j] = i * len + j + odd;
+			}
+
+			zassert_equal(flash_img_buffered_write(&ctx, data,
+							       len, false),
+				      0, "write failed");
+			zassert_equal(flash_img_bytes_written(&ctx) %
+				      CONFIG_IMG_BLOCK_BUF_SIZE, 0,
+				      "partial block written");
+		}
+
+		zassert_equal(flash_img_buffered_write(&ctx, data, 0, true),
+			      0, "flush failed");
+		zassert_equal(flash_img_bytes_written(&ctx), 3 * len,
+			      "wrong length");
+
+		for (i = 0; i < 3 * len; i++) {
+			zassert_equal(flash_read(flash_dev,
+						 FLASH_AREA_IMAGE_1_OFFSET + i,
+						 &temp, 1), 0,
+				      "flash_read failed");
+			zassert_equal(temp, (u8_t)(i + odd), "wrong data");
+		}
+	}
+}
+
+/* Upload over a slot that still holds an old image, the way mcumgr does */
+void test_upload(void)
+{
+	struct device *flash_dev;
+	struct flash_img_context ctx;
+	static u8_t data[UPLOAD_CHUNK];
+	u32_t start, total, cycles, worst = 0;
+	u32_t i, j;
+	u8_t temp;
+#if defined(CONFIG_IMG_STREAM_SHA256)
+	struct tc_sha256_state_struct sha256;
+	u8_t expected[TC_SHA256_DIGEST_SIZE];
+	u8_t digest[TC_SHA256_DIGEST_SIZE];
+
+	tc_sha256_init(&sha256);
+#endif
+
+	flash_dev = device_get_binding(FLASH_DEV_NAME);
+
+	memset(data, 0x00, sizeof(data));
+	flash_write_protection_set(flash_dev, false);
+	zassert_equal(flash_write(flash_dev, FLASH_AREA_IMAGE_1_OFFSET, data,
+				  sizeof(data)), 0, "flash_write failed");
+	flash_write_protection_set(flash_dev, true);
+
+	total = k_cycle_get_32();
+
+#if !defined(CONFIG_IMG_ERASE_PROGRESSIVELY)
+	flash_write_protection_set(flash_dev, false);
+	flash_erase(flash_dev, FLASH_AREA_IMAGE_1_OFFSET,
+		    FLASH_AREA_IMAGE_1_SIZE);
+	flash_write_protection_set(flash_dev, true);
+	worst = k_cycle_get_32() - total;
+#endif
+
+	flash_img_init(&ctx, flash_dev);
+#if defined(CONFIG_IMG_STREAM_SHA256)
+	flash_img_hash_start(&ctx, UPLOAD_LEN);
+#endif
+
+	for (i = 0; i < UPLOAD_LEN; i += sizeof(data)) {
+		for (j = 0; j < sizeof(data); j++) {
+			data[j] = (i + j) * 7;
+		}
+
+#if defined(CONFIG_IMG_STREAM_SHA256)
+		tc_sha256_update(&sha256, data, sizeof(data));
+#endif
+
+		start = k_cycle_get_32();
+		zassert_equal(flash_img_buffered_write(&ctx, data,
+						       sizeof(data), false),
+			      0, "write failed");
+		cycles = k_cycle_get_32() - start;
+
+		if (cycles > worst) {
+			worst = cycles;
+		}
+	}
+
+	zassert_equal(flash_img_buffered_write(&ctx, data, 0, true), 0,
+		      "flush failed");
+
+	total = k_cycle_get_32() - total;
+
+	TC_PRINT("%u bytes in %u ms, worst request %u us\n", UPLOAD_LEN,
+		 (u32_t)(SYS_CLOCK_HW_CYCLES_TO_NS64(total) / NSEC_PER_USEC /
+			 USEC_PER_MSEC),
+		 (u32_t)(SYS_CLOCK_HW_CYCLES_TO_NS64(worst) / NSEC_PER_USEC));
+
+	for (i = 0; i < UPLOAD_LEN; i++) {
+		zassert_equal(flash_read(flash_dev,
+					 FLASH_AREA_IMAGE_1_OFFSET + i,
+					 &temp, 1), 0, "flash_read failed");
+		zassert_equal(temp, (u8_t)(i * 7), "wrong data");
+	}
+
+#if defined(CONFIG_IMG_STREAM_SHA256)
+	tc_sha256_final(expected, &sha256);
+	zassert_equal(flash_img_hash_finish(&ctx, digest), 0,
+		      "no digest");
+	zassert_equal(memcmp(digest, expected, sizeof(digest)), 0,
+		      "wrong digest");
+#endif
+}
+
 void test_main(void)
 {
 	ztest_test_suite(test_util,
-			ztest_unit_test(test_collecting));
+			ztest_unit_test(test_collecting),
+			ztest_unit_test(test_spans),
+			ztest_unit_test(test_upload));
 	ztest_run_test_suite(test_util);
 }